@@ -43,6 +43,7 @@ typedef struct Context_Extra {
 // #include "oogabooga/examples/audio_test.c"
 // #include "oogabooga/examples/custom_shader.c"
 //#include "oogabooga/examples/growing_array_example.c"
+// #include "oogabooga/examples/draw_replay.c"
 
 // This is where you swap in your own project!
 #include "entry_survival.c"
@@ -806,7 +806,9 @@ int entry(int argc, char** argv)
 	float zoom = 5;
 	Vector2 camera_pos = v2_zero;
 
-	f64 last_time = os_get_current_time_in_seconds();
+	// Runs at the display's refresh rate instead of as fast as it can
+	Frame_Pacer pacer;
+	frame_pacer_init(&pacer, 0);
 	f32 count_second = 0;
 	int32 frame_counter = 0;
 	string last_fps = alloc_string(get_heap_allocator(), 1);
@@ -815,10 +817,8 @@ int entry(int argc, char** argv)
 	{
 		reset_temporary_storage();
 
-		f64 now = os_get_current_time_in_seconds();
-		f64 delta_t = now - last_time;
+		f64 delta_t = frame_pacer_wait(&pacer);
 		context.extra.delta_t = delta_t;
-		last_time = now;
 		os_update();
 		update_timers();
 
@@ -0,0 +1,255 @@
+///
+// Async file IO
+// Reads and writes run on a few worker threads, so the thread that submits them doesn't block
+// and opening & reading many files overlaps instead of happening one after another.
+//
+//     Async_Io_Request requests[2] = {0};
+//     requests[0].kind = ASYNC_IO_READ_ENTIRE_FILE;
+//     requests[0].path = STR("player.png");
+//     requests[0].allocator = get_heap_allocator();
+//     requests[1] = ...
+//     async_io_submit(requests, 2);
+//     ... do other stuff ...
+//     async_io_wait(requests, 2);
+//     if (requests[0].state == ASYNC_IO_DONE) { requests[0].data is the file }
+//
+// Or give requests a callback and call async_io_poll() every frame. Callbacks are run from
+// there, on the thread that polls, so they can do things that aren't thread safe.
+//
+// Requests are owned by you and must stay where they are until they are complete, and until
+// their callback has run if they have one. Same goes for the path and the data to write.
+// Allocators in requests are used from the worker threads so they must be thread safe (the
+// heap allocator is, temp allocators are not).
+//
+// Workers are started on the first submit with ASYNC_IO_DEFAULT_THREAD_COUNT threads. Call
+// async_io_init() before that if you want another number.
+
+#define ASYNC_IO_DEFAULT_THREAD_COUNT 4
+#define ASYNC_IO_MAX_THREADS 32
+#define ASYNC_IO_WAIT_SPIN_COUNT 64
+
+typedef enum Async_Io_Kind {
+	ASYNC_IO_READ_ENTIRE_FILE,  // path -> data, allocated with allocator
+	ASYNC_IO_WRITE_ENTIRE_FILE, // data -> path, replacing the file
+	ASYNC_IO_READ,              // file at offset -> data.data, up to data.count bytes
+	ASYNC_IO_WRITE,             // data -> file at offset
+} Async_Io_Kind;
+
+typedef enum Async_Io_State {
+	ASYNC_IO_NOT_SUBMITTED = 0,
+	ASYNC_IO_PENDING,
+	ASYNC_IO_DONE,
+	ASYNC_IO_FAILED,
+} Async_Io_State;
+
+typedef struct Async_Io_Request Async_Io_Request;
+
+typedef void(*Async_Io_Callback)(Async_Io_Request *request);
+
+typedef struct Async_Io_Request {
+	// Set these before submitting
+	Async_Io_Kind kind;
+	string path;
+	File file;
+	u64 offset;
+	string data;
+	Allocator allocator;
+	Async_Io_Callback callback; // Optional
+	void *userdata;
+
+	// Set when complete. Use async_io_is_complete() to check from another thread than the
+	// one that waited.
+	volatile u32 state; // Async_Io_State
+	u64 bytes_transferred;
+
+	Async_Io_Request *next; // Internal
+} Async_Io_Request;
+
+typedef struct Async_Io {
+	volatile bool initted;
+	Thread threads[ASYNC_IO_MAX_THREADS];
+	u64 thread_count;
+
+	Spinlock queue_lock;
+	Async_Io_Request *queue_first;
+	Async_Io_Request *queue_last;
+	volatile u32 queue_generation; // Bumped on every submit, idle workers sleep on it
+
+	Spinlock completed_lock;
+	Async_Io_Request *completed_first; // Requests with callbacks waiting for async_io_poll()
+	Async_Io_Request *completed_last;
+} Async_Io;
+
+// #Global
+ogb_instance Async_Io async_io;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Async_Io async_io = {0};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void
+_async_io_execute(Async_Io_Request *r) {
+	bool ok = false;
+	u64 bytes_transferred = 0;
+
+	switch (r->kind) {
+		case ASYNC_IO_READ_ENTIRE_FILE: {
+			r->data = (string){0};
+			ok = os_read_entire_file_s(r->path, &r->data, r->allocator);
+			if (ok) {
+				bytes_transferred = r->data.count;
+			} else {
+				// Still allocated on a short read
+				if (r->data.data) dealloc(r->allocator, r->data.data);
+				r->data = (string){0};
+			}
+			break;
+		}
+		case ASYNC_IO_WRITE_ENTIRE_FILE: {
+			ok = os_write_entire_file_s(r->path, r->data);
+			if (ok) bytes_transferred = r->data.count;
+			break;
+		}
+		case ASYNC_IO_READ: {
+			ok = os_file_read_at(r->file, r->offset, r->data.data, r->data.count, &bytes_transferred);
+			break;
+		}
+		case ASYNC_IO_WRITE: {
+			ok = os_file_write_at(r->file, r->offset, r->data.data, r->data.count);
+			if (ok) bytes_transferred = r->data.count;
+			break;
+		}
+		default: {
+			assert(false, "Invalid Async_Io_Kind %d", r->kind);
+			break;
+		}
+	}
+
+	// The request may be gone the moment its state is set, unless it has a callback
+	Async_Io_Callback callback = r->callback;
+
+	r->bytes_transferred = bytes_transferred;
+	atomic_store_32(&r->state, ok ? ASYNC_IO_DONE : ASYNC_IO_FAILED, MEMORY_ORDER_RELEASE);
+	os_wake_address_all(&r->state);
+
+	if (callback) {
+		spinlock_acquire_or_wait(&async_io.completed_lock);
+		r->next = 0;
+		if (async_io.completed_last) async_io.completed_last->next = r;
+		else                         async_io.completed_first = r;
+		async_io.completed_last = r;
+		spinlock_release(&async_io.completed_lock);
+	}
+}
+
+void
+_async_io_thread_proc(Thread *t) {
+	while (true) {
+		u32 generation = atomic_load_32(&async_io.queue_generation, MEMORY_ORDER_ACQUIRE);
+
+		spinlock_acquire_or_wait(&async_io.queue_lock);
+		Async_Io_Request *r = async_io.queue_first;
+		if (r) {
+			async_io.queue_first = r->next;
+			if (!async_io.queue_first) async_io.queue_last = 0;
+		}
+		spinlock_release(&async_io.queue_lock);
+
+		if (!r) {
+			// Returns right away if something was submitted since we looked
+			os_wait_on_address_32(&async_io.queue_generation, generation);
+			continue;
+		}
+
+		_async_io_execute(r);
+
+		reset_temporary_storage();
+	}
+}
+
+// Starts the worker threads. Does nothing if they're already started.
+void
+async_io_init(u64 thread_count) {
+	assert(thread_count > 0 && thread_count <= ASYNC_IO_MAX_THREADS, "async_io thread_count must be 1-%d", ASYNC_IO_MAX_THREADS);
+
+	if (!compare_and_swap_bool(&async_io.initted, true, false)) return;
+
+	async_io.thread_count = thread_count;
+	for (u64 i = 0; i < thread_count; i++) {
+		os_thread_init(&async_io.threads[i], _async_io_thread_proc);
+		async_io.threads[i].name = STR("Async IO");
+		os_thread_start(&async_io.threads[i]);
+	}
+}
+
+// Queues the requests for the workers, all in one go.
+void
+async_io_submit(Async_Io_Request *requests, u64 count) {
+	if (!async_io.initted) async_io_init(ASYNC_IO_DEFAULT_THREAD_COUNT);
+	if (count == 0) return;
+
+	for (u64 i = 0; i < count; i++) {
+		Async_Io_Request *r = &requests[i];
+		assert(r->state != ASYNC_IO_PENDING, "Async_Io_Request was submitted again before it completed");
+		r->state = ASYNC_IO_PENDING;
+		r->bytes_transferred = 0;
+		r->next = i+1 < count ? &requests[i+1] : 0;
+	}
+
+	spinlock_acquire_or_wait(&async_io.queue_lock);
+	if (async_io.queue_last) async_io.queue_last->next = &requests[0];
+	else                     async_io.queue_first = &requests[0];
+	async_io.queue_last = &requests[count-1];
+	spinlock_release(&async_io.queue_lock);
+
+	atomic_fetch_add_32(&async_io.queue_generation, 1, MEMORY_ORDER_RELEASE);
+	if (count == 1) os_wake_address_single(&async_io.queue_generation);
+	else            os_wake_address_all(&async_io.queue_generation);
+}
+
+bool
+async_io_is_complete(Async_Io_Request *request) {
+	u32 state = atomic_load_32(&request->state, MEMORY_ORDER_ACQUIRE);
+	return state == ASYNC_IO_DONE || state == ASYNC_IO_FAILED;
+}
+
+// Blocks until all the requests are complete. Callbacks are still only run by async_io_poll().
+void
+async_io_wait(Async_Io_Request *requests, u64 count) {
+	for (u64 i = 0; i < count; i++) {
+		Async_Io_Request *r = &requests[i];
+		u32 spins = 0;
+		while (true) {
+			u32 state = atomic_load_32(&r->state, MEMORY_ORDER_ACQUIRE);
+			if (state != ASYNC_IO_PENDING) break;
+			// Small requests finish in microseconds, so spin for a bit before going to sleep
+			if (spins < ASYNC_IO_WAIT_SPIN_COUNT) {
+				spins += 1;
+				os_yield_thread();
+				continue;
+			}
+			os_wait_on_address_32(&r->state, state);
+		}
+	}
+}
+
+// Runs the callbacks of requests that completed since last poll, in the order they completed.
+// Returns how many it ran.
+u64
+async_io_poll() {
+	spinlock_acquire_or_wait(&async_io.completed_lock);
+	Async_Io_Request *r = async_io.completed_first;
+	async_io.completed_first = 0;
+	async_io.completed_last = 0;
+	spinlock_release(&async_io.completed_lock);
+
+	u64 count = 0;
+	while (r) {
+		// The callback may free or resubmit the request
+		Async_Io_Request *next = r->next;
+		r->callback(r);
+		r = next;
+		count += 1;
+	}
+	return count;
+}
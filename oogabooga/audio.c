@@ -38,6 +38,10 @@
 	player->config.volume                = ...; // (1.0 by default)
 	player->config.playback_speed        = ...; // (1.0 by default)
 	
+		or, to change several at once without the audio thread seeing a half-written config:
+		
+	void    audio_player_set_config(Audio_Player *p, Audio_Playback_Config config);
+	
 */
 
 
@@ -137,14 +141,12 @@ typedef struct Audio_Source {
 		stb_vorbis *ogg;
 	};
 	
-	// #Memory #Incomplete #StbVorbisFileStream
+	// #StbVorbisFileStream
 	// I tried replacing the stdio stuff in stb_vorbis with oogabooga file api, but now
 	// stb_vorbis is shitting itself.
-	// So, for now, we're just reading the file into memory and then streaming from that
-	// memory.
-	// Luckily, ogg compression is pretty good so it's not going to completely butcher
-	// memory usage, but it's definitely suboptimal.
-	string ogg_raw;
+	// So instead the file is mapped into memory and stb_vorbis streams from that, which
+	// means pages are only read in as they are decoded and the OS can drop them again.
+	Os_File_Map ogg_file;
 	
 	// For memory source
 	void *pcm_frames;
@@ -577,15 +579,18 @@ audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format for
 	} else if (check_ogg_header(header)) {
 		src->decoder = AUDIO_DECODER_OGG;
 		
-		ok = os_read_entire_file(path, &src->ogg_raw, src->allocator);
+		ok = os_file_map(path, &src->ogg_file, OS_FILE_MAP_ACCESS_SEQUENTIAL);
 		if (!ok) return false;
 		
 		third_party_allocator = src->allocator;
 		int err = 0;
-		src->ogg = stb_vorbis_open_memory(src->ogg_raw.data, src->ogg_raw.count, &err, 0);
+		src->ogg = stb_vorbis_open_memory(src->ogg_file.data.data, src->ogg_file.data.count, &err, 0);
 		third_party_allocator = ZERO(Allocator);
 		
-		if (err != 0 || src->ogg == 0) return false;
+		if (err != 0 || src->ogg == 0) {
+			os_file_unmap(&src->ogg_file);
+			return false;
+		}
 		
 		third_party_allocator = src->allocator;
 		src->number_of_frames = stb_vorbis_stream_length_in_samples(src->ogg);
@@ -636,15 +641,18 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 	} else if (check_ogg_header(header)) {
 		src->decoder = AUDIO_DECODER_OGG;
 		
-		ok = os_read_entire_file(path, &src->ogg_raw, src->allocator);
+		ok = os_file_map(path, &src->ogg_file, OS_FILE_MAP_ACCESS_SEQUENTIAL | OS_FILE_MAP_PREFETCH);
 		if (!ok) return false;
 		
 		third_party_allocator = src->allocator;
 		int err = 0;
-		src->ogg = stb_vorbis_open_memory(src->ogg_raw.data, src->ogg_raw.count, &err, 0);
+		src->ogg = stb_vorbis_open_memory(src->ogg_file.data.data, src->ogg_file.data.count, &err, 0);
 		third_party_allocator = ZERO(Allocator);
 		
-		if (err != 0 || src->ogg == 0) return false;
+		if (err != 0 || src->ogg == 0) {
+			os_file_unmap(&src->ogg_file);
+			return false;
+		}
 		
 		third_party_allocator = src->allocator;
 		src->number_of_frames = stb_vorbis_stream_length_in_samples(src->ogg);
@@ -662,6 +670,7 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 		third_party_allocator = src->allocator;
 		stb_vorbis_close(src->ogg);
 		third_party_allocator = ZERO(Allocator);
+		os_file_unmap(&src->ogg_file);
 		
 		if (retrieved != src->number_of_frames) {
 			dealloc(src->allocator, src->pcm_frames);
@@ -697,7 +706,7 @@ audio_source_destroy(Audio_Source *src) {
 				}
 				case AUDIO_DECODER_OGG: {
 					stb_vorbis_close(src->ogg);
-					dealloc_string(src->allocator, src->ogg_raw);
+					os_file_unmap(&src->ogg_file);
 					break;
 				}
 			}
@@ -1175,8 +1184,10 @@ typedef struct Audio_Player {
 	DEPRECATED(float32 volume, "Use player->config.volume instead");
 	DEPRECATED(float32 playback_speed, "Use player->config.playback_speed instead");
 	
-	// This is safe to set whenever
+	// This is safe to set whenever, but the audio thread may see a mix of old and new
+	// fields. Use audio_player_set_config() to set it as a whole.
 	Audio_Playback_Config config;
+	Seqlock config_lock;
 	
 } Audio_Player;
 #define AUDIO_PLAYERS_PER_BLOCK 128
@@ -1238,6 +1249,10 @@ audio_player_release(Audio_Player *p) {
 	p->marked_for_release = true;
 }
 void
+audio_player_set_config(Audio_Player *p, Audio_Playback_Config config) {
+	seqlock_write(&p->config_lock, &p->config, &config, sizeof(config));
+}
+void
 audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
 
 	if (p->state == state) return;
@@ -1362,12 +1377,48 @@ audio_player_set_looping(Audio_Player *p, bool looping) {
 // #Global
 ogb_instance Hash_Table just_audio_clips;
 ogb_instance bool just_audio_clips_initted;
+ogb_instance Rw_Lock just_audio_clips_lock;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Hash_Table just_audio_clips;
 bool just_audio_clips_initted = false;
+Rw_Lock just_audio_clips_lock = {0};
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
+// Clips are looked up every time one is played but only loaded once, so lookups
+// share a read lock and only a miss takes the write lock.
+bool
+just_audio_clips_get_or_open(string path, Audio_Source *result) {
+	rw_lock_read_acquire(&just_audio_clips_lock);
+	Audio_Source *src_ptr = just_audio_clips_initted ? hash_table_find(&just_audio_clips, path) : 0;
+	if (src_ptr) *result = *src_ptr;
+	rw_lock_read_release(&just_audio_clips_lock);
+	
+	if (src_ptr) return true;
+	
+	rw_lock_write_acquire(&just_audio_clips_lock);
+	
+	if (!just_audio_clips_initted) {
+		just_audio_clips_initted = true;
+		just_audio_clips = make_hash_table(string, Audio_Source, get_heap_allocator());
+	}
+	
+	// Someone might have opened it while we waited for the write lock
+	src_ptr = hash_table_find(&just_audio_clips, path);
+	bool ok = true;
+	if (src_ptr) {
+		*result = *src_ptr;
+	} else {
+		ok = audio_open_source_stream(result, path, get_heap_allocator());
+		if (ok) hash_table_add(&just_audio_clips, path, *result);
+	}
+	
+	rw_lock_write_release(&just_audio_clips_lock);
+	
+	if (!ok) log_error("Could not load audio to play from %s", path);
+	return ok;
+}
+
 void
 DEPRECATED(play_one_audio_clip_source_at_position(Audio_Source source, Vector3 pos), "Use play_one_audio_clip_source_with_config() instead") {
 	Audio_Player *p = audio_player_get_one();
@@ -1383,7 +1434,7 @@ play_one_audio_clip_source_with_config(Audio_Source source, Audio_Playback_Confi
 	Audio_Player *p = audio_player_get_one();
 	audio_player_set_source(p, source);
 	audio_player_set_state(p, AUDIO_PLAYER_STATE_PLAYING);
-	p->config = config;
+	audio_player_set_config(p, config);
 	p->release_when_done = true;
 }
 
@@ -1396,46 +1447,15 @@ play_one_audio_clip_source(Audio_Source source) {
 }
 void
 DEPRECATED(play_one_audio_clip_at_position(string path, Vector3 pos), "Use play_one_audio_clip_with_config() instead") {
-	if (!just_audio_clips_initted) {
-		just_audio_clips_initted = true;
-		just_audio_clips = make_hash_table(string, Audio_Source, get_heap_allocator());
-	}
-	
-	Audio_Source *src_ptr = hash_table_find(&just_audio_clips, path);
-	if (src_ptr) {
-		play_one_audio_clip_source_at_position(*src_ptr, pos);
-	} else {
-		Audio_Source new_src;
-		bool ok = audio_open_source_stream(&new_src, path, get_heap_allocator());
-		if (!ok) {
-			log_error("Could not load audio to play from %s", path);
-			return;
-		}
-		hash_table_add(&just_audio_clips, path, new_src);
-		play_one_audio_clip_source_at_position(new_src, pos);
-	}
-	
+	Audio_Source src;
+	if (!just_audio_clips_get_or_open(path, &src)) return;
+	play_one_audio_clip_source_at_position(src, pos);
 }
 void
 play_one_audio_clip_with_config(string path, Audio_Playback_Config config) {
-	if (!just_audio_clips_initted) {
-		just_audio_clips_initted = true;
-		just_audio_clips = make_hash_table(string, Audio_Source, get_heap_allocator());
-	}
-	
-	Audio_Source *src_ptr = hash_table_find(&just_audio_clips, path);
-	if (src_ptr) {
-		play_one_audio_clip_source_with_config(*src_ptr, config);
-	} else {
-		Audio_Source new_src;
-		bool ok = audio_open_source_stream(&new_src, path, get_heap_allocator());
-		if (!ok) {
-			log_error("Could not load audio to play from %s", path);
-			return;
-		}
-		hash_table_add(&just_audio_clips, path, new_src);
-		play_one_audio_clip_source_with_config(new_src, config);
-	}
+	Audio_Source src;
+	if (!just_audio_clips_get_or_open(path, &src)) return;
+	play_one_audio_clip_source_with_config(src, config);
 }
 void inline
 play_one_audio_clip(string path) {
@@ -1660,6 +1680,9 @@ void
 do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format, 
 							 void *output) {
 							 
+	u64 mix_start = rdtsc();
+	u64 active_players = 0;
+	
 	reset_temporary_storage();
 							 
 	u64 out_comp_size  = get_audio_bit_width_byte_size(out_format.bit_width);
@@ -1703,11 +1726,17 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 				if (p->fade_frames == 0) continue;
 			}
 			
+			// Snapshot so the whole mix uses one consistent config
+			Audio_Playback_Config config;
+			seqlock_read(&p->config_lock, &config, &p->config, sizeof(config));
+			
 			// #Incomplete Reverse playback ?
-			if (p->config.playback_speed <= 0.0) continue;
+			if (config.playback_speed <= 0.0) continue;
 			
 			if (p->frame_index >= p->source.number_of_frames && !p->looping) continue;
 			
+			active_players += 1;
+			
 			spinlock_acquire_or_wait(&p->sample_lock);
 			
 			Audio_Source src = p->source;
@@ -1715,7 +1744,7 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 			mutex_acquire_or_wait(&src.mutex_for_destroy);
 
 			Audio_Format sample_format = src.format;
-			sample_format.sample_rate = sample_format.sample_rate*p->config.playback_speed;
+			sample_format.sample_rate = sample_format.sample_rate*config.playback_speed;
 			
 			bool need_convert = !bytes_match(
 				&out_format, 
@@ -1872,11 +1901,11 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 				assert(converted == number_of_output_frames);
 			}
 
-			if (p->config.enable_spacialization) {
-				apply_audio_spacialization(mix_buffer, out_format, number_of_output_frames, p->config.position_ndc);
+			if (config.enable_spacialization) {
+				apply_audio_spacialization(mix_buffer, out_format, number_of_output_frames, config.position_ndc);
 			}
-			if (p->config.volume != 0.0) {
-				apply_audio_volume(mix_buffer, out_format, number_of_output_frames, p->config.volume);
+			if (config.volume != 0.0) {
+				apply_audio_volume(mix_buffer, out_format, number_of_output_frames, config.volume);
 			}
 			
 			mix_frames(output, mix_buffer, number_of_output_frames, out_format);
@@ -1886,4 +1915,8 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 		
 		block = block->next;
 	}
+	
+	metric_set(METRIC_AUDIO_ACTIVE_PLAYERS, (f64)active_players);
+	metric_add(METRIC_AUDIO_FRAMES_OUTPUT, (s64)number_of_output_frames);
+	metric_record(METRIC_AUDIO_MIX_US, (rdtsc()-mix_start)*1000000/os_get_tsc_frequency());
 }
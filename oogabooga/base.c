@@ -129,9 +129,17 @@ thread_local Context context;
 thread_local Context context_stack[CONTEXT_STACK_MAX];
 thread_local u64 num_contexts = 0;
 
+#if ENABLE_ALLOCATION_TRACING
+// Where alloc()/dealloc() was called from, for allocation events in the profiler
+thread_local void *_alloc_call_site = 0;
+#endif
+
 void* 
 alloc(Allocator allocator, u64 size) {
 	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+#if ENABLE_ALLOCATION_TRACING
+	_alloc_call_site = return_address();
+#endif
 	void *p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);
 #if DO_ZERO_INITIALIZATION
 	memset(p, 0, size);
@@ -142,12 +150,18 @@ alloc(Allocator allocator, u64 size) {
 void* 
 alloc_uninitialized(Allocator allocator, u64 size) {
 	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+#if ENABLE_ALLOCATION_TRACING
+	_alloc_call_site = return_address();
+#endif
 	return allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);	
 }
 
 void 
 dealloc(Allocator allocator, void *p) {
 	assert(p != 0, "You tried to deallocate a pointer at adress 0. That doesn't make sense!");
+#if ENABLE_ALLOCATION_TRACING
+	_alloc_call_site = return_address();
+#endif
 	allocator.proc(0, p, ALLOCATOR_DEALLOCATE, allocator.data);
 }
 
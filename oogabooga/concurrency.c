@@ -9,6 +9,10 @@ inline bool compare_and_swap_16(volatile uint16_t *a, uint16_t b, uint16_t old);
 inline bool compare_and_swap_32(volatile uint32_t *a, uint32_t b, uint32_t old);
 inline bool compare_and_swap_64(volatile uint64_t *a, uint64_t b, uint64_t old);
 inline bool compare_and_swap_bool(volatile bool *a, bool b, bool old);
+inline bool compare_and_swap_128(volatile Atomic_128 *a, Atomic_128 b, Atomic_128 old);
+
+// atomic_load/store/exchange/fetch_add/fetch_sub/fetch_and/fetch_or/fetch_xor_8/16/32/64
+// and atomic_fence take an explicit Memory_Order, see cpu.c.
 
 ///
 // Spinlock "primitive"
@@ -78,6 +82,148 @@ void ogb_instance
 binary_semaphore_signal(Binary_Semaphore *sem);
 
 
+///
+// Reader-writer lock
+// Any number of readers OR one writer. Writer preferred: once a writer is waiting, new
+// readers wait too so a steady stream of readers can't starve writers.
+// Spins for a little while and then sleeps on the state with os_wait_on_address_32, so
+// it needs no OS handle and uncontended read acquire/release is one CAS + one fetch_sub.
+// Not recursive, and a reader can't upgrade to a writer.
+#define RW_LOCK_WRITER          (1u << 31)
+#define RW_LOCK_WRITER_WAITING  (1u << 30)
+#define RW_LOCK_READER_MASK     (RW_LOCK_WRITER_WAITING-1)
+#define RW_LOCK_SPIN_COUNT 128
+typedef struct Rw_Lock {
+	volatile u32 state; // RW_LOCK_WRITER | RW_LOCK_WRITER_WAITING | number of readers
+	volatile u32 waiting_writers;
+} Rw_Lock;
+
+void ogb_instance
+rw_lock_init(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_read_acquire(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_read_release(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_write_acquire(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_write_release(Rw_Lock *l);
+
+
+///
+// Seqlock
+// For small POD state that is written rarely and read often (Audio_Playback_Config).
+// Readers never block writers and never write to shared memory; they copy the data and
+// retry if a write happened meanwhile. Multiple writers are serialized on the sequence.
+// Use seqlock_write/seqlock_read to copy whole structs, or the begin/end procedures
+// directly if you know what you're doing.
+typedef struct Seqlock {
+	volatile u32 sequence; // Odd while a write is in progress
+} Seqlock;
+
+void ogb_instance
+seqlock_init(Seqlock *s);
+
+void ogb_instance
+seqlock_write_begin(Seqlock *s);
+
+void ogb_instance
+seqlock_write_end(Seqlock *s);
+
+u32 ogb_instance
+seqlock_read_begin(Seqlock *s);
+
+// Returns true if the data read since seqlock_read_begin may be torn and must be read again
+bool ogb_instance
+seqlock_read_retry(Seqlock *s, u32 start);
+
+void ogb_instance
+seqlock_write(Seqlock *s, void *dst, void *src, u64 size);
+
+void ogb_instance
+seqlock_read(Seqlock *s, void *dst, void *src, u64 size);
+
+
+///
+// Single-producer single-consumer ring buffer
+// Wait-free, but only if exactly one thread pushes and exactly one thread pops.
+// Producer and consumer indices live on separate cache lines, and each side keeps
+// a cached copy of the other side's index so it only reads the shared index when
+// the ring looks full/empty.
+// Items are copied in and out by value, item_size is whatever you want.
+typedef struct Spsc_Ring {
+	// Written by producer
+	alignat(CACHE_LINE_SIZE) volatile u64 write_index;
+	u64 cached_read_index;
+	
+	// Written by consumer
+	alignat(CACHE_LINE_SIZE) volatile u64 read_index;
+	u64 cached_write_index;
+	
+	// Readonly after init
+	alignat(CACHE_LINE_SIZE) u8 *buffer;
+	u64 item_size;
+	u64 capacity; // Always power of two
+	Allocator allocator;
+} Spsc_Ring;
+
+// capacity is rounded up to the next power of two
+void ogb_instance
+spsc_ring_init(Spsc_Ring *r, u64 item_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+spsc_ring_destroy(Spsc_Ring *r);
+
+// Returns false if full
+bool ogb_instance
+spsc_ring_push(Spsc_Ring *r, void *item);
+
+// Returns false if empty
+bool ogb_instance
+spsc_ring_pop(Spsc_Ring *r, void *item);
+
+// Only a snapshot, may be stale as soon as it returns.
+u64 ogb_instance
+spsc_ring_get_count(Spsc_Ring *r);
+
+
+///
+// Bounded multi-producer multi-consumer queue
+// Lock-free (Dmitry Vyukov's bounded queue). Every cell has a sequence number which
+// tells producers & consumers whether it is ready to be written or read, so threads
+// only contend on the enqueue/dequeue index CAS and never on the same cell.
+typedef struct Mpmc_Queue {
+	alignat(CACHE_LINE_SIZE) volatile u64 enqueue_index;
+	alignat(CACHE_LINE_SIZE) volatile u64 dequeue_index;
+	
+	// Readonly after init
+	alignat(CACHE_LINE_SIZE) u8 *cells;
+	u64 cell_size; // sequence + item, 8 byte aligned
+	u64 item_size;
+	u64 capacity; // Always power of two
+	Allocator allocator;
+} Mpmc_Queue;
+
+// capacity is rounded up to the next power of two, minimum 2
+void ogb_instance
+mpmc_queue_init(Mpmc_Queue *q, u64 item_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+mpmc_queue_destroy(Mpmc_Queue *q);
+
+// Returns false if full
+bool ogb_instance
+mpmc_queue_push(Mpmc_Queue *q, void *item);
+
+// Returns false if empty
+bool ogb_instance
+mpmc_queue_pop(Mpmc_Queue *q, void *item);
+
+
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 void spinlock_init(Spinlock *l) {
@@ -179,4 +325,258 @@ void binary_semaphore_signal(Binary_Semaphore *sem) {
     mutex_release(&sem->mutex);
 }
 
+
+///
+// Reader-writer lock
+
+void rw_lock_init(Rw_Lock *l) {
+	memset(l, 0, sizeof(*l));
+}
+void rw_lock_read_acquire(Rw_Lock *l) {
+	u32 spins = 0;
+	while (true) {
+		u32 state = atomic_load_32(&l->state, MEMORY_ORDER_RELAXED);
+		
+		if (!(state & (RW_LOCK_WRITER | RW_LOCK_WRITER_WAITING))) {
+			assert((state & RW_LOCK_READER_MASK) != RW_LOCK_READER_MASK, "Too many readers in Rw_Lock");
+			if (compare_and_swap_32(&l->state, state+1, state)) return;
+			continue;
+		}
+		
+		if (spins < RW_LOCK_SPIN_COUNT) {
+			spins += 1;
+			_mm_pause();
+			continue;
+		}
+		
+		// Whoever clears the writer bits will wake us
+		os_wait_on_address_32(&l->state, state);
+	}
+}
+void rw_lock_read_release(Rw_Lock *l) {
+	u32 old = atomic_fetch_sub_32(&l->state, 1, MEMORY_ORDER_RELEASE);
+	assert((old & RW_LOCK_READER_MASK) != 0, "Tried to release a read lock which is not acquired");
+	
+	// Last reader out lets the waiting writer in. Readers may be sleeping on the same
+	// address, so wake everyone or we could wake only a reader who goes right back to sleep.
+	if ((old & RW_LOCK_READER_MASK) == 1 && (old & RW_LOCK_WRITER_WAITING)) {
+		os_wake_address_all(&l->state);
+	}
+}
+void rw_lock_write_acquire(Rw_Lock *l) {
+	atomic_fetch_add_32(&l->waiting_writers, 1, MEMORY_ORDER_RELAXED);
+	
+	u32 spins = 0;
+	while (true) {
+		u32 state = atomic_load_32(&l->state, MEMORY_ORDER_RELAXED);
+		
+		if ((state & ~RW_LOCK_WRITER_WAITING) == 0) {
+			// Keep blocking new readers if more writers are queued up behind us
+			u32 new_state = RW_LOCK_WRITER;
+			if (atomic_load_32(&l->waiting_writers, MEMORY_ORDER_RELAXED) > 1) new_state |= RW_LOCK_WRITER_WAITING;
+			
+			if (compare_and_swap_32(&l->state, new_state, state)) {
+				atomic_fetch_sub_32(&l->waiting_writers, 1, MEMORY_ORDER_RELAXED);
+				return;
+			}
+			continue;
+		}
+		
+		if (!(state & RW_LOCK_WRITER_WAITING)) {
+			compare_and_swap_32(&l->state, state | RW_LOCK_WRITER_WAITING, state);
+			continue;
+		}
+		
+		if (spins < RW_LOCK_SPIN_COUNT) {
+			spins += 1;
+			_mm_pause();
+			continue;
+		}
+		
+		os_wait_on_address_32(&l->state, state);
+	}
+}
+void rw_lock_write_release(Rw_Lock *l) {
+	while (true) {
+		u32 state = atomic_load_32(&l->state, MEMORY_ORDER_RELAXED);
+		assert(state & RW_LOCK_WRITER, "Tried to release a write lock which is not acquired");
+		if (compare_and_swap_32(&l->state, state & RW_LOCK_WRITER_WAITING, state)) break;
+	}
+	os_wake_address_all(&l->state);
+}
+
+
+///
+// Seqlock
+
+void seqlock_init(Seqlock *s) {
+	memset(s, 0, sizeof(*s));
+}
+void seqlock_write_begin(Seqlock *s) {
+	while (true) {
+		u32 sequence = atomic_load_32(&s->sequence, MEMORY_ORDER_RELAXED);
+		// CAS is a full barrier so the data writes can't move above this
+		if (!(sequence & 1) && compare_and_swap_32(&s->sequence, sequence+1, sequence)) return;
+		_mm_pause();
+	}
+}
+void seqlock_write_end(Seqlock *s) {
+	u32 sequence = atomic_load_32(&s->sequence, MEMORY_ORDER_RELAXED);
+	assert(sequence & 1, "seqlock_write_end without seqlock_write_begin");
+	atomic_store_32(&s->sequence, sequence+1, MEMORY_ORDER_RELEASE);
+}
+u32 seqlock_read_begin(Seqlock *s) {
+	while (true) {
+		u32 sequence = atomic_load_32(&s->sequence, MEMORY_ORDER_ACQUIRE);
+		if (!(sequence & 1)) return sequence;
+		_mm_pause();
+	}
+}
+bool seqlock_read_retry(Seqlock *s, u32 start) {
+	// Data reads must be done before we look at the sequence again
+	atomic_fence(MEMORY_ORDER_ACQUIRE);
+	return atomic_load_32(&s->sequence, MEMORY_ORDER_RELAXED) != start;
+}
+void seqlock_write(Seqlock *s, void *dst, void *src, u64 size) {
+	seqlock_write_begin(s);
+	memcpy(dst, src, size);
+	seqlock_write_end(s);
+}
+void seqlock_read(Seqlock *s, void *dst, void *src, u64 size) {
+	u32 start;
+	do {
+		start = seqlock_read_begin(s);
+		memcpy(dst, src, size);
+	} while (seqlock_read_retry(s, start));
+}
+
+
+///
+// Single-producer single-consumer ring buffer
+
+void spsc_ring_init(Spsc_Ring *r, u64 item_size, u64 capacity, Allocator allocator) {
+	assert(item_size > 0, "Spsc_Ring item_size must be more than 0");
+	assert(capacity > 0, "Spsc_Ring capacity must be more than 0");
+	memset(r, 0, sizeof(*r));
+	r->item_size = item_size;
+	r->capacity = get_next_power_of_two(capacity);
+	r->allocator = allocator;
+	r->buffer = (u8*)alloc(allocator, r->item_size*r->capacity);
+}
+void spsc_ring_destroy(Spsc_Ring *r) {
+	dealloc(r->allocator, r->buffer);
+	memset(r, 0, sizeof(*r));
+}
+bool spsc_ring_push(Spsc_Ring *r, void *item) {
+	u64 write_index = atomic_load_64(&r->write_index, MEMORY_ORDER_RELAXED);
+	
+	if (write_index - r->cached_read_index >= r->capacity) {
+		// Acquire: the consumer must be done reading the slot before we overwrite it
+		r->cached_read_index = atomic_load_64(&r->read_index, MEMORY_ORDER_ACQUIRE);
+		if (write_index - r->cached_read_index >= r->capacity) return false;
+	}
+	
+	memcpy(r->buffer + (write_index & (r->capacity-1))*r->item_size, item, r->item_size);
+	
+	// Release: item must be visible before the new write_index is
+	atomic_store_64(&r->write_index, write_index + 1, MEMORY_ORDER_RELEASE);
+	
+	return true;
+}
+bool spsc_ring_pop(Spsc_Ring *r, void *item) {
+	u64 read_index = atomic_load_64(&r->read_index, MEMORY_ORDER_RELAXED);
+	
+	if (read_index == r->cached_write_index) {
+		// Acquire: don't read the item before we've seen the write_index which published it
+		r->cached_write_index = atomic_load_64(&r->write_index, MEMORY_ORDER_ACQUIRE);
+		if (read_index == r->cached_write_index) return false;
+	}
+	
+	memcpy(item, r->buffer + (read_index & (r->capacity-1))*r->item_size, r->item_size);
+	
+	// Release: done reading before we hand the slot back to the producer
+	atomic_store_64(&r->read_index, read_index + 1, MEMORY_ORDER_RELEASE);
+	
+	return true;
+}
+u64 spsc_ring_get_count(Spsc_Ring *r) {
+	u64 read_index = atomic_load_64(&r->read_index, MEMORY_ORDER_ACQUIRE);
+	u64 write_index = atomic_load_64(&r->write_index, MEMORY_ORDER_ACQUIRE);
+	return write_index - read_index;
+}
+
+
+///
+// Bounded multi-producer multi-consumer queue
+
+void mpmc_queue_init(Mpmc_Queue *q, u64 item_size, u64 capacity, Allocator allocator) {
+	assert(item_size > 0, "Mpmc_Queue item_size must be more than 0");
+	memset(q, 0, sizeof(*q));
+	q->item_size = item_size;
+	q->cell_size = align_next(sizeof(u64)+item_size, sizeof(u64));
+	q->capacity = get_next_power_of_two(max(capacity, 2));
+	q->allocator = allocator;
+	q->cells = (u8*)alloc(allocator, q->cell_size*q->capacity);
+	
+	for (u64 i = 0; i < q->capacity; i++) {
+		*(u64*)(q->cells + i*q->cell_size) = i;
+	}
+}
+void mpmc_queue_destroy(Mpmc_Queue *q) {
+	dealloc(q->allocator, q->cells);
+	memset(q, 0, sizeof(*q));
+}
+bool mpmc_queue_push(Mpmc_Queue *q, void *item) {
+	u64 mask = q->capacity-1;
+	u64 pos = atomic_load_64(&q->enqueue_index, MEMORY_ORDER_RELAXED);
+	
+	while (true) {
+		u8 *cell = q->cells + (pos & mask)*q->cell_size;
+		volatile u64 *sequence = (volatile u64*)cell;
+		u64 seq = atomic_load_64(sequence, MEMORY_ORDER_ACQUIRE);
+		s64 diff = (s64)seq - (s64)pos;
+		
+		if (diff == 0) {
+			// Cell is free for this position, try to claim it
+			if (compare_and_swap_64(&q->enqueue_index, pos+1, pos)) {
+				memcpy(cell + sizeof(u64), item, q->item_size);
+				atomic_store_64(sequence, pos+1, MEMORY_ORDER_RELEASE);
+				return true;
+			}
+		} else if (diff < 0) {
+			// Cell still holds an item from the previous lap, so we are full
+			return false;
+		}
+		
+		// Someone else got here first
+		pos = atomic_load_64(&q->enqueue_index, MEMORY_ORDER_RELAXED);
+	}
+}
+bool mpmc_queue_pop(Mpmc_Queue *q, void *item) {
+	u64 mask = q->capacity-1;
+	u64 pos = atomic_load_64(&q->dequeue_index, MEMORY_ORDER_RELAXED);
+	
+	while (true) {
+		u8 *cell = q->cells + (pos & mask)*q->cell_size;
+		volatile u64 *sequence = (volatile u64*)cell;
+		u64 seq = atomic_load_64(sequence, MEMORY_ORDER_ACQUIRE);
+		s64 diff = (s64)seq - (s64)(pos+1);
+		
+		if (diff == 0) {
+			// Cell has been published for this position, try to claim it
+			if (compare_and_swap_64(&q->dequeue_index, pos+1, pos)) {
+				memcpy(item, cell + sizeof(u64), q->item_size);
+				// Hand the cell to whichever producer is on the next lap
+				atomic_store_64(sequence, pos+q->capacity, MEMORY_ORDER_RELEASE);
+				return true;
+			}
+		} else if (diff < 0) {
+			// Nothing published here yet, so we are empty
+			return false;
+		}
+		
+		pos = atomic_load_64(&q->dequeue_index, MEMORY_ORDER_RELAXED);
+	}
+}
+
 #endif
\ No newline at end of file
@@ -18,11 +18,30 @@ typedef struct Cpu_Capabilities {
 	bool avx2;
 	bool avx512;
 	
+	// rdtsc ticks at a constant rate regardless of power states / frequency scaling,
+	// so it can be used as a clock.
+	bool invariant_tsc;
+	
 } Cpu_Capabilities;
 
 // I think this is the standard? (sse1)
 #define COMPILER_CAN_DO_SSE 1
 
+// #Portability
+// 64 bytes on every x86 cpu we care about. Used to keep data that is written
+// by different threads on separate cache lines (false sharing).
+#define CACHE_LINE_SIZE 64
+
+// Values match the C11/gcc memory orders so they can be passed straight to the builtins.
+// There is no consume, use acquire.
+typedef enum Memory_Order {
+	MEMORY_ORDER_RELAXED = 0,
+	MEMORY_ORDER_ACQUIRE = 2,
+	MEMORY_ORDER_RELEASE = 3,
+	MEMORY_ORDER_ACQ_REL = 4,
+	MEMORY_ORDER_SEQ_CST = 5,
+} Memory_Order;
+
 ///
 // Compiler specific stuff
 #if COMPILER_MVSC
@@ -46,9 +65,14 @@ typedef struct Cpu_Capabilities {
     }
     inline Cpu_Info_X86 cpuid(u32 function_id) {
     	Cpu_Info_X86 i;
-    	__cpuid((int*)&i, function_id);
+    	__cpuidex((int*)&i, function_id, 0);
     	return i;
     }
+    // Which register states the os saves on context switches (XCR0).
+    // Only valid if cpuid(1) has osxsave.
+    inline u64 xgetbv(u32 index) {
+    	return _xgetbv(index);
+    }
     
     #if _M_IX86_FP >= 2
 		#define COMPILER_CAN_DO_SSE2 1
@@ -73,6 +97,16 @@ typedef struct Cpu_Capabilities {
 		#define COMPILER_CAN_DO_AVX512 0
 	#endif
 	
+	// For procedures that use AVX2 no matter what the rest of the program is compiled for.
+	// Only call them if the cpu has it (Cpu_Capabilities).
+	// MSVC emits any intrinsic anywhere, so nothing to do here.
+	#define COMPILER_CAN_TARGET_AVX2 1
+	#define target_avx2
+	#define COMPILER_CAN_TARGET_AVX 1
+	#define target_avx
+	#define COMPILER_CAN_TARGET_AVX512 1
+	#define target_avx512
+	
 	#define DEPRECATED(proc, msg) __declspec(deprecated(msg)) func
 	
 	#pragma intrinsic(_InterlockedCompareExchange8)
@@ -107,8 +141,87 @@ typedef struct Cpu_Capabilities {
 	
 	#define MEMORY_BARRIER _ReadWriteBarrier()
 	
+	typedef struct alignat(16) Atomic_128 {
+		u64 low;
+		u64 high;
+	} Atomic_128;
+	
+	#define COMPILER_CAN_DO_CAS_128 1
+	inline bool 
+	compare_and_swap_128(volatile Atomic_128 *a, Atomic_128 b, Atomic_128 old) {
+		return _InterlockedCompareExchange128((volatile long long*)a, (long long)b.high, (long long)b.low, (long long*)&old) != 0;
+	}
+	
+	// x86 is strongly ordered: plain loads are acquire and plain stores are release,
+	// so those only need to stop the compiler from reordering. Seq_cst stores need
+	// a locked instruction and every interlocked rmw is a full barrier already.
+	#define _ATOMIC_OPS_MSVC(bits, type, suffix) \
+	inline u##bits \
+	atomic_load_##bits(volatile u##bits *a, Memory_Order order) { \
+		u##bits v = *a; \
+		if (order != MEMORY_ORDER_RELAXED) _ReadWriteBarrier(); \
+		return v; \
+	} \
+	inline void \
+	atomic_store_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		if (order == MEMORY_ORDER_SEQ_CST) { _InterlockedExchange##suffix((volatile type*)a, (type)v); return; } \
+		if (order != MEMORY_ORDER_RELAXED) _ReadWriteBarrier(); \
+		*a = v; \
+	} \
+	inline u##bits \
+	atomic_exchange_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedExchange##suffix((volatile type*)a, (type)v); \
+	} \
+	inline u##bits \
+	atomic_fetch_add_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedExchangeAdd##suffix((volatile type*)a, (type)v); \
+	} \
+	inline u##bits \
+	atomic_fetch_sub_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedExchangeAdd##suffix((volatile type*)a, -(type)v); \
+	} \
+	inline u##bits \
+	atomic_fetch_and_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedAnd##suffix((volatile type*)a, (type)v); \
+	} \
+	inline u##bits \
+	atomic_fetch_or_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedOr##suffix((volatile type*)a, (type)v); \
+	} \
+	inline u##bits \
+	atomic_fetch_xor_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return (u##bits)_InterlockedXor##suffix((volatile type*)a, (type)v); \
+	}
+	
+	_ATOMIC_OPS_MSVC(8,  char,      8)
+	_ATOMIC_OPS_MSVC(16, short,     16)
+	_ATOMIC_OPS_MSVC(32, long,      )
+	_ATOMIC_OPS_MSVC(64, long long, 64)
+	
+	inline void 
+	atomic_fence(Memory_Order order) {
+		if (order == MEMORY_ORDER_SEQ_CST) _mm_mfence();
+		else _ReadWriteBarrier();
+	}
+	
+	// Index of the highest/lowest set bit. x must not be 0.
+	inline u32 
+	bit_scan_reverse_64(u64 x) {
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return (u32)index;
+	}
+	inline u32 
+	bit_scan_forward_64(u64 x) {
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (u32)index;
+	}
+	
 	#define thread_local __declspec(thread)
 	
+	#define return_address() _ReturnAddress()
+	
 	#define SHARED_EXPORT __declspec(dllexport)
     #define SHARED_IMPORT __declspec(dllimport)
 	
@@ -143,6 +256,14 @@ typedef struct Cpu_Capabilities {
 	        : "a"(function_id), "c"(0));
 	    return info;
 	}
+	// Which register states the os saves on context switches (XCR0).
+	// Only valid if cpuid(1) has osxsave.
+	inline u64 
+	xgetbv(u32 index) {
+		u32 lo, hi;
+		__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+		return ((u64)hi << 32) | lo;
+	}
 	
 	#ifdef __SSE2__
 		#define COMPILER_CAN_DO_SSE2 1
@@ -170,6 +291,15 @@ typedef struct Cpu_Capabilities {
 		#define COMPILER_CAN_DO_AVX512 0
 	#endif
 	
+	// For procedures that use AVX2 no matter what the rest of the program is compiled for.
+	// Only call them if the cpu has it (Cpu_Capabilities).
+	#define COMPILER_CAN_TARGET_AVX2 1
+	#define target_avx2 __attribute__((target("avx2")))
+	#define COMPILER_CAN_TARGET_AVX 1
+	#define target_avx __attribute__((target("avx")))
+	#define COMPILER_CAN_TARGET_AVX512 1
+	#define target_avx512 __attribute__((target("avx512f")))
+	
 	#define DEPRECATED(proc, msg) __attribute__((deprecated(msg))) proc 
 	
 	inline bool 
@@ -227,8 +357,85 @@ typedef struct Cpu_Capabilities {
 	
 	#define MEMORY_BARRIER {__asm__ __volatile__("" ::: "memory");__sync_synchronize();}
 	
+	typedef struct alignat(16) Atomic_128 {
+		u64 low;
+		u64 high;
+	} Atomic_128;
+	
+	// #Portability x64 only. Needs cmpxchg16b, which every cpu that can run 64-bit windows has.
+	#define COMPILER_CAN_DO_CAS_128 1
+	inline bool 
+	compare_and_swap_128(volatile Atomic_128 *a, Atomic_128 b, Atomic_128 old) {
+		bool result;
+		__asm__ __volatile__(
+			"lock; cmpxchg16b %1"
+			: "=@ccz" (result), "+m" (*a), "+a" (old.low), "+d" (old.high)
+			: "b" (b.low), "c" (b.high)
+			: "memory"
+		);
+		return result;
+	}
+	
+	// Memory_Order maps 1:1 to __ATOMIC_*. These are always inlined so a constant order
+	// folds to the right instruction (plain mov for relaxed/acquire/release on x86).
+	#define _ATOMIC_OPS_GCC(bits) \
+	inline u##bits \
+	atomic_load_##bits(volatile u##bits *a, Memory_Order order) { \
+		return __atomic_load_n(a, (int)order); \
+	} \
+	inline void \
+	atomic_store_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		__atomic_store_n(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_exchange_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_exchange_n(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_fetch_add_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_fetch_add(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_fetch_sub_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_fetch_sub(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_fetch_and_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_fetch_and(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_fetch_or_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_fetch_or(a, v, (int)order); \
+	} \
+	inline u##bits \
+	atomic_fetch_xor_##bits(volatile u##bits *a, u##bits v, Memory_Order order) { \
+		return __atomic_fetch_xor(a, v, (int)order); \
+	}
+	
+	_ATOMIC_OPS_GCC(8)
+	_ATOMIC_OPS_GCC(16)
+	_ATOMIC_OPS_GCC(32)
+	_ATOMIC_OPS_GCC(64)
+	
+	inline void 
+	atomic_fence(Memory_Order order) {
+		__atomic_thread_fence((int)order);
+	}
+	
+	// Index of the highest/lowest set bit. x must not be 0.
+	inline u32 
+	bit_scan_reverse_64(u64 x) {
+		return 63 - (u32)__builtin_clzll(x);
+	}
+	inline u32 
+	bit_scan_forward_64(u64 x) {
+		return (u32)__builtin_ctzll(x);
+	}
+	
 	#define thread_local __thread
 	
+	#define return_address() __builtin_return_address(0)
+	
 #if TARGET_OS == WINDOWS
 	#define SHARED_EXPORT __attribute__((visibility("default"))) __declspec(dllexport)
     #define SHARED_IMPORT __declspec(dllimport)
@@ -244,15 +451,24 @@ typedef struct Cpu_Capabilities {
     inline u64 
     rdtsc() { return 0; }
     inline Cpu_Info_X86 cpuid(u32 function_id) {return (Cpu_Info_X86){0};}
+    inline u64 xgetbv(u32 index) {return 0;}
     #define COMPILER_CAN_DO_SSE2 0
     #define COMPILER_CAN_DO_AVX 0
     #define COMPILER_CAN_DO_AVX2 0
     #define COMPILER_CAN_DO_AVX512 0
+    #define COMPILER_CAN_TARGET_AVX2 0
+    #define target_avx2
+    #define COMPILER_CAN_TARGET_AVX 0
+    #define target_avx
+    #define COMPILER_CAN_TARGET_AVX512 0
+    #define target_avx512
     
     #define DEPRECATED(proc, msg) 
     
     #define MEMORY_BARRIER
     
+    #define return_address() 0
+    
     #warning "Compiler is not explicitly supported, some things will probably not work as expected"
 #endif
 
@@ -274,10 +490,29 @@ query_cpu_capabilities() {
     
     result.avx = (info.ecx & (1 << 28)) != 0;
 
-    Cpu_Info_X86 ext_info = cpuid(7);
-    result.avx2 = (ext_info.ebx & (1 << 5)) != 0;
+    if (cpuid(0).eax >= 7) {
+        Cpu_Info_X86 ext_info = cpuid(7);
+        result.avx2 = (ext_info.ebx & (1 << 5)) != 0;
+        
+        result.avx512 = (ext_info.ebx & (1 << 16)) != 0;
+    }
     
-    result.avx512 = (ext_info.ebx & (1 << 16)) != 0;
+    // The cpu having avx doesn't mean the os saves the ymm/zmm registers, and if it
+    // doesn't then using them faults.
+    bool osxsave = (info.ecx & (1 << 27)) != 0;
+    u64 os_saves = osxsave ? xgetbv(0) : 0;
+    if ((os_saves & 0x6) != 0x6) {
+        result.avx = result.avx2 = result.avx512 = false;
+    }
+    if ((os_saves & 0xE6) != 0xE6) {
+        result.avx512 = false;
+    }
+    
+    Cpu_Info_X86 ext_max = cpuid(0x80000000);
+    if (ext_max.eax >= 0x80000007) {
+        Cpu_Info_X86 power_info = cpuid(0x80000007);
+        result.invariant_tsc = (power_info.edx & (1 << 8)) != 0;
+    }
 
     return result;
 }
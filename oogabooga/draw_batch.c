@@ -0,0 +1,257 @@
+/*
+	The CPU side of rendering a Draw_Frame: sorting quads and turning them into vertices.
+	Shared by the renderer and draw frame replays (see draw_capture.c).
+
+		void draw_batch_sort_quads(Draw_Quad *quads, u64 count);
+		u64  draw_batch_cull_quads(Draw_Quad *quads, u64 count);
+		void draw_batch_build_vertices(Draw_Batch *batch, Draw_Quad *quads, u64 count);
+
+	Quads are culled when they are drawn (see draw_quad_projected), so the renderer doesn't call
+	draw_batch_cull_quads(). It's here so replays can measure it.
+*/
+
+#define DRAW_BATCH_MAX_TEXTURES 32
+
+// We wanna pack this at some point
+// #Cleanup #Memory why am I doing alignat(16)?
+// #Volatile reflected in the renderer's vertex layout & 2D batch shader
+typedef struct alignat(16) Draw_Vertex {
+
+	Vector4 color;
+	Vector4 position;
+	Vector2 uv;
+	Vector2 self_uv;
+	s8 texture_index;
+	u8 type;
+	u8 sampler;
+	u8 has_scissor;
+
+	Vector4 userdata[VERTEX_2D_USER_DATA_COUNT];
+
+	Vector4 scissor;
+
+} Draw_Vertex;
+
+typedef struct Draw_Batch Draw_Batch;
+
+// Called when the batch runs out of texture slots. Should draw batch->quad_count quads from
+// batch->vertices with batch->textures, after which the batch starts over from the first vertex.
+typedef void(*Draw_Batch_Flush_Proc)(Draw_Batch *batch);
+
+typedef struct Draw_Batch {
+	// Set these before building
+	Draw_Vertex *vertices; // Room for 6 per quad
+	s32 window_width;
+	s32 window_height;
+	Draw_Batch_Flush_Proc flush; // Optional
+
+	// Built
+	Gfx_Handle textures[DRAW_BATCH_MAX_TEXTURES];
+	u64 num_textures;
+	u64 quad_count;
+	u64 flush_count;
+
+} Draw_Batch;
+
+// #Global
+ogb_instance Draw_Quad *sort_quad_buffer;
+ogb_instance u64 sort_quad_buffer_size;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Draw_Quad *sort_quad_buffer = 0;
+u64 sort_quad_buffer_size = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void
+draw_batch_sort_quads(Draw_Quad *quads, u64 count) {
+	if (!sort_quad_buffer || (sort_quad_buffer_size < count*sizeof(Draw_Quad))) {
+		// #Memory #Heapalloc
+		u64 new_count = max(get_next_power_of_two(count), 128);
+		if (sort_quad_buffer) dealloc(get_heap_allocator(), sort_quad_buffer);
+		sort_quad_buffer = alloc(get_heap_allocator(), new_count*sizeof(Draw_Quad));
+		sort_quad_buffer_size = new_count*sizeof(Draw_Quad);
+	}
+	radix_sort(quads, sort_quad_buffer, count, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
+}
+
+// Removes offscreen quads, keeping the order. Returns the new count.
+u64
+draw_batch_cull_quads(Draw_Quad *quads, u64 count) {
+	u64 visible_count = 0;
+	for (u64 i = 0; i < count; i++) {
+		if (draw_quad_is_offscreen(&quads[i])) continue;
+		if (visible_count != i) quads[visible_count] = quads[i];
+		visible_count += 1;
+	}
+	return visible_count;
+}
+
+void
+draw_batch_build_vertices(Draw_Batch *batch, Draw_Quad *quads, u64 count) {
+
+	Gfx_Handle last_texture = 0;
+	s8 last_texture_index = 0;
+
+	Draw_Vertex* pointer = batch->vertices + batch->quad_count*6;
+
+	for (u64 i = 0; i < count; i++)  {
+
+		Draw_Quad *q = &quads[i];
+
+		assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
+		assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
+
+		s8 texture_index = -1;
+
+		if (q->image) {
+			if (last_texture == q->image->gfx_handle) {
+				texture_index = last_texture_index;
+			} else {
+				// First look if texture is already bound
+				for (u64 j = 0; j < batch->num_textures; j++) {
+					if (batch->textures[j] == q->image->gfx_handle) {
+						texture_index = (s8)j;
+						break;
+					}
+				}
+				// Otherwise use a new slot
+				if (texture_index <= -1) {
+					if (batch->num_textures >= DRAW_BATCH_MAX_TEXTURES) {
+						// If max textures reached, make a draw call and start over
+						if (batch->flush) batch->flush(batch);
+						batch->flush_count += 1;
+						batch->num_textures = 1; // This texture goes in the first slot
+						batch->quad_count = 0;
+						texture_index = 0;
+						pointer = batch->vertices;
+					} else {
+						texture_index = (s8)batch->num_textures;
+						batch->num_textures += 1;
+					}
+				}
+			}
+			batch->textures[texture_index] = q->image->gfx_handle;
+			last_texture = q->image->gfx_handle;
+			last_texture_index = texture_index;
+		}
+
+		Vector2 bottom_left  = q->bottom_left;
+		Vector2 top_left     = q->top_left;
+		Vector2 top_right    = q->top_right;
+		Vector2 bottom_right = q->bottom_right;
+
+		if (q->type == QUAD_TYPE_TEXT) {
+
+		    // This is meant to fix the annoying artifacts that shows up when sampling text from an atlas
+		    // presumably for floating point precision issues or something.
+
+		    // #Incomplete
+		    // If we want to animate text with small movements then it will look wonky.
+		    // This should be optional probably.
+		    // Also, we might want to do this on non-text if rendering with linear filtering
+		    // from a large texture atlas.
+
+			float pixel_width = 2.0/(float)batch->window_width;
+			float pixel_height = 2.0/(float)batch->window_height;
+
+			bottom_left.x  = round(bottom_left.x  / pixel_width)  * pixel_width;
+		    bottom_left.y  = round(bottom_left.y  / pixel_height) * pixel_height;
+		    top_left.x     = round(top_left.x     / pixel_width)  * pixel_width;
+		    top_left.y     = round(top_left.y     / pixel_height) * pixel_height;
+		    top_right.x    = round(top_right.x    / pixel_width)  * pixel_width;
+		    top_right.y    = round(top_right.y    / pixel_height) * pixel_height;
+		    bottom_right.x = round(bottom_right.x / pixel_width)  * pixel_width;
+		    bottom_right.y = round(bottom_right.y / pixel_height) * pixel_height;
+		}
+
+		// We will write to 6 vertices for the one quad (two tris)
+		{
+
+			Draw_Vertex* BL  = pointer + 0;
+			Draw_Vertex* TL  = pointer + 1;
+			Draw_Vertex* TR  = pointer + 2;
+			Draw_Vertex* BL2 = pointer + 3;
+			Draw_Vertex* TR2 = pointer + 4;
+			Draw_Vertex* BR  = pointer + 5;
+			pointer += 6;
+
+			BL->position = v4(bottom_left.x,  bottom_left.y,  0, 1);
+			TL->position = v4(top_left.x,     top_left.y,     0, 1);
+			TR->position = v4(top_right.x,    top_right.y,    0, 1);
+			BR->position = v4(bottom_right.x, bottom_right.y, 0, 1);
+
+
+			if (q->image) {
+
+				BL->uv = v2(q->uv.x1, q->uv.y1);
+				TL->uv = v2(q->uv.x1, q->uv.y2);
+				TR->uv = v2(q->uv.x2, q->uv.y2);
+				BR->uv = v2(q->uv.x2, q->uv.y1);
+				// #Hack #Bug #Cleanup
+				// When a window dimension is uneven it slightly under/oversamples on an axis by a
+				// seemingly arbitrary amount. The 0.25 is a magic value I got from trial and error.
+				// (It undersamples by a fourth of the atlas texture?)
+				// Anything > 0.25 < will slightly over/undersample on my machine.
+				// I have no idea about #Portability here.
+				// - Charlie M 26th July 2024
+				if (batch->window_width % 2 != 0) {
+					BL->uv.x += (2.0/(float)q->image->width)*0.25;
+					TL->uv.x += (2.0/(float)q->image->width)*0.25;
+					TR->uv.x += (2.0/(float)q->image->width)*0.25;
+					BR->uv.x += (2.0/(float)q->image->width)*0.25;
+				}
+				if (batch->window_height % 2 != 0) {
+					BL->uv.y -= (2.0/(float)q->image->height)*0.25;
+					TL->uv.y -= (2.0/(float)q->image->height)*0.25;
+					TR->uv.y -= (2.0/(float)q->image->height)*0.25;
+					BR->uv.y -= (2.0/(float)q->image->height)*0.25;
+				}
+
+				u8 sampler = -1;
+				if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
+							&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
+						sampler = 0;
+				if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
+							&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
+						sampler = 1;
+				if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
+							&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
+						sampler = 2;
+				if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
+							&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
+						sampler = 3;
+				BL->sampler=TL->sampler=TR->sampler=BR->sampler = (u8)sampler;
+
+			}
+			BL->texture_index=TL->texture_index=TR->texture_index=BR->texture_index = texture_index;
+
+			BL->self_uv = v2(0, 0);
+			TL->self_uv = v2(0, 1);
+			TR->self_uv = v2(1, 1);
+			BR->self_uv = v2(1, 0);
+
+			// #Speed
+			memcpy(BL->userdata, q->userdata, sizeof(q->userdata));
+			memcpy(TL->userdata, q->userdata, sizeof(q->userdata));
+			memcpy(TR->userdata, q->userdata, sizeof(q->userdata));
+			memcpy(BR->userdata, q->userdata, sizeof(q->userdata));
+
+			BL->color = TL->color = TR->color = BR->color = q->color;
+
+			BL->type=TL->type=TR->type=BR->type = (u8)q->type;
+
+			// Scissor is in window pixels with y up, flip it to y down
+			Vector4 scissor = q->scissor;
+			scissor.y1 = batch->window_height - q->scissor.y2;
+			scissor.y2 = batch->window_height - q->scissor.y1;
+
+			BL->has_scissor=TL->has_scissor=TR->has_scissor=BR->has_scissor = q->has_scissor;
+			BL->scissor=TL->scissor=TR->scissor=BR->scissor = scissor;
+
+			*BL2 = *BL;
+			*TR2 = *TR;
+
+			batch->quad_count += 1;
+		}
+	}
+}
@@ -0,0 +1,435 @@
+/*
+	Capture draw frames to a file and replay them through the CPU side of the renderer, to
+	benchmark sorting, culling & vertex generation on the exact quads of a heavy frame without
+	running the game.
+
+		bool draw_capture_start(string path, u64 frame_count); // Captures the next frame_count frames
+		void draw_capture_stop();
+
+		bool draw_replay_load(string path, Draw_Replay *replay, Allocator allocator);
+		void draw_replay_destroy(Draw_Replay *replay);
+		void draw_replay_run(Draw_Replay *replay, u64 iterations, Draw_Replay_Stats *stats);
+		void draw_replay_append_report(Draw_Replay_Stats *stats, String_Builder *builder);
+
+	Frames are written in gfx_update() just before they are rendered. A frame has the quad
+	buffer, the draw_frame state (projection, view, z sorting & scissor stack), the window size
+	and the size of every image referenced so far. Image pixels are not captured: replayed images
+	only have a size and a fake gfx_handle, so nothing can be rendered from a replay.
+
+	Captures are raw structs, so they can only be replayed by a build with the same Draw_Quad.
+	See examples/draw_replay.c for a replay tool.
+*/
+
+#define DRAW_CAPTURE_VERSION 1
+
+typedef struct Draw_Capture_Header {
+	u8 magic[8]; // "OGBDRAWC"
+	u32 version;
+	u32 quad_size;
+	u32 user_data_count;
+	u32 reserved;
+} Draw_Capture_Header;
+
+// Followed by image_count Draw_Capture_Image's, scissor_count Vector4's and quad_count Draw_Quad's.
+// The image pointer of a captured quad is the image id (0 for no image).
+typedef struct Draw_Capture_Frame_Header {
+	Matrix4 projection;
+	Matrix4 view;
+	u64 quad_count;
+	u64 image_count;
+	u64 scissor_count;
+	s32 window_width;
+	s32 window_height;
+	u32 enable_z_sorting;
+	u32 reserved;
+} Draw_Capture_Frame_Header;
+
+typedef struct Draw_Capture_Image {
+	u64 id;
+	u32 width;
+	u32 height;
+	u32 channels;
+	u32 reserved;
+} Draw_Capture_Image;
+
+typedef struct Draw_Capture {
+	File file;
+	u64 frames_left;
+	u64 frames_written;
+	Gfx_Image **images; // Growing array, image id is index+1
+} Draw_Capture;
+
+typedef struct Draw_Replay_Frame {
+	Matrix4 projection;
+	Matrix4 view;
+	Draw_Quad *quads;
+	u64 quad_count;
+	Vector4 *scissors;
+	u64 scissor_count;
+	s32 window_width;
+	s32 window_height;
+	bool enable_z_sorting;
+} Draw_Replay_Frame;
+
+typedef struct Draw_Replay {
+	Draw_Replay_Frame *frames;
+	u64 frame_count;
+	// Index is image id-1. gfx_handle is the image id.
+	Gfx_Image *images;
+	u64 image_count;
+	u64 max_quad_count;
+	Allocator allocator;
+} Draw_Replay;
+
+typedef enum Draw_Replay_Stage {
+	DRAW_REPLAY_STAGE_COPY, // Restoring the captured quads, since sorting & culling work in place
+	DRAW_REPLAY_STAGE_SORT,
+	DRAW_REPLAY_STAGE_CULL,
+	DRAW_REPLAY_STAGE_VERTICES,
+
+	DRAW_REPLAY_STAGE_COUNT
+} Draw_Replay_Stage;
+
+typedef struct Draw_Replay_Stats {
+	u64 iterations;
+	u64 frames;
+	u64 quads;
+	u64 culled_quads;
+	u64 flushes;
+	// Cycles per frame for each stage
+	u64 total_cycles[DRAW_REPLAY_STAGE_COUNT];
+	u64 min_cycles[DRAW_REPLAY_STAGE_COUNT];
+	u64 max_cycles[DRAW_REPLAY_STAGE_COUNT];
+} Draw_Replay_Stats;
+
+// #Global
+ogb_instance Draw_Capture draw_capture;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Draw_Capture draw_capture = {0};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+const u8 DRAW_CAPTURE_MAGIC[8] = {'O', 'G', 'B', 'D', 'R', 'A', 'W', 'C'};
+
+bool
+draw_capture_start(string path, u64 frame_count) {
+	assert(draw_capture.frames_left == 0, "A draw capture is already running");
+	if (frame_count == 0) return false;
+
+	File file = os_file_open_s(path, O_CREATE | O_WRITE);
+	if (file == OS_INVALID_FILE) {
+		log_error("Could not open '%s' for draw capture", path);
+		return false;
+	}
+
+	Draw_Capture_Header header = ZERO(Draw_Capture_Header);
+	memcpy(header.magic, DRAW_CAPTURE_MAGIC, sizeof(header.magic));
+	header.version = DRAW_CAPTURE_VERSION;
+	header.quad_size = sizeof(Draw_Quad);
+	header.user_data_count = VERTEX_2D_USER_DATA_COUNT;
+	os_file_write_bytes(file, &header, sizeof(header));
+
+	draw_capture.file = file;
+	draw_capture.frames_left = frame_count;
+	draw_capture.frames_written = 0;
+	if (!draw_capture.images) {
+		growing_array_init((void**)&draw_capture.images, sizeof(Gfx_Image*), get_heap_allocator());
+	}
+	growing_array_clear((void**)&draw_capture.images);
+
+	return true;
+}
+
+void
+draw_capture_stop() {
+	if (draw_capture.frames_left == 0 && draw_capture.frames_written == 0) return;
+	os_file_close(draw_capture.file);
+	log_info("Captured %llu draw frames", draw_capture.frames_written);
+	draw_capture.frames_left = 0;
+	draw_capture.frames_written = 0;
+}
+
+u64
+_draw_capture_get_image_id(Gfx_Image *image) {
+	if (!image) return 0;
+	u64 count = growing_array_get_valid_count(draw_capture.images);
+	for (u64 i = 0; i < count; i++) {
+		if (draw_capture.images[i] == image) return i+1;
+	}
+	growing_array_add((void**)&draw_capture.images, &image);
+	return count+1;
+}
+
+// Called by the renderer before it processes draw_frame
+void
+draw_capture_frame() {
+	if (draw_capture.frames_left == 0) return;
+
+	// Images need ids before the image table is written
+	Gfx_Image *last_image = 0;
+	for (u64 i = 0; i < draw_frame.num_quads; i++) {
+		Gfx_Image *image = quad_buffer[i].image;
+		if (image && image != last_image) _draw_capture_get_image_id(image);
+		last_image = image;
+	}
+
+	Draw_Capture_Frame_Header header = ZERO(Draw_Capture_Frame_Header);
+	header.projection = draw_frame.projection;
+	header.view = draw_frame.view;
+	header.quad_count = draw_frame.num_quads;
+	header.image_count = growing_array_get_valid_count(draw_capture.images);
+	header.scissor_count = draw_frame.scissor_count;
+	header.window_width = window.width;
+	header.window_height = window.height;
+	header.enable_z_sorting = draw_frame.enable_z_sorting;
+	os_file_write_bytes(draw_capture.file, &header, sizeof(header));
+
+	for (u64 i = 0; i < header.image_count; i++) {
+		Gfx_Image *image = draw_capture.images[i];
+		Draw_Capture_Image captured = ZERO(Draw_Capture_Image);
+		captured.id = i+1;
+		captured.width = image->width;
+		captured.height = image->height;
+		captured.channels = image->channels;
+		os_file_write_bytes(draw_capture.file, &captured, sizeof(captured));
+	}
+
+	if (draw_frame.scissor_count > 0) {
+		os_file_write_bytes(draw_capture.file, draw_frame.scissor_stack, sizeof(Vector4)*draw_frame.scissor_count);
+	}
+
+	// Swap image pointers for ids in chunks
+	Draw_Quad chunk[64];
+	u64 last_id = 0;
+	last_image = 0;
+	for (u64 start = 0; start < draw_frame.num_quads; start += 64) {
+		u64 count = min(draw_frame.num_quads-start, 64);
+		memcpy(chunk, quad_buffer+start, count*sizeof(Draw_Quad));
+		for (u64 i = 0; i < count; i++) {
+			if (chunk[i].image != last_image) {
+				last_image = chunk[i].image;
+				last_id = _draw_capture_get_image_id(last_image);
+			}
+			chunk[i].image = (Gfx_Image*)last_id;
+		}
+		os_file_write_bytes(draw_capture.file, chunk, count*sizeof(Draw_Quad));
+	}
+
+	draw_capture.frames_written += 1;
+	draw_capture.frames_left -= 1;
+	if (draw_capture.frames_left == 0) draw_capture_stop();
+}
+
+void
+draw_replay_destroy(Draw_Replay *replay) {
+	for (u64 i = 0; i < replay->frame_count; i++) {
+		Draw_Replay_Frame *frame = &replay->frames[i];
+		if (frame->quads) dealloc(replay->allocator, frame->quads);
+		if (frame->scissors) dealloc(replay->allocator, frame->scissors);
+	}
+	if (replay->frames) growing_array_deinit((void**)&replay->frames);
+	if (replay->images) dealloc(replay->allocator, replay->images);
+	*replay = ZERO(Draw_Replay);
+}
+
+bool
+draw_replay_load(string path, Draw_Replay *replay, Allocator allocator) {
+	*replay = ZERO(Draw_Replay);
+	replay->allocator = allocator;
+
+	string data;
+	if (!os_read_entire_file_s(path, &data, allocator)) {
+		log_error("Could not read draw capture '%s'", path);
+		return false;
+	}
+
+	bool ok = true;
+	u8 *p = data.data;
+	u8 *end = data.data+data.count;
+
+	Draw_Capture_Header header;
+	if (data.count < sizeof(header)) {
+		log_error("'%s' is not a draw capture", path);
+		ok = false;
+	} else {
+		memcpy(&header, p, sizeof(header));
+		p += sizeof(header);
+		if (memcmp(header.magic, DRAW_CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+			log_error("'%s' is not a draw capture", path);
+			ok = false;
+		} else if (header.version != DRAW_CAPTURE_VERSION || header.quad_size != sizeof(Draw_Quad) || header.user_data_count != VERTEX_2D_USER_DATA_COUNT) {
+			log_error("Draw capture '%s' was made with a different version or Draw_Quad layout", path);
+			ok = false;
+		}
+	}
+
+	if (!ok) {
+		if (data.count > 0) dealloc_string(allocator, data);
+		return false;
+	}
+
+	growing_array_init((void**)&replay->frames, sizeof(Draw_Replay_Frame), allocator);
+
+	Draw_Capture_Image *images = 0; // The image table of the last frame has every image
+	while (ok && p < end) {
+		Draw_Capture_Frame_Header frame_header;
+		if ((u64)(end-p) < sizeof(frame_header)) { ok = false; break; }
+		memcpy(&frame_header, p, sizeof(frame_header));
+		p += sizeof(frame_header);
+
+		u64 images_size = frame_header.image_count*sizeof(Draw_Capture_Image);
+		u64 scissors_size = frame_header.scissor_count*sizeof(Vector4);
+		u64 quads_size = frame_header.quad_count*sizeof(Draw_Quad);
+		if ((u64)(end-p) < images_size+scissors_size+quads_size) { ok = false; break; }
+
+		images = (Draw_Capture_Image*)p;
+		replay->image_count = frame_header.image_count;
+		p += images_size;
+
+		Draw_Replay_Frame *frame = growing_array_add_empty((void**)&replay->frames);
+		*frame = ZERO(Draw_Replay_Frame);
+		frame->projection = frame_header.projection;
+		frame->view = frame_header.view;
+		frame->window_width = frame_header.window_width;
+		frame->window_height = frame_header.window_height;
+		frame->enable_z_sorting = frame_header.enable_z_sorting != 0;
+
+		frame->scissor_count = frame_header.scissor_count;
+		if (scissors_size > 0) {
+			frame->scissors = (Vector4*)alloc(allocator, scissors_size);
+			memcpy(frame->scissors, p, scissors_size);
+		}
+		p += scissors_size;
+
+		frame->quad_count = frame_header.quad_count;
+		if (quads_size > 0) {
+			frame->quads = (Draw_Quad*)alloc(allocator, quads_size);
+			memcpy(frame->quads, p, quads_size);
+		}
+		p += quads_size;
+
+		replay->max_quad_count = max(replay->max_quad_count, frame->quad_count);
+	}
+	replay->frame_count = growing_array_get_valid_count(replay->frames);
+
+	if (ok && replay->image_count > 0) {
+		replay->images = (Gfx_Image*)alloc(allocator, sizeof(Gfx_Image)*replay->image_count);
+		memset(replay->images, 0, sizeof(Gfx_Image)*replay->image_count);
+		for (u64 i = 0; i < replay->image_count; i++) {
+			Draw_Capture_Image *captured = &images[i];
+			if (captured->id == 0 || captured->id > replay->image_count) { ok = false; break; }
+			Gfx_Image *image = &replay->images[captured->id-1];
+			image->width = captured->width;
+			image->height = captured->height;
+			image->channels = captured->channels;
+			image->gfx_handle = (Gfx_Handle)captured->id;
+			image->allocator = allocator;
+		}
+	}
+
+	// Ids back to pointers
+	for (u64 f = 0; ok && f < replay->frame_count; f++) {
+		Draw_Replay_Frame *frame = &replay->frames[f];
+		for (u64 i = 0; i < frame->quad_count; i++) {
+			u64 id = (u64)frame->quads[i].image;
+			if (id > replay->image_count) { ok = false; break; }
+			frame->quads[i].image = id ? &replay->images[id-1] : 0;
+		}
+	}
+
+	if (data.count > 0) dealloc_string(allocator, data);
+
+	if (!ok) {
+		log_error("Draw capture '%s' is corrupt or truncated", path);
+		draw_replay_destroy(replay);
+		return false;
+	}
+
+	return true;
+}
+
+// Runs every frame of the replay through the renderer's CPU stages iterations times
+void
+draw_replay_run(Draw_Replay *replay, u64 iterations, Draw_Replay_Stats *stats) {
+	*stats = ZERO(Draw_Replay_Stats);
+	stats->iterations = iterations;
+	for (u64 s = 0; s < DRAW_REPLAY_STAGE_COUNT; s++) stats->min_cycles[s] = UINT64_MAX;
+
+	if (replay->frame_count == 0 || replay->max_quad_count == 0) return;
+
+	Draw_Quad *quads = (Draw_Quad*)alloc(get_heap_allocator(), replay->max_quad_count*sizeof(Draw_Quad));
+	Draw_Vertex *vertices = (Draw_Vertex*)alloc(get_heap_allocator(), replay->max_quad_count*6*sizeof(Draw_Vertex));
+	assert((u64)vertices%16 == 0);
+
+	for (u64 iteration = 0; iteration < iterations; iteration++) {
+		for (u64 f = 0; f < replay->frame_count; f++) {
+			Draw_Replay_Frame *frame = &replay->frames[f];
+			u64 cycles[DRAW_REPLAY_STAGE_COUNT];
+
+			u64 t0 = rdtsc();
+			memcpy(quads, frame->quads, frame->quad_count*sizeof(Draw_Quad));
+			u64 t1 = rdtsc();
+			if (frame->enable_z_sorting) draw_batch_sort_quads(quads, frame->quad_count);
+			u64 t2 = rdtsc();
+			u64 visible_count = draw_batch_cull_quads(quads, frame->quad_count);
+			u64 t3 = rdtsc();
+			Draw_Batch batch = ZERO(Draw_Batch);
+			batch.vertices = vertices;
+			batch.window_width = frame->window_width;
+			batch.window_height = frame->window_height;
+			draw_batch_build_vertices(&batch, quads, visible_count);
+			u64 t4 = rdtsc();
+
+			cycles[DRAW_REPLAY_STAGE_COPY]     = t1-t0;
+			cycles[DRAW_REPLAY_STAGE_SORT]     = t2-t1;
+			cycles[DRAW_REPLAY_STAGE_CULL]     = t3-t2;
+			cycles[DRAW_REPLAY_STAGE_VERTICES] = t4-t3;
+			for (u64 s = 0; s < DRAW_REPLAY_STAGE_COUNT; s++) {
+				stats->total_cycles[s] += cycles[s];
+				stats->min_cycles[s] = min(stats->min_cycles[s], cycles[s]);
+				stats->max_cycles[s] = max(stats->max_cycles[s], cycles[s]);
+			}
+
+			stats->frames += 1;
+			stats->quads += frame->quad_count;
+			stats->culled_quads += frame->quad_count-visible_count;
+			stats->flushes += batch.flush_count;
+		}
+	}
+
+	dealloc(get_heap_allocator(), vertices);
+	dealloc(get_heap_allocator(), quads);
+}
+
+void
+draw_replay_append_report(Draw_Replay_Stats *stats, String_Builder *builder) {
+	const char *stage_names[DRAW_REPLAY_STAGE_COUNT] = {
+		[DRAW_REPLAY_STAGE_COPY]     = "copy     ",
+		[DRAW_REPLAY_STAGE_SORT]     = "z sort   ",
+		[DRAW_REPLAY_STAGE_CULL]     = "cull     ",
+		[DRAW_REPLAY_STAGE_VERTICES] = "vertices ",
+	};
+
+	f64 cycles_to_us = 1000000.0/(f64)os_get_tsc_frequency();
+	u64 frames = max(stats->frames, 1);
+	u64 quads = max(stats->quads, 1);
+
+	string_builder_print(builder, STR("%llu frames, %llu iterations, %.1f quads per frame, %llu culled, %llu texture limit flushes\n"),
+		stats->frames, stats->iterations, (f64)stats->quads/(f64)frames, stats->culled_quads, stats->flushes);
+	string_builder_append(builder, STR("Stage       Mean us      Min us      Max us     ns/quad\n"));
+
+	u64 total_cycles = 0;
+	for (u64 s = 0; s < DRAW_REPLAY_STAGE_COUNT; s++) {
+		total_cycles += stats->total_cycles[s];
+		u64 min_cycles = stats->min_cycles[s] == UINT64_MAX ? 0 : stats->min_cycles[s];
+		string_builder_print(builder, STR("%cs %11.3f %11.3f %11.3f %11.3f\n"),
+			stage_names[s],
+			(f64)stats->total_cycles[s]*cycles_to_us/(f64)frames,
+			(f64)min_cycles*cycles_to_us,
+			(f64)stats->max_cycles[s]*cycles_to_us,
+			(f64)stats->total_cycles[s]*cycles_to_us*1000.0/(f64)quads);
+	}
+	string_builder_print(builder, STR("total     %11.3f                         %11.3f\n"),
+		(f64)total_cycles*cycles_to_us/(f64)frames,
+		(f64)total_cycles*cycles_to_us*1000.0/(f64)quads);
+}
@@ -14,9 +14,17 @@
 	Draw_Quad *draw_quad_projected(Draw_Quad quad, Matrix4 world_to_clip);
 	Draw_Quad *draw_quad(Draw_Quad quad);
 	Draw_Quad *draw_quad_xform(Draw_Quad quad, Matrix4 xform);
+	Draw_Quad *draw_quad_projected_affine2(Draw_Quad quad, Affine2 world_to_clip);
+	Draw_Quad *draw_quad_affine2(Draw_Quad quad, Affine2 xform);
+	Draw_Quad *draw_rect_affine2(Affine2 xform, Vector2 size, Vector4 color);
+	Draw_Quad *draw_circle_affine2(Affine2 xform, Vector2 size, Vector4 color);
+	Draw_Quad *draw_image_affine2(Gfx_Image *image, Affine2 xform, Vector2 size, Vector4 color);
 	void draw_text_xform(Gfx_Font *font, string text, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color);
+	void draw_text_affine2(Gfx_Font *font, string text, u32 raster_height, Affine2 xform, Vector2 scale, Vector4 color);
 	void draw_text(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color);
 	Gfx_Text_Metrics draw_text_and_measure(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color);
+	void draw_text_codepoints_xform(Gfx_Font *font, u32 *codepoints, u64 codepoint_count, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color);
+	void draw_text_codepoints(Gfx_Font *font, u32 *codepoints, u64 codepoint_count, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color);
 	void draw_line(Vector2 p0, Vector2 p1, float line_width, Vector4 color);
 */
 
@@ -109,20 +117,19 @@ void pop_window_scissor() {
 	draw_frame.scissor_count -= 1;
 }
 
-Draw_Quad _nil_quad = {0};
-Draw_Quad *draw_quad_projected(Draw_Quad quad, Matrix4 world_to_clip) {
-	quad.bottom_left  = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_left), 0, 1)).xy;
-	quad.top_left     = m4_transform(world_to_clip, v4(v2_expand(quad.top_left), 0, 1)).xy;
-	quad.top_right    = m4_transform(world_to_clip, v4(v2_expand(quad.top_right), 0, 1)).xy;
-	quad.bottom_right = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_right), 0, 1)).xy;
-	
-	bool should_cull = 
-	    (quad.bottom_left.x < -1 && quad.top_left.x < -1 && quad.top_right.x < -1 && quad.bottom_right.x < -1) ||
-	    (quad.bottom_left.x > 1 && quad.top_left.x > 1 && quad.top_right.x > 1 && quad.bottom_right.x > 1) ||
-	    (quad.bottom_left.y < -1 && quad.top_left.y < -1 && quad.top_right.y < -1 && quad.bottom_right.y < -1) ||
-	    (quad.bottom_left.y > 1 && quad.top_left.y > 1 && quad.top_right.y > 1 && quad.bottom_right.y > 1);
+// True if all corners are outside the same edge of the screen (quad corners are in ndc)
+inline bool draw_quad_is_offscreen(Draw_Quad *quad) {
+	return 
+	    (quad->bottom_left.x < -1 && quad->top_left.x < -1 && quad->top_right.x < -1 && quad->bottom_right.x < -1) ||
+	    (quad->bottom_left.x > 1 && quad->top_left.x > 1 && quad->top_right.x > 1 && quad->bottom_right.x > 1) ||
+	    (quad->bottom_left.y < -1 && quad->top_left.y < -1 && quad->top_right.y < -1 && quad->bottom_right.y < -1) ||
+	    (quad->bottom_left.y > 1 && quad->top_left.y > 1 && quad->top_right.y > 1 && quad->bottom_right.y > 1);
+}
 
-	if (should_cull) {
+Draw_Quad _nil_quad = {0};
+// Quad corners are already in ndc
+Draw_Quad *_draw_quad_push(Draw_Quad quad) {
+	if (draw_quad_is_offscreen(&quad)) {
 		return &_nil_quad;
 	}
 	
@@ -162,11 +169,56 @@ Draw_Quad *draw_quad_projected(Draw_Quad quad, Matrix4 world_to_clip) {
 	
 	return &quad_buffer[draw_frame.num_quads-1];
 }
+Draw_Quad *draw_quad_projected(Draw_Quad quad, Matrix4 world_to_clip) {
+	quad.bottom_left  = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_left), 0, 1)).xy;
+	quad.top_left     = m4_transform(world_to_clip, v4(v2_expand(quad.top_left), 0, 1)).xy;
+	quad.top_right    = m4_transform(world_to_clip, v4(v2_expand(quad.top_right), 0, 1)).xy;
+	quad.bottom_right = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_right), 0, 1)).xy;
+	
+	return _draw_quad_push(quad);
+}
+Draw_Quad *draw_quad_projected_affine2(Draw_Quad quad, Affine2 world_to_clip) {
+	quad.bottom_left  = affine2_transform(world_to_clip, quad.bottom_left);
+	quad.top_left     = affine2_transform(world_to_clip, quad.top_left);
+	quad.top_right    = affine2_transform(world_to_clip, quad.top_right);
+	quad.bottom_right = affine2_transform(world_to_clip, quad.bottom_right);
+	
+	return _draw_quad_push(quad);
+}
+
+// projection * inverse(view) as an Affine2. False if the projection or view does something
+// that isn't 2D (perspective, rotating out of the xy plane), then it has to be Matrix4's.
+bool _draw_frame_world_to_clip_affine2(Affine2 *world_to_clip) {
+	if (!m4_is_affine2(draw_frame.projection) || !m4_is_affine2(draw_frame.view)) return false;
+	
+	*world_to_clip = affine2_mul(affine2_from_m4(draw_frame.projection), affine2_inverse(affine2_from_m4(draw_frame.view)));
+	return true;
+}
+
 Draw_Quad *draw_quad(Draw_Quad quad) {
+	Affine2 world_to_clip;
+	if (_draw_frame_world_to_clip_affine2(&world_to_clip)) {
+		return draw_quad_projected_affine2(quad, world_to_clip);
+	}
 	return draw_quad_projected(quad, m4_mul(draw_frame.projection, m4_inverse(draw_frame.view)));
 }
 
+Draw_Quad *draw_quad_affine2(Draw_Quad quad, Affine2 xform) {
+	Affine2 world_to_clip;
+	if (_draw_frame_world_to_clip_affine2(&world_to_clip)) {
+		return draw_quad_projected_affine2(quad, affine2_mul(world_to_clip, xform));
+	}
+	return draw_quad_projected(quad, m4_mul(m4_mul(draw_frame.projection, m4_inverse(draw_frame.view)), m4_from_affine2(xform)));
+}
+
 Draw_Quad *draw_quad_xform(Draw_Quad quad, Matrix4 xform) {
+	// m4_is_affine2 doesn't look at the z row of xform, which only doesn't matter when the
+	// projection & view are 2D too. Otherwise the whole xform goes through the Matrix4 path.
+	Affine2 frame_to_clip;
+	if (m4_is_affine2(xform) && _draw_frame_world_to_clip_affine2(&frame_to_clip)) {
+		return draw_quad_projected_affine2(quad, affine2_mul(frame_to_clip, affine2_from_m4(xform)));
+	}
+	
 	Matrix4 world_to_clip = m4_scalar(1.0);
 	world_to_clip         = m4_mul(world_to_clip, draw_frame.projection);
 	world_to_clip         = m4_mul(world_to_clip, m4_inverse(draw_frame.view));
@@ -205,6 +257,19 @@ Draw_Quad *draw_rect_xform(Matrix4 xform, Vector2 size, Vector4 color) {
 	
 	return draw_quad_xform(q, xform);
 }
+Draw_Quad *draw_rect_affine2(Affine2 xform, Vector2 size, Vector4 color) {
+	// #Copypaste #Volatile	
+	Draw_Quad q = ZERO(Draw_Quad);
+	q.bottom_left  = v2(0,  0);
+	q.top_left     = v2(0,  size.y);
+	q.top_right    = v2(size.x, size.y);
+	q.bottom_right = v2(size.x, 0);
+	q.color = color;
+	q.image = 0;
+	q.type = QUAD_TYPE_REGULAR;
+	
+	return draw_quad_affine2(q, xform);
+}
 Draw_Quad *draw_circle(Vector2 position, Vector2 size, Vector4 color) {
 	// #Copypaste #Volatile	
 	const float32 left   = position.x;
@@ -236,6 +301,19 @@ Draw_Quad *draw_circle_xform(Matrix4 xform, Vector2 size, Vector4 color) {
 	
 	return draw_quad_xform(q, xform);
 }
+Draw_Quad *draw_circle_affine2(Affine2 xform, Vector2 size, Vector4 color) {
+	// #Copypaste #Volatile	
+	Draw_Quad q = ZERO(Draw_Quad);
+	q.bottom_left  = v2(0,  0);
+	q.top_left     = v2(0,  size.y);
+	q.top_right    = v2(size.x, size.y);
+	q.bottom_right = v2(size.x, 0);
+	q.color = color;
+	q.image = 0;
+	q.type = QUAD_TYPE_CIRCLE;
+	
+	return draw_quad_affine2(q, xform);
+}
 Draw_Quad *draw_image(Gfx_Image *image, Vector2 position, Vector2 size, Vector4 color) {
 	Draw_Quad *q = draw_rect(position, size, color);
 	
@@ -252,11 +330,22 @@ Draw_Quad *draw_image_xform(Gfx_Image *image, Matrix4 xform, Vector2 size, Vecto
 	
 	return q;
 }
+Draw_Quad *draw_image_affine2(Gfx_Image *image, Affine2 xform, Vector2 size, Vector4 color) {
+	Draw_Quad *q = draw_rect_affine2(xform, size, color);
+	
+	q->image = image;
+	q->uv = v4(0, 0, 1, 1);
+	
+	return q;
+}
 
 typedef struct {
 	Gfx_Font *font;
 	string text;
 	u32 raster_height;
+	// Affine2 unless the Matrix4 does more than 2D
+	bool use_affine2;
+	Affine2 affine2;
 	Matrix4 xform;
 	Vector2 scale;
 	Vector4 color;
@@ -269,9 +358,14 @@ bool draw_text_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, f
 	
 	Vector2 size = v2(glyph.width*params->scale.x, glyph.height*params->scale.y);
 	
-	Matrix4 glyph_xform = m4_translate(params->xform, v3(glyph_x, glyph_y, 0));
-	
-	Draw_Quad *q = draw_image_xform(atlas->image, glyph_xform, size, params->color);
+	Draw_Quad *q;
+	if (params->use_affine2) {
+		Affine2 glyph_xform = affine2_translate(params->affine2, v2(glyph_x, glyph_y));
+		q = draw_image_affine2(atlas->image, glyph_xform, size, params->color);
+	} else {
+		Matrix4 glyph_xform = m4_translate(params->xform, v3(glyph_x, glyph_y, 0));
+		q = draw_image_xform(atlas->image, glyph_xform, size, params->color);
+	}
 	q->uv = glyph.uv;
 	q->type = QUAD_TYPE_TEXT;
 	q->image_min_filter = GFX_FILTER_MODE_LINEAR;
@@ -280,29 +374,55 @@ bool draw_text_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, f
 	return true;
 }
 
-void draw_text_xform(Gfx_Font *font, string text, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color) {
+void draw_text_spec_xform(Walk_Glyphs_Spec spec, Matrix4 xform, Vector4 color) {
 	
 	Draw_Text_Callback_Params p;
-	p.font = font;
-	p.text = text;
-	p.raster_height = raster_height;
+	p.font = spec.font;
+	p.text = spec.text;
+	p.raster_height = spec.raster_height;
+	// Same as draw_quad_xform, the z row of xform matters unless the frame is 2D
+	Affine2 world_to_clip;
+	p.use_affine2 = m4_is_affine2(xform) && _draw_frame_world_to_clip_affine2(&world_to_clip);
+	if (p.use_affine2) p.affine2 = affine2_from_m4(xform);
 	p.xform = xform;
-	p.scale = scale;
+	p.scale = spec.scale;
 	p.color = color;
 	
-	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &p}, draw_text_callback);
+	spec.ud = &p;
+	walk_glyphs(spec, draw_text_callback);
 }
-void draw_text(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color) {
-	Matrix4 xform = m4_scalar(1.0);
-	xform         = m4_translate(xform, v3(position.x, position.y, 0));
+void draw_text_spec_affine2(Walk_Glyphs_Spec spec, Affine2 xform, Vector4 color) {
+	
+	Draw_Text_Callback_Params p;
+	p.font = spec.font;
+	p.text = spec.text;
+	p.raster_height = spec.raster_height;
+	p.use_affine2 = true;
+	p.affine2 = xform;
+	p.scale = spec.scale;
+	p.color = color;
 	
-	draw_text_xform(font, text, raster_height, xform, scale, color);
+	spec.ud = &p;
+	walk_glyphs(spec, draw_text_callback);
+}
+void draw_text_xform(Gfx_Font *font, string text, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color) {
+	draw_text_spec_xform((Walk_Glyphs_Spec){font, text, raster_height, scale, true, 0}, xform, color);
+}
+void draw_text_affine2(Gfx_Font *font, string text, u32 raster_height, Affine2 xform, Vector2 scale, Vector4 color) {
+	draw_text_spec_affine2((Walk_Glyphs_Spec){font, text, raster_height, scale, true, 0}, xform, color);
+}
+// For text that's already decoded, see utf8_decode_to_utf32
+void draw_text_codepoints_xform(Gfx_Font *font, u32 *codepoints, u64 codepoint_count, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color) {
+	draw_text_spec_xform((Walk_Glyphs_Spec){font, null_string, raster_height, scale, true, 0, codepoints, codepoint_count}, xform, color);
+}
+void draw_text_codepoints(Gfx_Font *font, u32 *codepoints, u64 codepoint_count, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color) {
+	draw_text_spec_affine2((Walk_Glyphs_Spec){font, null_string, raster_height, scale, true, 0, codepoints, codepoint_count}, affine2_make_translation(position), color);
+}
+void draw_text(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color) {
+	draw_text_affine2(font, text, raster_height, affine2_make_translation(position), scale, color);
 }
 Gfx_Text_Metrics draw_text_and_measure(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color) {
-	Matrix4 xform = m4_scalar(1.0);
-	xform         = m4_translate(xform, v3(position.x, position.y, 0));
-	
-	draw_text_xform(font, text, raster_height, xform, scale, color);
+	draw_text_affine2(font, text, raster_height, affine2_make_translation(position), scale, color);
 	
 	return measure_text(font, text, raster_height, scale);
 }
@@ -310,12 +430,14 @@ Gfx_Text_Metrics draw_text_and_measure(Gfx_Font *font, string text, u32 raster_h
 void draw_line(Vector2 p0, Vector2 p1, float line_width, Vector4 color) {
 	Vector2 dir = v2(p1.x - p0.x, p1.y - p0.y);
 	float length = sqrt(dir.x * dir.x + dir.y * dir.y);
-	float r = atan2(-dir.y, dir.x);
-	Matrix4 line_xform = m4_scalar(1);
-	line_xform = m4_translate(line_xform, v3(p0.x, p0.y, 0));
-	line_xform = m4_rotate_z(line_xform, r);
-	line_xform = m4_translate(line_xform, v3(0, -line_width/2, 0));
-	draw_rect_xform(line_xform, v2(length, line_width), color);
+	
+	// x along the line, y across it, so no need for angles
+	Vector2 along = length > 0 ? v2_divf(dir, length) : v2(1, 0);
+	Affine2 line_xform;
+	line_xform.m[0][0] = along.x; line_xform.m[0][1] = -along.y; line_xform.m[0][2] = p0.x;
+	line_xform.m[1][0] = along.y; line_xform.m[1][1] =  along.x; line_xform.m[1][2] = p0.y;
+	line_xform = affine2_translate(line_xform, v2(0, -line_width/2));
+	draw_rect_affine2(line_xform, v2(length, line_width), color);
 }
 
 #define COLOR_RED   ((Vector4){1.0, 0.0, 0.0, 1.0})
@@ -0,0 +1,49 @@
+/*
+
+	Replays a draw capture through the CPU side of the renderer (z sorting, culling and vertex
+	generation) in a loop and prints how long each stage takes. Nothing is rendered, so this
+	is a reproducible benchmark for changes to the renderer.
+
+	Make a capture in your game with:
+
+		draw_capture_start(STR("draw_capture.bin"), 60); // Captures the next 60 frames
+
+	Or press 'C' in renderer_stress_test.c.
+
+	Then run this with:
+
+		cgame.exe [capture path] [iterations]
+
+*/
+
+int entry(int argc, char **argv) {
+
+	string path = argc > 1 ? STR(argv[1]) : STR("draw_capture.bin");
+	u64 iterations = 100;
+	if (argc > 2) {
+		iterations = 0;
+		for (char *c = argv[2]; *c >= '0' && *c <= '9'; c++) iterations = iterations*10 + (*c-'0');
+	}
+
+	Draw_Replay replay;
+	if (!draw_replay_load(path, &replay, get_heap_allocator())) {
+		return 1;
+	}
+
+	log("Replaying %llu frames from '%s' %llu times", replay.frame_count, path, iterations);
+
+	// Warm up caches & the sort buffer so the first iteration isn't an outlier
+	Draw_Replay_Stats stats;
+	draw_replay_run(&replay, 1, &stats);
+
+	draw_replay_run(&replay, iterations, &stats);
+
+	String_Builder report;
+	string_builder_init(&report, get_heap_allocator());
+	draw_replay_append_report(&stats, &report);
+	print("%s", report.result);
+
+	draw_replay_destroy(&replay);
+
+	return 0;
+}
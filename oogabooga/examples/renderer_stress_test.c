@@ -92,6 +92,9 @@ int entry(int argc, char **argv) {
 		camera_view = m4_translate(camera_view, v3(v2_expand(cam_move), 0));
 		draw_frame.view = camera_view;
 		
+		// Capture 60 frames for examples/draw_replay.c
+		if (is_key_just_pressed('C')) draw_capture_start(STR("draw_capture.bin"), 60);
+		
 		local_persist bool do_enable_z_sorting = false;
 		draw_frame.enable_z_sorting = do_enable_z_sorting;
 		if (is_key_just_pressed('Z')) do_enable_z_sorting = !do_enable_z_sorting;
@@ -99,29 +99,36 @@ typedef struct Gfx_Font_Variation {
 } Gfx_Font_Variation;
 typedef struct Gfx_Font {
 	stbtt_fontinfo stbtt_handle;
-	string raw_font_data;
+	Os_File_Map font_file; // stbtt reads glyphs straight from the mapped file
 	Gfx_Font_Variation variations[MAX_FONT_HEIGHT]; // Variation per font height
 	Allocator allocator;
 } Gfx_Font;
 
 Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	
-	string font_data;
-	bool read_ok = os_read_entire_file(path, &font_data, allocator);
+	Os_File_Map font_file;
+	bool map_ok = os_file_map(path, &font_file, OS_FILE_MAP_ACCESS_RANDOM);
 	
-	if (!read_ok) return 0;
+	if (!map_ok) return 0;
 	
 	third_party_allocator = allocator;
 	
 	stbtt_fontinfo stbtt_handle;
-	int result = stbtt_InitFont(&stbtt_handle, font_data.data, stbtt_GetFontOffsetForIndex(font_data.data, 0));
+	int result = 0;
+	if (font_file.data.count > 0) {
+		result = stbtt_InitFont(&stbtt_handle, font_file.data.data, stbtt_GetFontOffsetForIndex(font_file.data.data, 0));
+	}
 	
-	if (result == 0) return 0;
+	if (result == 0) {
+		os_file_unmap(&font_file);
+		third_party_allocator = ZERO(Allocator);
+		return 0;
+	}
 	
 	Gfx_Font *font = alloc(allocator, sizeof(Gfx_Font));
 	memset(font, 0, sizeof(Gfx_Font));
 	font->stbtt_handle = stbtt_handle;
-	font->raw_font_data = font_data;
+	font->font_file = font_file;
 	font->allocator = allocator;
 	
 	third_party_allocator = ZERO(Allocator);
@@ -146,7 +153,7 @@ void destroy_font(Gfx_Font *font) {
 		
 	}
 
-	dealloc_string(font->allocator, font->raw_font_data);
+	os_file_unmap(&font->font_file);
 	dealloc(font->allocator, font);
 	
 	third_party_allocator = ZERO(Allocator);
@@ -281,28 +288,39 @@ typedef struct {
 	Vector2 scale;
 	bool ignore_control_codes;
 	void *ud;
-} Walk_Glyphs_Spec;
-void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
 	
-	Gfx_Font_Variation *variation = &spec.font->variations[spec.raster_height];
+	// Optional, already decoded text. Walked instead of text if set.
+	u32 *codepoints;
+	u64 codepoint_count;
+} Walk_Glyphs_Spec;
+
+// Text is decoded this many bytes at a time into a buffer on the stack
+#define WALK_GLYPHS_DECODE_CHUNK 512
+
+typedef struct {
+	float x;
+	float y;
+	u32 last_c;
+} Walk_Glyphs_State;
+
+// Returns false if proc said to stop
+bool walk_glyphs_codepoints(Walk_Glyphs_Spec *spec, Walk_Glyphs_Callback_Proc proc, Walk_Glyphs_State *state, u32 *codepoints, u64 count) {
 	
-	float x = 0;
-	float y = 0;
+	Gfx_Font_Variation *variation = &spec->font->variations[spec->raster_height];
 	
-	u32 last_c = 0;
-	u32 c = next_utf8(&spec.text);
-	while (c != 0) {
+	for (u64 i = 0; i < count; i++) {
+		u32 c = codepoints[i];
+		if (c == 0) return false;
 		
-		render_atlas_if_not_yet_rendered(spec.font, spec.raster_height, c);
+		render_atlas_if_not_yet_rendered(spec->font, spec->raster_height, c);
 		
 		if (c == '\n') {
-			x = 0;
-			y -= (variation->metrics.latin_ascent-variation->metrics.latin_descent+variation->metrics.line_spacing)*spec.scale.y;
-			last_c = 0;
+			state->x = 0;
+			state->y -= (variation->metrics.latin_ascent-variation->metrics.latin_descent+variation->metrics.line_spacing)*spec->scale.y;
+			state->last_c = 0;
 		}
 		
-		if (c < 32 && spec.ignore_control_codes) {
-			c = next_utf8(&spec.text);
+		if (c < 32 && spec->ignore_control_codes) {
 			continue;
 		}
 		
@@ -311,22 +329,49 @@ void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
 		Gfx_Font_Atlas *atlas = (Gfx_Font_Atlas*)hash_table_find(&variation->atlases, atlas_index);
 		Gfx_Glyph glyph = atlas->glyphs[c-atlas->first_codepoint];
 		
-		float glyph_x = x+glyph.xoffset*spec.scale.x;
-		float glyph_y = y+(glyph.yoffset)*spec.scale.y;
-		bool should_continue = proc(glyph, atlas, glyph_x, glyph_y, spec.ud);
+		float glyph_x = state->x+glyph.xoffset*spec->scale.x;
+		float glyph_y = state->y+(glyph.yoffset)*spec->scale.y;
+		bool should_continue = proc(glyph, atlas, glyph_x, glyph_y, spec->ud);
 		
-		if (!should_continue) break;
+		if (!should_continue) return false;
 		
 		// #Incomplete kerning
-		x += glyph.advance*spec.scale.x;
-		if (last_c != 0) {
-			int kerning_unscaled = stbtt_GetCodepointKernAdvance(&spec.font->stbtt_handle, last_c, c);
+		state->x += glyph.advance*spec->scale.x;
+		if (state->last_c != 0) {
+			int kerning_unscaled = stbtt_GetCodepointKernAdvance(&spec->font->stbtt_handle, state->last_c, c);
 			float kerning_scaled_to_font_height = kerning_unscaled * variation->scale;
-			x += kerning_scaled_to_font_height*spec.scale.x;
+			state->x += kerning_scaled_to_font_height*spec->scale.x;
 		}
 		
-		last_c = c;
-		c = next_utf8(&spec.text);
+		state->last_c = c;
+	}
+	
+	return true;
+}
+void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
+	
+	Walk_Glyphs_State state = ZERO(Walk_Glyphs_State);
+	
+	if (spec.codepoints) {
+		walk_glyphs_codepoints(&spec, proc, &state, spec.codepoints, spec.codepoint_count);
+		return;
+	}
+	
+	u32 codepoints[WALK_GLYPHS_DECODE_CHUNK];
+	string text = spec.text;
+	while (text.count > 0) {
+		u64 chunk = min(text.count, WALK_GLYPHS_DECODE_CHUNK);
+		
+		// Don't cut a codepoint in half
+		u64 back = 0;
+		while (chunk-back < text.count && back < 3 && (text.data[chunk-back] & 0xC0) == 0x80) back += 1;
+		if (back < chunk) chunk -= back;
+		
+		u64 count = utf8_decode_to_utf32((string){chunk, text.data}, codepoints);
+		if (!walk_glyphs_codepoints(&spec, proc, &state, codepoints, count)) break;
+		
+		text.data  += chunk;
+		text.count -= chunk;
 	}
 }
 
@@ -387,18 +432,26 @@ bool measure_text_glyph_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float g
 	
 	return true;
 }
-Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+Gfx_Text_Metrics measure_text_spec(Walk_Glyphs_Spec spec) {
 	Measure_Text_Walk_Glyphs_Context c = ZERO(Measure_Text_Walk_Glyphs_Context);
 	
-	c.scale = scale;
-	c.font = font;
-	c.raster_height = raster_height;
+	c.scale = spec.scale;
+	c.font = spec.font;
+	c.raster_height = spec.raster_height;
 	
-	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &c}, measure_text_glyph_callback);
+	spec.ud = &c;
+	walk_glyphs(spec, measure_text_glyph_callback);
 	
 	c.m.functional_size = v2_sub(c.m.functional_pos_max, c.m.functional_pos_min);
 	c.m.visual_size = v2_sub(c.m.visual_pos_max, c.m.visual_pos_min);
 	
 	return c.m;
 }
+Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+	return measure_text_spec((Walk_Glyphs_Spec){font, text, raster_height, scale, true, 0});
+}
+// For text that's already decoded, see utf8_decode_to_utf32
+Gfx_Text_Metrics measure_text_codepoints(Gfx_Font *font, u32 *codepoints, u64 codepoint_count, u32 raster_height, Vector2 scale) {
+	return measure_text_spec((Walk_Glyphs_Spec){font, null_string, raster_height, scale, true, 0, codepoints, codepoint_count});
+}
 
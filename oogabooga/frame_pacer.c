@@ -0,0 +1,166 @@
+
+/*
+
+	Frame pacing: waits until it's time for the next frame, so the game runs at a steady rate
+	instead of as fast as it can and burning a core on screens that don't need it.
+
+		Frame_Pacer pacer;
+		frame_pacer_init(&pacer, 0); // 0 means the refresh rate of the display
+		while (!window.should_close) {
+			f64 delta_t = frame_pacer_wait(&pacer);
+			os_update();
+			...
+			gfx_update();
+		}
+
+	Waiting right before os_update() means input is as fresh as it can be when the frame starts.
+
+	Most of the wait is spent in os_sleep, which costs no CPU but can wake up late. The last
+	bit is spent spinning on the clock. How long to spin is calibrated while running, from how
+	late os_sleep has woken up on this machine recently.
+
+	If a frame starts more than a whole interval late, the schedule restarts from there instead
+	of rushing through frames to catch up.
+
+	frame_pacer_take_stats() gives lateness & jitter histograms since it was last called. Call it
+	from the same thread as metrics snapshots.
+
+*/
+
+#define FRAME_PACER_DEFAULT_FRAMES_PER_SECOND 60.0
+#define FRAME_PACER_MIN_SPIN_SECONDS 0.0002
+#define FRAME_PACER_MAX_SPIN_SECONDS 0.004
+
+typedef struct Frame_Pacer {
+	f64 target_seconds;
+	f64 spin_seconds;    // Calibrated from sleep_overshoot
+	f64 sleep_overshoot; // Recent worst case of how late os_sleep woke up
+	f64 next_frame_time;
+	f64 last_frame_time;
+
+	// Since last frame_pacer_take_stats()
+	u64 frame_count;
+	u64 missed_frame_count;
+	f64 seconds_slept;
+	f64 seconds_spun;
+	Metrics_Histogram lateness_us;
+	Metrics_Histogram jitter_us;
+} Frame_Pacer;
+
+typedef struct Frame_Pacer_Stats {
+	u64 frame_count;
+	u64 missed_frame_count; // Frames that started more than a whole interval late
+	f64 seconds_slept;
+	f64 seconds_spun;
+	f64 spin_seconds;
+	Metric_Value lateness_us; // How long after its target time each frame started
+	Metric_Value jitter_us;   // How far each frame's delta_t was from the target interval
+} Frame_Pacer_Stats;
+
+// frames_per_second <= 0 means the refresh rate of the display, or 60 if that's unknown
+void
+frame_pacer_set_rate(Frame_Pacer *p, f64 frames_per_second) {
+	if (frames_per_second <= 0) frames_per_second = os_get_display_refresh_rate();
+	if (frames_per_second <= 0) frames_per_second = FRAME_PACER_DEFAULT_FRAMES_PER_SECOND;
+	p->target_seconds = 1.0/frames_per_second;
+}
+
+void
+frame_pacer_init(Frame_Pacer *p, f64 frames_per_second) {
+	memset(p, 0, sizeof(*p));
+	frame_pacer_set_rate(p, frames_per_second);
+
+	// Until we know better, assume sleeps wake up within a ms
+	p->sleep_overshoot = 0.001;
+	p->spin_seconds = clamp(p->sleep_overshoot*1.25, FRAME_PACER_MIN_SPIN_SECONDS, FRAME_PACER_MAX_SPIN_SECONDS);
+
+	p->last_frame_time = os_get_current_time_in_seconds();
+	p->next_frame_time = p->last_frame_time + p->target_seconds;
+
+	os_set_high_timer_resolution(true);
+}
+
+void
+frame_pacer_deinit(Frame_Pacer *p) {
+	os_set_high_timer_resolution(false);
+}
+
+// Waits until it's time for the next frame and returns the seconds since the last frame started
+f64
+frame_pacer_wait(Frame_Pacer *p) {
+	f64 deadline = p->next_frame_time;
+	f64 now = os_get_current_time_in_seconds();
+
+	f64 sleepable = deadline - now - p->spin_seconds;
+	if (sleepable >= 0.001) {
+		u32 ms = (u32)(sleepable*1000.0);
+		os_sleep(ms);
+		f64 after = os_get_current_time_in_seconds();
+
+		f64 overshoot = (after-now) - (f64)ms/1000.0;
+		if (overshoot < 0) overshoot = 0;
+		// Jump to a worse overshoot right away, but only creep back down
+		if (overshoot > p->sleep_overshoot) p->sleep_overshoot = overshoot;
+		else                                p->sleep_overshoot += (overshoot-p->sleep_overshoot)*0.02;
+		p->spin_seconds = clamp(p->sleep_overshoot*1.25, FRAME_PACER_MIN_SPIN_SECONDS, FRAME_PACER_MAX_SPIN_SECONDS);
+
+		p->seconds_slept += after-now;
+		now = after;
+	}
+
+	f64 spin_start = now;
+	while (now < deadline) {
+		os_yield_thread();
+		now = os_get_current_time_in_seconds();
+	}
+	p->seconds_spun += now-spin_start;
+
+	f64 lateness = now-deadline;
+	f64 delta_t = now-p->last_frame_time;
+	metrics_histogram_record(&p->lateness_us, (u64)(lateness*1000000.0));
+	metrics_histogram_record(&p->jitter_us, (u64)(fabs(delta_t-p->target_seconds)*1000000.0));
+	p->frame_count += 1;
+
+	if (lateness > p->target_seconds) {
+		p->missed_frame_count += 1;
+		p->next_frame_time = now + p->target_seconds;
+	} else {
+		p->next_frame_time = deadline + p->target_seconds;
+	}
+	p->last_frame_time = now;
+
+	return delta_t;
+}
+
+void
+frame_pacer_take_stats(Frame_Pacer *p, Frame_Pacer_Stats *stats) {
+	memset(stats, 0, sizeof(*stats));
+	stats->frame_count        = p->frame_count;
+	stats->missed_frame_count = p->missed_frame_count;
+	stats->seconds_slept      = p->seconds_slept;
+	stats->seconds_spun       = p->seconds_spun;
+	stats->spin_seconds       = p->spin_seconds;
+	_metrics_take_histogram(&p->lateness_us, &stats->lateness_us);
+	_metrics_take_histogram(&p->jitter_us, &stats->jitter_us);
+
+	p->frame_count = 0;
+	p->missed_frame_count = 0;
+	p->seconds_slept = 0;
+	p->seconds_spun = 0;
+}
+
+void
+frame_pacer_append_report(Frame_Pacer_Stats *stats, String_Builder *builder) {
+	f64 waited = stats->seconds_slept + stats->seconds_spun;
+	string_builder_print(builder, STR("%llu frames, %llu missed. Waited %.1fms, %.1f%% of it spinning (spin tail %.0fus)\n"),
+		stats->frame_count, stats->missed_frame_count, waited*1000.0,
+		waited > 0 ? stats->seconds_spun/waited*100.0 : 0.0, stats->spin_seconds*1000000.0);
+
+	Metric_Value *histograms[] = {&stats->lateness_us, &stats->jitter_us};
+	const char *names[] = {"lateness", "jitter"};
+	for (u64 i = 0; i < 2; i++) {
+		Metric_Value *h = histograms[i];
+		string_builder_print(builder, STR("%cs us: mean %.1f, p50 %llu, p90 %llu, p99 %llu, max %llu\n"),
+			names[i], h->mean, h->p50, h->p90, h->p99, h->max);
+	}
+}
@@ -7,25 +7,6 @@ const Gfx_Handle GFX_INVALID_HANDLE = 0;
 
 string temp_win32_null_terminated_wide_to_fixed_utf8(const u16 *utf16);
 
-// We wanna pack this at some point
-// #Cleanup #Memory why am I doing alignat(16)?
-typedef struct alignat(16) D3D11_Vertex {
-	
-	Vector4 color;
-	Vector4 position;
-	Vector2 uv;
-	Vector2 self_uv;
-	s8 texture_index;
-	u8 type;
-	u8 sampler;
-	u8 has_scissor;
-	
-	Vector4 userdata[VERTEX_2D_USER_DATA_COUNT];
-	
-	Vector4 scissor;
-	
-} D3D11_Vertex;
-
 // #Global
 
 ID3D11Debug *d3d11_debug = 0;
@@ -60,9 +41,6 @@ void *d3d11_staging_quad_buffer = 0;
 ID3D11Buffer *d3d11_cbuffer = 0;
 u64 d3d11_cbuffer_size = 0;
 
-Draw_Quad *sort_quad_buffer = 0;
-u64 sort_quad_buffer_size = 0;
-
 const char* d3d11_stringify_category(D3D11_MESSAGE_CATEGORY category) {
     switch (category) {
     case D3D11_MESSAGE_CATEGORY_APPLICATION_DEFINED: return "Application Defined";
@@ -315,7 +293,7 @@ d3d11_compile_shader(string source) {
 	layout[0].SemanticIndex = 0;
 	layout[0].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[0].InputSlot = 0;
-	layout[0].AlignedByteOffset = offsetof(D3D11_Vertex, position);
+	layout[0].AlignedByteOffset = offsetof(Draw_Vertex, position);
 	layout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[0].InstanceDataStepRate = 0;
 	
@@ -323,7 +301,7 @@ d3d11_compile_shader(string source) {
 	layout[1].SemanticIndex = 0;
 	layout[1].Format = DXGI_FORMAT_R32G32_FLOAT;
 	layout[1].InputSlot = 0;
-	layout[1].AlignedByteOffset = offsetof(D3D11_Vertex, uv);
+	layout[1].AlignedByteOffset = offsetof(Draw_Vertex, uv);
 	layout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[1].InstanceDataStepRate = 0;
 	
@@ -331,7 +309,7 @@ d3d11_compile_shader(string source) {
 	layout[2].SemanticIndex = 0;
 	layout[2].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[2].InputSlot = 0;
-	layout[2].AlignedByteOffset = offsetof(D3D11_Vertex, color);
+	layout[2].AlignedByteOffset = offsetof(Draw_Vertex, color);
 	layout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[2].InstanceDataStepRate = 0;
 	
@@ -339,7 +317,7 @@ d3d11_compile_shader(string source) {
 	layout[3].SemanticIndex = 0;
 	layout[3].Format = DXGI_FORMAT_R8_SINT;
 	layout[3].InputSlot = 0;
-	layout[3].AlignedByteOffset = offsetof(D3D11_Vertex, texture_index);
+	layout[3].AlignedByteOffset = offsetof(Draw_Vertex, texture_index);
 	layout[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[3].InstanceDataStepRate = 0;
 	
@@ -347,7 +325,7 @@ d3d11_compile_shader(string source) {
 	layout[4].SemanticIndex = 0;
 	layout[4].Format = DXGI_FORMAT_R8_UINT;
 	layout[4].InputSlot = 0;
-	layout[4].AlignedByteOffset = offsetof(D3D11_Vertex, type);
+	layout[4].AlignedByteOffset = offsetof(Draw_Vertex, type);
 	layout[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[4].InstanceDataStepRate = 0;
 	
@@ -355,7 +333,7 @@ d3d11_compile_shader(string source) {
 	layout[5].SemanticIndex = 0;
 	layout[5].Format = DXGI_FORMAT_R8_SINT;
 	layout[5].InputSlot = 0;
-	layout[5].AlignedByteOffset = offsetof(D3D11_Vertex, sampler);
+	layout[5].AlignedByteOffset = offsetof(Draw_Vertex, sampler);
 	layout[5].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[5].InstanceDataStepRate = 0;
 	
@@ -363,7 +341,7 @@ d3d11_compile_shader(string source) {
 	layout[6].SemanticIndex = 0;
 	layout[6].Format = DXGI_FORMAT_R32G32_FLOAT;
 	layout[6].InputSlot = 0;
-	layout[6].AlignedByteOffset = offsetof(D3D11_Vertex, self_uv);
+	layout[6].AlignedByteOffset = offsetof(Draw_Vertex, self_uv);
 	layout[6].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[6].InstanceDataStepRate = 0;
 	
@@ -371,7 +349,7 @@ d3d11_compile_shader(string source) {
 	layout[7].SemanticIndex = 0;
 	layout[7].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[7].InputSlot = 0;
-	layout[7].AlignedByteOffset = offsetof(D3D11_Vertex, scissor);
+	layout[7].AlignedByteOffset = offsetof(Draw_Vertex, scissor);
 	layout[7].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[7].InstanceDataStepRate = 0;
 	
@@ -379,7 +357,7 @@ d3d11_compile_shader(string source) {
 	layout[8].SemanticIndex = 0;
 	layout[8].Format = DXGI_FORMAT_R8_UINT;
 	layout[8].InputSlot = 0;
-	layout[8].AlignedByteOffset = offsetof(D3D11_Vertex, has_scissor);
+	layout[8].AlignedByteOffset = offsetof(Draw_Vertex, has_scissor);
 	layout[8].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	layout[8].InstanceDataStepRate = 0;
 	
@@ -388,7 +366,7 @@ d3d11_compile_shader(string source) {
 	    layout[layout_base_count + i].SemanticIndex = i;
 	    layout[layout_base_count + i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	    layout[layout_base_count + i].InputSlot = 0;
-	    layout[layout_base_count + i].AlignedByteOffset = offsetof(D3D11_Vertex, userdata) + sizeof(Vector4) * i;
+	    layout[layout_base_count + i].AlignedByteOffset = offsetof(Draw_Vertex, userdata) + sizeof(Vector4) * i;
 	    layout[layout_base_count + i].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	}
 	
@@ -569,7 +547,7 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
 	viewport.MaxDepth = 1.0;
 	ID3D11DeviceContext_RSSetViewports(d3d11_context, 1, &viewport);
 	
-    UINT stride = sizeof(D3D11_Vertex);
+    UINT stride = sizeof(Draw_Vertex);
     UINT offset = 0;
 	
 	ID3D11DeviceContext_IASetInputLayout(d3d11_context, d3d11_image_vertex_layout);
@@ -602,6 +580,18 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
     ID3D11DeviceContext_PSSetShaderResources(d3d11_context, 0, num_textures, textures);
 
     ID3D11DeviceContext_Draw(d3d11_context, number_of_rendered_quads * 6, 0);
+    
+    metric_add(METRIC_GFX_DRAW_CALLS, 1);
+}
+
+// If max textures are reached, upload & draw what we have so far
+void d3d11_flush_batch(Draw_Batch *batch) {
+	metric_add(METRIC_GFX_TEXTURE_LIMIT_FLUSHES, 1);
+	D3D11_MAPPED_SUBRESOURCE buffer_mapping;
+	ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0, D3D11_MAP_WRITE_DISCARD, 0, &buffer_mapping);
+	memcpy(buffer_mapping.pData, batch->vertices, batch->quad_count*sizeof(Draw_Vertex)*6);
+	ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
+	d3d11_draw_call(batch->quad_count, batch->textures, batch->num_textures);
 }
 
 void d3d11_process_draw_frame() {
@@ -612,7 +602,7 @@ void d3d11_process_draw_frame() {
 	
 	///
 	// Maybe grow quad vbo
-	u32 required_size = sizeof(D3D11_Vertex) * allocated_quads*6;
+	u32 required_size = sizeof(Draw_Vertex) * allocated_quads*6;
 
 	if (required_size > d3d11_quad_vbo_size) {
 		if (d3d11_quad_vbo) {
@@ -634,195 +624,24 @@ void d3d11_process_draw_frame() {
 		log_verbose("Grew quad vbo to %d bytes.", d3d11_quad_vbo_size);
 	}
 
+	metric_add(METRIC_GFX_QUADS, (s64)draw_frame.num_quads);
+
 	if (draw_frame.num_quads > 0) {
 		///
 		// Render geometry from into vbo quad list
 	    
 		
-		ID3D11ShaderResourceView *textures[32];
-		ID3D11ShaderResourceView *last_texture = 0;
-		u64 num_textures = 0;
-		s8 last_texture_index = 0;
-		
-		D3D11_Vertex* head = (D3D11_Vertex*)d3d11_staging_quad_buffer;
-		D3D11_Vertex* pointer = head;
-		u64 number_of_rendered_quads = 0;
+		Draw_Batch batch = ZERO(Draw_Batch);
+		batch.vertices = (Draw_Vertex*)d3d11_staging_quad_buffer;
+		batch.window_width = window.width;
+		batch.window_height = window.height;
+		batch.flush = d3d11_flush_batch;
 		
 		tm_scope("Quad processing") {
 			if (draw_frame.enable_z_sorting) tm_scope("Z sorting") {
-				if (!sort_quad_buffer || (sort_quad_buffer_size < allocated_quads*sizeof(Draw_Quad))) {
-					// #Memory #Heapalloc
-					if (sort_quad_buffer) dealloc(get_heap_allocator(), sort_quad_buffer);
-					sort_quad_buffer = alloc(get_heap_allocator(), allocated_quads*sizeof(Draw_Quad));
-					sort_quad_buffer_size = allocated_quads*sizeof(Draw_Quad);
-				}
-				radix_sort(quad_buffer, sort_quad_buffer, draw_frame.num_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
-			}
-		
-			for (u64 i = 0; i < draw_frame.num_quads; i++)  {
-				
-				Draw_Quad *q = &quad_buffer[i];
-				
-				assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
-				assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
-				
-				s8 texture_index = -1;
-				
-				if (q->image) {
-					if (last_texture == q->image->gfx_handle) {
-						texture_index = last_texture_index;
-					} else {
-						// First look if texture is already bound
-						for (u64 j = 0; j < num_textures; j++) {
-							if (textures[j] == q->image->gfx_handle) {
-								texture_index = (s8)j;
-								break;
-							}
-						}
-						// Otherwise use a new slot
-						if (texture_index <= -1) {
-							if (num_textures >= 32) {
-								// If max textures reached, make a draw call and start over
-								D3D11_MAPPED_SUBRESOURCE buffer_mapping;
-								ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0, D3D11_MAP_WRITE_DISCARD, 0, &buffer_mapping);
-								memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, number_of_rendered_quads*sizeof(D3D11_Vertex)*6);
-								ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
-								d3d11_draw_call(number_of_rendered_quads, textures, num_textures);
-								head = (D3D11_Vertex*)d3d11_staging_quad_buffer;
-								num_textures = 0;
-								texture_index = 0;
-								number_of_rendered_quads = 0;
-								pointer = head;
-							} else {
-								texture_index = (s8)num_textures;
-								num_textures += 1;
-							}
-						}
-					}
-					textures[texture_index] = q->image->gfx_handle;
-					last_texture = q->image->gfx_handle;
-					last_texture_index = texture_index;
-				}
-				
-				if (q->type == QUAD_TYPE_TEXT) {
-				
-				    // This is meant to fix the annoying artifacts that shows up when sampling text from an atlas
-				    // presumably for floating point precision issues or something.
-				
-				    // #Incomplete
-				    // If we want to animate text with small movements then it will look wonky.
-				    // This should be optional probably.
-				    // Also, we might want to do this on non-text if rendering with linear filtering
-				    // from a large texture atlas.
-				
-					float pixel_width = 2.0/(float)window.width;
-					float pixel_height = 2.0/(float)window.height;
-
-                    bool xeven = window.width % 2 == 0;
-                    bool yeven = window.height % 2 == 0;
-					
-					q->bottom_left.x  = round(q->bottom_left.x  / pixel_width)  * pixel_width;
-				    q->bottom_left.y  = round(q->bottom_left.y  / pixel_height) * pixel_height;
-				    q->top_left.x     = round(q->top_left.x     / pixel_width)  * pixel_width;
-				    q->top_left.y     = round(q->top_left.y     / pixel_height) * pixel_height;
-				    q->top_right.x    = round(q->top_right.x    / pixel_width)  * pixel_width;
-				    q->top_right.y    = round(q->top_right.y    / pixel_height) * pixel_height;
-				    q->bottom_right.x = round(q->bottom_right.x / pixel_width)  * pixel_width;
-				    q->bottom_right.y = round(q->bottom_right.y / pixel_height) * pixel_height;
-				}
-				
-				// We will write to 6 vertices for the one quad (two tris)
-				 {
-				
-					D3D11_Vertex* BL  = pointer + 0;
-					D3D11_Vertex* TL  = pointer + 1;
-					D3D11_Vertex* TR  = pointer + 2;
-					D3D11_Vertex* BL2 = pointer + 3;
-					D3D11_Vertex* TR2 = pointer + 4;
-					D3D11_Vertex* BR  = pointer + 5;
-					pointer += 6;
-					
-					BL->position = v4(q->bottom_left.x,  q->bottom_left.y,  0, 1);
-					TL->position = v4(q->top_left.x,     q->top_left.y,     0, 1);
-					TR->position = v4(q->top_right.x,    q->top_right.y,    0, 1);
-					BR->position = v4(q->bottom_right.x, q->bottom_right.y, 0, 1);
-					
-					
-					if (q->image) {
-
-						BL->uv = v2(q->uv.x1, q->uv.y1);
-						TL->uv = v2(q->uv.x1, q->uv.y2);
-						TR->uv = v2(q->uv.x2, q->uv.y2);
-						BR->uv = v2(q->uv.x2, q->uv.y1);
-						// #Hack #Bug #Cleanup
-						// When a window dimension is uneven it slightly under/oversamples on an axis by a
-						// seemingly arbitrary amount. The 0.25 is a magic value I got from trial and error.
-						// (It undersamples by a fourth of the atlas texture?)
-						// Anything > 0.25 < will slightly over/undersample on my machine.
-						// I have no idea about #Portability here.
-						// - Charlie M 26th July 2024
-						if (window.width % 2 != 0) {
-							BL->uv.x += (2.0/(float)q->image->width)*0.25;
-							TL->uv.x += (2.0/(float)q->image->width)*0.25;
-							TR->uv.x += (2.0/(float)q->image->width)*0.25;
-							BR->uv.x += (2.0/(float)q->image->width)*0.25;
-						}
-						if (window.height % 2 != 0) {
-							BL->uv.y -= (2.0/(float)q->image->height)*0.25;
-							TL->uv.y -= (2.0/(float)q->image->height)*0.25;
-							TR->uv.y -= (2.0/(float)q->image->height)*0.25;
-							BR->uv.y -= (2.0/(float)q->image->height)*0.25;
-						}
-
-						u8 sampler = -1;
-						if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
-									&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
-								sampler = 0;
-						if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
-									&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
-								sampler = 1;
-						if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
-									&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
-								sampler = 2;
-						if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
-									&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
-								sampler = 3;
-						BL->sampler=TL->sampler=TR->sampler=BR->sampler = (u8)sampler;
-								
-					}
-					BL->texture_index=TL->texture_index=TR->texture_index=BR->texture_index = texture_index;
-					
-					BL->self_uv = v2(0, 0);
-					TL->self_uv = v2(0, 1);
-					TR->self_uv = v2(1, 1);
-					BR->self_uv = v2(1, 0);
-					
-					// #Speed
-					memcpy(BL->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(TL->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(TR->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(BR->userdata, q->userdata, sizeof(q->userdata));
-					
-					BL->color = TL->color = TR->color = BR->color = q->color;
-					
-					BL->type=TL->type=TR->type=BR->type = (u8)q->type;
-					
-					float t = q->scissor.y1;
-					q->scissor.y1 = q->scissor.y2;
-					q->scissor.y2 = t;
-					
-					q->scissor.y1 = window.pixel_height - q->scissor.y1;
-					q->scissor.y2 = window.pixel_height - q->scissor.y2;
-					
-					BL->has_scissor=TL->has_scissor=TR->has_scissor=BR->has_scissor = q->has_scissor;
-					BL->scissor=TL->scissor=TR->scissor=BR->scissor = q->scissor;
-					
-					*BL2 = *BL;
-					*TR2 = *TR;
-					
-					number_of_rendered_quads += 1;
-				}
+				draw_batch_sort_quads(quad_buffer, draw_frame.num_quads);
 			}
+			draw_batch_build_vertices(&batch, quad_buffer, draw_frame.num_quads);
 		}
 		
 		tm_scope("Write to gpu") {
@@ -832,7 +651,7 @@ void d3d11_process_draw_frame() {
 			d3d11_check_hr(hr);
 			}
 			tm_scope("The memcpy") {
-				memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, number_of_rendered_quads*sizeof(D3D11_Vertex)*6);
+				memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, batch.quad_count*sizeof(Draw_Vertex)*6);
 			}
 			tm_scope("The Unmap call") {
 				ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
@@ -841,7 +660,7 @@ void d3d11_process_draw_frame() {
 		
 		///
 		// Draw call
-		tm_scope("Draw call") d3d11_draw_call(number_of_rendered_quads, textures, num_textures);
+		tm_scope("Draw call") d3d11_draw_call(batch.quad_count, batch.textures, batch.num_textures);
     }
     
     reset_draw_frame(&draw_frame);
@@ -850,6 +669,8 @@ void d3d11_process_draw_frame() {
 void gfx_update() {
 	if (window.should_close) return;
 	
+	profiler_overlay_update_and_draw();
+	
 	
 
 	HRESULT hr;
@@ -864,12 +685,16 @@ void gfx_update() {
 		d3d11_update_swapchain();
 	}
 
+	draw_capture_frame();
+
 	d3d11_process_draw_frame();
 
 	tm_scope("Present") {
 		IDXGISwapChain1_Present(d3d11_swap_chain, window.enable_vsync, window.enable_vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 	}
 	
+	metrics_frame_end();
+	
 	
 #if CONFIGURATION == DEBUG
 	d3d11_output_debug_messages();
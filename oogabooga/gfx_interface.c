@@ -80,8 +80,8 @@ make_image(u32 width, u32 height, u32 channels, void *initial_data, Allocator al
 
 Gfx_Image *
 load_image_from_disk(string path, Allocator allocator) {
-    string png;
-    bool ok = os_read_entire_file(path, &png, allocator);
+    Os_File_Map png;
+    bool ok = os_file_map(path, &png, OS_FILE_MAP_ACCESS_SEQUENTIAL);
     if (!ok) return 0;
 
     Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
@@ -89,12 +89,13 @@ load_image_from_disk(string path, Allocator allocator) {
     int width, height, channels;
     stbi_set_flip_vertically_on_load(1);
     third_party_allocator = allocator;
-    unsigned char* stb_data = stbi_load_from_memory(png.data, png.count, &width, &height, &channels, STBI_rgb_alpha);
+    unsigned char* stb_data = stbi_load_from_memory(png.data.data, png.data.count, &width, &height, &channels, STBI_rgb_alpha);
     
     
     if (!stb_data) {
         dealloc(allocator, image);
-        dealloc_string(allocator, png);
+        os_file_unmap(&png);
+        third_party_allocator = ZERO(Allocator);
         return 0;
     }
     
@@ -104,7 +105,7 @@ load_image_from_disk(string path, Allocator allocator) {
     image->allocator = allocator;
     image->channels = 4;
 
-    dealloc_string(allocator, png);
+    os_file_unmap(&png);
     
     gfx_init_image(image, stb_data);
     
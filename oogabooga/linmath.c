@@ -551,6 +551,511 @@ Matrix4 m4_inverse(Matrix4 m) {
     return inv;
 }
 
+///
+// Affine2
+// A 2D transform as the 2x3 that matters out of a Matrix4 that only moves things around in x & y:
+//     x' = m[0][0]*x + m[0][1]*y + m[0][2]
+//     y' = m[1][0]*x + m[1][1]*y + m[1][2]
+// Same conventions as the Matrix4 procedures, so affine2_rotate(m, r) does what
+// m4_rotate_z(m, r) does and affine2_mul(a, b) applies b first.
+typedef struct Affine2 {
+    union {float32 m[2][3]; float32 data[6]; };
+} Affine2;
+
+inline Affine2 affine2_scalar(float32 scalar) {
+	return (Affine2){.m = {{scalar, 0, 0}, {0, scalar, 0}}};
+}
+inline Affine2 affine2_make_translation(Vector2 translation) {
+	return (Affine2){.m = {{1, 0, translation.x}, {0, 1, translation.y}}};
+}
+inline Affine2 affine2_make_rotation(float32 radians) {
+	float32 c = cosf(radians);
+	float32 s = sinf(radians);
+	return (Affine2){.m = {{c, s, 0}, {-s, c, 0}}};
+}
+inline Affine2 affine2_make_scale(Vector2 scale) {
+	return (Affine2){.m = {{scale.x, 0, 0}, {0, scale.y, 0}}};
+}
+
+Affine2 affine2_mul(Affine2 a, Affine2 b) {
+	Affine2 result;
+	for (int i = 0; i < 2; i++) {
+		result.m[i][0] = a.m[i][0] * b.m[0][0] + a.m[i][1] * b.m[1][0];
+		result.m[i][1] = a.m[i][0] * b.m[0][1] + a.m[i][1] * b.m[1][1];
+		result.m[i][2] = a.m[i][0] * b.m[0][2] + a.m[i][1] * b.m[1][2] + a.m[i][2];
+	}
+	return result;
+}
+
+// These multiply on the right like m4_translate & co, so they happen before m
+inline Affine2 affine2_translate(Affine2 m, Vector2 translation) {
+	m.m[0][2] += m.m[0][0] * translation.x + m.m[0][1] * translation.y;
+	m.m[1][2] += m.m[1][0] * translation.x + m.m[1][1] * translation.y;
+	return m;
+}
+inline Affine2 affine2_rotate(Affine2 m, float32 radians) {
+	return affine2_mul(m, affine2_make_rotation(radians));
+}
+inline Affine2 affine2_scale(Affine2 m, Vector2 scale) {
+	m.m[0][0] *= scale.x; m.m[1][0] *= scale.x;
+	m.m[0][1] *= scale.y; m.m[1][1] *= scale.y;
+	return m;
+}
+
+// Inverse of the 2x2 part, and the translation undone through it.
+// All zeros if m can't be inverted, like m4_inverse.
+Affine2 affine2_inverse(Affine2 m) {
+	float32 det = m.m[0][0] * m.m[1][1] - m.m[0][1] * m.m[1][0];
+	if (det == 0) return affine2_scalar(0);
+	float32 inv_det = 1.0f / det;
+	
+	Affine2 inv;
+	inv.m[0][0] =  m.m[1][1] * inv_det;
+	inv.m[0][1] = -m.m[0][1] * inv_det;
+	inv.m[1][0] = -m.m[1][0] * inv_det;
+	inv.m[1][1] =  m.m[0][0] * inv_det;
+	inv.m[0][2] = -(inv.m[0][0] * m.m[0][2] + inv.m[0][1] * m.m[1][2]);
+	inv.m[1][2] = -(inv.m[1][0] * m.m[0][2] + inv.m[1][1] * m.m[1][2]);
+	return inv;
+}
+
+inline Vector2 affine2_transform(Affine2 m, Vector2 p) {
+	return v2(m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2],
+	          m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2]);
+}
+// Without the translation
+inline Vector2 affine2_transform_direction(Affine2 m, Vector2 d) {
+	return v2(m.m[0][0] * d.x + m.m[0][1] * d.y,
+	          m.m[1][0] * d.x + m.m[1][1] * d.y);
+}
+
+// True if x & y out of m only depend on x & y in and w stays 1, so the Affine2 of it
+// does the same thing to points with z = 0 (orthographic projections, and anything made
+// of translations, rotations around z and scales).
+inline bool m4_is_affine2(Matrix4 m) {
+	return m.m[0][2] == 0 && m.m[1][2] == 0 &&
+	       m.m[3][0] == 0 && m.m[3][1] == 0 && m.m[3][2] == 0 && m.m[3][3] == 1;
+}
+inline Affine2 affine2_from_m4(Matrix4 m) {
+	return (Affine2){.m = {{m.m[0][0], m.m[0][1], m.m[0][3]}, {m.m[1][0], m.m[1][1], m.m[1][3]}}};
+}
+inline Matrix4 m4_from_affine2(Affine2 a) {
+	Matrix4 m = m4_scalar(1.0);
+	m.m[0][0] = a.m[0][0]; m.m[0][1] = a.m[0][1]; m.m[0][3] = a.m[0][2];
+	m.m[1][0] = a.m[1][0]; m.m[1][1] = a.m[1][1]; m.m[1][3] = a.m[1][2];
+	return m;
+}
+
+///
+// Batch math
+// The same thing done to lots of points or boxes at once, for transforming vertices, culling
+// and radius queries. The _soa versions take each component in its own array so 4 (SSE) or
+// 8 (AVX) of them fill a register as they are. The others take arrays of Vector2 / Vector4
+// and shuffle them into that layout a block at a time on the stack.
+// Boxes are Vector4's as {left, bottom, right, top}. Touching counts as overlapping.
+// Which path runs follows simd_procs.level. out arrays may be the in arrays.
+
+#define LINMATH_BATCH_BLOCK 256
+
+// Basic versions, also used for what's left after the simd blocks
+void _m4_transform_points_v2_soa_basic(Matrix4 *m, const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 start, u64 end) {
+	for (u64 i = start; i < end; i++) {
+		float32 tx = m->m[0][0]*x[i] + m->m[0][1]*y[i] + m->m[0][3];
+		float32 ty = m->m[1][0]*x[i] + m->m[1][1]*y[i] + m->m[1][3];
+		out_x[i] = tx;
+		out_y[i] = ty;
+	}
+}
+void _v2_length_batch_soa_basic(const float32 *x, const float32 *y, float32 *out, u64 start, u64 end) {
+	for (u64 i = start; i < end; i++) out[i] = sqrt(x[i]*x[i] + y[i]*y[i]);
+}
+void _v2_normalize_batch_soa_basic(const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 start, u64 end) {
+	for (u64 i = start; i < end; i++) {
+		Vector2 n = v2_normalize(v2(x[i], y[i]));
+		out_x[i] = n.x;
+		out_y[i] = n.y;
+	}
+}
+void _v2_distance_squared_batch_soa_basic(Vector2 p, const float32 *x, const float32 *y, float32 *out, u64 start, u64 end) {
+	for (u64 i = start; i < end; i++) {
+		float32 dx = x[i]-p.x;
+		float32 dy = y[i]-p.y;
+		out[i] = dx*dx + dy*dy;
+	}
+}
+u64 _v2_find_within_radius_soa_basic(Vector2 p, float32 radius, const float32 *x, const float32 *y, u64 start, u64 end, u64 index_offset, u64 *out_indices) {
+	float32 r2 = radius*radius;
+	u64 found = 0;
+	for (u64 i = start; i < end; i++) {
+		float32 dx = x[i]-p.x;
+		float32 dy = y[i]-p.y;
+		if (dx*dx + dy*dy <= r2) out_indices[found++] = index_offset+i;
+	}
+	return found;
+}
+u64 _aabb_find_overlapping_soa_basic(Vector4 box, const float32 *left, const float32 *bottom, const float32 *right, const float32 *top, u64 start, u64 end, u64 index_offset, u64 *out_indices) {
+	u64 found = 0;
+	for (u64 i = start; i < end; i++) {
+		if (left[i] <= box.right && right[i] >= box.left && bottom[i] <= box.top && top[i] >= box.bottom) {
+			out_indices[found++] = index_offset+i;
+		}
+	}
+	return found;
+}
+
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+
+// Appends i+index_offset for each set bit in mask
+inline u64 _batch_push_indices(u64 mask, u64 i, u64 index_offset, u64 *out_indices) {
+	u64 found = 0;
+	while (mask) {
+		out_indices[found++] = index_offset + i + bit_scan_forward_64(mask);
+		mask &= mask-1;
+	}
+	return found;
+}
+
+void _m4_transform_points_v2_soa_sse(Matrix4 *m, const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+	__m128 m00 = _mm_set1_ps(m->m[0][0]), m01 = _mm_set1_ps(m->m[0][1]), m03 = _mm_set1_ps(m->m[0][3]);
+	__m128 m10 = _mm_set1_ps(m->m[1][0]), m11 = _mm_set1_ps(m->m[1][1]), m13 = _mm_set1_ps(m->m[1][3]);
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		__m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, vx), _mm_mul_ps(m01, vy)), m03);
+		__m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, vx), _mm_mul_ps(m11, vy)), m13);
+		_mm_storeu_ps(out_x+i, tx);
+		_mm_storeu_ps(out_y+i, ty);
+	}
+	_m4_transform_points_v2_soa_basic(m, x, y, out_x, out_y, i, count);
+}
+void _v2_length_batch_soa_sse(const float32 *x, const float32 *y, float32 *out, u64 count) {
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		_mm_storeu_ps(out+i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy))));
+	}
+	_v2_length_batch_soa_basic(x, y, out, i, count);
+}
+void _v2_normalize_batch_soa_sse(const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+		// Zero length gives 0/0, masked out to (0, 0) like v2_normalize
+		__m128 nonzero = _mm_cmpneq_ps(length, _mm_setzero_ps());
+		_mm_storeu_ps(out_x+i, _mm_and_ps(nonzero, _mm_div_ps(vx, length)));
+		_mm_storeu_ps(out_y+i, _mm_and_ps(nonzero, _mm_div_ps(vy, length)));
+	}
+	_v2_normalize_batch_soa_basic(x, y, out_x, out_y, i, count);
+}
+void _v2_distance_squared_batch_soa_sse(Vector2 p, const float32 *x, const float32 *y, float32 *out, u64 count) {
+	__m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y);
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x+i), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y+i), py);
+		_mm_storeu_ps(out+i, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+	}
+	_v2_distance_squared_batch_soa_basic(p, x, y, out, i, count);
+}
+u64 _v2_find_within_radius_soa_sse(Vector2 p, float32 radius, const float32 *x, const float32 *y, u64 count, u64 index_offset, u64 *out_indices) {
+	__m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), r2 = _mm_set1_ps(radius*radius);
+	u64 found = 0;
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x+i), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y+i), py);
+		__m128 inside = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), r2);
+		found += _batch_push_indices((u64)_mm_movemask_ps(inside), i, index_offset, out_indices+found);
+	}
+	found += _v2_find_within_radius_soa_basic(p, radius, x, y, i, count, index_offset, out_indices+found);
+	return found;
+}
+u64 _aabb_find_overlapping_soa_sse(Vector4 box, const float32 *left, const float32 *bottom, const float32 *right, const float32 *top, u64 count, u64 index_offset, u64 *out_indices) {
+	__m128 box_left = _mm_set1_ps(box.left), box_bottom = _mm_set1_ps(box.bottom);
+	__m128 box_right = _mm_set1_ps(box.right), box_top = _mm_set1_ps(box.top);
+	u64 found = 0;
+	u64 i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128 overlap_x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(left+i), box_right), _mm_cmpge_ps(_mm_loadu_ps(right+i), box_left));
+		__m128 overlap_y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(bottom+i), box_top), _mm_cmpge_ps(_mm_loadu_ps(top+i), box_bottom));
+		found += _batch_push_indices((u64)_mm_movemask_ps(_mm_and_ps(overlap_x, overlap_y)), i, index_offset, out_indices+found);
+	}
+	found += _aabb_find_overlapping_soa_basic(box, left, bottom, right, top, i, count, index_offset, out_indices+found);
+	return found;
+}
+
+#if COMPILER_CAN_TARGET_AVX
+target_avx void _m4_transform_points_v2_soa_avx(Matrix4 *m, const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+	__m256 m00 = _mm256_set1_ps(m->m[0][0]), m01 = _mm256_set1_ps(m->m[0][1]), m03 = _mm256_set1_ps(m->m[0][3]);
+	__m256 m10 = _mm256_set1_ps(m->m[1][0]), m11 = _mm256_set1_ps(m->m[1][1]), m13 = _mm256_set1_ps(m->m[1][3]);
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 vx = _mm256_loadu_ps(x+i);
+		__m256 vy = _mm256_loadu_ps(y+i);
+		__m256 tx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)), m03);
+		__m256 ty = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)), m13);
+		_mm256_storeu_ps(out_x+i, tx);
+		_mm256_storeu_ps(out_y+i, ty);
+	}
+	_m4_transform_points_v2_soa_basic(m, x, y, out_x, out_y, i, count);
+}
+target_avx void _v2_length_batch_soa_avx(const float32 *x, const float32 *y, float32 *out, u64 count) {
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 vx = _mm256_loadu_ps(x+i);
+		__m256 vy = _mm256_loadu_ps(y+i);
+		_mm256_storeu_ps(out+i, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy))));
+	}
+	_v2_length_batch_soa_basic(x, y, out, i, count);
+}
+target_avx void _v2_normalize_batch_soa_avx(const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 vx = _mm256_loadu_ps(x+i);
+		__m256 vy = _mm256_loadu_ps(y+i);
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+		__m256 nonzero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+		_mm256_storeu_ps(out_x+i, _mm256_and_ps(nonzero, _mm256_div_ps(vx, length)));
+		_mm256_storeu_ps(out_y+i, _mm256_and_ps(nonzero, _mm256_div_ps(vy, length)));
+	}
+	_v2_normalize_batch_soa_basic(x, y, out_x, out_y, i, count);
+}
+target_avx void _v2_distance_squared_batch_soa_avx(Vector2 p, const float32 *x, const float32 *y, float32 *out, u64 count) {
+	__m256 px = _mm256_set1_ps(p.x), py = _mm256_set1_ps(p.y);
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x+i), px);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y+i), py);
+		_mm256_storeu_ps(out+i, _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+	}
+	_v2_distance_squared_batch_soa_basic(p, x, y, out, i, count);
+}
+target_avx u64 _v2_find_within_radius_soa_avx(Vector2 p, float32 radius, const float32 *x, const float32 *y, u64 count, u64 index_offset, u64 *out_indices) {
+	__m256 px = _mm256_set1_ps(p.x), py = _mm256_set1_ps(p.y), r2 = _mm256_set1_ps(radius*radius);
+	u64 found = 0;
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x+i), px);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y+i), py);
+		__m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), r2, _CMP_LE_OQ);
+		found += _batch_push_indices((u64)_mm256_movemask_ps(inside), i, index_offset, out_indices+found);
+	}
+	found += _v2_find_within_radius_soa_basic(p, radius, x, y, i, count, index_offset, out_indices+found);
+	return found;
+}
+target_avx u64 _aabb_find_overlapping_soa_avx(Vector4 box, const float32 *left, const float32 *bottom, const float32 *right, const float32 *top, u64 count, u64 index_offset, u64 *out_indices) {
+	__m256 box_left = _mm256_set1_ps(box.left), box_bottom = _mm256_set1_ps(box.bottom);
+	__m256 box_right = _mm256_set1_ps(box.right), box_top = _mm256_set1_ps(box.top);
+	u64 found = 0;
+	u64 i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m256 overlap_x = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(left+i), box_right, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(right+i), box_left, _CMP_GE_OQ));
+		__m256 overlap_y = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(bottom+i), box_top, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(top+i), box_bottom, _CMP_GE_OQ));
+		found += _batch_push_indices((u64)_mm256_movemask_ps(_mm256_and_ps(overlap_x, overlap_y)), i, index_offset, out_indices+found);
+	}
+	found += _aabb_find_overlapping_soa_basic(box, left, bottom, right, top, i, count, index_offset, out_indices+found);
+	return found;
+}
+#endif // COMPILER_CAN_TARGET_AVX
+
+#endif // ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	#define _LINMATH_BATCH_CAN_SSE (simd_procs.level >= SIMD_LEVEL_SSE)
+#else
+	#define _LINMATH_BATCH_CAN_SSE 0
+#endif
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX
+	#define _LINMATH_BATCH_CAN_AVX (simd_procs.level >= SIMD_LEVEL_AVX)
+#else
+	#define _LINMATH_BATCH_CAN_AVX 0
+#endif
+
+void m4_transform_points_v2_soa(Matrix4 m, const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) { _m4_transform_points_v2_soa_avx(&m, x, y, out_x, out_y, count); return; }
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) { _m4_transform_points_v2_soa_sse(&m, x, y, out_x, out_y, count); return; }
+#endif
+	_m4_transform_points_v2_soa_basic(&m, x, y, out_x, out_y, 0, count);
+}
+void v2_length_batch_soa(const float32 *x, const float32 *y, float32 *out, u64 count) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) { _v2_length_batch_soa_avx(x, y, out, count); return; }
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) { _v2_length_batch_soa_sse(x, y, out, count); return; }
+#endif
+	_v2_length_batch_soa_basic(x, y, out, 0, count);
+}
+void v2_normalize_batch_soa(const float32 *x, const float32 *y, float32 *out_x, float32 *out_y, u64 count) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) { _v2_normalize_batch_soa_avx(x, y, out_x, out_y, count); return; }
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) { _v2_normalize_batch_soa_sse(x, y, out_x, out_y, count); return; }
+#endif
+	_v2_normalize_batch_soa_basic(x, y, out_x, out_y, 0, count);
+}
+void v2_distance_squared_batch_soa(Vector2 p, const float32 *x, const float32 *y, float32 *out, u64 count) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) { _v2_distance_squared_batch_soa_avx(p, x, y, out, count); return; }
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) { _v2_distance_squared_batch_soa_sse(p, x, y, out, count); return; }
+#endif
+	_v2_distance_squared_batch_soa_basic(p, x, y, out, 0, count);
+}
+u64 _v2_find_within_radius_soa(Vector2 p, float32 radius, const float32 *x, const float32 *y, u64 count, u64 index_offset, u64 *out_indices) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) return _v2_find_within_radius_soa_avx(p, radius, x, y, count, index_offset, out_indices);
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) return _v2_find_within_radius_soa_sse(p, radius, x, y, count, index_offset, out_indices);
+#endif
+	return _v2_find_within_radius_soa_basic(p, radius, x, y, 0, count, index_offset, out_indices);
+}
+// Writes the index of every point at most radius away from p, returns how many.
+// out_indices needs room for count.
+u64 v2_find_within_radius_soa(Vector2 p, float32 radius, const float32 *x, const float32 *y, u64 count, u64 *out_indices) {
+	return _v2_find_within_radius_soa(p, radius, x, y, count, 0, out_indices);
+}
+u64 _aabb_find_overlapping_soa(Vector4 box, const float32 *left, const float32 *bottom, const float32 *right, const float32 *top, u64 count, u64 index_offset, u64 *out_indices) {
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+#if COMPILER_CAN_TARGET_AVX
+	if (_LINMATH_BATCH_CAN_AVX) return _aabb_find_overlapping_soa_avx(box, left, bottom, right, top, count, index_offset, out_indices);
+#endif
+	if (_LINMATH_BATCH_CAN_SSE) return _aabb_find_overlapping_soa_sse(box, left, bottom, right, top, count, index_offset, out_indices);
+#endif
+	return _aabb_find_overlapping_soa_basic(box, left, bottom, right, top, 0, count, index_offset, out_indices);
+}
+// Writes the index of every box that overlaps box, returns how many.
+// out_indices needs room for count.
+u64 aabb_find_overlapping_soa(Vector4 box, const float32 *left, const float32 *bottom, const float32 *right, const float32 *top, u64 count, u64 *out_indices) {
+	return _aabb_find_overlapping_soa(box, left, bottom, right, top, count, 0, out_indices);
+}
+
+// Array of structs <-> struct of arrays, for count <= LINMATH_BATCH_BLOCK
+void _v2_to_soa(const Vector2 *in, float32 *x, float32 *y, u64 count) {
+	u64 i = 0;
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	if (_LINMATH_BATCH_CAN_SSE) {
+		for (; i+4 <= count; i += 4) {
+			__m128 a = _mm_loadu_ps((float32*)(in+i));   // x0 y0 x1 y1
+			__m128 b = _mm_loadu_ps((float32*)(in+i+2)); // x2 y2 x3 y3
+			_mm_storeu_ps(x+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(y+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+	}
+}
+void _v2_from_soa(const float32 *x, const float32 *y, Vector2 *out, u64 count) {
+	u64 i = 0;
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	if (_LINMATH_BATCH_CAN_SSE) {
+		for (; i+4 <= count; i += 4) {
+			__m128 vx = _mm_loadu_ps(x+i);
+			__m128 vy = _mm_loadu_ps(y+i);
+			_mm_storeu_ps((float32*)(out+i),   _mm_unpacklo_ps(vx, vy));
+			_mm_storeu_ps((float32*)(out+i+2), _mm_unpackhi_ps(vx, vy));
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		out[i].x = x[i];
+		out[i].y = y[i];
+	}
+}
+void _v4_to_soa(const Vector4 *in, float32 *x, float32 *y, float32 *z, float32 *w, u64 count) {
+	u64 i = 0;
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	if (_LINMATH_BATCH_CAN_SSE) {
+		for (; i+4 <= count; i += 4) {
+			__m128 r0 = _mm_loadu_ps(in[i+0].data);
+			__m128 r1 = _mm_loadu_ps(in[i+1].data);
+			__m128 r2 = _mm_loadu_ps(in[i+2].data);
+			__m128 r3 = _mm_loadu_ps(in[i+3].data);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(x+i, r0);
+			_mm_storeu_ps(y+i, r1);
+			_mm_storeu_ps(z+i, r2);
+			_mm_storeu_ps(w+i, r3);
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+		z[i] = in[i].z;
+		w[i] = in[i].w;
+	}
+}
+
+// Transforms (x, y, 0, 1) by m and keeps x & y. No perspective divide.
+void m4_transform_points_v2(Matrix4 m, const Vector2 *in, Vector2 *out, u64 count) {
+	float32 x[LINMATH_BATCH_BLOCK], y[LINMATH_BATCH_BLOCK];
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v2_to_soa(in+start, x, y, n);
+		m4_transform_points_v2_soa(m, x, y, x, y, n);
+		_v2_from_soa(x, y, out+start, n);
+	}
+}
+void v2_length_batch(const Vector2 *in, float32 *out, u64 count) {
+	float32 x[LINMATH_BATCH_BLOCK], y[LINMATH_BATCH_BLOCK];
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v2_to_soa(in+start, x, y, n);
+		v2_length_batch_soa(x, y, out+start, n);
+	}
+}
+void v2_normalize_batch(const Vector2 *in, Vector2 *out, u64 count) {
+	float32 x[LINMATH_BATCH_BLOCK], y[LINMATH_BATCH_BLOCK];
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v2_to_soa(in+start, x, y, n);
+		v2_normalize_batch_soa(x, y, x, y, n);
+		_v2_from_soa(x, y, out+start, n);
+	}
+}
+void v2_distance_squared_batch(Vector2 p, const Vector2 *in, float32 *out, u64 count) {
+	float32 x[LINMATH_BATCH_BLOCK], y[LINMATH_BATCH_BLOCK];
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v2_to_soa(in+start, x, y, n);
+		v2_distance_squared_batch_soa(p, x, y, out+start, n);
+	}
+}
+u64 v2_find_within_radius(Vector2 p, float32 radius, const Vector2 *points, u64 count, u64 *out_indices) {
+	float32 x[LINMATH_BATCH_BLOCK], y[LINMATH_BATCH_BLOCK];
+	u64 found = 0;
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v2_to_soa(points+start, x, y, n);
+		found += _v2_find_within_radius_soa(p, radius, x, y, n, start, out_indices+found);
+	}
+	return found;
+}
+u64 aabb_find_overlapping(Vector4 box, const Vector4 *boxes, u64 count, u64 *out_indices) {
+	float32 left[LINMATH_BATCH_BLOCK], bottom[LINMATH_BATCH_BLOCK], right[LINMATH_BATCH_BLOCK], top[LINMATH_BATCH_BLOCK];
+	u64 found = 0;
+	for (u64 start = 0; start < count; start += LINMATH_BATCH_BLOCK) {
+		u64 n = count-start < LINMATH_BATCH_BLOCK ? count-start : LINMATH_BATCH_BLOCK;
+		_v4_to_soa(boxes+start, left, bottom, right, top, n);
+		found += _aabb_find_overlapping_soa(box, left, bottom, right, top, n, start, out_indices+found);
+	}
+	return found;
+}
+
 // This isn't really linmath but just putting it here for now
 #define clamp(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
 
@@ -0,0 +1,460 @@
+///
+// Async logger
+// The default logger takes a lock and writes every line to stdout before it returns, so a
+// thread that logs waits for the console. That's bad news on the audio thread, or when
+// something logs a lot in one frame.
+//
+// While the async logger runs, log lines are instead copied into a ring buffer that belongs
+// to the calling thread, without taking any locks. A writer thread collects the lines of all
+// threads in the order they were logged and writes them in batches, to stdout and/or a log file.
+//
+//     async_logger_start(STR("logs/game.log"), true); // null_string for no log file
+//     log_info("Hi");                                 // As usual, from any thread
+//     async_logger_flush();                           // Waits until everything logged so far is written
+//     async_logger_stop();
+//
+// Or #define ENABLE_ASYNC_LOGGING 1 to have it started in oogabooga_init (stdout only) and
+// stopped when the program exits.
+//
+// If a thread logs faster than the writer keeps up, lines that don't fit in its ring are
+// dropped. The writer counts them and writes a warning with how many it dropped.
+// Errors wait for the writer before returning, so they aren't lost if the program crashes
+// right after. Set async_logger.flush_on_error = false if that's not what you want.
+//
+// Whenever the log file would grow past async_logger.max_file_size it's rotated: game.log is
+// renamed to game.1.log, game.1.log to game.2.log and so on, keeping max_file_count files.
+// A log file that already exists on start is rotated too, so the last few runs are kept.
+//
+// Lines that are logged while print() prints may come out after the print.
+
+#define ASYNC_LOGGER_MAX_THREADS 64
+// Per thread. A line takes one record per ASYNC_LOGGER_RECORD_TEXT_SIZE bytes.
+#define ASYNC_LOGGER_RING_RECORD_COUNT 512
+#define ASYNC_LOGGER_RECORD_TEXT_SIZE 112
+#define ASYNC_LOGGER_BATCH_SIZE KB(64)
+#define ASYNC_LOGGER_DEFAULT_MAX_FILE_SIZE MB(16)
+#define ASYNC_LOGGER_DEFAULT_MAX_FILE_COUNT 4
+
+typedef struct Async_Log_Record {
+	u64 time; // rdtsc, to put the lines of different threads back in order
+	u16 level;
+	u16 length;     // Of the text in this record
+	u16 parts_left; // How many of the next records continue this line
+	u16 unused;
+	u8 text[ASYNC_LOGGER_RECORD_TEXT_SIZE];
+} Async_Log_Record;
+
+typedef enum Async_Log_Slot_State {
+	ASYNC_LOG_SLOT_FREE = 0,
+	ASYNC_LOG_SLOT_CLAIMING,
+	ASYNC_LOG_SLOT_OWNED,
+	ASYNC_LOG_SLOT_ABANDONED, // The thread exited, free it when it's drained
+} Async_Log_Slot_State;
+
+typedef struct Async_Log_Slot {
+	Spsc_Ring ring; // Owning thread pushes, writer pops
+	volatile u32 state;  // Async_Log_Slot_State
+	volatile u64 dropped;
+
+	// Writer only
+	Async_Log_Record front; // Popped from the ring and waiting for its turn
+	bool has_front;
+} Async_Log_Slot;
+
+typedef struct Async_Logger_Stats {
+	u64 lines_written;
+	u64 lines_dropped;
+	u64 bytes_written;
+	u64 batches_written;
+} Async_Logger_Stats;
+
+typedef struct Async_Logger {
+	// Set these before starting if you want something else
+	bool flush_on_error;
+	u64 max_file_size;
+	u64 max_file_count;
+
+	volatile bool running;
+	bool write_to_stdout;
+	string file_path;
+	File file;
+	u64 file_size;
+	Thread writer;
+
+	Async_Log_Slot slots[ASYNC_LOGGER_MAX_THREADS];
+	volatile u32 slot_count; // Slots past this were never claimed
+
+	volatile u32 stop;
+	volatile u32 writer_sleeping;
+	volatile u32 wake_generation;
+	volatile u32 flush_requested;
+	volatile u32 flush_completed;
+
+	char *batch;
+	u64 batch_count;
+
+	// Written by the writer
+	Async_Logger_Stats stats;
+} Async_Logger;
+
+// #Global
+ogb_instance Async_Logger async_logger;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Async_Logger async_logger = {
+	.flush_on_error = true,
+	.max_file_size  = ASYNC_LOGGER_DEFAULT_MAX_FILE_SIZE,
+	.max_file_count = ASYNC_LOGGER_DEFAULT_MAX_FILE_COUNT,
+};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+thread_local Async_Log_Slot *_async_log_slot = 0;
+
+// Same as default_logger, all the same length so the messages line up
+#define ASYNC_LOG_PREFIX_LENGTH 11
+const char *_async_log_prefixes[LOG_LEVEL_COUNT+1] = {
+	[LOG_ERROR]       = "[ERROR]:   ",
+	[LOG_INFO]        = "[INFO]:    ",
+	[LOG_WARNING]     = "[WARNING]: ",
+	[LOG_VERBOSE]     = "[VERBOSE]: ",
+	[LOG_LEVEL_COUNT] = "[?]:       ",
+};
+
+Async_Log_Slot *
+_async_logger_claim_slot() {
+	for (u32 i = 0; i < ASYNC_LOGGER_MAX_THREADS; i++) {
+		Async_Log_Slot *slot = &async_logger.slots[i];
+		if (!compare_and_swap_32(&slot->state, ASYNC_LOG_SLOT_CLAIMING, ASYNC_LOG_SLOT_FREE)) continue;
+
+		// Rings are kept when a slot is freed and reused by the next thread that claims it
+		if (!slot->ring.buffer) {
+			spsc_ring_init(&slot->ring, sizeof(Async_Log_Record), ASYNC_LOGGER_RING_RECORD_COUNT, get_heap_allocator());
+		}
+
+		while (true) {
+			u32 count = atomic_load_32(&async_logger.slot_count, MEMORY_ORDER_ACQUIRE);
+			if (count > i || compare_and_swap_32(&async_logger.slot_count, i+1, count)) break;
+		}
+		atomic_store_32(&slot->state, ASYNC_LOG_SLOT_OWNED, MEMORY_ORDER_RELEASE);
+		return slot;
+	}
+	return 0;
+}
+
+void
+_async_logger_wake_writer() {
+	atomic_fetch_add_32(&async_logger.wake_generation, 1, MEMORY_ORDER_RELEASE);
+	os_wake_address_single(&async_logger.wake_generation);
+}
+
+// Returns false if the line couldn't be queued and should be written some other way
+bool
+_async_logger_push(Log_Level level, string s) {
+	Async_Log_Slot *slot = _async_log_slot;
+	if (!slot) {
+		slot = _async_logger_claim_slot();
+		if (!slot) return false;
+		_async_log_slot = slot;
+	}
+
+	u64 length = min(s.count, LOG_MAX_MESSAGE_SIZE);
+	u64 part_count = max((length + ASYNC_LOGGER_RECORD_TEXT_SIZE-1)/ASYNC_LOGGER_RECORD_TEXT_SIZE, 1);
+
+	// Only the writer makes room, so if it fits now it will still fit while we push
+	if (slot->ring.capacity - spsc_ring_get_count(&slot->ring) < part_count) {
+		atomic_fetch_add_64(&slot->dropped, 1, MEMORY_ORDER_RELAXED);
+		return true;
+	}
+
+	Async_Log_Record record;
+	record.time = rdtsc();
+	record.level = (u16)level;
+	record.unused = 0;
+	u64 offset = 0;
+	for (u64 i = 0; i < part_count; i++) {
+		record.length = (u16)min(length-offset, ASYNC_LOGGER_RECORD_TEXT_SIZE);
+		record.parts_left = (u16)(part_count-1-i);
+		memcpy(record.text, s.data+offset, record.length);
+		offset += record.length;
+		bool pushed = spsc_ring_push(&slot->ring, &record);
+		assert(pushed, "Internal error in async logger: ring filled up while pushing");
+	}
+
+	// The writer sets writer_sleeping and then checks the rings, we push and then check
+	// writer_sleeping. With a full barrier on both sides, at least one of us sees the other.
+	atomic_fence(MEMORY_ORDER_SEQ_CST);
+	if (atomic_load_32(&async_logger.writer_sleeping, MEMORY_ORDER_RELAXED)) {
+		_async_logger_wake_writer();
+	}
+
+	return true;
+}
+
+// Call when a thread that logged is about to exit, so its ring can be reused by another thread.
+// Threads started with os_thread_start do this by themselves.
+void
+async_logger_release_thread() {
+	Async_Log_Slot *slot = _async_log_slot;
+	if (!slot) return;
+	_async_log_slot = 0;
+	atomic_store_32(&slot->state, ASYNC_LOG_SLOT_ABANDONED, MEMORY_ORDER_RELEASE);
+}
+
+// "game.log" -> "game.3.log", index 0 is the path itself
+string
+_async_logger_rotated_path(u64 index) {
+	if (index == 0) return async_logger.file_path;
+	string extension = get_file_extension(async_logger.file_path);
+	string base = string_view(async_logger.file_path, 0, async_logger.file_path.count-extension.count);
+	return tprint("%s.%llu%s", base, index, extension);
+}
+
+void
+_async_logger_rotate_files() {
+	if (async_logger.max_file_count <= 1) return; // Just start over in the same file
+
+	u64 last = async_logger.max_file_count-1;
+	os_file_delete_s(_async_logger_rotated_path(last));
+	for (u64 i = last; i >= 1; i--) {
+		os_file_move_s(_async_logger_rotated_path(i-1), _async_logger_rotated_path(i), true);
+	}
+}
+
+void
+_async_logger_write_output(const char *data, u64 size) {
+	if (size == 0) return;
+
+	if (async_logger.write_to_stdout) {
+		os_write_string_to_stdout((string){size, (u8*)data});
+	}
+
+	if (async_logger.file != OS_INVALID_FILE) {
+		if (async_logger.file_size > 0 && async_logger.file_size + size > async_logger.max_file_size) {
+			os_file_close(async_logger.file);
+			_async_logger_rotate_files();
+			async_logger.file = os_file_open_s(async_logger.file_path, O_CREATE | O_WRITE);
+			async_logger.file_size = 0;
+		}
+		if (async_logger.file != OS_INVALID_FILE) {
+			os_file_write_bytes(async_logger.file, (void*)data, size);
+			async_logger.file_size += size;
+		}
+	}
+
+	async_logger.stats.bytes_written += size;
+	async_logger.stats.batches_written += 1;
+}
+
+void
+_async_logger_append(const void *data, u64 size) {
+	if (async_logger.batch_count + size > ASYNC_LOGGER_BATCH_SIZE) {
+		_async_logger_write_output(async_logger.batch, async_logger.batch_count);
+		async_logger.batch_count = 0;
+	}
+	memcpy(async_logger.batch + async_logger.batch_count, data, size);
+	async_logger.batch_count += size;
+}
+
+bool
+_async_logger_has_pending() {
+	u32 slot_count = atomic_load_32(&async_logger.slot_count, MEMORY_ORDER_ACQUIRE);
+	for (u32 i = 0; i < slot_count; i++) {
+		Async_Log_Slot *slot = &async_logger.slots[i];
+		if (slot->has_front) return true;
+		u32 state = atomic_load_32(&slot->state, MEMORY_ORDER_ACQUIRE);
+		if (state != ASYNC_LOG_SLOT_OWNED && state != ASYNC_LOG_SLOT_ABANDONED) continue;
+		if (spsc_ring_get_count(&slot->ring) > 0) return true;
+	}
+	return false;
+}
+
+// Writes everything in the rings, oldest line first. Returns how many lines it wrote.
+u64
+_async_logger_drain() {
+	u64 lines = 0;
+	u32 slot_count = atomic_load_32(&async_logger.slot_count, MEMORY_ORDER_ACQUIRE);
+
+	while (true) {
+		// Each ring is in order by itself, so the oldest line is at the front of one of them
+		Async_Log_Slot *oldest = 0;
+		for (u32 i = 0; i < slot_count; i++) {
+			Async_Log_Slot *slot = &async_logger.slots[i];
+			if (!slot->has_front) {
+				u32 state = atomic_load_32(&slot->state, MEMORY_ORDER_ACQUIRE);
+				if (state != ASYNC_LOG_SLOT_OWNED && state != ASYNC_LOG_SLOT_ABANDONED) continue;
+				slot->has_front = spsc_ring_pop(&slot->ring, &slot->front);
+				if (!slot->has_front) continue;
+			}
+			if (!oldest || slot->front.time < oldest->front.time) oldest = slot;
+		}
+		if (!oldest) break;
+
+		Async_Log_Record *record = &oldest->front;
+		_async_logger_append(_async_log_prefixes[min(record->level, LOG_LEVEL_COUNT)], ASYNC_LOG_PREFIX_LENGTH);
+		_async_logger_append(record->text, record->length);
+
+		// The rest of a long line was pushed right after the first part, but maybe not
+		// published yet if we got here in the middle of the push
+		u16 parts_left = record->parts_left;
+		while (parts_left > 0) {
+			Async_Log_Record part;
+			if (!spsc_ring_pop(&oldest->ring, &part)) {
+				os_yield_thread();
+				continue;
+			}
+			_async_logger_append(part.text, part.length);
+			parts_left = part.parts_left;
+		}
+		_async_logger_append("\n", 1);
+
+		oldest->has_front = false;
+		lines += 1;
+	}
+
+	u64 dropped = 0;
+	for (u32 i = 0; i < slot_count; i++) {
+		Async_Log_Slot *slot = &async_logger.slots[i];
+
+		if (atomic_load_64(&slot->dropped, MEMORY_ORDER_RELAXED)) {
+			dropped += atomic_exchange_64(&slot->dropped, 0, MEMORY_ORDER_RELAXED);
+		}
+
+		// The owner is gone and won't push anymore, so once it's empty it can be handed out again
+		u32 state = atomic_load_32(&slot->state, MEMORY_ORDER_ACQUIRE);
+		if (state == ASYNC_LOG_SLOT_ABANDONED && !slot->has_front && spsc_ring_get_count(&slot->ring) == 0) {
+			atomic_store_32(&slot->state, ASYNC_LOG_SLOT_FREE, MEMORY_ORDER_RELEASE);
+		}
+	}
+	if (dropped > 0) {
+		char line[128];
+		u64 length = format_string_to_buffer_va(line, sizeof(line), "[WARNING]: Async logger dropped %llu lines, the writer is falling behind\n", dropped);
+		_async_logger_append(line, length);
+		async_logger.stats.lines_dropped += dropped;
+	}
+
+	_async_logger_write_output(async_logger.batch, async_logger.batch_count);
+	async_logger.batch_count = 0;
+
+	async_logger.stats.lines_written += lines;
+	return lines;
+}
+
+void
+_async_logger_thread_proc(Thread *t) {
+	while (true) {
+		u32 stop = atomic_load_32(&async_logger.stop, MEMORY_ORDER_ACQUIRE);
+		u32 flush_requested = atomic_load_32(&async_logger.flush_requested, MEMORY_ORDER_ACQUIRE);
+
+		u64 lines = _async_logger_drain();
+		reset_temporary_storage();
+
+		if (flush_requested != async_logger.flush_completed) {
+			atomic_store_32(&async_logger.flush_completed, flush_requested, MEMORY_ORDER_RELEASE);
+			os_wake_address_all(&async_logger.flush_completed);
+		}
+
+		if (lines > 0) continue;
+		if (stop) break;
+
+		// Nothing to do, sleep until something is logged
+		u32 generation = atomic_load_32(&async_logger.wake_generation, MEMORY_ORDER_ACQUIRE);
+		atomic_store_32(&async_logger.writer_sleeping, 1, MEMORY_ORDER_SEQ_CST);
+		bool flush_pending = atomic_load_32(&async_logger.flush_requested, MEMORY_ORDER_ACQUIRE) != async_logger.flush_completed;
+		if (!flush_pending && !atomic_load_32(&async_logger.stop, MEMORY_ORDER_ACQUIRE) && !_async_logger_has_pending()) {
+			os_wait_on_address_32(&async_logger.wake_generation, generation);
+		}
+		atomic_store_32(&async_logger.writer_sleeping, 0, MEMORY_ORDER_RELAXED);
+	}
+}
+
+// Blocks until everything this thread logged before the call is written
+void
+async_logger_flush() {
+	if (!async_logger.running) return;
+	// The writer would be waiting for itself
+	if (context.thread_id == async_logger.writer.id) return;
+
+	u32 target = atomic_fetch_add_32(&async_logger.flush_requested, 1, MEMORY_ORDER_SEQ_CST) + 1;
+	_async_logger_wake_writer();
+
+	while (true) {
+		u32 completed = atomic_load_32(&async_logger.flush_completed, MEMORY_ORDER_ACQUIRE);
+		if ((s32)(completed - target) >= 0) break;
+		os_wait_on_address_32(&async_logger.flush_completed, completed);
+	}
+}
+
+// Logger_Proc. default_logger goes through here while the async logger runs, so you only need
+// this if you set context.logger yourself.
+void
+async_logger_proc(Log_Level level, string s) {
+	if (!async_logger.running || !_async_logger_push(level, s)) {
+		// Out of rings, or not running. Write it right away.
+		print("%cs%s\n", _async_log_prefixes[min((u32)level, LOG_LEVEL_COUNT)], s);
+		return;
+	}
+	if (level == LOG_ERROR && async_logger.flush_on_error) async_logger_flush();
+}
+
+// file_path may be null_string to only write to stdout
+void
+async_logger_start(string file_path, bool write_to_stdout) {
+	assert(!async_logger.running, "async_logger_start was called but the async logger is already running");
+
+	async_logger.write_to_stdout = write_to_stdout;
+	async_logger.file = OS_INVALID_FILE;
+	async_logger.file_size = 0;
+	async_logger.file_path = null_string;
+	if (file_path.count > 0) {
+		async_logger.file_path = alloc_string(get_heap_allocator(), file_path.count);
+		memcpy(async_logger.file_path.data, file_path.data, file_path.count);
+
+		if (os_is_file_s(async_logger.file_path)) _async_logger_rotate_files();
+		async_logger.file = os_file_open_s(async_logger.file_path, O_CREATE | O_WRITE);
+		if (async_logger.file == OS_INVALID_FILE) {
+			log_error("Async logger could not open log file '%s'", async_logger.file_path);
+		}
+	}
+
+	if (!async_logger.batch) async_logger.batch = (char*)alloc(get_heap_allocator(), ASYNC_LOGGER_BATCH_SIZE);
+	async_logger.batch_count = 0;
+	async_logger.stop = 0;
+
+	os_thread_init(&async_logger.writer, _async_logger_thread_proc);
+	async_logger.writer.name = STR("Async logger");
+	os_thread_start(&async_logger.writer);
+
+	atomic_store_8((volatile u8*)&async_logger.running, true, MEMORY_ORDER_RELEASE);
+}
+
+// Writes everything that was logged and stops the writer. Stop logging from other threads first.
+void
+async_logger_stop() {
+	if (!async_logger.running) return;
+
+	// From here, lines are written right away
+	atomic_store_8((volatile u8*)&async_logger.running, false, MEMORY_ORDER_SEQ_CST);
+
+	atomic_store_32(&async_logger.stop, 1, MEMORY_ORDER_RELEASE);
+	_async_logger_wake_writer();
+	os_thread_join(&async_logger.writer);
+	os_thread_destroy(&async_logger.writer);
+
+	if (async_logger.file != OS_INVALID_FILE) {
+		os_file_close(async_logger.file);
+		async_logger.file = OS_INVALID_FILE;
+	}
+	if (async_logger.file_path.count > 0) {
+		dealloc_string(get_heap_allocator(), async_logger.file_path);
+		async_logger.file_path = null_string;
+	}
+}
+
+// Totals since the program started
+void
+async_logger_get_stats(Async_Logger_Stats *stats) {
+	stats->lines_written   = atomic_load_64(&async_logger.stats.lines_written, MEMORY_ORDER_RELAXED);
+	stats->lines_dropped   = atomic_load_64(&async_logger.stats.lines_dropped, MEMORY_ORDER_RELAXED);
+	stats->bytes_written   = atomic_load_64(&async_logger.stats.bytes_written, MEMORY_ORDER_RELAXED);
+	stats->batches_written = atomic_load_64(&async_logger.stats.batches_written, MEMORY_ORDER_RELAXED);
+}
@@ -87,11 +87,13 @@ typedef alignat(16) struct Heap_Allocation_Metadata {
 ogb_instance Heap_Block *heap_head;
 ogb_instance bool heap_initted;
 ogb_instance Spinlock heap_lock;
+ogb_instance u64 heap_bytes_in_use;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Heap_Block *heap_head;
 bool heap_initted = false;
 Spinlock heap_lock;
+u64 heap_bytes_in_use = 0;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 	
 
@@ -388,9 +390,15 @@ void *heap_alloc(u64 size) {
 	sanity_check_block(meta->block);
 #endif
 	
+	heap_bytes_in_use += size;
+	metric_set(METRIC_HEAP_BYTES_IN_USE, (f64)heap_bytes_in_use);
+	
 	// #Sync #Speed oof
 	spinlock_release(&heap_lock);
 	
+	metric_add(METRIC_HEAP_ALLOCATIONS, 1);
+	trace_allocation_event(PROFILE_EVENT_HEAP_ALLOC, meta, size);
+	
 	
 	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
 	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
@@ -527,8 +535,14 @@ void heap_dealloc(void *p) {
 #if VERY_DEBUG
 	sanity_check_block(block);
 #endif
+	heap_bytes_in_use -= size;
+	metric_set(METRIC_HEAP_BYTES_IN_USE, (f64)heap_bytes_in_use);
+	
 	// #Sync #Speed oof
 	spinlock_release(&heap_lock);
+	
+	metric_add(METRIC_HEAP_DEALLOCATIONS, 1);
+	trace_allocation_event(PROFILE_EVENT_HEAP_DEALLOC, p, size);
 }
 
 void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
@@ -645,6 +659,8 @@ void* talloc(u64 size) {
 	temporary_storage_pointer = (u8*)temporary_storage_pointer + size;
 	
 	if ((u8*)temporary_storage_pointer >= (u8*)temporary_storage+TEMPORARY_STORAGE_SIZE) {
+		metric_add(METRIC_TEMPORARY_STORAGE_OVERFLOWS, 1);
+		trace_allocation_event(PROFILE_EVENT_TEMPORARY_STORAGE_OVERFLOW, temporary_storage, size);
 		if (!has_warned_temporary_storage_overflow) {
 			os_write_string_to_stdout(STR("WARNING: temporary storage was overflown, we wrap around at the start.\n"));
 		}
@@ -652,6 +668,8 @@ void* talloc(u64 size) {
 		return talloc(size);;
 	}
 	
+	metric_add(METRIC_TEMPORARY_STORAGE_BYTES, (s64)size);
+	
 	return p;
 }
 
@@ -0,0 +1,403 @@
+
+/*
+
+	Counters, gauges and histograms for engine & game statistics.
+
+		Metric_Id metric_register(const char *name, Metric_Kind kind); // Cache the result, name must outlive the metric
+		void      metric_add(Metric_Id id, s64 n);      // Counters
+		void      metric_set(Metric_Id id, f64 value);  // Gauges
+		void      metric_record(Metric_Id id, u64 value); // Histograms
+
+		void metrics_frame_end(); // Records frame time & snapshots into metrics_frame. Called in gfx_update().
+		void metrics_take_snapshot(Metrics_Snapshot *snapshot);
+
+		void metrics_snapshot_append_json(Metrics_Snapshot *snapshot, String_Builder *builder);
+		void metrics_snapshot_append_csv_header(Metrics_Snapshot *snapshot, String_Builder *builder);
+		void metrics_snapshot_append_csv_row(Metrics_Snapshot *snapshot, String_Builder *builder);
+
+	Counters are accumulated per thread with plain stores and summed on snapshot, so metric_add
+	never contends. The first METRICS_MAX_THREADS threads to touch a counter get a block each,
+	threads after that share one block with atomic adds. A snapshot has both the total and what was added since the last snapshot.
+	Gauges are a single value, last write wins.
+	Histograms are log-linear (like HDR histograms): 32 linear sub-buckets per power of two, so
+	any percentile is within ~3% of the real value. Recording is a few atomic adds.
+	A snapshot resets histograms, so their stats are for the last frame only.
+
+	The engine's own metrics are listed in Builtin_Metric and need no registration.
+	Nothing in here allocates, so the allocators can be instrumented too.
+
+	Snapshots are meant to be taken from one thread, once per frame. In a headless program,
+	call metrics_frame_end() yourself.
+
+*/
+
+#define METRICS_MAX 256
+#define METRICS_MAX_HISTOGRAMS 32
+#define METRICS_MAX_THREADS 64
+
+#define METRICS_HISTOGRAM_SUB_BUCKET_BITS 5
+#define METRICS_HISTOGRAM_SUB_BUCKETS (1 << METRICS_HISTOGRAM_SUB_BUCKET_BITS)
+#define METRICS_HISTOGRAM_BUCKETS ((64-METRICS_HISTOGRAM_SUB_BUCKET_BITS+1)*METRICS_HISTOGRAM_SUB_BUCKETS)
+
+typedef u32 Metric_Id;
+
+typedef enum Metric_Kind {
+	METRIC_KIND_COUNTER,
+	METRIC_KIND_GAUGE,
+	METRIC_KIND_HISTOGRAM,
+} Metric_Kind;
+
+typedef enum Builtin_Metric {
+	METRIC_FRAME_TIME_US,
+
+	METRIC_GFX_QUADS,
+	METRIC_GFX_DRAW_CALLS,
+	METRIC_GFX_TEXTURE_LIMIT_FLUSHES,
+
+	METRIC_HEAP_ALLOCATIONS,
+	METRIC_HEAP_DEALLOCATIONS,
+	METRIC_HEAP_BYTES_IN_USE,
+	METRIC_TEMPORARY_STORAGE_BYTES,
+	METRIC_TEMPORARY_STORAGE_OVERFLOWS,
+
+	METRIC_AUDIO_ACTIVE_PLAYERS,
+	METRIC_AUDIO_FRAMES_OUTPUT,
+	METRIC_AUDIO_MIX_US,
+
+	METRIC_BUILTIN_COUNT
+} Builtin_Metric;
+
+typedef struct Metric_Info {
+	const char *name;
+	Metric_Kind kind;
+	u32 histogram_index;
+} Metric_Info;
+
+typedef struct Metrics_Thread_Block {
+	alignat(CACHE_LINE_SIZE) volatile u64 counters[METRICS_MAX];
+} Metrics_Thread_Block;
+
+typedef struct Metrics_Histogram {
+	volatile u64 count;
+	volatile u64 sum;
+	volatile u64 min;
+	volatile u64 max;
+	volatile u64 buckets[METRICS_HISTOGRAM_BUCKETS];
+} Metrics_Histogram;
+
+typedef struct Metric_Value {
+	const char *name;
+	Metric_Kind kind;
+
+	// Counters
+	s64 total;
+	s64 frame;
+
+	// Gauges
+	f64 value;
+
+	// Histograms, since last snapshot
+	u64 count;
+	u64 min;
+	u64 max;
+	u64 p50;
+	u64 p90;
+	u64 p99;
+	f64 mean;
+} Metric_Value;
+
+typedef struct Metrics_Snapshot {
+	u64 frame_index;
+	f64 time;
+	u64 metric_count;
+	Metric_Value metrics[METRICS_MAX];
+} Metrics_Snapshot;
+
+// #Global
+ogb_instance Metric_Info _metrics[METRICS_MAX];
+ogb_instance volatile u64 _metric_count;
+ogb_instance u64 _metrics_histogram_count;
+ogb_instance Spinlock _metrics_register_lock;
+ogb_instance Metrics_Thread_Block _metrics_thread_blocks[METRICS_MAX_THREADS];
+ogb_instance volatile u64 _metrics_thread_block_count;
+ogb_instance Metrics_Thread_Block _metrics_shared_block;
+ogb_instance volatile u64 _metrics_gauges[METRICS_MAX];
+ogb_instance Metrics_Histogram _metrics_histograms[METRICS_MAX_HISTOGRAMS];
+ogb_instance s64 _metrics_counter_last_totals[METRICS_MAX];
+ogb_instance u64 _metrics_last_frame_end;
+// Snapshot from the last metrics_frame_end()
+ogb_instance Metrics_Snapshot metrics_frame;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Metric_Info _metrics[METRICS_MAX] = {
+	[METRIC_FRAME_TIME_US]               = {"frame.time_us",             METRIC_KIND_HISTOGRAM, 0},
+	[METRIC_GFX_QUADS]                   = {"gfx.quads",                 METRIC_KIND_COUNTER,   0},
+	[METRIC_GFX_DRAW_CALLS]              = {"gfx.draw_calls",            METRIC_KIND_COUNTER,   0},
+	[METRIC_GFX_TEXTURE_LIMIT_FLUSHES]   = {"gfx.texture_limit_flushes", METRIC_KIND_COUNTER,   0},
+	[METRIC_HEAP_ALLOCATIONS]            = {"heap.allocations",          METRIC_KIND_COUNTER,   0},
+	[METRIC_HEAP_DEALLOCATIONS]          = {"heap.deallocations",        METRIC_KIND_COUNTER,   0},
+	[METRIC_HEAP_BYTES_IN_USE]           = {"heap.bytes_in_use",         METRIC_KIND_GAUGE,     0},
+	[METRIC_TEMPORARY_STORAGE_BYTES]     = {"temp.bytes",                METRIC_KIND_COUNTER,   0},
+	[METRIC_TEMPORARY_STORAGE_OVERFLOWS] = {"temp.overflows",            METRIC_KIND_COUNTER,   0},
+	[METRIC_AUDIO_ACTIVE_PLAYERS]        = {"audio.active_players",      METRIC_KIND_GAUGE,     0},
+	[METRIC_AUDIO_FRAMES_OUTPUT]         = {"audio.frames_output",       METRIC_KIND_COUNTER,   0},
+	[METRIC_AUDIO_MIX_US]                = {"audio.mix_us",              METRIC_KIND_HISTOGRAM, 1},
+};
+volatile u64 _metric_count = METRIC_BUILTIN_COUNT;
+u64 _metrics_histogram_count = 2;
+Spinlock _metrics_register_lock = {0};
+Metrics_Thread_Block _metrics_thread_blocks[METRICS_MAX_THREADS];
+volatile u64 _metrics_thread_block_count = 0;
+Metrics_Thread_Block _metrics_shared_block;
+volatile u64 _metrics_gauges[METRICS_MAX];
+Metrics_Histogram _metrics_histograms[METRICS_MAX_HISTOGRAMS];
+s64 _metrics_counter_last_totals[METRICS_MAX];
+u64 _metrics_last_frame_end = 0;
+Metrics_Snapshot metrics_frame;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// 0 means no block yet, -1 means we're on the shared block because the pool ran out
+thread_local Metrics_Thread_Block *_metrics_thread_block = 0;
+
+Metric_Id
+metric_register(const char *name, Metric_Kind kind) {
+	spinlock_acquire_or_wait(&_metrics_register_lock);
+
+	for (u64 i = 0; i < _metric_count; i++) {
+		if (strcmp(_metrics[i].name, name) == 0) {
+			assert(_metrics[i].kind == kind, "Metric '%cs' was already registered as another kind", name);
+			spinlock_release(&_metrics_register_lock);
+			return (Metric_Id)i;
+		}
+	}
+
+	assert(_metric_count < METRICS_MAX, "Too many metrics registered, max is %d", METRICS_MAX);
+
+	Metric_Info *m = &_metrics[_metric_count];
+	m->name = name;
+	m->kind = kind;
+	if (kind == METRIC_KIND_HISTOGRAM) {
+		assert(_metrics_histogram_count < METRICS_MAX_HISTOGRAMS, "Too many histogram metrics registered, max is %d", METRICS_MAX_HISTOGRAMS);
+		m->histogram_index = (u32)_metrics_histogram_count;
+		_metrics_histogram_count += 1;
+	}
+
+	Metric_Id id = (Metric_Id)_metric_count;
+	atomic_store_64(&_metric_count, _metric_count+1, MEMORY_ORDER_RELEASE);
+
+	spinlock_release(&_metrics_register_lock);
+
+	return id;
+}
+
+Metrics_Thread_Block *
+_metrics_claim_thread_block() {
+	u64 index = atomic_fetch_add_64(&_metrics_thread_block_count, 1, MEMORY_ORDER_ACQ_REL);
+	if (index >= METRICS_MAX_THREADS) {
+		_metrics_thread_block = (Metrics_Thread_Block*)-1;
+	} else {
+		_metrics_thread_block = &_metrics_thread_blocks[index];
+	}
+	return _metrics_thread_block;
+}
+
+inline void
+metric_add(Metric_Id id, s64 n) {
+	Metrics_Thread_Block *b = _metrics_thread_block;
+	if (!b) b = _metrics_claim_thread_block();
+
+	if (b == (Metrics_Thread_Block*)-1) {
+		atomic_fetch_add_64(&_metrics_shared_block.counters[id], (u64)n, MEMORY_ORDER_RELAXED);
+		return;
+	}
+
+	// Only this thread writes here, the store just needs to not tear for the snapshot reader
+	atomic_store_64(&b->counters[id], b->counters[id]+(u64)n, MEMORY_ORDER_RELAXED);
+}
+
+inline void
+metric_set(Metric_Id id, f64 value) {
+	union { f64 f; u64 u; } v = {value};
+	atomic_store_64(&_metrics_gauges[id], v.u, MEMORY_ORDER_RELAXED);
+}
+
+inline u64
+_metrics_histogram_bucket(u64 value) {
+	if (value < METRICS_HISTOGRAM_SUB_BUCKETS) return value;
+	u64 exponent = bit_scan_reverse_64(value);
+	u64 sub = (value >> (exponent-METRICS_HISTOGRAM_SUB_BUCKET_BITS)) & (METRICS_HISTOGRAM_SUB_BUCKETS-1);
+	return (exponent-METRICS_HISTOGRAM_SUB_BUCKET_BITS+1)*METRICS_HISTOGRAM_SUB_BUCKETS + sub;
+}
+// Middle of the range of values that end up in bucket
+u64
+_metrics_histogram_bucket_value(u64 bucket) {
+	if (bucket < METRICS_HISTOGRAM_SUB_BUCKETS) return bucket;
+	u64 exponent = bucket/METRICS_HISTOGRAM_SUB_BUCKETS + METRICS_HISTOGRAM_SUB_BUCKET_BITS - 1;
+	u64 sub = bucket % METRICS_HISTOGRAM_SUB_BUCKETS;
+	u64 width = 1ull << (exponent-METRICS_HISTOGRAM_SUB_BUCKET_BITS);
+	u64 lower = (1ull << exponent) | (sub << (exponent-METRICS_HISTOGRAM_SUB_BUCKET_BITS));
+	return lower + width/2;
+}
+
+// For histograms that aren't metrics (see frame_pacer.c). Read them with _metrics_take_histogram.
+void
+metrics_histogram_record(Metrics_Histogram *h, u64 value) {
+	atomic_fetch_add_64(&h->buckets[_metrics_histogram_bucket(value)], 1, MEMORY_ORDER_RELAXED);
+	atomic_fetch_add_64(&h->count, 1, MEMORY_ORDER_RELAXED);
+	atomic_fetch_add_64(&h->sum, value, MEMORY_ORDER_RELAXED);
+
+	// min is stored inverted so 0 means empty for both
+	u64 inverted = ~value;
+	u64 current = h->min;
+	while (inverted > current && !compare_and_swap_64(&h->min, inverted, current)) current = h->min;
+	current = h->max;
+	while (value > current && !compare_and_swap_64(&h->max, value, current)) current = h->max;
+}
+
+void
+metric_record(Metric_Id id, u64 value) {
+	assert(_metrics[id].kind == METRIC_KIND_HISTOGRAM, "metric_record on metric '%cs' which is not a histogram", _metrics[id].name);
+	metrics_histogram_record(&_metrics_histograms[_metrics[id].histogram_index], value);
+}
+
+void
+_metrics_take_histogram(Metrics_Histogram *h, Metric_Value *v) {
+	v->count = atomic_exchange_64(&h->count, 0, MEMORY_ORDER_ACQ_REL);
+	u64 sum  = atomic_exchange_64(&h->sum, 0, MEMORY_ORDER_ACQ_REL);
+	v->min   = ~atomic_exchange_64(&h->min, 0, MEMORY_ORDER_ACQ_REL);
+	v->max   = atomic_exchange_64(&h->max, 0, MEMORY_ORDER_ACQ_REL);
+
+	if (v->count == 0) v->min = 0;
+
+	// Records racing with the snapshot may land in either frame, so the bucket total is what
+	// the percentiles are ranked against.
+	// Snapshots are taken from one thread, so this doesn't need to be on the stack.
+	local_persist u64 counts[METRICS_HISTOGRAM_BUCKETS];
+	u64 bucket_counts_total = 0;
+	for (u64 i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+		counts[i] = h->buckets[i] ? atomic_exchange_64(&h->buckets[i], 0, MEMORY_ORDER_ACQ_REL) : 0;
+		bucket_counts_total += counts[i];
+	}
+	if (v->count == 0 || bucket_counts_total == 0) return;
+
+	v->mean = (f64)sum/(f64)v->count;
+
+	u64 p50_rank = (bucket_counts_total*50 + 99)/100;
+	u64 p90_rank = (bucket_counts_total*90 + 99)/100;
+	u64 p99_rank = (bucket_counts_total*99 + 99)/100;
+	u64 seen = 0;
+	for (u64 i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+		if (counts[i] == 0) continue;
+		u64 before = seen;
+		seen += counts[i];
+		u64 value = clamp(_metrics_histogram_bucket_value(i), v->min, v->max);
+		if (before < p50_rank && seen >= p50_rank) v->p50 = value;
+		if (before < p90_rank && seen >= p90_rank) v->p90 = value;
+		if (before < p99_rank && seen >= p99_rank) v->p99 = value;
+	}
+}
+
+void
+metrics_take_snapshot(Metrics_Snapshot *snapshot) {
+	u64 metric_count = atomic_load_64(&_metric_count, MEMORY_ORDER_ACQUIRE);
+	u64 block_count = min(atomic_load_64(&_metrics_thread_block_count, MEMORY_ORDER_ACQUIRE), METRICS_MAX_THREADS);
+
+	snapshot->time = os_get_current_time_in_seconds();
+	snapshot->metric_count = metric_count;
+
+	for (u64 i = 0; i < metric_count; i++) {
+		Metric_Info *m = &_metrics[i];
+		Metric_Value *v = &snapshot->metrics[i];
+		memset(v, 0, sizeof(*v));
+		v->name = m->name;
+		v->kind = m->kind;
+
+		switch (m->kind) {
+			case METRIC_KIND_COUNTER: {
+				s64 total = (s64)atomic_load_64(&_metrics_shared_block.counters[i], MEMORY_ORDER_RELAXED);
+				for (u64 b = 0; b < block_count; b++) {
+					total += (s64)atomic_load_64(&_metrics_thread_blocks[b].counters[i], MEMORY_ORDER_RELAXED);
+				}
+				v->total = total;
+				v->frame = total - _metrics_counter_last_totals[i];
+				_metrics_counter_last_totals[i] = total;
+				break;
+			}
+			case METRIC_KIND_GAUGE: {
+				union { u64 u; f64 f; } g = {atomic_load_64(&_metrics_gauges[i], MEMORY_ORDER_RELAXED)};
+				v->value = g.f;
+				break;
+			}
+			case METRIC_KIND_HISTOGRAM: {
+				_metrics_take_histogram(&_metrics_histograms[m->histogram_index], v);
+				break;
+			}
+		}
+	}
+
+	snapshot->frame_index += 1;
+}
+
+void
+metrics_frame_end() {
+	u64 now = rdtsc();
+	if (_metrics_last_frame_end != 0) {
+		metric_record(METRIC_FRAME_TIME_US, (now-_metrics_last_frame_end)*1000000/os_get_tsc_frequency());
+	}
+	_metrics_last_frame_end = now;
+
+	metrics_take_snapshot(&metrics_frame);
+	
+	profiler_mark_frame();
+}
+
+void
+metrics_snapshot_append_json(Metrics_Snapshot *snapshot, String_Builder *builder) {
+	string_builder_print(builder, STR("{\"frame\":%llu,\"time\":%.6f,\"metrics\":{"), snapshot->frame_index, snapshot->time);
+	for (u64 i = 0; i < snapshot->metric_count; i++) {
+		Metric_Value *v = &snapshot->metrics[i];
+		if (i > 0) string_builder_append(builder, STR(","));
+		switch (v->kind) {
+			case METRIC_KIND_COUNTER:
+				string_builder_print(builder, STR("\"%cs\":{\"kind\":\"counter\",\"total\":%lld,\"frame\":%lld}"), v->name, v->total, v->frame);
+				break;
+			case METRIC_KIND_GAUGE:
+				string_builder_print(builder, STR("\"%cs\":{\"kind\":\"gauge\",\"value\":%.6f}"), v->name, v->value);
+				break;
+			case METRIC_KIND_HISTOGRAM:
+				string_builder_print(builder, STR("\"%cs\":{\"kind\":\"histogram\",\"count\":%llu,\"min\":%llu,\"mean\":%.3f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}"), v->name, v->count, v->min, v->mean, v->p50, v->p90, v->p99, v->max);
+				break;
+		}
+	}
+	string_builder_append(builder, STR("}}"));
+}
+
+void
+metrics_snapshot_append_csv_header(Metrics_Snapshot *snapshot, String_Builder *builder) {
+	string_builder_append(builder, STR("frame,time"));
+	for (u64 i = 0; i < snapshot->metric_count; i++) {
+		Metric_Value *v = &snapshot->metrics[i];
+		if (v->kind == METRIC_KIND_HISTOGRAM) {
+			string_builder_print(builder, STR(",%cs.count,%cs.mean,%cs.p50,%cs.p99,%cs.max"), v->name, v->name, v->name, v->name, v->name);
+		} else {
+			string_builder_print(builder, STR(",%cs"), v->name);
+		}
+	}
+	string_builder_append(builder, STR("\n"));
+}
+
+// Counters are written as the per-frame value. Metrics registered after the header was
+// written add columns, so register everything up front when logging CSV.
+void
+metrics_snapshot_append_csv_row(Metrics_Snapshot *snapshot, String_Builder *builder) {
+	string_builder_print(builder, STR("%llu,%.6f"), snapshot->frame_index, snapshot->time);
+	for (u64 i = 0; i < snapshot->metric_count; i++) {
+		Metric_Value *v = &snapshot->metrics[i];
+		switch (v->kind) {
+			case METRIC_KIND_COUNTER:   string_builder_print(builder, STR(",%lld"), v->frame); break;
+			case METRIC_KIND_GAUGE:     string_builder_print(builder, STR(",%.6f"), v->value); break;
+			case METRIC_KIND_HISTOGRAM: string_builder_print(builder, STR(",%llu,%.3f,%llu,%llu,%llu"), v->count, v->mean, v->p50, v->p99, v->max); break;
+		}
+	}
+	string_builder_append(builder, STR("\n"));
+}
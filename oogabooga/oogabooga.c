@@ -86,8 +86,23 @@
 			
 				#define RUN_TESTS 1
 				
+		- RUN_BENCHMARK_ASSERTS
+			Make the tests fail when something is slower than expected, rather than just printing
+			the timings. Timings depend on the machine, load & optimization level, so only turn
+			this on in optimized builds on a quiet machine.
+		
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define RUN_BENCHMARK_ASSERTS 1
+				
 		- ENABLE_PROFILING
-			Enable time profiling which will be dumped to google_trace.json.
+			Enable time profiling which will be dumped on exit to:
+				google_trace_time.json   (microseconds)
+				google_trace_cycles.json (rdtsc cycles)
+				profile_stats.txt        (count, min, mean, p99 & max per scope name)
 		
 			0: Disable
 			1: Enable
@@ -101,7 +116,35 @@
 					tm_scope
 					tm_scope_var
 					tm_scope_accum
+				See profiler_overlay.c for viewing the timings live in game.
+				See sampling_profiler.c for profiling without instrumentation or rebuilding.
+					
+		- ENABLE_ALLOCATION_TRACING
+			Record heap allocations & deallocations, temporary storage overflows and program memory
+			growth into the profile traces, and write allocation_report.txt with the top allocating
+			scopes per frame. Needs ENABLE_PROFILING.
+			
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define ENABLE_ALLOCATION_TRACING 1
 					
+		- ENABLE_ASYNC_LOGGING
+			Write log lines from a background thread instead of the thread that logs, so logging
+			never waits for the console. Lines are written to stdout in batches.
+			
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define ENABLE_ASYNC_LOGGING 1
+				
+			Note:
+				See logger.c for also writing to a rotating log file.
+				
 		- OOGABOOGA_HEADLESS
             Run oogabooga in headless mode, i.e. no window, no graphics, no audio.
             Useful if you only need the oogabooga standard library for something like a game server.
@@ -193,6 +236,26 @@ typedef u8 bool;
 	#define DO_ZERO_INITIALIZATION 1
 #endif
 
+#ifndef RUN_BENCHMARK_ASSERTS
+	#define RUN_BENCHMARK_ASSERTS 0
+#endif
+
+#ifndef ENABLE_PROFILING
+	#define ENABLE_PROFILING 0
+#endif
+
+#ifndef ENABLE_ALLOCATION_TRACING
+	#define ENABLE_ALLOCATION_TRACING 0
+#endif
+
+#if ENABLE_ALLOCATION_TRACING && !ENABLE_PROFILING
+	#error "ENABLE_ALLOCATION_TRACING needs ENABLE_PROFILING"
+#endif
+
+#ifndef ENABLE_ASYNC_LOGGING
+	#define ENABLE_ASYNC_LOGGING 0
+#endif
+
 #ifndef ENABLE_SIMD
 	#define ENABLE_SIMD 1
 #endif
@@ -229,10 +292,10 @@ typedef u8 bool;
 #ifdef _WIN32
 	#define COBJMACROS
 	#undef noreturn
+	// Must come before Windows.h, which otherwise pulls in the old winsock.h
+	#include <winsock2.h>
 	#include <Windows.h>
-    #if CONFIGURATION == DEBUG
-    	#include <dbghelp.h>
-    #endif
+    #include <dbghelp.h>
 	#define TARGET_OS WINDOWS
 	#define OS_PATHS_HAVE_BACKSLASH 1
 #elif defined(__linux__)
@@ -283,6 +346,7 @@ typedef u8 bool;
 #include "string.c"
 #include "unicode.c"
 #include "string_format.c"
+#include "string_parse.c"
 #include "hash.c"
 #include "path_utils.c"
 #include "linmath.c"
@@ -307,6 +371,8 @@ typedef u8 bool;
 #include "concurrency.c"
 
 #include "profiling.c"
+#include "metrics.c"
+#include "frame_pacer.c"
 #include "random.c"
 #include "color.c"
 #include "memory.c"
@@ -314,6 +380,12 @@ typedef u8 bool;
 
 #include "growing_array.c"
 
+#include "sampling_profiler.c"
+
+#include "async_io.c"
+
+#include "logger.c"
+
 #ifndef OOGABOOGA_HEADLESS
 
     #include "gfx_interface.c"
@@ -321,8 +393,14 @@ typedef u8 bool;
     #include "font.c"
 
     #include "drawing.c"
+    
+    #include "draw_batch.c"
+    
+    #include "draw_capture.c"
 
     #include "audio.c"
+
+    #include "profiler_overlay.c"
 #endif
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
@@ -361,6 +439,11 @@ Mutex _default_logger_mutex;
 bool _default_logger_mutex_initted = false;
 void default_logger(Log_Level level, string s) {
 
+	if (async_logger.running) {
+		async_logger_proc(level, s);
+		return;
+	}
+
 	if (!_default_logger_mutex_initted) {
 		mutex_init(&_default_logger_mutex);
 		_default_logger_mutex_initted = true;
@@ -384,9 +467,17 @@ void oogabooga_init(u64 program_memory_size) {
 	context.logger = default_logger;
 	temp_allocator = get_initialization_allocator();
 	Cpu_Capabilities features = query_cpu_capabilities();
+	simd_procs_init(features, SIMD_LEVEL_AVX512);
 	os_init(program_memory_size);
+	os_start_tsc_calibration();
 	heap_init();
 	temporary_storage_init(TEMPORARY_STORAGE_SIZE);
+#if ENABLE_PROFILING
+	profiler_init();
+#endif
+#if ENABLE_ASYNC_LOGGING
+	async_logger_start(null_string, true);
+#endif
 	log_info("Ooga booga version is %d.%02d.%03d", OGB_VERSION_MAJOR, OGB_VERSION_MINOR, OGB_VERSION_PATCH);
 #ifndef OOGABOOGA_HEADLESS
 	gfx_init();
@@ -402,6 +493,7 @@ void oogabooga_init(u64 program_memory_size) {
 	log_verbose("CPU has avx:    %cs", features.avx ? "true" : "false");
 	log_verbose("CPU has avx2:   %cs", features.avx2 ? "true" : "false");
 	log_verbose("CPU has avx512: %cs", features.avx512 ? "true" : "false");
+	log_verbose("CPU has invariant tsc: %cs", features.invariant_tsc ? "true" : "false");
 }
 #endif
 
@@ -436,6 +528,12 @@ int main(int argc, char **argv) {
 	dump_profile_result();
 	
 #endif
+
+	if (sampling_profiler.running || sampling_profiler_get_sample_count() > 0) {
+		sampling_profiler_dump();
+	}
+	
+	async_logger_stop();
 	
 	printf("Ooga booga program exit with code %i\n", code);
 	
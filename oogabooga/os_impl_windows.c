@@ -6,60 +6,42 @@
 #include <mmdeviceapi.h>
 #include <initguid.h>
 #include <avrt.h>
+#include <tlhelp32.h>
 
 #define VIRTUAL_MEMORY_BASE ((void*)0x0000690000000000ULL)
 
 void* heap_alloc(u64);
 void heap_dealloc(void*);
 
-u16 *win32_fixed_utf8_to_null_terminated_wide(string utf8, Allocator allocator) {
+// SymInitialize is done in os_init for debug builds, otherwise when symbols are first needed
+bool win32_symbols_initialized = false;
 
-	if (utf8.count == 0) {
-		u16 *utf16_str = (u16 *)alloc(allocator, (1) * sizeof(u16));
-		*utf16_str = 0;
-		return utf16_str;
-	}
+u16 *win32_fixed_utf8_to_null_terminated_wide(string utf8, Allocator allocator) {
 
-    u64 utf16_length = MultiByteToWideChar(CP_UTF8, 0, (LPCCH)utf8.data, (int)utf8.count, 0, 0);
+	// A utf8 byte never becomes more than one utf16 unit
+	u16 *utf16_str = (u16 *)alloc(allocator, (utf8.count + 1) * sizeof(u16));
 
-    u16 *utf16_str = (u16 *)alloc(allocator, (utf16_length + 1) * sizeof(u16));
+	u64 utf16_length = utf8_to_utf16(utf8, utf16_str);
+	utf16_str[utf16_length] = 0;
 
-    int result = MultiByteToWideChar(CP_UTF8, 0, (LPCCH)utf8.data, (int)utf8.count, utf16_str, utf16_length);
-    if (result == 0) {
-        dealloc(allocator, utf16_str);
-        return 0;
-    }
-
-    utf16_str[utf16_length] = 0;
-
-    return utf16_str;
+	return utf16_str;
 }
 u16 *temp_win32_fixed_utf8_to_null_terminated_wide(string utf8) {
 	return win32_fixed_utf8_to_null_terminated_wide(utf8, get_temporary_allocator());
 }
 string win32_null_terminated_wide_to_fixed_utf8(const u16 *utf16, Allocator allocator) {
-    u64 utf8_length = WideCharToMultiByte(CP_UTF8, 0, (LPCWCH)utf16, -1, 0, 0, 0, 0);
-
-	if (utf8_length == 0) {
-		string utf8;
-		utf8.count = 0;
-		utf8.data = 0;
-		return utf8;
-	}
+	u64 utf16_length = 0;
+	while (utf16[utf16_length] != 0) utf16_length += 1;
 
-    u8 *utf8_str = (u8 *)alloc(allocator, utf8_length * sizeof(u8));
+	// A utf16 unit never becomes more than 3 utf8 bytes. +1 to keep it null terminated
+	u8 *utf8_str = (u8 *)alloc(allocator, utf16_length*3 + 1);
 
-    int result = WideCharToMultiByte(CP_UTF8, 0, (LPCWCH)utf16, -1, (LPSTR)utf8_str, (int)utf8_length, 0, 0);
-    if (result == 0) {
-        dealloc(allocator, utf8_str);
-        return (string){0, 0};
-    }
-
-    string utf8;
-    utf8.data = utf8_str;
-    utf8.count = utf8_length-1;
+	string utf8;
+	utf8.data = utf8_str;
+	utf8.count = utf16_to_utf8(utf16, utf16_length, utf8_str);
+	utf8_str[utf8.count] = 0;
 
-    return utf8;
+	return utf8;
 }
 
 string temp_win32_null_terminated_wide_to_fixed_utf8(const u16 *utf16) {
@@ -109,6 +91,31 @@ HCURSOR win32_shadowed_mouse_pointer = 0;
 bool win32_did_override_user_mouse_pointer = false;
 SYSTEM_INFO win32_system_info;
 
+// WaitOnAddress lives in Synchronization.lib on win8+, we load it in init so we don't need
+// to link with it and can fall back to yielding on older windows.
+typedef BOOL (WINAPI *Win32_Wait_On_Address_Proc)(volatile VOID*, PVOID, SIZE_T, DWORD);
+typedef VOID (WINAPI *Win32_Wake_By_Address_Proc)(PVOID);
+Win32_Wait_On_Address_Proc win32_wait_on_address = 0;
+Win32_Wake_By_Address_Proc win32_wake_by_address_single = 0;
+Win32_Wake_By_Address_Proc win32_wake_by_address_all = 0;
+
+// Same for PrefetchVirtualMemory (win8+), used for OS_FILE_MAP_PREFETCH
+typedef struct Win32_Memory_Range_Entry {
+	PVOID VirtualAddress;
+	SIZE_T NumberOfBytes;
+} Win32_Memory_Range_Entry;
+typedef BOOL (WINAPI *Win32_Prefetch_Virtual_Memory_Proc)(HANDLE, ULONG_PTR, Win32_Memory_Range_Entry*, ULONG);
+Win32_Prefetch_Virtual_Memory_Proc win32_prefetch_virtual_memory = 0;
+
+// And Set/GetThreadDescription (win10 1607+), for os_thread_set_name & os_get_thread_name
+typedef HRESULT (WINAPI *Win32_Set_Thread_Description_Proc)(HANDLE, PCWSTR);
+typedef HRESULT (WINAPI *Win32_Get_Thread_Description_Proc)(HANDLE, PWSTR*);
+Win32_Set_Thread_Description_Proc win32_set_thread_description = 0;
+Win32_Get_Thread_Description_Proc win32_get_thread_description = 0;
+
+// MMCSS registration of the calling thread, if it has OS_THREAD_PRIORITY_AUDIO
+thread_local HANDLE win32_mmcss_task = 0;
+
 #ifndef OOGABOOGA_HEADLESS
 
 // Persistent
@@ -340,16 +347,36 @@ void os_init(u64 program_memory_capacity) {
 	assert(os.crt != 0, "Could not load win32 crt library. Might be compiled with non-msvc? #Incomplete #Portability");
 	os.crt_vsnprintf = (Crt_Vsnprintf_Proc)os_dynamic_library_load_symbol(os.crt, STR("vsnprintf"));
 	assert(os.crt_vsnprintf, "Missing vsnprintf in crt");
+	
+	Dynamic_Library_Handle synch = os_load_dynamic_library(STR("api-ms-win-core-synch-l1-2-0.dll"));
+	if (synch) {
+		win32_wait_on_address        = (Win32_Wait_On_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WaitOnAddress"));
+		win32_wake_by_address_single = (Win32_Wake_By_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WakeByAddressSingle"));
+		win32_wake_by_address_all    = (Win32_Wake_By_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WakeByAddressAll"));
+	}
+	
+	Dynamic_Library_Handle kernel32 = os_load_dynamic_library(STR("kernel32.dll"));
+	if (kernel32) {
+		win32_prefetch_virtual_memory = (Win32_Prefetch_Virtual_Memory_Proc)os_dynamic_library_load_symbol(kernel32, STR("PrefetchVirtualMemory"));
+		win32_set_thread_description  = (Win32_Set_Thread_Description_Proc)os_dynamic_library_load_symbol(kernel32, STR("SetThreadDescription"));
+		win32_get_thread_description  = (Win32_Get_Thread_Description_Proc)os_dynamic_library_load_symbol(kernel32, STR("GetThreadDescription"));
+	}
+
+	WSADATA wsa_data;
+	int wsa_result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
+	assert(wsa_result == 0, "WSAStartup failed, error: %d", wsa_result);
 
 #if CONFIGURATION == DEBUG
 	HANDLE process = GetCurrentProcess();
 	SymInitialize(process, NULL, TRUE);
+	win32_symbols_initialized = true;
 #endif
 	
 	HRESULT hr = CoInitializeEx(0, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
     win32_check_hr(hr);
 	
 	context.thread_id = GetCurrentThreadId();
+	os_thread_set_name(0, STR("Main"));
 
 
 
@@ -405,6 +432,9 @@ void os_init(u64 program_memory_capacity) {
     
     os_thread_init(&audio_thread, win32_audio_thread);
     os_thread_init(&audio_poll_default_device_thread, win32_audio_poll_default_device_thread);
+    audio_thread.name = STR("Audio");
+    audio_thread.priority = OS_THREAD_PRIORITY_AUDIO;
+    audio_poll_default_device_thread.name = STR("Audio device poll");
     
     os_thread_start(&audio_thread);
     os_thread_start(&audio_poll_default_device_thread);
@@ -475,10 +505,14 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 #if CONFIGURATION == RELEASE
 	// #Configurable #Copypaste
 	SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS);
-	SetThreadPriority(t->os_handle, THREAD_PRIORITY_TIME_CRITICAL);
 	timeBeginPeriod(1);
 #endif
 	
+	// t->os_handle may not be set yet, so these go through the pseudo handle of the calling thread
+	if (t->name.count > 0) os_thread_set_name(0, t->name);
+	os_thread_set_priority(0, t->priority);
+	if (t->affinity_mask) os_thread_set_affinity(0, t->affinity_mask);
+	
 	temporary_storage_init(t->temporary_storage_size);
 	
 	context = t->initial_context;
@@ -486,8 +520,13 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	
 	t->proc(t);
 	
+	async_logger_release_thread();
+	
 	heap_dealloc(temporary_storage);
 	
+	// After the last heap_dealloc, which is traced with ENABLE_ALLOCATION_TRACING
+	profiler_release_thread();
+	
 	return 0;
 }
 
@@ -551,6 +590,84 @@ void os_thread_join(Thread *t) {
 	WaitForSingleObject(t->os_handle, INFINITE);
 }
 
+HANDLE
+win32_get_thread_handle(Thread *t) {
+	return t ? t->os_handle : GetCurrentThread();
+}
+
+bool
+os_thread_set_name(Thread *t, string name) {
+	if (!win32_set_thread_description) return false;
+	HRESULT hr = win32_set_thread_description(win32_get_thread_handle(t), temp_win32_fixed_utf8_to_null_terminated_wide(name));
+	return SUCCEEDED(hr);
+}
+
+bool
+os_thread_set_priority(Thread *t, Os_Thread_Priority priority) {
+	bool is_calling_thread = !t || t->id == GetCurrentThreadId();
+	
+	if (priority == OS_THREAD_PRIORITY_AUDIO) {
+		// MMCSS registers the calling thread, there is no way to do it for another one
+		if (!is_calling_thread) return false;
+		if (win32_mmcss_task) return true;
+		DWORD task_index = 0;
+		win32_mmcss_task = AvSetMmThreadCharacteristics(TEXT("Pro Audio"), &task_index);
+		return win32_mmcss_task != 0;
+	}
+	
+	if (is_calling_thread && win32_mmcss_task) {
+		AvRevertMmThreadCharacteristics(win32_mmcss_task);
+		win32_mmcss_task = 0;
+	}
+	
+	int win32_priority = THREAD_PRIORITY_NORMAL;
+	switch (priority) {
+		case OS_THREAD_PRIORITY_DEFAULT:
+#if CONFIGURATION == RELEASE
+			win32_priority = THREAD_PRIORITY_TIME_CRITICAL; // #Configurable
+#else
+			win32_priority = THREAD_PRIORITY_NORMAL;
+#endif
+			break;
+		case OS_THREAD_PRIORITY_LOW:           win32_priority = THREAD_PRIORITY_BELOW_NORMAL;  break;
+		case OS_THREAD_PRIORITY_NORMAL:        win32_priority = THREAD_PRIORITY_NORMAL;        break;
+		case OS_THREAD_PRIORITY_HIGH:          win32_priority = THREAD_PRIORITY_HIGHEST;       break;
+		case OS_THREAD_PRIORITY_TIME_CRITICAL: win32_priority = THREAD_PRIORITY_TIME_CRITICAL; break;
+		default: assert(false, "Invalid Os_Thread_Priority %d", priority); break;
+	}
+	
+	return SetThreadPriority(win32_get_thread_handle(t), win32_priority) != 0;
+}
+
+bool
+os_thread_set_affinity(Thread *t, u64 logical_processor_mask) {
+	if (logical_processor_mask == 0) {
+		DWORD_PTR process_mask, system_mask;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return false;
+		logical_processor_mask = (u64)process_mask;
+	}
+	return SetThreadAffinityMask(win32_get_thread_handle(t), (DWORD_PTR)logical_processor_mask) != 0;
+}
+
+string
+os_get_thread_name(u64 thread_id, Allocator allocator) {
+	if (!win32_get_thread_description) return null_string;
+	
+	HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)thread_id);
+	if (!thread) return null_string;
+	
+	string name = null_string;
+	PWSTR description = 0;
+	HRESULT hr = win32_get_thread_description(thread, &description);
+	if (SUCCEEDED(hr) && description) {
+		if (description[0] != 0) name = win32_null_terminated_wide_to_fixed_utf8((u16*)description, allocator);
+		LocalFree(description);
+	}
+	
+	CloseHandle(thread);
+	return name;
+}
+
 ///
 // Mutex primitive
 
@@ -591,6 +708,24 @@ void os_unlock_mutex(Mutex_Handle m) {
 	assert(result, "Unlock mutex 0x%x failed with error %d", m, GetLastError());
 }
 
+///
+// Address waiting
+
+void os_wait_on_address_32(volatile u32 *address, u32 expected) {
+	if (win32_wait_on_address) {
+		win32_wait_on_address(address, &expected, sizeof(u32), INFINITE);
+	} else {
+		// #Portability pre win8. Caller re-checks the condition anyways.
+		os_yield_thread();
+	}
+}
+void os_wake_address_single(volatile void *address) {
+	if (win32_wake_by_address_single) win32_wake_by_address_single((PVOID)address);
+}
+void os_wake_address_all(volatile void *address) {
+	if (win32_wake_by_address_all) win32_wake_by_address_all((PVOID)address);
+}
+
 
 void os_sleep(u32 ms) {
     Sleep(ms);
@@ -606,7 +741,8 @@ void os_high_precision_sleep(f64 ms) {
 	
 	f64 start = os_get_current_time_in_seconds();
 	f64 end = start + (f64)s;
-	s32 sleep_time = (s32)((end-start)-1.0);
+	// Sleep can wake up to a millisecond late even with timeBeginPeriod(1), yield the rest
+	s32 sleep_time = (s32)(ms-1.0);
 	bool do_sleep = sleep_time >= 1;
 	
 	timeBeginPeriod(1);
@@ -620,6 +756,11 @@ void os_high_precision_sleep(f64 ms) {
 	timeEndPeriod(1);
 }
 
+void os_set_high_timer_resolution(bool enable) {
+	if (enable) timeBeginPeriod(1);
+	else        timeEndPeriod(1);
+}
+
 
 ///
 ///
@@ -636,9 +777,30 @@ float64 os_get_current_time_in_seconds() {
     if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&counter)) {
         return -1.0;
     }
+
     return (double)counter.QuadPart / (double)frequency.QuadPart;
 }
 
+f64 os_get_display_refresh_rate() {
+	DEVMODEW mode = ZERO(DEVMODEW);
+	mode.dmSize = sizeof(DEVMODEW);
+
+	WCHAR *device = 0;
+	MONITORINFOEXW monitor_info = ZERO(MONITORINFOEXW);
+	monitor_info.cbSize = sizeof(MONITORINFOEXW);
+	if (window._initialized) {
+		HMONITOR monitor = MonitorFromWindow(window._os_handle, MONITOR_DEFAULTTOPRIMARY);
+		if (monitor && GetMonitorInfoW(monitor, (MONITORINFO*)&monitor_info)) device = monitor_info.szDevice;
+	}
+
+	if (!EnumDisplaySettingsW(device, ENUM_CURRENT_SETTINGS, &mode)) return 0;
+
+	// 0 and 1 mean "the hardware's default"
+	if (mode.dmDisplayFrequency <= 1) return 0;
+
+	return (f64)mode.dmDisplayFrequency;
+}
+
 
 ///
 ///
@@ -706,6 +868,11 @@ bool os_file_copy_s(string from, string to, bool replace_if_exists) {
     u16 *to_wide   = temp_win32_fixed_utf8_to_null_terminated_wide(to);
 	return (bool)CopyFileW(from_wide, to_wide, !replace_if_exists);
 }
+bool os_file_move_s(string from, string to, bool replace_if_exists) {
+    u16 *from_wide = temp_win32_fixed_utf8_to_null_terminated_wide(from);
+    u16 *to_wide   = temp_win32_fixed_utf8_to_null_terminated_wide(to);
+	return (bool)MoveFileExW(from_wide, to_wide, replace_if_exists ? MOVEFILE_REPLACE_EXISTING : 0);
+}
 
 bool os_make_directory_s(string path, bool recursive) {
     wchar_t *wide_path = temp_win32_fixed_utf8_to_null_terminated_wide(path);
@@ -792,6 +959,15 @@ bool os_file_write_bytes(File f, void *buffer, u64 size_in_bytes) {
     return result && (written == size_in_bytes);
 }
 
+bool os_file_write_strings(File f, string *strings, u64 count) {
+    // WriteFileGather only works on unbuffered files with page aligned buffers, so this is one
+    // WriteFile per string. Callers keep the strings big so that's few calls anyway.
+    for (u64 i = 0; i < count; i++) {
+        if (!os_file_write_string(f, strings[i])) return false;
+    }
+    return true;
+}
+
 bool os_file_read(File f, void* buffer, u64 bytes_to_read, u64 *actual_read_bytes) {
     DWORD read;
     BOOL result = ReadFile(f, buffer, (DWORD)bytes_to_read, &read, 0);
@@ -801,6 +977,30 @@ bool os_file_read(File f, void* buffer, u64 bytes_to_read, u64 *actual_read_byte
     return result;
 }
 
+bool os_file_read_at(File f, u64 offset, void* buffer, u64 bytes_to_read, u64 *actual_read_bytes) {
+    // With an OVERLAPPED on a synchronous handle ReadFile reads at Offset and blocks like usual
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset     = (DWORD)(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD read = 0;
+    BOOL result = ReadFile(f, buffer, (DWORD)bytes_to_read, &read, &overlapped);
+    // Reading at or past the end of the file is not an error, it just reads 0 bytes
+    if (!result && GetLastError() == ERROR_HANDLE_EOF) result = TRUE;
+    if (actual_read_bytes) {
+        *actual_read_bytes = read;
+    }
+    return result;
+}
+
+bool os_file_write_at(File f, u64 offset, void *buffer, u64 size_in_bytes) {
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset     = (DWORD)(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD written = 0;
+    BOOL result = WriteFile(f, buffer, (DWORD)size_in_bytes, &written, &overlapped);
+    return result && (written == size_in_bytes);
+}
+
 bool os_file_set_pos(File f, s64 pos_in_bytes) {
 	if (pos_in_bytes < 0) return false;
     LARGE_INTEGER pos;
@@ -894,6 +1094,59 @@ bool os_read_entire_file_s(string path, string *result, Allocator allocator) {
     return res;
 }
 
+bool os_file_map_s(string path, Os_File_Map *map, Os_File_Map_Flags flags) {
+    *map = ZERO(Os_File_Map);
+
+    // Windows has no madvise, these hints go to the cache manager through the file handle
+    DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+    if (flags & OS_FILE_MAP_ACCESS_SEQUENTIAL) attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+    if (flags & OS_FILE_MAP_ACCESS_RANDOM)     attributes |= FILE_FLAG_RANDOM_ACCESS;
+
+    u16 *wide = temp_win32_fixed_utf8_to_null_terminated_wide(path);
+    HANDLE file = CreateFileW(wide, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, attributes, 0);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    if (file_size.QuadPart == 0) {
+        // Empty files can't be mapped
+        CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+    // The mapping keeps the file open
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    if ((flags & OS_FILE_MAP_PREFETCH) && win32_prefetch_virtual_memory) {
+        Win32_Memory_Range_Entry range;
+        range.VirtualAddress = view;
+        range.NumberOfBytes = (SIZE_T)file_size.QuadPart;
+        win32_prefetch_virtual_memory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    map->data.data = (u8*)view;
+    map->data.count = (u64)file_size.QuadPart;
+    map->os_handle = mapping;
+    return true;
+}
+
+void os_file_unmap(Os_File_Map *map) {
+    if (map->data.data) UnmapViewOfFile(map->data.data);
+    if (map->os_handle) CloseHandle(map->os_handle);
+    *map = ZERO(Os_File_Map);
+}
+
 bool os_is_file_s(string path) {
 	u16 *path_wide = temp_win32_fixed_utf8_to_null_terminated_wide(path);
 	assert(path_wide, "Invalid path string");
@@ -926,6 +1179,277 @@ bool os_is_directory_s(string path) {
     return (attributes & FILE_ATTRIBUTE_DIRECTORY);
 }
 
+#define WIN32_ITERATE_MAX_PATH 1024
+
+typedef struct Win32_Directory_Iterator {
+	u16 wide_path[WIN32_ITERATE_MAX_PATH];
+	u64 wide_count;
+	u8 path[WIN32_ITERATE_MAX_PATH*3];
+	u64 path_count;
+	bool recursive;
+	bool stopped;
+	Os_Directory_Iterate_Proc proc;
+	void *userdata;
+} Win32_Directory_Iterator;
+
+u64 win32_filetime_to_u64(FILETIME t) {
+	return ((u64)t.dwHighDateTime << 32) | (u64)t.dwLowDateTime;
+}
+
+// Lists it->wide_path. Entries are appended to the path buffers while they are visited, so
+// recursion needs no allocations.
+bool win32_iterate_directory(Win32_Directory_Iterator *it) {
+	u64 wide_count = it->wide_count;
+	u64 path_count = it->path_count;
+
+	if (wide_count+3 > WIN32_ITERATE_MAX_PATH) return false;
+	memcpy(it->wide_path+wide_count, L"\\*", 3*sizeof(u16));
+
+	WIN32_FIND_DATAW find_data;
+	HANDLE find = FindFirstFileExW(it->wide_path, FindExInfoBasic, &find_data, FindExSearchNameMatch, 0, FIND_FIRST_EX_LARGE_FETCH);
+	it->wide_path[wide_count] = 0;
+	if (find == INVALID_HANDLE_VALUE) return false;
+
+	do {
+		WCHAR *name = find_data.cFileName;
+		if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+
+		u64 name_wide_count = wcslen(name);
+		if (wide_count+1+name_wide_count+1 > WIN32_ITERATE_MAX_PATH) continue;
+		int name_count = WideCharToMultiByte(CP_UTF8, 0, name, (int)name_wide_count, (LPSTR)it->path+path_count+1, (int)(sizeof(it->path)-path_count-1), 0, 0);
+		if (name_count <= 0) continue;
+
+		it->path[path_count] = '/';
+		it->path_count = path_count+1+name_count;
+		it->wide_path[wide_count] = '\\';
+		memcpy(it->wide_path+wide_count+1, name, (name_wide_count+1)*sizeof(u16));
+		it->wide_count = wide_count+1+name_wide_count;
+
+		Os_File_Info info;
+		info.path = (string){it->path_count, it->path};
+		info.name = (string){(u64)name_count, it->path+path_count+1};
+		info.is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		info.size = info.is_directory ? 0 : (((u64)find_data.nFileSizeHigh << 32) | (u64)find_data.nFileSizeLow);
+		info.modification_time = win32_filetime_to_u64(find_data.ftLastWriteTime);
+
+		if (!it->proc(&info, it->userdata)) {
+			it->stopped = true;
+		} else if (info.is_directory && it->recursive && !(find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+			// Reparse points are links & junctions, which could go in circles
+			win32_iterate_directory(it);
+		}
+
+		it->wide_count = wide_count;
+		it->path_count = path_count;
+		it->wide_path[wide_count] = 0;
+
+	} while (!it->stopped && FindNextFileW(find, &find_data));
+
+	FindClose(find);
+	return true;
+}
+
+bool os_iterate_directory_s(string path, bool recursive, Os_Directory_Iterate_Proc proc, void *userdata) {
+	// Trailing separators are added back when joining with names
+	while (path.count > 1 && (path.data[path.count-1] == '/' || path.data[path.count-1] == '\\')) path.count -= 1;
+	if (path.count == 0) path = STR(".");
+
+	Win32_Directory_Iterator *it = alloc(get_heap_allocator(), sizeof(Win32_Directory_Iterator));
+	it->recursive = recursive;
+	it->stopped = false;
+	it->proc = proc;
+	it->userdata = userdata;
+
+	bool ok = false;
+	int wide_count = MultiByteToWideChar(CP_UTF8, 0, (LPCCH)path.data, (int)path.count, it->wide_path, WIN32_ITERATE_MAX_PATH-1);
+	if (wide_count > 0 && path.count < sizeof(it->path)) {
+		it->wide_path[wide_count] = 0;
+		it->wide_count = (u64)wide_count;
+		memcpy(it->path, path.data, path.count);
+		it->path_count = path.count;
+		ok = win32_iterate_directory(it);
+	}
+
+	dealloc(get_heap_allocator(), it);
+	return ok;
+}
+
+bool os_get_file_info_s(string path, Os_File_Info *info) {
+	u16 *path_wide = temp_win32_fixed_utf8_to_null_terminated_wide(path);
+	if (!path_wide) return false;
+
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(path_wide, GetFileExInfoStandard, &data)) return false;
+
+	string name = path;
+	while (name.count > 1 && (name.data[name.count-1] == '/' || name.data[name.count-1] == '\\')) name.count -= 1;
+	for (s64 i = (s64)name.count-1; i >= 0; i--) {
+		if (name.data[i] == '/' || name.data[i] == '\\') {
+			name.data += i+1;
+			name.count -= i+1;
+			break;
+		}
+	}
+
+	info->path = path;
+	info->name = name;
+	info->is_directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	info->size = info->is_directory ? 0 : (((u64)data.nFileSizeHigh << 32) | (u64)data.nFileSizeLow);
+	info->modification_time = win32_filetime_to_u64(data.ftLastWriteTime);
+	return true;
+}
+
+// 64kb is the most ReadDirectoryChangesW can do for network drives
+#define WIN32_DIRECTORY_WATCH_BUFFER_SIZE KB(64)
+
+typedef struct Win32_Directory_Watch {
+	DWORD buffer[WIN32_DIRECTORY_WATCH_BUFFER_SIZE/sizeof(DWORD)]; // FILE_NOTIFY_INFORMATION needs DWORD alignment
+	HANDLE directory;
+	OVERLAPPED overlapped;
+	bool recursive;
+	bool pending; // A ReadDirectoryChangesW is in flight
+
+	// Growing arrays, reused between polls
+	Os_File_Change *changes;
+	u8 *names;
+} Win32_Directory_Watch;
+
+bool win32_directory_watch_read(Win32_Directory_Watch *w) {
+	DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+	             | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+	ResetEvent(w->overlapped.hEvent);
+	w->pending = ReadDirectoryChangesW(w->directory, w->buffer, sizeof(w->buffer), w->recursive, filter, 0, &w->overlapped, 0);
+	return w->pending;
+}
+
+void win32_directory_watch_add_change(Win32_Directory_Watch *w, Os_File_Change_Kind kind, WCHAR *wide_name, u64 wide_count) {
+	Os_File_Change *change = growing_array_add_empty((void**)&w->changes);
+	change->kind = kind;
+	change->path.count = 0;
+	change->path.data = (u8*)(u64)growing_array_get_valid_count(w->names);
+	if (wide_count == 0) return;
+
+	int name_count = WideCharToMultiByte(CP_UTF8, 0, wide_name, (int)wide_count, 0, 0, 0, 0);
+	if (name_count <= 0) return;
+	u64 offset = (u64)change->path.data;
+	growing_array_resize((void**)&w->names, offset+name_count);
+	WideCharToMultiByte(CP_UTF8, 0, wide_name, (int)wide_count, (LPSTR)w->names+offset, name_count, 0, 0);
+	for (int i = 0; i < name_count; i++) {
+		if (w->names[offset+i] == '\\') w->names[offset+i] = '/';
+	}
+	change->path.count = (u64)name_count;
+}
+
+bool os_watch_directory_s(string path, bool recursive, Os_Directory_Watch *watch) {
+	*watch = ZERO(Os_Directory_Watch);
+
+	u16 *path_wide = temp_win32_fixed_utf8_to_null_terminated_wide(path);
+	if (!path_wide) return false;
+
+	HANDLE directory = CreateFileW(
+		path_wide,
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		0,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		0
+	);
+	if (directory == INVALID_HANDLE_VALUE) return false;
+
+	Win32_Directory_Watch *w = alloc(get_heap_allocator(), sizeof(Win32_Directory_Watch));
+	memset(w, 0, sizeof(*w));
+	w->directory = directory;
+	w->recursive = recursive;
+	w->overlapped.hEvent = CreateEventW(0, TRUE, FALSE, 0);
+	growing_array_init((void**)&w->changes, sizeof(Os_File_Change), get_heap_allocator());
+	growing_array_init((void**)&w->names, sizeof(u8), get_heap_allocator());
+
+	// Changes are only collected from the first ReadDirectoryChangesW call
+	if (!w->overlapped.hEvent || !win32_directory_watch_read(w)) {
+		watch->os_data = w;
+		os_unwatch_directory(watch);
+		return false;
+	}
+
+	watch->os_data = w;
+	return true;
+}
+
+u64 os_poll_directory_changes(Os_Directory_Watch *watch, Os_File_Change **changes, Allocator allocator) {
+	Win32_Directory_Watch *w = (Win32_Directory_Watch*)watch->os_data;
+	*changes = 0;
+	if (!w) return 0;
+
+	growing_array_clear((void**)&w->changes);
+	growing_array_clear((void**)&w->names);
+
+	// Changes that happen while we handle a buffer are queued up by the OS for the next read,
+	// which may then complete right away
+	while (w->pending) {
+		DWORD bytes = 0;
+		if (!GetOverlappedResult(w->directory, &w->overlapped, &bytes, FALSE)) {
+			if (GetLastError() == ERROR_IO_INCOMPLETE) break;
+			// Probably the watched directory itself was removed
+			win32_directory_watch_add_change(w, OS_FILE_CHANGE_OVERFLOW, 0, 0);
+			w->pending = false;
+			break;
+		}
+
+		if (bytes == 0) {
+			// The OS side buffer overflowed
+			win32_directory_watch_add_change(w, OS_FILE_CHANGE_OVERFLOW, 0, 0);
+		} else {
+			u8 *p = (u8*)w->buffer;
+			while (true) {
+				FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION*)p;
+				Os_File_Change_Kind kind = OS_FILE_CHANGE_MODIFIED;
+				switch (info->Action) {
+					case FILE_ACTION_ADDED:            kind = OS_FILE_CHANGE_ADDED;    break;
+					case FILE_ACTION_RENAMED_NEW_NAME: kind = OS_FILE_CHANGE_ADDED;    break;
+					case FILE_ACTION_REMOVED:          kind = OS_FILE_CHANGE_REMOVED;  break;
+					case FILE_ACTION_RENAMED_OLD_NAME: kind = OS_FILE_CHANGE_REMOVED;  break;
+					default:                           kind = OS_FILE_CHANGE_MODIFIED; break;
+				}
+				win32_directory_watch_add_change(w, kind, info->FileName, info->FileNameLength/sizeof(WCHAR));
+
+				if (info->NextEntryOffset == 0) break;
+				p += info->NextEntryOffset;
+			}
+		}
+
+		win32_directory_watch_read(w);
+	}
+
+	return os_pack_directory_changes(
+		w->changes,
+		growing_array_get_valid_count(w->changes),
+		w->names,
+		changes,
+		allocator
+	);
+}
+
+void os_unwatch_directory(Os_Directory_Watch *watch) {
+	Win32_Directory_Watch *w = (Win32_Directory_Watch*)watch->os_data;
+	if (!w) return;
+
+	if (w->pending) {
+		// The OS writes to the buffer until the read is cancelled
+		CancelIoEx(w->directory, &w->overlapped);
+		DWORD bytes;
+		GetOverlappedResult(w->directory, &w->overlapped, &bytes, TRUE);
+	}
+	CloseHandle(w->directory);
+	if (w->overlapped.hEvent) CloseHandle(w->overlapped.hEvent);
+
+	growing_array_deinit((void**)&w->changes);
+	growing_array_deinit((void**)&w->names);
+	dealloc(get_heap_allocator(), w);
+
+	watch->os_data = 0;
+}
+
 bool os_is_path_absolute(string path) {
 	// #Incomplete #Portability not sure this is very robust.
 	
@@ -1034,6 +1558,263 @@ void fprintf(File f, const char* fmt, ...) {
 
 
 
+///
+///
+// Sockets
+///
+
+// Not in winsock2.h. Without it, a UDP socket that sent to a port nobody listens on gets
+// WSAECONNRESET from its next recvfrom.
+#ifndef SIO_UDP_CONNRESET
+	#define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
+#endif
+
+#define WIN32_SOCKET_BUFFER_SIZE (1024*1024)
+#define WIN32_MAX_SOCKET_IO_SIZE 0x7FFFFFFF
+
+struct sockaddr_in
+win32_to_sockaddr(Socket_Address address) {
+	struct sockaddr_in a = ZERO(struct sockaddr_in);
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(address.ip);
+	a.sin_port = htons(address.port);
+	return a;
+}
+Socket_Address
+win32_from_sockaddr(struct sockaddr_in a) {
+	Socket_Address address;
+	address.ip = ntohl(a.sin_addr.s_addr);
+	address.port = ntohs(a.sin_port);
+	return address;
+}
+
+bool
+win32_socket_would_block(int error) {
+	// Sending on a socket that is still connecting gives WSAENOTCONN
+	return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS || error == WSAENOTCONN;
+}
+
+SOCKET
+win32_make_socket(int type, int protocol) {
+	SOCKET s = socket(AF_INET, type, protocol);
+	if (s == INVALID_SOCKET) {
+		log_error("Failed creating socket, error: %d", WSAGetLastError());
+		return INVALID_SOCKET;
+	}
+
+	u_long non_blocking = 1;
+	if (ioctlsocket(s, FIONBIO, &non_blocking) != 0) {
+		log_error("Failed making socket non-blocking, error: %d", WSAGetLastError());
+		closesocket(s);
+		return INVALID_SOCKET;
+	}
+
+	// Default buffers are small enough to drop datagrams if we're a frame late to receive
+	int buffer_size = WIN32_SOCKET_BUFFER_SIZE;
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char*)&buffer_size, sizeof(buffer_size));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char*)&buffer_size, sizeof(buffer_size));
+
+	return s;
+}
+
+void
+win32_socket_set_no_delay(SOCKET s) {
+	// Games send small messages that should go out now, not when Nagle thinks it's worth it
+	BOOL no_delay = TRUE;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*)&no_delay, sizeof(no_delay));
+}
+
+Socket
+os_socket_open_udp(Socket_Address address) {
+	SOCKET s = win32_make_socket(SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET) return OS_INVALID_SOCKET;
+
+	BOOL report_reset = FALSE;
+	DWORD bytes_returned = 0;
+	WSAIoctl(s, SIO_UDP_CONNRESET, &report_reset, sizeof(report_reset), 0, 0, &bytes_returned, 0, 0);
+
+	struct sockaddr_in a = win32_to_sockaddr(address);
+	if (bind(s, (struct sockaddr*)&a, sizeof(a)) != 0) {
+		log_error("Failed binding UDP socket to port %d, error: %d", address.port, WSAGetLastError());
+		closesocket(s);
+		return OS_INVALID_SOCKET;
+	}
+
+	return (Socket)s;
+}
+
+Socket
+os_socket_listen(Socket_Address address) {
+	SOCKET s = win32_make_socket(SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) return OS_INVALID_SOCKET;
+
+	struct sockaddr_in a = win32_to_sockaddr(address);
+	if (bind(s, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(s, SOMAXCONN) != 0) {
+		log_error("Failed listening on port %d, error: %d", address.port, WSAGetLastError());
+		closesocket(s);
+		return OS_INVALID_SOCKET;
+	}
+
+	return (Socket)s;
+}
+
+Socket
+os_socket_accept(Socket listener, Socket_Address *remote) {
+	struct sockaddr_in a;
+	int a_size = sizeof(a);
+	SOCKET s = accept((SOCKET)listener, (struct sockaddr*)&a, &a_size);
+	if (s == INVALID_SOCKET) {
+		int error = WSAGetLastError();
+		if (!win32_socket_would_block(error)) log_error("Failed accepting connection, error: %d", error);
+		return OS_INVALID_SOCKET;
+	}
+
+	// Accepted sockets inherit non-blocking from the listener, but not the rest
+	win32_socket_set_no_delay(s);
+
+	if (remote) *remote = win32_from_sockaddr(a);
+	return (Socket)s;
+}
+
+Socket
+os_socket_connect(Socket_Address address) {
+	SOCKET s = win32_make_socket(SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) return OS_INVALID_SOCKET;
+
+	win32_socket_set_no_delay(s);
+
+	struct sockaddr_in a = win32_to_sockaddr(address);
+	if (connect(s, (struct sockaddr*)&a, sizeof(a)) != 0) {
+		int error = WSAGetLastError();
+		if (!win32_socket_would_block(error)) {
+			log_error("Failed connecting to port %d, error: %d", address.port, error);
+			closesocket(s);
+			return OS_INVALID_SOCKET;
+		}
+	}
+
+	return (Socket)s;
+}
+
+void
+os_socket_close(Socket s) {
+	if (s == OS_INVALID_SOCKET) return;
+	closesocket((SOCKET)s);
+}
+
+bool
+os_socket_get_address(Socket s, Socket_Address *address) {
+	struct sockaddr_in a;
+	int a_size = sizeof(a);
+	if (getsockname((SOCKET)s, (struct sockaddr*)&a, &a_size) != 0) return false;
+	*address = win32_from_sockaddr(a);
+	return true;
+}
+
+s64
+os_socket_send(Socket s, void *data, u64 size) {
+	int sent = send((SOCKET)s, (char*)data, (int)min(size, (u64)WIN32_MAX_SOCKET_IO_SIZE), 0);
+	if (sent == SOCKET_ERROR) {
+		return win32_socket_would_block(WSAGetLastError()) ? 0 : -1;
+	}
+	return (s64)sent;
+}
+
+s64
+os_socket_receive(Socket s, void *buffer, u64 size) {
+	int received = recv((SOCKET)s, (char*)buffer, (int)min(size, (u64)WIN32_MAX_SOCKET_IO_SIZE), 0);
+	if (received == 0 && size > 0) return -1; // Closed by the other side
+	if (received == SOCKET_ERROR) {
+		return win32_socket_would_block(WSAGetLastError()) ? 0 : -1;
+	}
+	return (s64)received;
+}
+
+// Windows has no sendmmsg/recvmmsg, so these are a syscall per datagram. It's still one call
+// for the caller and the loop stops at the first would-block, so an idle socket costs one
+// syscall a frame.
+u64
+os_socket_send_datagrams(Socket s, Socket_Datagram *datagrams, u64 count) {
+	u64 sent_count = 0;
+	for (; sent_count < count; sent_count += 1) {
+		Socket_Datagram *d = &datagrams[sent_count];
+		struct sockaddr_in a = win32_to_sockaddr(d->address);
+		int sent = sendto((SOCKET)s, (char*)d->data.data, (int)d->data.count, 0, (struct sockaddr*)&a, sizeof(a));
+		if (sent == SOCKET_ERROR) {
+			int error = WSAGetLastError();
+			if (!win32_socket_would_block(error)) log_error("Failed sending datagram, error: %d", error);
+			break;
+		}
+	}
+	return sent_count;
+}
+
+u64
+os_socket_receive_datagrams(Socket s, Socket_Datagram *datagrams, u64 max_count, void *buffer, u64 buffer_size) {
+	u8 *next = (u8*)buffer;
+	u8 *end = next + buffer_size;
+	u64 count = 0;
+	while (count < max_count && (u64)(end-next) >= SOCKET_MAX_DATAGRAM_SIZE) {
+		struct sockaddr_in a;
+		int a_size = sizeof(a);
+		int received = recvfrom((SOCKET)s, (char*)next, SOCKET_MAX_DATAGRAM_SIZE, 0, (struct sockaddr*)&a, &a_size);
+		if (received == SOCKET_ERROR) {
+			int error = WSAGetLastError();
+			if (error == WSAEMSGSIZE) continue; // Too big, the rest of it is gone. Drop it.
+			if (!win32_socket_would_block(error)) log_error("Failed receiving datagram, error: %d", error);
+			break;
+		}
+
+		Socket_Datagram *d = &datagrams[count];
+		d->address = win32_from_sockaddr(a);
+		d->data.data = next;
+		d->data.count = (u64)received;
+		next += received;
+		count += 1;
+	}
+	return count;
+}
+
+u64
+os_socket_poll(Socket_Poll *polls, u64 count, s64 timeout_ms) {
+	WSAPOLLFD stack_fds[64];
+	WSAPOLLFD *fds = count <= 64 ? stack_fds : (WSAPOLLFD*)alloc(get_temporary_allocator(), count*sizeof(WSAPOLLFD));
+
+	for (u64 i = 0; i < count; i++) {
+		fds[i].fd = (SOCKET)polls[i].socket;
+		fds[i].events = 0;
+		fds[i].revents = 0;
+		// POLLIN & POLLOUT include priority band flags which WSAPoll rejects
+		if (polls[i].wait_for & SOCKET_EVENT_READ)  fds[i].events |= POLLRDNORM;
+		if (polls[i].wait_for & SOCKET_EVENT_WRITE) fds[i].events |= POLLWRNORM;
+		polls[i].events = 0;
+	}
+
+	int result = WSAPoll(fds, (ULONG)count, timeout_ms < 0 ? -1 : (INT)min(timeout_ms, (s64)0x7FFFFFFF));
+	if (result == SOCKET_ERROR) {
+		log_error("WSAPoll failed, error: %d", WSAGetLastError());
+		return 0;
+	}
+
+	u64 ready_count = 0;
+	for (u64 i = 0; i < count; i++) {
+		SHORT r = fds[i].revents;
+		Socket_Events events = 0;
+		// Hangup means the other side closed, which a receive then reports
+		if (r & (POLLRDNORM | POLLHUP)) events |= SOCKET_EVENT_READ;
+		if (r & POLLWRNORM)             events |= SOCKET_EVENT_WRITE;
+		if (r & (POLLERR | POLLNVAL))   events |= SOCKET_EVENT_ERROR;
+		events &= polls[i].wait_for | SOCKET_EVENT_ERROR;
+		polls[i].events = events;
+		if (events) ready_count += 1;
+	}
+	return ready_count;
+}
+
+
+
+
+
 ///
 ///
 // Queries
@@ -1055,12 +1836,76 @@ os_get_number_of_logical_processors() {
 	return (u64)win32_system_info.dwNumberOfProcessors;
 }
 
+u64
+os_get_current_processor() {
+	return (u64)GetCurrentProcessorNumber();
+}
+
+u64
+win32_count_bits(u64 mask) {
+	u64 count = 0;
+	while (mask) {
+		mask &= mask-1;
+		count += 1;
+	}
+	return count;
+}
+
+bool
+os_get_cpu_topology(Os_Cpu_Topology *topology) {
+	memset(topology, 0, sizeof(*topology));
+	
+	DWORD size = 0;
+	GetLogicalProcessorInformationEx(RelationAll, 0, &size);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) return false;
+	
+	// Several kb on big cpus, too much for temporary storage on threads with the default size
+	u8 *buffer = (u8*)alloc(get_heap_allocator(), size);
+	if (!GetLogicalProcessorInformationEx(RelationAll, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)buffer, &size)) {
+		dealloc(get_heap_allocator(), buffer);
+		return false;
+	}
+	
+	// Only processor group 0, which is the first 64 logical processors
+	for (u8 *next = buffer; next < buffer+size;) {
+		SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)next;
+		next += info->Size;
+		
+		if (info->Relationship == RelationProcessorCore) {
+			GROUP_AFFINITY *group = &info->Processor.GroupMask[0];
+			if (group->Group != 0 || topology->core_count >= OS_MAX_CPU_CORES) continue;
+			
+			Os_Cpu_Core *core = &topology->cores[topology->core_count];
+			core->logical_processor_mask = (u64)group->Mask;
+			core->efficiency_class = info->Processor.EfficiencyClass;
+			topology->core_count += 1;
+			topology->logical_processor_count += win32_count_bits(core->logical_processor_mask);
+		} else if (info->Relationship == RelationCache) {
+			CACHE_RELATIONSHIP *c = &info->Cache;
+			if (c->Type == CacheInstruction || c->GroupMask.Group != 0) continue;
+			if (topology->cache_count >= OS_MAX_CPU_CACHES) continue;
+			
+			Os_Cpu_Cache *cache = &topology->caches[topology->cache_count];
+			cache->level = c->Level;
+			cache->size = c->CacheSize;
+			cache->line_size = c->LineSize;
+			cache->logical_processor_mask = (u64)c->GroupMask.Mask;
+			topology->cache_count += 1;
+		}
+	}
+	
+	dealloc(get_heap_allocator(), buffer);
+	return true;
+}
+
 ///
 ///
 // Debug
 ///
 #define WIN32_MAX_STACK_FRAMES 64
 #define WIN32_MAX_SYMBOL_NAME_LENGTH 256
+// Frames deeper than this into the stack of a sampled thread are cut off
+#define WIN32_MAX_SAMPLED_STACK_SIZE KB(256)
 string *
 os_get_stack_trace(u64 *trace_count, Allocator allocator) {
 #if CONFIGURATION == DEBUG
@@ -1156,6 +2001,160 @@ os_get_stack_trace(u64 *trace_count, Allocator allocator) {
 #endif // NOT DEBUG
 }
 
+u64
+os_get_process_thread_ids(u64 *thread_ids, u64 max_count) {
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot == INVALID_HANDLE_VALUE) return 0;
+
+	DWORD process_id = GetCurrentProcessId();
+
+	THREADENTRY32 entry = ZERO(THREADENTRY32);
+	entry.dwSize = sizeof(THREADENTRY32);
+
+	u64 count = 0;
+	if (Thread32First(snapshot, &entry)) {
+		do {
+			if (entry.th32OwnerProcessID == process_id) {
+				if (count < max_count) thread_ids[count] = entry.th32ThreadID;
+				count += 1;
+			}
+			entry.dwSize = sizeof(THREADENTRY32);
+		} while (Thread32Next(snapshot, &entry));
+	}
+
+	CloseHandle(snapshot);
+	return count;
+}
+
+// Stack bytes of the thread currently being sampled. Allocated up front, the sampled thread
+// might be holding the heap lock while it's suspended.
+// There's some zeroed slack after the copy for unwinding a frame that got cut off in the
+// middle, which then just ends on a zero return address.
+thread_local u8 *win32_sampled_stack = 0;
+
+// Registers pointing into the original stack need to point into the copy instead
+inline void
+win32_rebase_stack_register(DWORD64 *reg, u64 stack_start, u64 stack_end, u64 copy) {
+	if (*reg >= stack_start && *reg < stack_end) *reg = *reg - stack_start + copy;
+}
+
+u64
+os_sample_thread_stack(u64 thread_id, u64 *frames, u64 max_frames) {
+#ifdef _M_X64
+	if (max_frames == 0 || thread_id == GetCurrentThreadId()) return 0;
+
+	if (!win32_sampled_stack) {
+		win32_sampled_stack = VirtualAlloc(0, WIN32_MAX_SAMPLED_STACK_SIZE + KB(64), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		if (!win32_sampled_stack) return 0;
+	}
+
+	HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, (DWORD)thread_id);
+	if (!thread) return 0;
+
+	// Thread ids come from a snapshot which might be stale by now, so the id could have been
+	// reused by a thread in another process.
+	if (GetProcessIdOfThread(thread) != GetCurrentProcessId()) {
+		CloseHandle(thread);
+		return 0;
+	}
+
+	if (SuspendThread(thread) == (DWORD)-1) {
+		CloseHandle(thread);
+		return 0;
+	}
+
+	// The thread might be holding the heap, dbghelp or loader lock (which the unwind table
+	// lookup takes), so while it's suspended we only copy its registers and stack and do the
+	// unwinding on the copy once it's running again.
+	CONTEXT context = ZERO(CONTEXT);
+	context.ContextFlags = CONTEXT_FULL;
+
+	u64 stack_start = 0;
+	u64 stack_end = 0;
+	if (GetThreadContext(thread, &context)) {
+		MEMORY_BASIC_INFORMATION stack_info;
+		if (VirtualQuery((void*)context.Rsp, &stack_info, sizeof(stack_info))) {
+			stack_start = context.Rsp;
+			stack_end = (u64)stack_info.BaseAddress + stack_info.RegionSize;
+			stack_end = min(stack_end, stack_start + WIN32_MAX_SAMPLED_STACK_SIZE);
+			memcpy(win32_sampled_stack, (void*)stack_start, stack_end - stack_start);
+			memset(win32_sampled_stack + (stack_end - stack_start), 0, KB(64));
+		}
+	}
+
+	ResumeThread(thread);
+	CloseHandle(thread);
+
+	if (stack_end == 0) return 0;
+
+	u64 copy = (u64)win32_sampled_stack;
+	u64 copy_end = copy + (stack_end - stack_start);
+
+	u64 count = 0;
+	while (count < max_frames && context.Rip != 0) {
+		frames[count] = context.Rip;
+		count += 1;
+
+		// Saved frame pointers & such that were restored from the stack still point into the
+		// original stack
+		win32_rebase_stack_register(&context.Rsp, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.Rbp, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.Rbx, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.Rsi, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.Rdi, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.R12, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.R13, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.R14, stack_start, stack_end, copy);
+		win32_rebase_stack_register(&context.R15, stack_start, stack_end, copy);
+		if (context.Rsp < copy || context.Rsp >= copy_end) break;
+
+		DWORD64 image_base;
+		PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(context.Rip, &image_base, 0);
+		if (function) {
+			void *handler_data;
+			DWORD64 establisher_frame;
+			RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, context.Rip, function, &context, &handler_data, &establisher_frame, 0);
+		} else {
+			// Leaf function, the return address is on top of the stack
+			if (context.Rsp+sizeof(u64) > copy_end) break;
+			context.Rip = *(DWORD64*)context.Rsp;
+			context.Rsp += sizeof(u64);
+		}
+
+		if (context.Rsp >= copy_end) break;
+	}
+
+	return count;
+#else
+	// #Incomplete
+	return 0;
+#endif
+}
+
+string
+os_get_symbol_name(u64 address, Allocator allocator) {
+	HANDLE process = GetCurrentProcess();
+	if (!win32_symbols_initialized) {
+		SymInitialize(process, NULL, TRUE);
+		win32_symbols_initialized = true;
+	}
+
+	DWORD64 displacement = 0;
+	char buffer[sizeof(SYMBOL_INFO) + WIN32_MAX_SYMBOL_NAME_LENGTH * sizeof(TCHAR)];
+	PSYMBOL_INFO symbol = (PSYMBOL_INFO)buffer;
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = WIN32_MAX_SYMBOL_NAME_LENGTH;
+
+	if (!SymFromAddr(process, address, &displacement, symbol) || symbol->NameLen == 0) {
+		return null_string;
+	}
+
+	u64 length = min((u64)symbol->NameLen, (u64)WIN32_MAX_SYMBOL_NAME_LENGTH-1);
+	string name = alloc_string(allocator, length);
+	memcpy(name.data, symbol->Name, length);
+	return name;
+}
+
 bool os_grow_program_memory(u64 new_size) {
 	os_lock_mutex(program_memory_mutex); // #Sync
 	if (program_memory_capacity >= new_size) {
@@ -1220,6 +2219,9 @@ bool os_grow_program_memory(u64 new_size) {
 	os_write_string_to_stdout(STR(size_str));
 	os_write_string_to_stdout(STR(" kb\n"));
 	os_unlock_mutex(program_memory_mutex); // #Sync
+	
+	if (heap_head) trace_allocation_event(PROFILE_EVENT_PROGRAM_MEMORY_GROW, program_memory, program_memory_capacity);
+	
 	return true;
 }
 
@@ -1543,9 +2545,6 @@ win32_audio_init() {
     } else {
     	panic("What");
     }
-    
-    DWORD task_index;
-	AvSetMmThreadCharacteristics(TEXT("Pro Audio"), &task_index);
 
     log_info("Successfully initialized default audio device. Channels: %d, sample_rate: %d, bits: %d", audio_output_format.channels, audio_output_format.sample_rate, get_audio_bit_width_byte_size(audio_output_format.bit_width)*8);
     did_report_error_last_call = false;
@@ -47,6 +47,11 @@ typedef struct Os_Info {
     
     void *static_memory_start, *static_memory_end;
     
+    // rdtsc ticks per second, 0 until calibrated. Use os_get_tsc_frequency().
+    u64 tsc_frequency;
+    u64 tsc_calibration_start;
+    f64 tsc_calibration_start_seconds;
+    
 } Os_Info;
 
 typedef struct Os_Window {
@@ -98,6 +103,17 @@ typedef struct Thread Thread;
 
 typedef void(*Thread_Proc)(Thread*);
 
+typedef enum Os_Thread_Priority {
+	OS_THREAD_PRIORITY_DEFAULT = 0, // Whatever the engine does for its threads (time critical in release builds)
+	OS_THREAD_PRIORITY_LOW,
+	OS_THREAD_PRIORITY_NORMAL,
+	OS_THREAD_PRIORITY_HIGH,
+	OS_THREAD_PRIORITY_TIME_CRITICAL,
+	// Scheduled like the OS schedules audio (MMCSS "Pro Audio" on windows), which preempts
+	// pretty much everything else. Only for threads that do a little work on a strict deadline.
+	OS_THREAD_PRIORITY_AUDIO,
+} Os_Thread_Priority;
+
 typedef struct Thread {
 	u64 id; // This is valid after os_thread_start
 	Context initial_context;
@@ -106,6 +122,11 @@ typedef struct Thread {
 	Thread_Proc proc;
 	Thread_Handle os_handle;
 	
+	// Optional, set before os_thread_start. Applied from the thread before proc is called.
+	string name; // Shows up in debuggers & profilers. Must stay valid until the thread started.
+	Os_Thread_Priority priority;
+	u64 affinity_mask; // See os_thread_set_affinity. 0 means any processor.
+	
 	
 	Allocator allocator;  // Deprecated !! #Cleanup
 } Thread;
@@ -129,6 +150,25 @@ os_thread_start(Thread *t);
 void ogb_instance
 os_thread_join(Thread *t);
 
+// These take a started thread, or 0 for the calling thread. Return false if the OS didn't let
+// us, which is not worth failing over.
+
+bool ogb_instance
+os_thread_set_name(Thread *t, string name);
+
+// OS_THREAD_PRIORITY_AUDIO can only be set on the calling thread
+bool ogb_instance
+os_thread_set_priority(Thread *t, Os_Thread_Priority priority);
+
+// Bit n lets the thread run on logical processor n. Use os_get_cpu_topology to pick them.
+// Only the first 64 logical processors can be used.
+bool ogb_instance
+os_thread_set_affinity(Thread *t, u64 logical_processor_mask);
+
+// Empty string if the thread has no name or doesn't exist
+string ogb_instance
+os_get_thread_name(u64 thread_id, Allocator allocator);
+
 
 
 ///
@@ -145,6 +185,22 @@ os_lock_mutex(Mutex_Handle m);
 void ogb_instance
 os_unlock_mutex(Mutex_Handle m);
 
+///
+// Address waiting (futex style)
+// Sleeps the calling thread for as long as *address == expected, until some other thread
+// calls os_wake_address_single/all on the same address. Wakeups may be spurious, so always
+// re-check whatever condition you are waiting for.
+// Waiting and waking on an address nobody else touches costs nothing, so this is the
+// building block for blocking locks that don't need an OS handle (see Rw_Lock).
+void ogb_instance
+os_wait_on_address_32(volatile u32 *address, u32 expected);
+
+void ogb_instance
+os_wake_address_single(volatile void *address);
+
+void ogb_instance
+os_wake_address_all(volatile void *address);
+
 ///
 // Threading utilities
 
@@ -157,6 +213,12 @@ os_yield_thread();
 void ogb_instance
 os_high_precision_sleep(f64 ms);
 
+// Makes os_sleep wake up as close to on time as the OS can (1ms on windows instead of up to
+// ~16ms) while enabled. Costs some power, so disable it again when you don't need it.
+// Calls nest, so pair every enable with a disable.
+void ogb_instance
+os_set_high_timer_resolution(bool enable);
+
 
 ///
 ///
@@ -168,6 +230,71 @@ DEPRECATED(u64 os_get_current_cycle_count(), "use rdtsc() instead");
 float64 ogb_instance
 os_get_current_time_in_seconds();
 
+// Refresh rate of the display the window is on (or the main display if there is no window),
+// 0 if it's unknown.
+f64 ogb_instance
+os_get_display_refresh_rate();
+
+#define OS_TSC_CALIBRATION_SECONDS 0.01
+
+// Starts measuring rdtsc against os_get_current_time_in_seconds. Called in oogabooga_init,
+// so by the time the frequency is first needed enough time has usually passed to not wait.
+void ogb_instance
+os_start_tsc_calibration();
+
+// rdtsc ticks per second. Calibrated on the first call from the time since
+// os_start_tsc_calibration(), spinning for the rest of OS_TSC_CALIBRATION_SECONDS if it's
+// called sooner than that.
+// Only a reliable clock if the cpu has Cpu_Capabilities.invariant_tsc.
+u64 ogb_instance
+os_get_tsc_frequency();
+
+// Measures rdtsc frequency from now by spinning for duration_seconds, and stores it in
+// os.tsc_frequency. Only needed to recalibrate, os_get_tsc_frequency() does it lazily.
+void ogb_instance
+os_calibrate_tsc(f64 duration_seconds);
+
+// The longer the program has run since os_start_tsc_calibration() the more accurate this
+// gets, so use this over os_get_tsc_frequency() when you can afford it (like when dumping a profile).
+f64 ogb_instance
+os_get_refined_tsc_frequency();
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+void os_start_tsc_calibration() {
+	os.tsc_frequency = 0;
+	os.tsc_calibration_start_seconds = os_get_current_time_in_seconds();
+	os.tsc_calibration_start = rdtsc();
+}
+void _os_finish_tsc_calibration(f64 duration_seconds) {
+	f64 end_seconds = os_get_current_time_in_seconds();
+	while (end_seconds-os.tsc_calibration_start_seconds < duration_seconds) {
+		end_seconds = os_get_current_time_in_seconds();
+	}
+	u64 end_tsc = rdtsc();
+	
+	// Threads racing here all write about the same value, so no lock
+	os.tsc_frequency = (u64)((f64)(end_tsc-os.tsc_calibration_start)/(end_seconds-os.tsc_calibration_start_seconds));
+}
+u64 os_get_tsc_frequency() {
+	if (os.tsc_frequency == 0) _os_finish_tsc_calibration(OS_TSC_CALIBRATION_SECONDS);
+	return os.tsc_frequency;
+}
+void os_calibrate_tsc(f64 duration_seconds) {
+	os_start_tsc_calibration();
+	_os_finish_tsc_calibration(duration_seconds);
+}
+f64 os_get_refined_tsc_frequency() {
+	u64 tsc_frequency = os_get_tsc_frequency();
+	f64 elapsed_seconds = os_get_current_time_in_seconds()-os.tsc_calibration_start_seconds;
+	u64 elapsed_tsc = rdtsc()-os.tsc_calibration_start;
+	
+	// Timer resolution makes short intervals worse than the initial calibration
+	if (elapsed_seconds < 1.0) return (f64)tsc_frequency;
+	
+	return (f64)elapsed_tsc/elapsed_seconds;
+}
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
 ///
 ///
 // Dynamic Libraries
@@ -215,6 +342,10 @@ os_file_delete_s(string path);
 bool ogb_instance
 os_file_copy_s(string from, string to, bool replace_if_exists);
 
+// Renames/moves a file, within the same drive
+bool ogb_instance
+os_file_move_s(string from, string to, bool replace_if_exists);
+
 
 bool ogb_instance
 os_make_directory_s(string path, bool recursive);
@@ -229,11 +360,24 @@ os_file_write_string(File f, string s);
 bool ogb_instance
 os_file_write_bytes(File f, void *buffer, u64 size_in_bytes);
 
+// Writes the strings one after another, in as few calls to the os as it can
+bool ogb_instance
+os_file_write_strings(File f, string *strings, u64 count);
+
 
 bool ogb_instance
 os_file_read(File f, void* buffer, u64 bytes_to_read, u64 *actual_read_bytes);
 
 
+// Read/write at offset regardless of the file position, so several threads can use different
+// parts of the same file. The file position afterwards is unspecified.
+bool ogb_instance
+os_file_read_at(File f, u64 offset, void* buffer, u64 bytes_to_read, u64 *actual_read_bytes);
+
+bool ogb_instance
+os_file_write_at(File f, u64 offset, void *buffer, u64 size_in_bytes);
+
+
 bool ogb_instance
 os_file_set_pos(File f, s64 pos_in_bytes);
 
@@ -260,6 +404,33 @@ os_read_entire_file_handle(File f, string *result, Allocator allocator);
 bool ogb_instance
 os_read_entire_file_s(string path, string *result, Allocator allocator);
 
+///
+// File mapping
+// Maps a file into memory read only, so it can be used like the result of os_read_entire_file
+// without allocating a buffer and copying the file into it. Pages are read from disk (or
+// rather the OS file cache) the first time they're touched, and don't count as private memory
+// so the OS can just drop them again when it needs the memory.
+// The file can't be written to or deleted while it's mapped.
+
+typedef enum Os_File_Map_Flags {
+	OS_FILE_MAP_ACCESS_NORMAL     = 0,
+	OS_FILE_MAP_ACCESS_SEQUENTIAL = 1<<0, // Mostly read front to back, like by a decoder
+	OS_FILE_MAP_ACCESS_RANDOM     = 1<<1, // Read all over the place, so reading ahead is a waste
+	OS_FILE_MAP_PREFETCH          = 1<<2, // Start reading in the whole file right away
+} Os_File_Map_Flags;
+
+typedef struct Os_File_Map {
+	string data; // Read only!
+	void *os_handle;
+} Os_File_Map;
+
+// Returns false on fail. An empty file maps to an empty string.
+bool ogb_instance
+os_file_map_s(string path, Os_File_Map *map, Os_File_Map_Flags flags);
+
+void ogb_instance
+os_file_unmap(Os_File_Map *map);
+
 
 bool ogb_instance
 os_is_file_s(string path);
@@ -267,6 +438,118 @@ os_is_file_s(string path);
 bool ogb_instance
 os_is_directory_s(string path);
 
+///
+// Directory listing
+
+typedef struct Os_File_Info {
+	string path; // The path passed in joined with name. Only valid until the proc returns
+	string name;
+	bool is_directory;
+	u64 size; // 0 for directories
+	// Ticks of 100 nanoseconds since some point in the past. Only meaningful compared to
+	// other modification times, like one you stored last time you loaded the file.
+	u64 modification_time;
+} Os_File_Info;
+
+// Return false to stop iterating
+typedef bool(*Os_Directory_Iterate_Proc)(Os_File_Info *info, void *userdata);
+
+// Calls proc for every file & directory in path, except . and ..
+// With recursive it goes into subdirectories after calling proc for them (but doesn't follow
+// symbolic links). Order within a directory is up to the OS.
+// Returns false if path couldn't be listed.
+bool ogb_instance
+os_iterate_directory_s(string path, bool recursive, Os_Directory_Iterate_Proc proc, void *userdata);
+
+// Returns false if there is no file or directory at path
+bool ogb_instance
+os_get_file_info_s(string path, Os_File_Info *info);
+
+///
+// Directory watching
+// Collects changes to the files in a directory in the background, for you to poll, say once
+// a frame, so an asset cache can reload just the files that changed.
+//
+//     Os_Directory_Watch watch;
+//     os_watch_directory(STR("assets"), true, &watch);
+//     ...
+//     Os_File_Change *changes;
+//     u64 count = os_poll_directory_changes(&watch, &changes, get_temporary_allocator());
+//     for (u64 i = 0; i < count; i++) if (changes[i].kind == OS_FILE_CHANGE_MODIFIED) reload(changes[i].path);
+//
+// Renames come as a removal of the old name and an addition of the new name.
+// Saving a file usually modifies it several times; repeats of the same change to the same
+// path within a poll are dropped.
+// A file may not be done being written when you get a change for it.
+
+typedef enum Os_File_Change_Kind {
+	OS_FILE_CHANGE_ADDED,
+	OS_FILE_CHANGE_REMOVED,
+	OS_FILE_CHANGE_MODIFIED,
+	// Changes happened faster than they could be collected and some were lost, so anything in
+	// the directory may have changed. path is empty.
+	OS_FILE_CHANGE_OVERFLOW,
+} Os_File_Change_Kind;
+
+typedef struct Os_File_Change {
+	Os_File_Change_Kind kind;
+	string path; // Relative to the watched directory, with / as separator
+} Os_File_Change;
+
+typedef struct Os_Directory_Watch {
+	void *os_data;
+} Os_Directory_Watch;
+
+// Returns false if path couldn't be watched
+bool ogb_instance
+os_watch_directory_s(string path, bool recursive, Os_Directory_Watch *watch);
+
+// Doesn't block. Returns the number of changes since last poll, and the changes in one
+// allocation with the paths. Dealloc *changes if it's not 0.
+u64 ogb_instance
+os_poll_directory_changes(Os_Directory_Watch *watch, Os_File_Change **changes, Allocator allocator);
+
+void ogb_instance
+os_unwatch_directory(Os_Directory_Watch *watch);
+
+// For os implementations of os_poll_directory_changes.
+// changes[i].path.data is an offset into names rather than a pointer. Drops repeats and packs
+// changes & paths into one allocation.
+u64
+os_pack_directory_changes(Os_File_Change *changes, u64 count, u8 *names, Os_File_Change **result, Allocator allocator);
+
+// Chunked_String_Builder (string.c) output, here because it needs the file procedures
+#define CHUNKED_STRING_BUILDER_WRITE_BATCH 64
+
+// Writes the chunks as they are, CHUNKED_STRING_BUILDER_WRITE_BATCH at a time
+bool
+chunked_string_builder_write_to_file(Chunked_String_Builder *b, File f) {
+	string batch[CHUNKED_STRING_BUILDER_WRITE_BATCH];
+	u64 count = 0;
+	for (String_Chunk *c = b->first; c; c = c->next) {
+		if (c->count == 0) continue;
+		batch[count++] = (string){c->count, c->data};
+		if (count == CHUNKED_STRING_BUILDER_WRITE_BATCH) {
+			if (!os_file_write_strings(f, batch, count)) return false;
+			count = 0;
+		}
+	}
+	return count == 0 || os_file_write_strings(f, batch, count);
+}
+bool
+chunked_string_builder_write_entire_file_s(Chunked_String_Builder *b, string path) {
+	File f = os_file_open_s(path, O_WRITE | O_CREATE);
+	if (f == OS_INVALID_FILE) return false;
+	bool ok = chunked_string_builder_write_to_file(b, f);
+	os_file_close(f);
+	return ok;
+}
+inline bool chunked_string_builder_write_entire_file_f(Chunked_String_Builder *b, const char *path) {return chunked_string_builder_write_entire_file_s(b, STR(path));}
+#define chunked_string_builder_write_entire_file(...) _Generic((SECOND_ARG(__VA_ARGS__)), \
+                           string:  chunked_string_builder_write_entire_file_s, \
+                           default: chunked_string_builder_write_entire_file_f \
+                          )(__VA_ARGS__)
+
 
 bool ogb_instance
 os_is_path_absolute(string path);
@@ -302,6 +585,11 @@ inline bool os_file_copy_f(const char *from, const char *to, bool replace_if_exi
                            string:  os_file_copy_s, \
                            default: os_file_copy_f \
                           )(__VA_ARGS__)
+inline bool os_file_move_f(const char *from, const char *to, bool replace_if_exists) {return os_file_move_s(STR(from), STR(to), replace_if_exists);}
+#define os_file_move(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_file_move_s, \
+                           default: os_file_move_f \
+                          )(__VA_ARGS__)
                           
 inline bool os_make_directory_f(const char *path, bool recursive) { return os_make_directory_s(STR(path), recursive); }
 #define os_make_directory(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
@@ -326,6 +614,12 @@ inline bool os_read_entire_file_f(const char *path, string *result, Allocator al
                            default: os_read_entire_file_f \
                           )(__VA_ARGS__)
                           
+inline bool os_file_map_f(const char *path, Os_File_Map *map, Os_File_Map_Flags flags) {return os_file_map_s(STR(path), map, flags);}
+#define os_file_map(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_file_map_s, \
+                           default: os_file_map_f \
+                          )(__VA_ARGS__)
+                          
 inline bool os_is_file_f(const char *path) {return os_is_file_s(STR(path));}
 #define os_is_file(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
                            string:  os_is_file_s, \
@@ -338,6 +632,24 @@ inline bool os_is_directory_f(const char *path) {return os_is_directory_s(STR(pa
                            default: os_is_directory_f \
                           )(__VA_ARGS__)
                           
+inline bool os_iterate_directory_f(const char *path, bool recursive, Os_Directory_Iterate_Proc proc, void *userdata) {return os_iterate_directory_s(STR(path), recursive, proc, userdata);}
+#define os_iterate_directory(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_iterate_directory_s, \
+                           default: os_iterate_directory_f \
+                          )(__VA_ARGS__)
+                          
+inline bool os_get_file_info_f(const char *path, Os_File_Info *info) {return os_get_file_info_s(STR(path), info);}
+#define os_get_file_info(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_get_file_info_s, \
+                           default: os_get_file_info_f \
+                          )(__VA_ARGS__)
+                          
+inline bool os_watch_directory_f(const char *path, bool recursive, Os_Directory_Watch *watch) {return os_watch_directory_s(STR(path), recursive, watch);}
+#define os_watch_directory(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_watch_directory_s, \
+                           default: os_watch_directory_f \
+                          )(__VA_ARGS__)
+                          
                           
 
 void ogb_instance
@@ -376,6 +688,174 @@ void fprint_va_list_buffered(File f, const string fmt, va_list args) {
 	}
 }
 
+u64
+os_pack_directory_changes(Os_File_Change *changes, u64 count, u8 *names, Os_File_Change **result, Allocator allocator) {
+	*result = 0;
+	if (count == 0) return 0;
+
+	// Index+1 of the last kept change per path. Only drop a change if the last one kept for its
+	// path is the same kind, so added -> removed -> added doesn't turn into added -> removed.
+	u64 table_size = get_next_power_of_two(count*2);
+	u32 *table = alloc(get_heap_allocator(), table_size*sizeof(u32));
+	memset(table, 0, table_size*sizeof(u32));
+
+	bool *keep = alloc(get_heap_allocator(), count*sizeof(bool));
+	u64 kept_count = 0;
+	u64 kept_names_size = 0;
+
+	for (u64 i = 0; i < count; i++) {
+		string path = changes[i].path;
+		path.data = names + (u64)changes[i].path.data;
+
+		u64 slot = string_get_hash(path) & (table_size-1);
+		while (table[slot]) {
+			Os_File_Change *other = &changes[table[slot]-1];
+			string other_path = other->path;
+			other_path.data = names + (u64)other->path.data;
+			if (strings_match(path, other_path)) break;
+			slot = (slot+1) & (table_size-1);
+		}
+
+		keep[i] = !table[slot] || changes[table[slot]-1].kind != changes[i].kind;
+		if (keep[i]) {
+			table[slot] = (u32)i+1;
+			kept_count += 1;
+			kept_names_size += path.count;
+		}
+	}
+
+	Os_File_Change *packed = alloc(allocator, kept_count*sizeof(Os_File_Change) + kept_names_size);
+	u8 *packed_names = (u8*)(packed + kept_count);
+
+	u64 next = 0;
+	for (u64 i = 0; i < count; i++) {
+		if (!keep[i]) continue;
+		packed[next].kind = changes[i].kind;
+		packed[next].path.count = changes[i].path.count;
+		packed[next].path.data = packed_names;
+		memcpy(packed_names, names + (u64)changes[i].path.data, changes[i].path.count);
+		packed_names += changes[i].path.count;
+		next += 1;
+	}
+
+	dealloc(get_heap_allocator(), table);
+	dealloc(get_heap_allocator(), keep);
+
+	*result = packed;
+	return kept_count;
+}
+
+
+///
+///
+// Sockets
+///
+// Non-blocking UDP & TCP over IPv4. Nothing here blocks except os_socket_poll, so sockets can
+// be serviced once a frame from the game loop, or a network thread can sleep in
+// os_socket_poll until one of its sockets is ready.
+//
+//     Socket s = os_socket_open_udp(socket_address(0, 0, 0, 0, 27015));
+//     ...
+//     Socket_Datagram received[64];
+//     u64 count = os_socket_receive_datagrams(s, received, 64, buffer, buffer_size);
+//     for (u64 i = 0; i < count; i++) handle_packet(received[i].address, received[i].data);
+//
+// Datagrams are received straight into the buffer you pass, back to back, so their data
+// points into memory you own (like a per-frame arena) and nothing is copied or allocated.
+
+#ifndef SOCKET_MAX_DATAGRAM_SIZE
+	// Bigger datagrams are dropped when received. Anything over the ~1500 bytes of an ethernet
+	// frame is fragmented on most networks anyway, and one lost fragment loses the datagram.
+	#define SOCKET_MAX_DATAGRAM_SIZE 1500
+#endif
+
+typedef u64 Socket;
+#define OS_INVALID_SOCKET ((Socket)-1)
+
+typedef struct Socket_Address {
+	u32 ip;   // Host byte order, 127.0.0.1 is 0x7F000001. 0 binds to all interfaces.
+	u16 port; // 0 binds to any free port, see os_socket_get_address
+} Socket_Address;
+
+inline Socket_Address
+socket_address(u8 a, u8 b, u8 c, u8 d, u16 port) {
+	return (Socket_Address){ ((u32)a << 24) | ((u32)b << 16) | ((u32)c << 8) | (u32)d, port };
+}
+inline Socket_Address
+socket_address_loopback(u16 port) {
+	return socket_address(127, 0, 0, 1, port);
+}
+inline bool
+socket_addresses_match(Socket_Address a, Socket_Address b) {
+	return a.ip == b.ip && a.port == b.port;
+}
+
+typedef struct Socket_Datagram {
+	Socket_Address address; // Where it came from, or where to send it
+	string data;
+} Socket_Datagram;
+
+typedef enum Socket_Events {
+	SOCKET_EVENT_READ  = 1<<0, // Something to receive or accept, or the other side closed
+	SOCKET_EVENT_WRITE = 1<<1, // Room to send, or a connect finished
+	SOCKET_EVENT_ERROR = 1<<2, // Always reported, doesn't need to be waited for. Failed connect or reset connection.
+} Socket_Events;
+
+typedef struct Socket_Poll {
+	Socket socket;
+	Socket_Events wait_for;
+	Socket_Events events; // Set by os_socket_poll
+} Socket_Poll;
+
+// UDP socket bound to address. Returns OS_INVALID_SOCKET on fail.
+Socket ogb_instance
+os_socket_open_udp(Socket_Address address);
+
+// TCP socket accepting connections on address. Returns OS_INVALID_SOCKET on fail.
+Socket ogb_instance
+os_socket_listen(Socket_Address address);
+
+// Returns OS_INVALID_SOCKET if there is no connection waiting. remote may be 0.
+Socket ogb_instance
+os_socket_accept(Socket listener, Socket_Address *remote);
+
+// Starts connecting and returns right away. The socket gets SOCKET_EVENT_WRITE when it's
+// connected, or SOCKET_EVENT_ERROR if it couldn't connect. Sending before then would block.
+// Returns OS_INVALID_SOCKET on fail.
+Socket ogb_instance
+os_socket_connect(Socket_Address address);
+
+void ogb_instance
+os_socket_close(Socket s);
+
+// The address the socket is bound to, to find out which port it got when binding to port 0
+bool ogb_instance
+os_socket_get_address(Socket s, Socket_Address *address);
+
+// TCP. Returns the number of bytes sent, which may be less than size, 0 if it would block, and
+// -1 if the connection is closed or broken.
+s64 ogb_instance
+os_socket_send(Socket s, void *data, u64 size);
+
+// TCP. Returns the number of bytes received, 0 if there's nothing to receive, and -1 if the
+// connection is closed or broken.
+s64 ogb_instance
+os_socket_receive(Socket s, void *buffer, u64 size);
+
+// UDP. Sends datagrams in order until one would block or fails, and returns how many were sent.
+u64 ogb_instance
+os_socket_send_datagrams(Socket s, Socket_Datagram *datagrams, u64 count);
+
+// UDP. Receives up to max_count waiting datagrams into buffer and returns how many. Stops early
+// if the rest of the buffer is smaller than SOCKET_MAX_DATAGRAM_SIZE.
+u64 ogb_instance
+os_socket_receive_datagrams(Socket s, Socket_Datagram *datagrams, u64 max_count, void *buffer, u64 buffer_size);
+
+// Waits until any of the sockets have any of the events they wait for, or timeout_ms has
+// passed. 0 doesn't wait, -1 waits forever. Returns how many sockets have events.
+u64 ogb_instance
+os_socket_poll(Socket_Poll *polls, u64 count, s64 timeout_ms);
+
 
 ///
 ///
@@ -389,6 +869,52 @@ os_get_stack_limit();
 ogb_instance u64
 os_get_number_of_logical_processors();
 
+// The logical processor the calling thread is running on right now
+ogb_instance u64
+os_get_current_processor();
+
+///
+// CPU topology
+// So threads can be placed on separate physical cores instead of fighting over the SMT
+// siblings of one, and threads that share data on cores that share a cache.
+//
+//     Os_Cpu_Topology topology;
+//     os_get_cpu_topology(&topology);
+//     // One worker per physical core, each on the first logical processor of its core
+//     for (u64 i = 0; i < topology.core_count; i++) {
+//         workers[i].affinity_mask = topology.cores[i].logical_processor_mask & -topology.cores[i].logical_processor_mask;
+//     }
+//
+// Masks only cover the first 64 logical processors, like os_thread_set_affinity.
+
+#define OS_MAX_CPU_CORES 64
+#define OS_MAX_CPU_CACHES 128
+
+typedef struct Os_Cpu_Core {
+	u64 logical_processor_mask; // More than one bit means SMT (hyperthreading)
+	// Higher is faster. On CPUs with performance & efficiency cores, the efficiency cores have
+	// the lowest class. 0 for all cores when they're all the same.
+	u8 efficiency_class;
+} Os_Cpu_Core;
+
+typedef struct Os_Cpu_Cache {
+	u32 level; // 1 = L1 and so on
+	u64 size;
+	u64 line_size;
+	u64 logical_processor_mask; // The logical processors sharing this cache
+} Os_Cpu_Cache;
+
+typedef struct Os_Cpu_Topology {
+	u64 logical_processor_count;
+	u64 core_count;
+	Os_Cpu_Core cores[OS_MAX_CPU_CORES];
+	u64 cache_count;
+	Os_Cpu_Cache caches[OS_MAX_CPU_CACHES]; // Data & unified caches, instruction caches are left out
+} Os_Cpu_Topology;
+
+ogb_instance bool
+os_get_cpu_topology(Os_Cpu_Topology *topology);
+
 
 ///
 ///
@@ -408,6 +934,26 @@ dump_stack_trace() {
 	}
 }
 
+///
+// Stack sampling (see sampling_profiler.c)
+
+// Writes the ids of the threads in this process to thread_ids and returns how many there are,
+// which may be more than max_count.
+ogb_instance u64
+os_get_process_thread_ids(u64 *thread_ids, u64 max_count);
+
+// Suspends the thread, writes up to max_frames instruction addresses of its stack (innermost
+// first) and resumes it. Returns the number of frames written, 0 if the thread could not be
+// sampled (exited, or it is the calling thread).
+// The thread can be stopped while holding any lock, so this does not allocate or take locks.
+ogb_instance u64
+os_sample_thread_stack(u64 thread_id, u64 *frames, u64 max_frames);
+
+// Name of the function containing address, or an empty string if there is no symbol for it.
+// Not thread safe.
+ogb_instance string
+os_get_symbol_name(u64 address, Allocator allocator);
+
 
 ///
 ///
@@ -0,0 +1,306 @@
+
+/*
+
+	Live profiler overlay.
+
+	Shows a frame time graph of the last PROFILER_OVERLAY_FRAME_HISTORY frames and a timeline
+	of all tm_scope's, on all threads, that overlapped the last frame. Nested scopes are stacked
+	beneath their parent, so it reads like a flame graph per thread.
+
+	Opt-in:
+
+		profiler_overlay.enabled = true;
+
+	Then toggle it with profiler_overlay.toggle_key (F3 by default) and freeze the timeline
+	with profiler_overlay.pause_key (F4 by default).
+	With freeze_on_spike the timeline freezes by itself on the first frame that takes longer
+	than spike_threshold_ms (or twice the average frame time if spike_threshold_ms is 0), so
+	you can see what happened in that frame. Press the pause key to resume.
+
+	The overlay is drawn at the start of gfx_update(), so the timeline shows the time from the
+	last gfx_update() to this one.
+	The frame graph works without ENABLE_PROFILING, but the timeline needs it.
+
+	If profiler_overlay.font isn't set, the overlay loads profiler_overlay.font_path the first
+	time it's shown, or PROFILER_OVERLAY_DEFAULT_FONT_PATH if font_path is empty.
+
+*/
+
+#ifndef PROFILER_OVERLAY_DEFAULT_FONT_PATH
+	// #Portability
+	#define PROFILER_OVERLAY_DEFAULT_FONT_PATH "C:/windows/fonts/consola.ttf"
+#endif
+
+#define PROFILER_OVERLAY_FRAME_HISTORY 240
+#define PROFILER_OVERLAY_MAX_RECORDS 8192
+#define PROFILER_OVERLAY_MAX_DEPTH 16
+
+typedef struct Profiler_Overlay {
+	bool enabled;
+	bool visible;
+	bool paused;
+	bool freeze_on_spike;
+	Input_Key_Code toggle_key;
+	Input_Key_Code pause_key;
+
+	Gfx_Font *font;
+	string font_path;
+	u32 font_height;
+
+	// 0 means twice the average frame time
+	f64 spike_threshold_ms;
+
+	// Frame time history, ring buffer
+	f32 frame_times_ms[PROFILER_OVERLAY_FRAME_HISTORY];
+	u64 frame_count;
+	u64 last_frame_start;
+
+	// The frame shown in the timeline
+	Profile_Record *records;
+	u64 record_count;
+	u64 frame_start;
+	u64 frame_end;
+	f32 frame_time_ms;
+	bool is_spike;
+
+	bool font_load_failed;
+
+} Profiler_Overlay;
+
+// #Global
+ogb_instance Profiler_Overlay profiler_overlay;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Profiler_Overlay profiler_overlay = {
+	.freeze_on_spike = true,
+	.toggle_key = KEY_F3,
+	.pause_key = KEY_F4,
+	.font_height = 14,
+};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+Vector4
+_profiler_overlay_color_for_name(const char *name) {
+	u64 h = string_get_hash(STR(name));
+	f32 r = 0.35f + 0.5f*(f32)((h >>  0) & 0xff)/255.0f;
+	f32 g = 0.35f + 0.5f*(f32)((h >>  8) & 0xff)/255.0f;
+	f32 b = 0.35f + 0.5f*(f32)((h >> 16) & 0xff)/255.0f;
+	return v4(r, g, b, 1.0);
+}
+
+void
+_profiler_overlay_text(string text, Vector2 pos, Vector4 color) {
+	if (!profiler_overlay.font) return;
+	draw_text(profiler_overlay.font, text, profiler_overlay.font_height, pos, v2(1, 1), color);
+}
+
+// Returns the y below the graph
+f32
+_profiler_overlay_draw_frame_graph(f32 x, f32 top, f32 width, f32 height) {
+	Profiler_Overlay *o = &profiler_overlay;
+
+	u64 count = min(o->frame_count, PROFILER_OVERLAY_FRAME_HISTORY);
+	f32 max_ms = 33.4f;
+	f64 sum_ms = 0;
+	for (u64 i = 0; i < count; i++) {
+		max_ms = max(max_ms, o->frame_times_ms[i]);
+		sum_ms += o->frame_times_ms[i];
+	}
+	f64 avg_ms = count ? sum_ms/(f64)count : 0;
+	max_ms *= 1.1f;
+
+	f32 bottom = top-height;
+	draw_rect(v2(x, bottom), v2(width, height), v4(0, 0, 0, 0.6));
+
+	f32 bar_width = width/(f32)PROFILER_OVERLAY_FRAME_HISTORY;
+	for (u64 i = 0; i < count; i++) {
+		// Oldest to the left
+		u64 frame = o->frame_count-count+i;
+		f32 ms = o->frame_times_ms[frame % PROFILER_OVERLAY_FRAME_HISTORY];
+
+		Vector4 color = v4(0.3, 0.9, 0.3, 1.0);
+		if      (ms > 33.4f) color = v4(0.95, 0.25, 0.25, 1.0);
+		else if (ms > 16.7f) color = v4(0.95, 0.85, 0.25, 1.0);
+
+		f32 bar_height = height*(ms/max_ms);
+		draw_rect(v2(x+bar_width*(f32)(i+PROFILER_OVERLAY_FRAME_HISTORY-count), bottom), v2(max(bar_width-1, 1), bar_height), color);
+	}
+
+	// 60 & 30 fps lines
+	draw_rect(v2(x, bottom+height*(16.667f/max_ms)), v2(width, 1), v4(1, 1, 1, 0.35));
+	draw_rect(v2(x, bottom+height*(33.333f/max_ms)), v2(width, 1), v4(1, 1, 1, 0.35));
+
+	f32 last_ms = count ? o->frame_times_ms[(o->frame_count-1) % PROFILER_OVERLAY_FRAME_HISTORY] : 0;
+	string header = tprint("Frame %.2f ms   avg %.2f ms   max %.2f ms", (f64)last_ms, avg_ms, (f64)(max_ms/1.1f));
+	_profiler_overlay_text(header, v2(x+4, top-(f32)o->font_height-2), COLOR_WHITE);
+
+	return bottom;
+}
+
+void
+_profiler_overlay_draw_timeline(f32 x, f32 top, f32 width) {
+	Profiler_Overlay *o = &profiler_overlay;
+
+	const f32 row_height = (f32)o->font_height+4;
+	const f32 label_width = 110;
+
+	f32 y = top;
+
+	string title;
+#if ENABLE_PROFILING
+	if (o->is_spike)    title = tprint("Spike frame %.2f ms, %llu scopes (pause key to resume)", (f64)o->frame_time_ms, o->record_count);
+	else if (o->paused) title = tprint("Paused frame %.2f ms, %llu scopes", (f64)o->frame_time_ms, o->record_count);
+	else                title = tprint("Last frame %.2f ms, %llu scopes", (f64)o->frame_time_ms, o->record_count);
+#else
+	title = STR("Timeline needs ENABLE_PROFILING");
+#endif
+	draw_rect(v2(x, y-row_height), v2(width, row_height), v4(0, 0, 0, 0.6));
+	_profiler_overlay_text(title, v2(x+4, y-row_height+3), o->is_spike ? v4(1, 0.4, 0.4, 1) : COLOR_WHITE);
+	y -= row_height;
+
+	if (o->record_count == 0 || o->frame_end <= o->frame_start) return;
+
+	f32 track_x = x+label_width;
+	f32 track_width = width-label_width;
+	f64 px_per_tick = (f64)track_width/(f64)(o->frame_end-o->frame_start);
+
+	u64 stack_ends[PROFILER_OVERLAY_MAX_DEPTH];
+
+	// Records are sorted by thread, so each run of the same thread_id is one lane
+	u64 lane_first = 0;
+	while (lane_first < o->record_count) {
+		u64 thread_id = o->records[lane_first].thread_id;
+		u64 lane_last = lane_first;
+		while (lane_last < o->record_count && o->records[lane_last].thread_id == thread_id) lane_last += 1;
+
+		// First pass for lane depth so we know how tall it is
+		u64 depth_count = 0;
+		u64 lane_depth = 1;
+		for (u64 i = lane_first; i < lane_last; i++) {
+			Profile_Record *r = &o->records[i];
+			while (depth_count > 0 && stack_ends[depth_count-1] <= r->start) depth_count -= 1;
+			if (depth_count < PROFILER_OVERLAY_MAX_DEPTH) stack_ends[depth_count++] = r->end;
+			lane_depth = max(lane_depth, depth_count);
+		}
+
+		f32 lane_height = row_height*(f32)lane_depth;
+		draw_rect(v2(x, y-lane_height), v2(width, lane_height), v4(0.05, 0.05, 0.05, 0.75));
+		string lane_name = thread_id == context.thread_id ? STR("Main thread") : tprint("Thread %llu", thread_id);
+		_profiler_overlay_text(lane_name, v2(x+4, y-row_height+3), COLOR_WHITE);
+
+		depth_count = 0;
+		for (u64 i = lane_first; i < lane_last; i++) {
+			Profile_Record *r = &o->records[i];
+			while (depth_count > 0 && stack_ends[depth_count-1] <= r->start) depth_count -= 1;
+			if (depth_count >= PROFILER_OVERLAY_MAX_DEPTH) continue;
+			u64 depth = depth_count;
+			stack_ends[depth_count++] = r->end;
+
+			u64 start = max(r->start, o->frame_start);
+			u64 end   = min(r->end, o->frame_end);
+			if (end < start) continue;
+
+			f32 x0 = track_x + (f32)((f64)(start-o->frame_start)*px_per_tick);
+			f32 w  = max((f32)((f64)(end-start)*px_per_tick), 1.0f);
+			f32 y0 = y-row_height*(f32)(depth+1);
+
+			draw_rect(v2(x0, y0+1), v2(w, row_height-2), _profiler_overlay_color_for_name(r->name));
+
+			if (w > 40 && o->font) {
+				f64 ms = (f64)(r->end-r->start)*1000.0/(f64)os_get_tsc_frequency();
+				push_window_scissor(v2(x0, y0), v2(x0+w, y0+row_height));
+				_profiler_overlay_text(tprint("%cs %.2fms", r->name, ms), v2(x0+2, y0+3), COLOR_BLACK);
+				pop_window_scissor();
+			}
+		}
+
+		y -= lane_height+2;
+		lane_first = lane_last;
+	}
+}
+
+void
+profiler_overlay_update_and_draw() {
+	Profiler_Overlay *o = &profiler_overlay;
+	if (!o->enabled) return;
+
+	u64 now = rdtsc();
+
+	if (is_key_just_pressed(o->toggle_key)) o->visible = !o->visible;
+	if (is_key_just_pressed(o->pause_key)) {
+		o->paused = !o->paused;
+		if (!o->paused) o->is_spike = false;
+	}
+
+	if (o->last_frame_start == 0) {
+		o->last_frame_start = now;
+		return;
+	}
+
+	u64 frame_start = o->last_frame_start;
+	o->last_frame_start = now;
+
+	f32 frame_ms = (f32)((f64)(now-frame_start)*1000.0/(f64)os_get_tsc_frequency());
+
+	u64 history_count = min(o->frame_count, PROFILER_OVERLAY_FRAME_HISTORY);
+	f64 sum_ms = 0;
+	for (u64 i = 0; i < history_count; i++) sum_ms += o->frame_times_ms[i];
+	f64 threshold_ms = o->spike_threshold_ms;
+	if (threshold_ms <= 0) threshold_ms = history_count >= 30 ? 2.0*sum_ms/(f64)history_count : F32_MAX;
+	bool is_spike = (f64)frame_ms > threshold_ms;
+
+	o->frame_times_ms[o->frame_count % PROFILER_OVERLAY_FRAME_HISTORY] = frame_ms;
+	o->frame_count += 1;
+
+#if ENABLE_PROFILING
+	if (!o->records) {
+		profiler_enable_recent_records();
+		o->records = (Profile_Record*)alloc(get_heap_allocator(), sizeof(Profile_Record)*PROFILER_OVERLAY_MAX_RECORDS*2);
+	}
+
+	if (!o->paused) {
+		o->record_count = profiler_copy_recent_records(frame_start, now, o->records, PROFILER_OVERLAY_MAX_RECORDS);
+		merge_sort(o->records, o->records+PROFILER_OVERLAY_MAX_RECORDS, o->record_count, sizeof(Profile_Record), _profile_record_compare_thread_then_start);
+		o->frame_start = frame_start;
+		o->frame_end = now;
+		o->frame_time_ms = frame_ms;
+
+		if (is_spike && o->freeze_on_spike) {
+			o->paused = true;
+			o->is_spike = true;
+			log_info("Profiler overlay: frame spike of %.2f ms, freezing timeline", (f64)frame_ms);
+		}
+	}
+#else
+	(void)is_spike;
+#endif
+
+	if (!o->visible) return;
+
+	if (!o->font && !o->font_load_failed) {
+		string path = o->font_path.count ? o->font_path : STR(PROFILER_OVERLAY_DEFAULT_FONT_PATH);
+		o->font = load_font_from_disk(path, get_heap_allocator());
+		if (!o->font) {
+			o->font_load_failed = true;
+			log_error("Profiler overlay could not load font '%s', set profiler_overlay.font or profiler_overlay.font_path to get text", path);
+		}
+	}
+
+	// Draw in window pixels on top of everything, then restore whatever the game was using
+	Matrix4 projection = draw_frame.projection;
+	Matrix4 view = draw_frame.view;
+	draw_frame.projection = m4_make_orthographic_projection(0, (f32)window.pixel_width, 0, (f32)window.pixel_height, -1, 10);
+	draw_frame.view = m4_scalar(1.0);
+	push_z_layer(MAX_Z);
+
+	f32 margin = 10;
+	f32 width = (f32)window.pixel_width-margin*2;
+	f32 top = (f32)window.pixel_height-margin;
+
+	f32 y = _profiler_overlay_draw_frame_graph(margin, top, width, 90);
+	_profiler_overlay_draw_timeline(margin, y-4, width);
+
+	pop_z_layer();
+	draw_frame.projection = projection;
+	draw_frame.view = view;
+}
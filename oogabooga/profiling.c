@@ -1,48 +1,828 @@
+///
+// Records are written to a per-thread ring buffer of fixed size binary records, so a scope
+// costs two rdtsc's and a couple of stores. No locks, no formatting.
+// A background thread drains the rings every few ms into one big array of records, and at
+// exit dump_profile_result() drains the rest and writes:
+//     google_trace_time.json   - google trace in microseconds, converted with the calibrated TSC frequency
+//     google_trace_cycles.json - google trace in raw rdtsc cycles
+//     profile_stats.txt        - count, min, mean, p99, max & total per scope name
+//     allocation_report.txt    - top allocating scopes per frame (ENABLE_ALLOCATION_TRACING)
+// If a thread produces records faster than they are drained, new records are dropped and
+// counted in Profiler_Thread_Buffer.dropped_count.
+// When a thread exits, its buffer is handed to the next thread that records something once
+// the flusher has drained it.
+// The drained records are capped at profiler_max_records (PROFILER_MAX_RECORDS by default) so a
+// long session doesn't eat all memory. Past that, records still reach the recent records ring
+// below, but are dropped from the dump and counted in _profile_dropped_record_count. Events are
+// capped the same way by profiler_max_events.
+//
+// profiler_enable_recent_records() additionally keeps the last PROFILER_RECENT_RECORDS_CAPACITY
+// drained records in a ring, which can be queried by time with profiler_copy_recent_records().
+// This is what the profiler overlay uses to show live timings.
+//
+// With ENABLE_ALLOCATION_TRACING, heap allocations & deallocations, temporary storage overflows
+// and program memory growth are recorded as Profile_Event's in a second per-thread ring, along
+// with a frame marker from metrics_frame_end(). These go into the traces as instant events and a
+// "Heap bytes in use" counter, and allocation_report.txt lists the top allocating scopes per frame.
+// An allocation is attributed to the innermost scope that was open on its thread.
+//
+// The name passed to tm_scope is stored as a pointer, so it needs to be a string literal (or
+// otherwise live until the profile is dumped).
 
+#define PROFILER_THREAD_BUFFER_CAPACITY (1 << 16) // Must be power of two
+#define PROFILER_FLUSH_INTERVAL_MS 5
+#define PROFILER_RECENT_RECORDS_CAPACITY (1 << 14) // Must be power of two
+#define PROFILER_THREAD_EVENT_CAPACITY (1 << 14) // Must be power of two
+#define PROFILER_MAX_RECORDS (1 << 22) // 128mb of Profile_Record's
+#define PROFILER_MAX_EVENTS (1 << 21)  // 80mb of Profile_Event_Record's
+
+typedef struct Profile_Scope_Record {
+	const char *name;
+	u64 start;
+	u64 end;
+} Profile_Scope_Record;
+
+typedef struct Profile_Record {
+	const char *name;
+	u64 start;
+	u64 end;
+	u64 thread_id;
+} Profile_Record;
+
+typedef enum Profile_Event_Kind {
+	PROFILE_EVENT_HEAP_ALLOC,
+	PROFILE_EVENT_HEAP_DEALLOC,
+	PROFILE_EVENT_TEMPORARY_STORAGE_OVERFLOW,
+	PROFILE_EVENT_PROGRAM_MEMORY_GROW,
+	PROFILE_EVENT_FRAME,
+} Profile_Event_Kind;
+
+#define PROFILE_EVENT_KIND_SHIFT 56
+#define PROFILE_EVENT_SIZE_MASK ((1ull << PROFILE_EVENT_KIND_SHIFT)-1)
+
+typedef struct Profile_Event {
+	u64 tsc;
+	u64 address;
+	// Return address of the alloc()/dealloc() call
+	u64 call_site;
+	// Profile_Event_Kind in the top 8 bits
+	u64 size_and_kind;
+} Profile_Event;
+
+typedef struct Profile_Event_Record {
+	Profile_Event event;
+	u64 thread_id;
+} Profile_Event_Record;
+
+typedef enum Profiler_Thread_Buffer_State {
+	PROFILER_THREAD_BUFFER_OWNED = 0,
+	PROFILER_THREAD_BUFFER_ABANDONED, // The thread exited, free it when it's drained
+	PROFILER_THREAD_BUFFER_FREE,      // Drained, can be claimed by another thread
+} Profiler_Thread_Buffer_State;
+
+typedef struct Profiler_Thread_Buffer {
+	// Written by owning thread
+	alignat(CACHE_LINE_SIZE) volatile u64 write_index;
+	u64 cached_read_index;
+	u64 dropped_count;
+	volatile u64 event_write_index;
+	u64 cached_event_read_index;
+	u64 dropped_event_count;
+
+	// Written by flusher
+	alignat(CACHE_LINE_SIZE) volatile u64 read_index;
+	volatile u64 event_read_index;
+
+	alignat(CACHE_LINE_SIZE) Profile_Scope_Record *records;
+	Profile_Event *events; // Only with ENABLE_ALLOCATION_TRACING
+	u64 thread_id;
+	volatile u32 state; // Profiler_Thread_Buffer_State
+	struct Profiler_Thread_Buffer *next;
+} Profiler_Thread_Buffer;
 
 // #Global
-ogb_instance String_Builder _profile_output;
 ogb_instance bool profiler_initted;
-ogb_instance Spinlock _profiler_lock;
+ogb_instance Profiler_Thread_Buffer *volatile _profiler_thread_buffers;
+ogb_instance Profile_Record *_profile_records;
+ogb_instance u64 _profile_record_count;
+ogb_instance u64 _profile_record_capacity;
+ogb_instance u64 _profile_dropped_record_count;
+ogb_instance u64 profiler_max_records;
+ogb_instance Spinlock _profiler_flush_lock;
+ogb_instance Thread _profiler_flush_thread;
+ogb_instance volatile bool _profiler_flush_thread_should_stop;
+ogb_instance Profile_Record *_profiler_recent_records;
+ogb_instance u64 _profiler_recent_record_count;
+ogb_instance Profile_Event_Record *_profile_events;
+ogb_instance u64 _profile_event_count;
+ogb_instance u64 _profile_event_capacity;
+ogb_instance u64 _profile_dropped_event_count;
+ogb_instance u64 profiler_max_events;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-String_Builder _profile_output = {0};
 bool profiler_initted = false;
-Spinlock _profiler_lock;
+Profiler_Thread_Buffer *volatile _profiler_thread_buffers = 0;
+Profile_Record *_profile_records = 0;
+u64 _profile_record_count = 0;
+u64 _profile_record_capacity = 0;
+u64 _profile_dropped_record_count = 0;
+u64 profiler_max_records = PROFILER_MAX_RECORDS;
+Spinlock _profiler_flush_lock = {0};
+Thread _profiler_flush_thread;
+volatile bool _profiler_flush_thread_should_stop = false;
+Profile_Record *_profiler_recent_records = 0;
+u64 _profiler_recent_record_count = 0;
+Profile_Event_Record *_profile_events = 0;
+u64 _profile_event_count = 0;
+u64 _profile_event_capacity = 0;
+u64 _profile_dropped_event_count = 0;
+u64 profiler_max_events = PROFILER_MAX_EVENTS;
 #endif
 
-void dump_profile_result() {
-	File file = os_file_open("google_trace.json", O_CREATE | O_WRITE);
+thread_local Profiler_Thread_Buffer *_profiler_thread_buffer = 0;
+// Allocations made for the thread buffer itself can't be traced into it
+thread_local bool _profiler_making_thread_buffer = false;
+
+void
+_profiler_thread_buffer_init(Profiler_Thread_Buffer *b) {
+	memset(b, 0, sizeof(*b));
+	b->records = (Profile_Scope_Record*)alloc(get_heap_allocator(), sizeof(Profile_Scope_Record)*PROFILER_THREAD_BUFFER_CAPACITY);
+#if ENABLE_ALLOCATION_TRACING
+	b->events = (Profile_Event*)alloc(get_heap_allocator(), sizeof(Profile_Event)*PROFILER_THREAD_EVENT_CAPACITY);
+#endif
+	b->thread_id = context.thread_id;
+}
+
+Profiler_Thread_Buffer *
+_profiler_make_thread_buffer() {
+	// Buffers are never removed from the list, so this doesn't race with the flusher
+	for (Profiler_Thread_Buffer *b = _profiler_thread_buffers; b; b = b->next) {
+		if (!compare_and_swap_32(&b->state, PROFILER_THREAD_BUFFER_OWNED, PROFILER_THREAD_BUFFER_FREE)) continue;
+		
+		// The indices just carry on from the previous owner
+		b->thread_id = context.thread_id;
+		_profiler_thread_buffer = b;
+		return b;
+	}
+
+	_profiler_making_thread_buffer = true;
+	Profiler_Thread_Buffer *b = (Profiler_Thread_Buffer*)alloc(get_heap_allocator(), sizeof(Profiler_Thread_Buffer));
+	_profiler_thread_buffer_init(b);
+	_profiler_making_thread_buffer = false;
+
+	// Push to the list of all thread buffers so the flusher can find it
+	while (true) {
+		Profiler_Thread_Buffer *head = _profiler_thread_buffers;
+		b->next = head;
+		if (compare_and_swap_64((volatile u64*)&_profiler_thread_buffers, (u64)b, (u64)head)) break;
+	}
+
+	_profiler_thread_buffer = b;
+	return b;
+}
+
+inline void
+_profiler_record(const char *name, u64 start, u64 end) {
+	Profiler_Thread_Buffer *b = _profiler_thread_buffer;
+	if (!b) b = _profiler_make_thread_buffer();
+
+	u64 write_index = b->write_index;
+	if (write_index - b->cached_read_index >= PROFILER_THREAD_BUFFER_CAPACITY) {
+		b->cached_read_index = atomic_load_64(&b->read_index, MEMORY_ORDER_ACQUIRE);
+		if (write_index - b->cached_read_index >= PROFILER_THREAD_BUFFER_CAPACITY) {
+			b->dropped_count += 1;
+			return;
+		}
+	}
+
+	Profile_Scope_Record *r = &b->records[write_index & (PROFILER_THREAD_BUFFER_CAPACITY-1)];
+	r->name = name;
+	r->start = start;
+	r->end = end;
+
+	atomic_store_64(&b->write_index, write_index+1, MEMORY_ORDER_RELEASE);
+}
+
+// Program memory grows can happen with the heap lock held, so those must not make a thread
+// buffer (which allocates). They are dropped on threads that haven't traced anything yet.
+void
+_profiler_record_event(Profile_Event_Kind kind, void *address, u64 size, void *call_site) {
+	if (_profiler_making_thread_buffer) return;
+	Profiler_Thread_Buffer *b = _profiler_thread_buffer;
+	if (!b) {
+		if (kind == PROFILE_EVENT_PROGRAM_MEMORY_GROW) return;
+		b = _profiler_make_thread_buffer();
+	}
+	if (!b->events) return;
+
+	u64 write_index = b->event_write_index;
+	if (write_index - b->cached_event_read_index >= PROFILER_THREAD_EVENT_CAPACITY) {
+		b->cached_event_read_index = atomic_load_64(&b->event_read_index, MEMORY_ORDER_ACQUIRE);
+		if (write_index - b->cached_event_read_index >= PROFILER_THREAD_EVENT_CAPACITY) {
+			b->dropped_event_count += 1;
+			return;
+		}
+	}
+
+	Profile_Event *e = &b->events[write_index & (PROFILER_THREAD_EVENT_CAPACITY-1)];
+	e->tsc = rdtsc();
+	e->address = (u64)address;
+	e->call_site = (u64)call_site;
+	e->size_and_kind = (size & PROFILE_EVENT_SIZE_MASK) | ((u64)kind << PROFILE_EVENT_KIND_SHIFT);
+
+	atomic_store_64(&b->event_write_index, write_index+1, MEMORY_ORDER_RELEASE);
+}
+
+// Call when a thread that was profiled is about to exit, so its buffer can be reused by another
+// thread. Threads started with os_thread_start do this by themselves.
+void
+profiler_release_thread() {
+	Profiler_Thread_Buffer *b = _profiler_thread_buffer;
+	if (!b) return;
+	_profiler_thread_buffer = 0;
+	atomic_store_32(&b->state, PROFILER_THREAD_BUFFER_ABANDONED, MEMORY_ORDER_RELEASE);
+}
+
+#if ENABLE_ALLOCATION_TRACING
+	#define trace_allocation_event(kind, address, size) _profiler_record_event(kind, address, size, _alloc_call_site)
+	#define profiler_mark_frame() _profiler_record_event(PROFILE_EVENT_FRAME, 0, 0, 0)
+#else
+	#define trace_allocation_event(...)
+	#define profiler_mark_frame()
+#endif
+
+// Moves everything currently in the thread rings to _profile_records & _profile_events, up to
+// profiler_max_records & profiler_max_events
+void
+_profiler_drain_thread_buffers() {
+	spinlock_acquire_or_wait(&_profiler_flush_lock);
+
+	Profiler_Thread_Buffer *b = _profiler_thread_buffers;
+	while (b) {
+		// Loaded before the write indices, so if it's abandoned we drain everything it recorded
+		u32 state = atomic_load_32(&b->state, MEMORY_ORDER_ACQUIRE);
+		
+		u64 read_index = b->read_index;
+		u64 write_index = atomic_load_64(&b->write_index, MEMORY_ORDER_ACQUIRE);
+		u64 count = write_index - read_index;
+
+		if (count > 0) {
+			u64 keep_count = _profile_record_count < profiler_max_records ? min(count, profiler_max_records-_profile_record_count) : 0;
+			if (_profile_record_count + keep_count > _profile_record_capacity) {
+				u64 new_capacity = min(max(get_next_power_of_two(_profile_record_count + keep_count), 1024*64), profiler_max_records);
+				Profile_Record *new_records = (Profile_Record*)alloc(get_heap_allocator(), sizeof(Profile_Record)*new_capacity);
+				if (_profile_records) {
+					memcpy(new_records, _profile_records, sizeof(Profile_Record)*_profile_record_count);
+					dealloc(get_heap_allocator(), _profile_records);
+				}
+				_profile_records = new_records;
+				_profile_record_capacity = new_capacity;
+			}
+
+			for (u64 i = read_index; i < write_index; i++) {
+				Profile_Scope_Record *src = &b->records[i & (PROFILER_THREAD_BUFFER_CAPACITY-1)];
+				Profile_Record r = { src->name, src->start, src->end, b->thread_id };
+				
+				if (i-read_index < keep_count) _profile_records[_profile_record_count++] = r;
+				
+				if (_profiler_recent_records) {
+					_profiler_recent_records[_profiler_recent_record_count & (PROFILER_RECENT_RECORDS_CAPACITY-1)] = r;
+					_profiler_recent_record_count += 1;
+				}
+			}
+			_profile_dropped_record_count += count-keep_count;
+
+			atomic_store_64(&b->read_index, write_index, MEMORY_ORDER_RELEASE);
+		}
+
+		u64 event_read_index = b->event_read_index;
+		u64 event_write_index = atomic_load_64(&b->event_write_index, MEMORY_ORDER_ACQUIRE);
+		u64 event_count = event_write_index - event_read_index;
+		if (event_count > 0) {
+			u64 keep_count = _profile_event_count < profiler_max_events ? min(event_count, profiler_max_events-_profile_event_count) : 0;
+			if (_profile_event_count + keep_count > _profile_event_capacity) {
+				u64 new_capacity = min(max(get_next_power_of_two(_profile_event_count + keep_count), 1024*16), profiler_max_events);
+				Profile_Event_Record *new_events = (Profile_Event_Record*)alloc(get_heap_allocator(), sizeof(Profile_Event_Record)*new_capacity);
+				if (_profile_events) {
+					memcpy(new_events, _profile_events, sizeof(Profile_Event_Record)*_profile_event_count);
+					dealloc(get_heap_allocator(), _profile_events);
+				}
+				_profile_events = new_events;
+				_profile_event_capacity = new_capacity;
+			}
+
+			for (u64 i = event_read_index; i < event_read_index+keep_count; i++) {
+				Profile_Event_Record *dst = &_profile_events[_profile_event_count++];
+				dst->event = b->events[i & (PROFILER_THREAD_EVENT_CAPACITY-1)];
+				dst->thread_id = b->thread_id;
+			}
+			_profile_dropped_event_count += event_count-keep_count;
+
+			atomic_store_64(&b->event_read_index, event_write_index, MEMORY_ORDER_RELEASE);
+		}
+		
+		if (state == PROFILER_THREAD_BUFFER_ABANDONED) {
+			atomic_store_32(&b->state, PROFILER_THREAD_BUFFER_FREE, MEMORY_ORDER_RELEASE);
+		}
+
+		b = b->next;
+	}
+
+	spinlock_release(&_profiler_flush_lock);
+}
+
+void
+_profiler_flush_thread_proc(Thread *t) {
+	while (!_profiler_flush_thread_should_stop) {
+		_profiler_drain_thread_buffers();
+		os_sleep(PROFILER_FLUSH_INTERVAL_MS);
+	}
+}
+
+void profiler_init() {
+	if (profiler_initted) return;
+	profiler_initted = true;
+
+	spinlock_init(&_profiler_flush_lock);
+
+	_profiler_flush_thread_should_stop = false;
+	os_thread_init(&_profiler_flush_thread, _profiler_flush_thread_proc);
+	_profiler_flush_thread.name = STR("Profiler flush");
+	os_thread_start(&_profiler_flush_thread);
+}
+
+typedef struct Profile_Scope_Stats {
+	const char *name;
+	u64 count;
+	u64 min_cycles;
+	u64 max_cycles;
+	u64 p99_cycles;
+	u64 total_cycles;
+	f64 mean_cycles;
+} Profile_Scope_Stats;
+
+int
+_profile_record_compare_name_then_duration(const void *a, const void *b) {
+	const Profile_Record *ra = (const Profile_Record*)a;
+	const Profile_Record *rb = (const Profile_Record*)b;
+	if (ra->name != rb->name) {
+		int c = strcmp(ra->name, rb->name);
+		if (c != 0) return c;
+	}
+	u64 da = ra->end-ra->start;
+	u64 db = rb->end-rb->start;
+	return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// Sorts records by name then duration (in place) and returns one Profile_Scope_Stats per
+// unique scope name, allocated with allocator.
+Profile_Scope_Stats *
+profile_compute_scope_stats(Profile_Record *records, u64 record_count, u64 *stats_count, Allocator allocator) {
+	*stats_count = 0;
+	if (record_count == 0) return 0;
+	
+	Profile_Record *help_buffer = (Profile_Record*)alloc(get_heap_allocator(), sizeof(Profile_Record)*record_count);
+	merge_sort(records, help_buffer, record_count, sizeof(Profile_Record), _profile_record_compare_name_then_duration);
+	dealloc(get_heap_allocator(), help_buffer);
+	
+	u64 unique_count = 1;
+	for (u64 i = 1; i < record_count; i++) {
+		if (strcmp(records[i].name, records[i-1].name) != 0) unique_count += 1;
+	}
+	
+	Profile_Scope_Stats *stats = (Profile_Scope_Stats*)alloc(allocator, sizeof(Profile_Scope_Stats)*unique_count);
+	
+	u64 first = 0;
+	for (u64 s = 0; s < unique_count; s++) {
+		u64 last = first+1;
+		while (last < record_count && strcmp(records[last].name, records[first].name) == 0) last += 1;
+		
+		Profile_Scope_Stats *st = &stats[s];
+		st->name = records[first].name;
+		st->count = last-first;
+		st->min_cycles = records[first].end-records[first].start;
+		st->max_cycles = records[last-1].end-records[last-1].start;
+		
+		// Nearest rank
+		u64 p99_rank = (st->count*99 + 99)/100;
+		Profile_Record *p99 = &records[first + p99_rank-1];
+		st->p99_cycles = p99->end-p99->start;
+		
+		st->total_cycles = 0;
+		for (u64 i = first; i < last; i++) st->total_cycles += records[i].end-records[i].start;
+		st->mean_cycles = (f64)st->total_cycles/(f64)st->count;
+		
+		first = last;
+	}
+	
+	*stats_count = unique_count;
+	return stats;
+}
+
+int
+_profile_record_compare_thread_then_start(const void *a, const void *b) {
+	const Profile_Record *ra = (const Profile_Record*)a;
+	const Profile_Record *rb = (const Profile_Record*)b;
+	if (ra->thread_id != rb->thread_id) return ra->thread_id < rb->thread_id ? -1 : 1;
+	if (ra->start != rb->start) return ra->start < rb->start ? -1 : 1;
+	// Parent before child when they start on the same tick
+	if (ra->end != rb->end) return ra->end > rb->end ? -1 : 1;
+	return 0;
+}
+int
+_profile_event_compare_tsc(const void *a, const void *b) {
+	const Profile_Event_Record *ea = (const Profile_Event_Record*)a;
+	const Profile_Event_Record *eb = (const Profile_Event_Record*)b;
+	return ea->event.tsc < eb->event.tsc ? -1 : (ea->event.tsc > eb->event.tsc ? 1 : 0);
+}
+int
+_profile_event_compare_thread_then_tsc(const void *a, const void *b) {
+	const Profile_Event_Record *ea = (const Profile_Event_Record*)a;
+	const Profile_Event_Record *eb = (const Profile_Event_Record*)b;
+	if (ea->thread_id != eb->thread_id) return ea->thread_id < eb->thread_id ? -1 : 1;
+	return _profile_event_compare_tsc(a, b);
+}
+
+int
+_profile_u64_compare(const void *a, const void *b) {
+	u64 ua = *(const u64*)a;
+	u64 ub = *(const u64*)b;
+	return ua < ub ? -1 : (ua > ub ? 1 : 0);
+}
+
+inline Profile_Event_Kind
+profile_event_kind(Profile_Event e) {
+	return (Profile_Event_Kind)(e.size_and_kind >> PROFILE_EVENT_KIND_SHIFT);
+}
+inline u64
+profile_event_size(Profile_Event e) {
+	return e.size_and_kind & PROFILE_EVENT_SIZE_MASK;
+}
+
+// Expects _profile_events to be sorted by time
+void
+_profiler_write_google_trace(string file_name, u64 base, f64 ticks_to_unit) {
+	// Can be hundreds of MB, so it's built in chunks and written out as it is
+	Chunked_String_Builder builder;
+	chunked_string_builder_init_chunk_size(&builder, 1024*1024, get_heap_allocator());
 	
-	os_file_write_string(file, STR("["));
-	os_file_write_string(file, _profile_output.result);
-	os_file_write_string(file, STR("{}]"));
+	chunked_string_builder_append(&builder, STR("["));
+	string fmt = STR("{\"cat\":\"function\",\"dur\":%.3f,\"name\":\"%cs\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f},");
+	for (u64 i = 0; i < _profile_record_count; i++) {
+		Profile_Record *r = &_profile_records[i];
+		f64 ts = (f64)(r->start-base)*ticks_to_unit;
+		f64 dur = (f64)(r->end-r->start)*ticks_to_unit;
+		chunked_string_builder_print(&builder, fmt, dur, r->name, r->thread_id, ts);
+	}
 	
-	os_file_close(file);
+	string instant_fmt = STR("{\"cat\":\"memory\",\"name\":\"%cs\",\"ph\":\"i\",\"s\":\"%cs\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"args\":{\"size\":%llu,\"address\":\"0x%llx\",\"call_site\":\"0x%llx\"}},");
+	string counter_fmt = STR("{\"name\":\"%cs\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"bytes\":%lld}},");
+	s64 heap_bytes = 0;
+	for (u64 i = 0; i < _profile_event_count; i++) {
+		Profile_Event_Record *r = &_profile_events[i];
+		u64 size = profile_event_size(r->event);
+		f64 ts = (f64)(r->event.tsc-base)*ticks_to_unit;
+		
+		switch (profile_event_kind(r->event)) {
+			case PROFILE_EVENT_HEAP_ALLOC: {
+				heap_bytes += (s64)size;
+				chunked_string_builder_print(&builder, instant_fmt, "alloc", "t", r->thread_id, ts, size, r->event.address, r->event.call_site);
+				chunked_string_builder_print(&builder, counter_fmt, "Heap bytes in use", ts, heap_bytes);
+				break;
+			}
+			case PROFILE_EVENT_HEAP_DEALLOC: {
+				heap_bytes -= (s64)size;
+				chunked_string_builder_print(&builder, instant_fmt, "dealloc", "t", r->thread_id, ts, size, r->event.address, r->event.call_site);
+				chunked_string_builder_print(&builder, counter_fmt, "Heap bytes in use", ts, heap_bytes);
+				break;
+			}
+			case PROFILE_EVENT_TEMPORARY_STORAGE_OVERFLOW: {
+				chunked_string_builder_print(&builder, instant_fmt, "temporary storage overflow", "t", r->thread_id, ts, size, r->event.address, r->event.call_site);
+				break;
+			}
+			case PROFILE_EVENT_PROGRAM_MEMORY_GROW: {
+				chunked_string_builder_print(&builder, instant_fmt, "program memory grow", "g", r->thread_id, ts, size, r->event.address, r->event.call_site);
+				chunked_string_builder_print(&builder, counter_fmt, "Program memory", ts, (s64)size);
+				break;
+			}
+			case PROFILE_EVENT_FRAME: {
+				chunked_string_builder_print(&builder, STR("{\"cat\":\"frame\",\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f},"), r->thread_id, ts);
+				break;
+			}
+		}
+	}
+	
+	chunked_string_builder_append(&builder, STR("{}]"));
 	
-	log_verbose("Wrote profiling result to google_trace.json");
+	chunked_string_builder_write_entire_file_s(&builder, file_name);
+	
+	chunked_string_builder_reset(&builder);
 }
-void _profiler_report_time_cycles(string name, u64 count, u64 start) {
-	if (!profiler_initted) {
-		spinlock_init(&_profiler_lock);
-		profiler_initted = true;
+
+#define PROFILER_REPORT_TOP_SCOPES 5
+#define PROFILER_REPORT_MAX_DEPTH 64
+
+typedef struct Profile_Allocation_Attribution {
+	u64 frame;
+	const char *scope;
+	u64 bytes;
+	u64 count;
+} Profile_Allocation_Attribution;
+
+int
+_profile_attribution_compare_frame_then_scope(const void *a, const void *b) {
+	const Profile_Allocation_Attribution *aa = (const Profile_Allocation_Attribution*)a;
+	const Profile_Allocation_Attribution *ab = (const Profile_Allocation_Attribution*)b;
+	if (aa->frame != ab->frame) return aa->frame < ab->frame ? -1 : 1;
+	if (aa->scope == ab->scope) return 0;
+	return strcmp(aa->scope, ab->scope);
+}
+int
+_profile_attribution_compare_frame_then_bytes(const void *a, const void *b) {
+	const Profile_Allocation_Attribution *aa = (const Profile_Allocation_Attribution*)a;
+	const Profile_Allocation_Attribution *ab = (const Profile_Allocation_Attribution*)b;
+	if (aa->frame != ab->frame) return aa->frame < ab->frame ? -1 : 1;
+	if (aa->bytes != ab->bytes) return aa->bytes > ab->bytes ? -1 : 1;
+	return 0;
+}
+
+// Sorts runs of the same frame & scope together and sums them, returns the new count
+u64
+_profile_merge_attributions(Profile_Allocation_Attribution *a, u64 count) {
+	if (count == 0) return 0;
+	Profile_Allocation_Attribution *help_buffer = (Profile_Allocation_Attribution*)alloc(get_heap_allocator(), sizeof(Profile_Allocation_Attribution)*count);
+	merge_sort(a, help_buffer, count, sizeof(Profile_Allocation_Attribution), _profile_attribution_compare_frame_then_scope);
+	
+	u64 merged = 0;
+	for (u64 i = 0; i < count; i++) {
+		if (merged > 0 && _profile_attribution_compare_frame_then_scope(&a[merged-1], &a[i]) == 0) {
+			a[merged-1].bytes += a[i].bytes;
+			a[merged-1].count += a[i].count;
+		} else {
+			a[merged++] = a[i];
+		}
+	}
+	
+	merge_sort(a, help_buffer, merged, sizeof(Profile_Allocation_Attribution), _profile_attribution_compare_frame_then_bytes);
+	dealloc(get_heap_allocator(), help_buffer);
+	return merged;
+}
+
+// Attributes every heap allocation to the innermost scope that was open on its thread and to
+// the frame it happened in (frames are separated by PROFILE_EVENT_FRAME markers), then lists
+// the top allocating scopes per frame.
+// Sorts records by thread & start time. Returns false if there were no allocations.
+bool
+profile_write_allocation_report(Profile_Record *records, u64 record_count, Profile_Event_Record *events, u64 event_count, String_Builder *builder) {
+	Allocator heap = get_heap_allocator();
+	
+	u64 frame_marker_count = 0;
+	u64 alloc_count = 0;
+	for (u64 i = 0; i < event_count; i++) {
+		Profile_Event_Kind kind = profile_event_kind(events[i].event);
+		if (kind == PROFILE_EVENT_FRAME) frame_marker_count += 1;
+		if (kind == PROFILE_EVENT_HEAP_ALLOC) alloc_count += 1;
+	}
+	if (alloc_count == 0) return false;
+	
+	u64 *frame_markers = (u64*)alloc(heap, sizeof(u64)*(frame_marker_count*2+1));
+	Profile_Event_Record *allocs = (Profile_Event_Record*)alloc(heap, sizeof(Profile_Event_Record)*alloc_count*2);
+	u64 f = 0, a = 0;
+	for (u64 i = 0; i < event_count; i++) {
+		Profile_Event_Kind kind = profile_event_kind(events[i].event);
+		if (kind == PROFILE_EVENT_FRAME) frame_markers[f++] = events[i].event.tsc;
+		if (kind == PROFILE_EVENT_HEAP_ALLOC) allocs[a++] = events[i];
+	}
+	merge_sort(frame_markers, frame_markers+frame_marker_count, frame_marker_count, sizeof(u64), _profile_u64_compare);
+	merge_sort(allocs, allocs+alloc_count, alloc_count, sizeof(Profile_Event_Record), _profile_event_compare_thread_then_tsc);
+	
+	if (record_count > 0) {
+		Profile_Record *help_buffer = (Profile_Record*)alloc(heap, sizeof(Profile_Record)*record_count);
+		merge_sort(records, help_buffer, record_count, sizeof(Profile_Record), _profile_record_compare_thread_then_start);
+		dealloc(heap, help_buffer);
+	}
+	
+	Profile_Allocation_Attribution *attributions = (Profile_Allocation_Attribution*)alloc(heap, sizeof(Profile_Allocation_Attribution)*alloc_count);
+	
+	// Sweep each thread's allocations and scopes in time order, with a stack of open scopes
+	Profile_Record *stack[PROFILER_REPORT_MAX_DEPTH];
+	u64 depth = 0;
+	u64 r = 0;
+	u64 current_thread = 0;
+	for (u64 i = 0; i < alloc_count; i++) {
+		Profile_Event_Record *e = &allocs[i];
+		if (i == 0 || e->thread_id != current_thread) {
+			current_thread = e->thread_id;
+			depth = 0;
+			while (r < record_count && records[r].thread_id < current_thread) r += 1;
+		}
+		
+		while (r < record_count && records[r].thread_id == current_thread && records[r].start <= e->event.tsc) {
+			while (depth > 0 && stack[depth-1]->end <= records[r].start) depth -= 1;
+			if (depth < PROFILER_REPORT_MAX_DEPTH) stack[depth++] = &records[r];
+			r += 1;
+		}
+		while (depth > 0 && stack[depth-1]->end < e->event.tsc) depth -= 1;
 		
-		string_builder_init_reserve(&_profile_output, 1024*1000, get_heap_allocator());	
+		// Number of frame markers before the allocation
+		u64 lo = 0, hi = frame_marker_count;
+		while (lo < hi) {
+			u64 mid = (lo+hi)/2;
+			if (frame_markers[mid] <= e->event.tsc) lo = mid+1;
+			else hi = mid;
+		}
 		
+		Profile_Allocation_Attribution *at = &attributions[i];
+		at->frame = lo;
+		at->scope = depth > 0 ? stack[depth-1]->name : "(no scope)";
+		at->bytes = profile_event_size(e->event);
+		at->count = 1;
 	}
 	
-	spinlock_acquire_or_wait(&_profiler_lock);
+	u64 total_bytes = 0;
+	for (u64 i = 0; i < alloc_count; i++) total_bytes += attributions[i].bytes;
+	
+	// Overall, by pretending it's all one frame
+	Profile_Allocation_Attribution *overall = (Profile_Allocation_Attribution*)alloc(heap, sizeof(Profile_Allocation_Attribution)*alloc_count);
+	memcpy(overall, attributions, sizeof(Profile_Allocation_Attribution)*alloc_count);
+	for (u64 i = 0; i < alloc_count; i++) overall[i].frame = 0;
+	u64 overall_count = _profile_merge_attributions(overall, alloc_count);
+	
+	u64 attribution_count = _profile_merge_attributions(attributions, alloc_count);
 	
-	string fmt = STR("{\"cat\":\"function\",\"dur\":%.3f,\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%lld},");
-	string_builder_print(&_profile_output, fmt, (float64)count*1000, name, get_context().thread_id, start*1000);
+	string_builder_print(builder, STR("Heap allocations: %llu, %llu bytes, over %llu frames\n\n"), alloc_count, total_bytes, frame_marker_count+1);
 	
-	spinlock_release(&_profiler_lock);
+	string_builder_append(builder, STR("Top allocating scopes overall:\n"));
+	for (u64 i = 0; i < min(overall_count, PROFILER_REPORT_TOP_SCOPES*2); i++) {
+		string_builder_print(builder, STR("    %14llu bytes %10llu allocations  %cs\n"), overall[i].bytes, overall[i].count, overall[i].scope);
+	}
+	
+	string_builder_append(builder, STR("\nTop allocating scopes per frame:\n"));
+	u64 frame_first = 0;
+	while (frame_first < attribution_count) {
+		u64 frame = attributions[frame_first].frame;
+		u64 frame_last = frame_first;
+		u64 frame_bytes = 0, frame_allocs = 0;
+		while (frame_last < attribution_count && attributions[frame_last].frame == frame) {
+			frame_bytes += attributions[frame_last].bytes;
+			frame_allocs += attributions[frame_last].count;
+			frame_last += 1;
+		}
+		
+		string_builder_print(builder, STR("Frame %llu: %llu bytes in %llu allocations\n"), frame, frame_bytes, frame_allocs);
+		for (u64 i = frame_first; i < min(frame_last, frame_first+PROFILER_REPORT_TOP_SCOPES); i++) {
+			string_builder_print(builder, STR("    %14llu bytes %10llu allocations  %cs\n"), attributions[i].bytes, attributions[i].count, attributions[i].scope);
+		}
+		
+		frame_first = frame_last;
+	}
+	
+	dealloc(heap, overall);
+	dealloc(heap, attributions);
+	dealloc(heap, allocs);
+	dealloc(heap, frame_markers);
+	
+	return true;
 }
-#if ENABLE_PROFILING
-#define tm_scope(name) \
+
+void profiler_enable_recent_records() {
+	if (_profiler_recent_records) return;
+	
+	Profile_Record *records = (Profile_Record*)alloc(get_heap_allocator(), sizeof(Profile_Record)*PROFILER_RECENT_RECORDS_CAPACITY);
+	
+	spinlock_acquire_or_wait(&_profiler_flush_lock);
+	_profiler_recent_records = records;
+	_profiler_recent_record_count = 0;
+	spinlock_release(&_profiler_flush_lock);
+}
+
+// Drains thread buffers and copies recent records that overlap [start, end] (rdtsc time) into
+// result, oldest first. Returns the number of records copied, at most max_count. If more
+// records overlap than that, the newest max_count are copied.
+// Needs profiler_enable_recent_records().
+u64 profiler_copy_recent_records(u64 start, u64 end, Profile_Record *result, u64 max_count) {
+	assert(_profiler_recent_records, "profiler_copy_recent_records needs profiler_enable_recent_records() to be called first");
+	
+	_profiler_drain_thread_buffers();
+	
+	spinlock_acquire_or_wait(&_profiler_flush_lock);
+	
+	u64 first = _profiler_recent_record_count > PROFILER_RECENT_RECORDS_CAPACITY ? _profiler_recent_record_count-PROFILER_RECENT_RECORDS_CAPACITY : 0;
+	
+	// Walk back from the newest record to find where the newest max_count matches begin
+	u64 match_count = 0;
+	u64 i = _profiler_recent_record_count;
+	while (i > first && match_count < max_count) {
+		i -= 1;
+		Profile_Record *r = &_profiler_recent_records[i & (PROFILER_RECENT_RECORDS_CAPACITY-1)];
+		if (r->end >= start && r->start <= end) match_count += 1;
+	}
+	
+	u64 count = 0;
+	for (; i < _profiler_recent_record_count && count < match_count; i++) {
+		Profile_Record *r = &_profiler_recent_records[i & (PROFILER_RECENT_RECORDS_CAPACITY-1)];
+		if (r->end >= start && r->start <= end) {
+			result[count++] = *r;
+		}
+	}
+	
+	spinlock_release(&_profiler_flush_lock);
+	
+	return count;
+}
+
+void dump_profile_result() {
+	if (profiler_initted) {
+		_profiler_flush_thread_should_stop = true;
+		os_thread_join(&_profiler_flush_thread);
+		profiler_initted = false;
+	}
+	_profiler_drain_thread_buffers();
+
+	u64 dropped_count = 0;
+	u64 dropped_event_count = 0;
+	for (Profiler_Thread_Buffer *b = _profiler_thread_buffers; b; b = b->next) {
+		dropped_count += b->dropped_count;
+		dropped_event_count += b->dropped_event_count;
+	}
+	if (dropped_count > 0) {
+		log_warning("Profiler dropped %llu records because thread buffers were full", dropped_count);
+	}
+	if (dropped_event_count > 0) {
+		log_warning("Profiler dropped %llu allocation events because thread buffers were full", dropped_event_count);
+	}
+	if (_profile_dropped_record_count > 0) {
+		log_warning("Profiler dropped %llu records past profiler_max_records (%llu), the dump only has the start of the session", _profile_dropped_record_count, profiler_max_records);
+	}
+	if (_profile_dropped_event_count > 0) {
+		log_warning("Profiler dropped %llu allocation events past profiler_max_events (%llu), the dump only has the start of the session", _profile_dropped_event_count, profiler_max_events);
+	}
+	
+	if (_profile_record_count == 0 && _profile_event_count == 0) return;
+	
+	if (_profile_event_count > 0) {
+		Profile_Event_Record *help_buffer = (Profile_Event_Record*)alloc(get_heap_allocator(), sizeof(Profile_Event_Record)*_profile_event_count);
+		merge_sort(_profile_events, help_buffer, _profile_event_count, sizeof(Profile_Event_Record), _profile_event_compare_tsc);
+		dealloc(get_heap_allocator(), help_buffer);
+	}
+	
+	Cpu_Capabilities cpu = query_cpu_capabilities();
+	if (!cpu.invariant_tsc) {
+		log_warning("CPU does not report an invariant TSC, profile timings in microseconds may be off");
+	}
+	f64 tsc_frequency = os_get_refined_tsc_frequency();
+	f64 cycles_to_us = 1000000.0/tsc_frequency;
+	
+	u64 base = UINT64_MAX;
+	for (u64 i = 0; i < _profile_record_count; i++) base = min(base, _profile_records[i].start);
+	if (_profile_event_count > 0) base = min(base, _profile_events[0].event.tsc);
+	
+	// Google trace format wants microseconds, but the viewer doesn't care what the unit is so
+	// the cycles trace just pretends 1 cycle is 1 us.
+	_profiler_write_google_trace(STR("google_trace_time.json"), base, cycles_to_us);
+	_profiler_write_google_trace(STR("google_trace_cycles.json"), base, 1.0);
+	
+	u64 stats_count;
+	Profile_Scope_Stats *stats = profile_compute_scope_stats(_profile_records, _profile_record_count, &stats_count, get_heap_allocator());
+	
+	String_Builder builder;
+	string_builder_init_reserve(&builder, stats_count*256 + 512, get_heap_allocator());
+	string_builder_print(&builder, STR("TSC frequency: %.3f ghz, invariant TSC: %cs\n\n"), tsc_frequency/1000000000.0, cpu.invariant_tsc ? "true" : "false");
+	// %cs doesn't do width, so names are padded by hand
+	const u64 name_column_width = 40;
+	string_builder_append(&builder, STR("Scope                                        Count       Min us      Mean us       P99 us       Max us       Total us |     Min cycles    Mean cycles     P99 cycles     Max cycles\n"));
+	for (u64 i = 0; i < stats_count; i++) {
+		Profile_Scope_Stats *st = &stats[i];
+		u64 name_length = strlen(st->name);
+		string_builder_print(&builder, STR("%cs "), st->name);
+		for (u64 c = name_length; c < name_column_width; c++) string_builder_append(&builder, STR(" "));
+		string_builder_print(&builder, STR("%10llu %12.3f %12.3f %12.3f %12.3f %14.3f | %14llu %14.1f %14llu %14llu\n"),
+			st->count,
+			(f64)st->min_cycles*cycles_to_us, st->mean_cycles*cycles_to_us, (f64)st->p99_cycles*cycles_to_us, (f64)st->max_cycles*cycles_to_us, (f64)st->total_cycles*cycles_to_us,
+			st->min_cycles, st->mean_cycles, st->p99_cycles, st->max_cycles);
+	}
+	os_write_entire_file_s(STR("profile_stats.txt"), builder.result);
+	
+	dealloc(get_heap_allocator(), builder.buffer);
+	if (stats) dealloc(get_heap_allocator(), stats);
+
+	log_verbose("Wrote %llu profiling records to google_trace_time.json & google_trace_cycles.json, and stats for %llu scopes to profile_stats.txt", _profile_record_count, stats_count);
+	
+	string_builder_init(&builder, get_heap_allocator());
+	if (profile_write_allocation_report(_profile_records, _profile_record_count, _profile_events, _profile_event_count, &builder)) {
+		os_write_entire_file_s(STR("allocation_report.txt"), builder.result);
+		log_verbose("Wrote %llu allocation events to traces and allocation_report.txt", _profile_event_count);
+	}
+	dealloc(get_heap_allocator(), builder.buffer);
+}
+
+#define _tm_scope_impl(name) \
     for (u64 start_time = rdtsc(), end_time = start_time, elapsed_time = 0; \
          elapsed_time == 0; \
-         elapsed_time = (end_time = rdtsc()) - start_time, _profiler_report_time_cycles(STR(name), elapsed_time, start_time))
+         elapsed_time = (end_time = rdtsc()) - start_time, _profiler_record(name, start_time, end_time))
+
+#if ENABLE_PROFILING
+#define tm_scope(name) _tm_scope_impl(name)
 #define tm_scope_var(name, var) \
     for (u64 start_time = rdtsc(), end_time = start_time, elapsed_time = 0; \
          elapsed_time == 0; \
@@ -55,4 +835,4 @@ void _profiler_report_time_cycles(string name, u64 count, u64 start) {
 	#define tm_scope(...)
 	#define tm_scope_var(...)
 	#define tm_scope_accum(...)
-#endif
\ No newline at end of file
+#endif
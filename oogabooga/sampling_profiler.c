@@ -0,0 +1,393 @@
+///
+// Sampling profiler. Unlike tm_scope this needs no instrumentation and no ENABLE_PROFILING:
+// a background thread suspends each thread in the process at a fixed rate and records its call
+// stack. Start it whenever with sampling_profiler_start(samples_per_second), and it's written
+// at exit (or when you call sampling_profiler_dump()) to:
+//     sampling_profile.folded - "thread;outer;...;inner count" per distinct stack, for
+//                               flamegraph.pl, speedscope, inferno and friends
+//     sampling_trace.json     - google trace with the samples & stack frames
+//
+// Only instruction addresses are recorded while sampling; symbolizing happens when dumping.
+// Inlined functions won't show up, and names need debug info (-g) in the executable.
+//
+// Sampling a thread costs it the few microseconds it's suspended for. The sampler thread sleeps
+// between samples, but with less than a couple of ms between samples it yields in a loop to
+// keep the rate, so rates above ~500 hz keep a core busy.
+
+#define SAMPLING_PROFILER_MAX_FRAMES 64
+#define SAMPLING_PROFILER_MAX_THREADS 256
+#define SAMPLING_PROFILER_THREAD_REFRESH_SECONDS 0.1
+
+typedef struct Sampling_Profiler_Sample {
+	u64 tsc;
+	u64 thread_id;
+	u32 first_frame; // Index into Sampling_Profiler.frames
+	u32 frame_count;
+} Sampling_Profiler_Sample;
+
+typedef struct Sampling_Profiler {
+	Thread thread;
+	volatile bool running;
+	u64 samples_per_second;
+
+	// Growing arrays, only touched by the sampler thread while running
+	Sampling_Profiler_Sample *samples;
+	u64 *frames; // Innermost frame first
+} Sampling_Profiler;
+
+// A node in the tree of all sampled stacks. Roots are threads.
+typedef struct Sampling_Profiler_Node {
+	u64 parent; // 0 for roots
+	u64 name;   // Index into names, or thread id for roots
+} Sampling_Profiler_Node;
+
+// #Global
+ogb_instance Sampling_Profiler sampling_profiler;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Sampling_Profiler sampling_profiler = {0};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void
+_sampling_profiler_thread_proc(Thread *t) {
+	u64 thread_ids[SAMPLING_PROFILER_MAX_THREADS];
+	u64 thread_count = 0;
+	f64 next_thread_refresh = 0;
+
+	u64 frames[SAMPLING_PROFILER_MAX_FRAMES];
+
+	f64 interval = 1.0/(f64)sampling_profiler.samples_per_second;
+	f64 next_sample = os_get_current_time_in_seconds();
+
+	while (sampling_profiler.running) {
+		f64 now = os_get_current_time_in_seconds();
+
+		// Enumerating threads is a lot slower than sampling them, so don't do it every sample
+		if (now >= next_thread_refresh) {
+			u64 process_thread_count = os_get_process_thread_ids(thread_ids, SAMPLING_PROFILER_MAX_THREADS);
+			thread_count = min(process_thread_count, SAMPLING_PROFILER_MAX_THREADS);
+			next_thread_refresh = now + SAMPLING_PROFILER_THREAD_REFRESH_SECONDS;
+		}
+
+		for (u64 i = 0; i < thread_count; i++) {
+			if (thread_ids[i] == context.thread_id) continue;
+
+			u64 tsc = rdtsc();
+			u64 frame_count = os_sample_thread_stack(thread_ids[i], frames, SAMPLING_PROFILER_MAX_FRAMES);
+			if (frame_count == 0) continue;
+
+			// The thread is running again, so it's safe to allocate now
+			Sampling_Profiler_Sample sample;
+			sample.tsc = tsc;
+			sample.thread_id = thread_ids[i];
+			sample.first_frame = (u32)growing_array_get_valid_count(sampling_profiler.frames);
+			sample.frame_count = (u32)frame_count;
+			growing_array_add((void**)&sampling_profiler.samples, &sample);
+
+			growing_array_resize((void**)&sampling_profiler.frames, sample.first_frame+frame_count);
+			memcpy(sampling_profiler.frames+sample.first_frame, frames, frame_count*sizeof(u64));
+		}
+
+		next_sample += interval;
+		now = os_get_current_time_in_seconds();
+		// Don't try to catch up if we fell behind
+		if (next_sample < now) next_sample = now;
+
+		f64 remaining_ms = (next_sample-now)*1000.0;
+		if (remaining_ms >= 2.0) os_sleep((u32)(remaining_ms-1.0));
+		now = os_get_current_time_in_seconds();
+		if (next_sample > now) os_high_precision_sleep((next_sample-now)*1000.0);
+	}
+}
+
+void
+sampling_profiler_start(u64 samples_per_second) {
+	assert(samples_per_second > 0, "samples_per_second must be more than 0");
+	if (sampling_profiler.running) return;
+
+	if (!sampling_profiler.samples) {
+		growing_array_init_reserve((void**)&sampling_profiler.samples, sizeof(Sampling_Profiler_Sample), 1024*16, get_heap_allocator());
+		growing_array_init_reserve((void**)&sampling_profiler.frames, sizeof(u64), 1024*256, get_heap_allocator());
+	}
+
+	sampling_profiler.samples_per_second = samples_per_second;
+	sampling_profiler.running = true;
+	os_thread_init(&sampling_profiler.thread, _sampling_profiler_thread_proc);
+	sampling_profiler.thread.name = STR("Sampling profiler");
+	os_thread_start(&sampling_profiler.thread);
+}
+
+void
+sampling_profiler_stop() {
+	if (!sampling_profiler.running) return;
+	sampling_profiler.running = false;
+	os_thread_destroy(&sampling_profiler.thread);
+}
+
+// Throws away the samples so far. The profiler must be stopped.
+void
+sampling_profiler_reset() {
+	assert(!sampling_profiler.running, "Stop the sampling profiler before resetting it");
+	if (!sampling_profiler.samples) return;
+	growing_array_clear((void**)&sampling_profiler.samples);
+	growing_array_clear((void**)&sampling_profiler.frames);
+}
+
+u64
+sampling_profiler_get_sample_count() {
+	if (!sampling_profiler.samples) return 0;
+	return growing_array_get_valid_count(sampling_profiler.samples);
+}
+
+// merge_sort comparators don't take user data, so these point at what's being sorted
+Sampling_Profiler_Sample *_sampling_profiler_sorting_samples = 0;
+u64 *_sampling_profiler_sorting_frame_names = 0;
+
+typedef struct Sampling_Profiler_Symbol {
+	string name;
+	u64 unique_address_index;
+} Sampling_Profiler_Symbol;
+
+int
+_sampling_profiler_compare_symbols(const void *a, const void *b) {
+	const Sampling_Profiler_Symbol *sa = (const Sampling_Profiler_Symbol*)a;
+	const Sampling_Profiler_Symbol *sb = (const Sampling_Profiler_Symbol*)b;
+	int c = memcmp(sa->name.data, sb->name.data, min(sa->name.count, sb->name.count));
+	if (c != 0) return c;
+	if (sa->name.count != sb->name.count) return sa->name.count < sb->name.count ? -1 : 1;
+	return 0;
+}
+
+// Thread, then stack from the outermost frame, so samples with a common stack prefix end up next to each other
+int
+_sampling_profiler_compare_samples(const void *a, const void *b) {
+	const Sampling_Profiler_Sample *sa = &_sampling_profiler_sorting_samples[*(const u32*)a];
+	const Sampling_Profiler_Sample *sb = &_sampling_profiler_sorting_samples[*(const u32*)b];
+	if (sa->thread_id != sb->thread_id) return sa->thread_id < sb->thread_id ? -1 : 1;
+
+	const u64 *fa = _sampling_profiler_sorting_frame_names + sa->first_frame;
+	const u64 *fb = _sampling_profiler_sorting_frame_names + sb->first_frame;
+	u32 common = min(sa->frame_count, sb->frame_count);
+	for (u32 i = 0; i < common; i++) {
+		u64 na = fa[sa->frame_count-1-i];
+		u64 nb = fb[sb->frame_count-1-i];
+		if (na != nb) return na < nb ? -1 : 1;
+	}
+	if (sa->frame_count != sb->frame_count) return sa->frame_count < sb->frame_count ? -1 : 1;
+	return 0;
+}
+
+s64
+_sampling_profiler_find_address(u64 *sorted_addresses, u64 count, u64 address) {
+	u64 low = 0;
+	u64 high = count;
+	while (low < high) {
+		u64 mid = low + (high-low)/2;
+		if (sorted_addresses[mid] < address) low = mid+1;
+		else high = mid;
+	}
+	if (low < count && sorted_addresses[low] == address) return (s64)low;
+	return -1;
+}
+
+void
+_sampling_profiler_append_folded_line(String_Builder *folded, Sampling_Profiler_Node *nodes, string *names, u64 leaf, u64 count) {
+	u64 path[SAMPLING_PROFILER_MAX_FRAMES+1];
+	u64 depth = 0;
+	for (u64 node = leaf; node != 0; node = nodes[node].parent) path[depth++] = node;
+
+	string_builder_print(folded, STR("thread %llu"), nodes[path[depth-1]].name);
+	for (s64 i = (s64)depth-2; i >= 0; i--) {
+		string_builder_append(folded, STR(";"));
+		string_builder_append(folded, names[nodes[path[i]].name]);
+	}
+	string_builder_print(folded, STR(" %llu\n"), count);
+}
+
+// Symbolizes the samples and appends the folded stacks and the google trace to the builders.
+// Returns false if there are no samples. The profiler must be stopped.
+bool
+sampling_profiler_write_results(String_Builder *folded, String_Builder *trace) {
+	assert(!sampling_profiler.running, "Stop the sampling profiler before writing results");
+
+	u64 sample_count = sampling_profiler_get_sample_count();
+	if (sample_count == 0) return false;
+
+	Sampling_Profiler_Sample *samples = sampling_profiler.samples;
+	u64 frame_count = growing_array_get_valid_count(sampling_profiler.frames);
+	Allocator allocator = get_heap_allocator();
+
+	// Every frame except the innermost is a return address, which points to the instruction
+	// after the call. That can be in the next function (or on the next line), so step back one.
+	u64 *addresses = (u64*)alloc(allocator, sizeof(u64)*frame_count);
+	for (u64 i = 0; i < sample_count; i++) {
+		for (u32 f = 0; f < samples[i].frame_count; f++) {
+			u64 address = sampling_profiler.frames[samples[i].first_frame+f];
+			addresses[samples[i].first_frame+f] = f == 0 ? address : address-1;
+		}
+	}
+
+	// Symbolize each unique address once
+	u64 *unique_addresses = (u64*)alloc(allocator, sizeof(u64)*frame_count);
+	u64 *help_buffer = (u64*)alloc(allocator, sizeof(u64)*frame_count);
+	memcpy(unique_addresses, addresses, sizeof(u64)*frame_count);
+	merge_sort(unique_addresses, help_buffer, frame_count, sizeof(u64), _profile_u64_compare);
+	u64 unique_count = 0;
+	for (u64 i = 0; i < frame_count; i++) {
+		if (unique_count == 0 || unique_addresses[unique_count-1] != unique_addresses[i]) {
+			unique_addresses[unique_count++] = unique_addresses[i];
+		}
+	}
+
+	Sampling_Profiler_Symbol *symbols = (Sampling_Profiler_Symbol*)alloc(allocator, sizeof(Sampling_Profiler_Symbol)*unique_count*2);
+	for (u64 i = 0; i < unique_count; i++) {
+		symbols[i].name = os_get_symbol_name(unique_addresses[i], allocator);
+		if (symbols[i].name.count == 0) symbols[i].name = sprint(allocator, STR("0x%llx"), unique_addresses[i]);
+		symbols[i].unique_address_index = i;
+	}
+
+	// Different addresses in the same function get the same name index
+	merge_sort(symbols, symbols+unique_count, unique_count, sizeof(Sampling_Profiler_Symbol), _sampling_profiler_compare_symbols);
+	string *names = (string*)alloc(allocator, sizeof(string)*unique_count);
+	u64 *name_of_unique_address = (u64*)alloc(allocator, sizeof(u64)*unique_count);
+	u64 name_count = 0;
+	for (u64 i = 0; i < unique_count; i++) {
+		if (name_count == 0 || _sampling_profiler_compare_symbols(&symbols[i-1], &symbols[i]) != 0) {
+			names[name_count++] = symbols[i].name;
+		} else {
+			dealloc(allocator, symbols[i].name.data);
+		}
+		name_of_unique_address[symbols[i].unique_address_index] = name_count-1;
+	}
+
+	// Reuse addresses for the name index of each frame
+	u64 *frame_names = addresses;
+	for (u64 i = 0; i < frame_count; i++) {
+		s64 unique_index = _sampling_profiler_find_address(unique_addresses, unique_count, addresses[i]);
+		assert(unique_index >= 0, "Sampled address went missing");
+		frame_names[i] = name_of_unique_address[unique_index];
+	}
+
+	// Sorting by stack turns building the tree of stacks into walking a sorted list of paths:
+	// consecutive samples share the nodes of their common prefix.
+	u32 *order = (u32*)alloc(allocator, sizeof(u32)*sample_count*2);
+	for (u64 i = 0; i < sample_count; i++) order[i] = (u32)i;
+	_sampling_profiler_sorting_samples = samples;
+	_sampling_profiler_sorting_frame_names = frame_names;
+	merge_sort(order, order+sample_count, sample_count, sizeof(u32), _sampling_profiler_compare_samples);
+
+	Sampling_Profiler_Node *nodes;
+	growing_array_init_reserve((void**)&nodes, sizeof(Sampling_Profiler_Node), 1024, allocator);
+	growing_array_add_empty((void**)&nodes); // 0 is no node
+
+	u64 *sample_nodes = (u64*)alloc(allocator, sizeof(u64)*sample_count);
+	u64 path[SAMPLING_PROFILER_MAX_FRAMES+1]; // path[0] is the thread, path[d] the frame at depth d
+	u64 run_count = 0;
+
+	for (u64 s = 0; s < sample_count; s++) {
+		Sampling_Profiler_Sample *sample = &samples[order[s]];
+		const u64 *sample_frame_names = frame_names + sample->first_frame;
+
+		u64 common = 0; // Number of frames shared with the previous sample
+		bool same_thread = false;
+		Sampling_Profiler_Sample *previous = s > 0 ? &samples[order[s-1]] : 0;
+		if (previous && previous->thread_id == sample->thread_id) {
+			same_thread = true;
+			const u64 *previous_frame_names = frame_names + previous->first_frame;
+			u32 max_common = min(previous->frame_count, sample->frame_count);
+			while (common < max_common
+			    && previous_frame_names[previous->frame_count-1-common] == sample_frame_names[sample->frame_count-1-common]) {
+				common += 1;
+			}
+		}
+
+		if (same_thread && common == sample->frame_count && common == previous->frame_count) {
+			run_count += 1;
+		} else {
+			if (run_count > 0) _sampling_profiler_append_folded_line(folded, nodes, names, sample_nodes[order[s-1]], run_count);
+			run_count = 1;
+
+			if (!same_thread) {
+				Sampling_Profiler_Node *root = growing_array_add_empty((void**)&nodes);
+				root->parent = 0;
+				root->name = sample->thread_id;
+				path[0] = growing_array_get_valid_count(nodes)-1;
+			}
+			for (u64 depth = common+1; depth <= sample->frame_count; depth++) {
+				Sampling_Profiler_Node *node = growing_array_add_empty((void**)&nodes);
+				node->parent = path[depth-1];
+				node->name = sample_frame_names[sample->frame_count-depth];
+				path[depth] = growing_array_get_valid_count(nodes)-1;
+			}
+		}
+
+		sample_nodes[order[s]] = path[sample->frame_count];
+	}
+	_sampling_profiler_append_folded_line(folded, nodes, names, sample_nodes[order[sample_count-1]], run_count);
+
+	// Google trace (the JSON object format, which has sample events & a stack frame table)
+	f64 cycles_to_us = 1000000.0/os_get_refined_tsc_frequency();
+	u64 base = UINT64_MAX;
+	for (u64 i = 0; i < sample_count; i++) base = min(base, samples[i].tsc);
+
+	string_builder_append(trace, STR("{\"traceEvents\":["));
+	u64 node_count = growing_array_get_valid_count(nodes);
+	bool first = true;
+	for (u64 i = 1; i < node_count; i++) {
+		if (nodes[i].parent != 0) continue;
+		// Threads that exited before now have lost their name
+		string thread_name = os_get_thread_name(nodes[i].name, get_temporary_allocator());
+		if (thread_name.count == 0) thread_name = tprint("thread %llu", nodes[i].name);
+		string_builder_print(trace, STR("%cs\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%llu,\"args\":{\"name\":\"%s\"}}"), first ? "" : ",", nodes[i].name, thread_name);
+		first = false;
+	}
+	string_builder_append(trace, STR("\n],\"stackFrames\":{"));
+	for (u64 i = 1; i < node_count; i++) {
+		if (i > 1) string_builder_append(trace, STR(","));
+		if (nodes[i].parent == 0) {
+			string_builder_print(trace, STR("\n\"%llu\":{\"category\":\"thread\",\"name\":\"thread %llu\"}"), i, nodes[i].name);
+		} else {
+			// Symbol names are plain identifiers (maybe with C++ templates), nothing to escape
+			string_builder_print(trace, STR("\n\"%llu\":{\"category\":\"sample\",\"name\":\"%s\",\"parent\":\"%llu\"}"), i, names[nodes[i].name], nodes[i].parent);
+		}
+	}
+	string_builder_append(trace, STR("\n},\"samples\":["));
+	for (u64 i = 0; i < sample_count; i++) {
+		string_builder_print(trace, STR("%cs\n{\"cat\":\"sample\",\"name\":\"sample\",\"pid\":0,\"tid\":%llu,\"ts\":%.3f,\"sf\":\"%llu\",\"weight\":1}"),
+			i == 0 ? "" : ",", samples[i].thread_id, (f64)(samples[i].tsc-base)*cycles_to_us, sample_nodes[i]);
+	}
+	string_builder_append(trace, STR("\n]}\n"));
+
+	for (u64 i = 0; i < name_count; i++) dealloc(allocator, names[i].data);
+	growing_array_deinit((void**)&nodes);
+	dealloc(allocator, sample_nodes);
+	dealloc(allocator, order);
+	dealloc(allocator, name_of_unique_address);
+	dealloc(allocator, names);
+	dealloc(allocator, symbols);
+	dealloc(allocator, help_buffer);
+	dealloc(allocator, unique_addresses);
+	dealloc(allocator, addresses);
+
+	return true;
+}
+
+// Stops the profiler and writes sampling_profile.folded & sampling_trace.json
+void
+sampling_profiler_dump() {
+	sampling_profiler_stop();
+
+	String_Builder folded;
+	String_Builder trace;
+	string_builder_init(&folded, get_heap_allocator());
+	string_builder_init(&trace, get_heap_allocator());
+
+	if (sampling_profiler_write_results(&folded, &trace)) {
+		os_write_entire_file_s(STR("sampling_profile.folded"), folded.result);
+		os_write_entire_file_s(STR("sampling_trace.json"), trace.result);
+		log_verbose("Wrote %llu stack samples to sampling_profile.folded & sampling_trace.json", sampling_profiler_get_sample_count());
+	}
+
+	dealloc(get_heap_allocator(), folded.buffer);
+	dealloc(get_heap_allocator(), trace.buffer);
+}
@@ -41,6 +41,69 @@ inline void basic_rsqrt_float32_128(float *a, float *result);
 inline void basic_rsqrt_float32_256(float *a, float *result);
 inline void basic_rsqrt_float32_512(float *a, float *result);
 
+///
+// Runtime dispatch
+// The 256 and 512 bit procedures need AVX/AVX2/AVX-512, which SIMD_ENABLE_* leaves off by
+// default so the program runs on any cpu. When they're off, simd_*_256/512 call through
+// simd_procs instead, which simd_procs_init() points at the widest version the cpu can run
+// (compiled for it with target attributes, whatever the rest of the program targets).
+// The *_array procedures do a whole array per call, that's where the wide versions pay off.
+// Before init, everything points at the basic versions.
+
+typedef enum Simd_Level {
+	SIMD_LEVEL_BASIC = 0,
+	SIMD_LEVEL_SSE,
+	SIMD_LEVEL_AVX,
+	SIMD_LEVEL_AVX2,
+	SIMD_LEVEL_AVX512,
+} Simd_Level;
+
+typedef void (*Simd_Float32_Proc)(float32 *a, float32 *b, float32 *result);
+typedef void (*Simd_Float32_Unary_Proc)(float32 *a, float32 *result);
+typedef void (*Simd_Int32_Proc)(s32 *a, s32 *b, s32 *result);
+typedef void (*Simd_Float32_Array_Proc)(float32 *a, float32 *b, float32 *result, u64 count);
+
+typedef struct Simd_Procs {
+	Simd_Level level;
+	
+	Simd_Float32_Proc add_float32_256;
+	Simd_Float32_Proc sub_float32_256;
+	Simd_Float32_Proc mul_float32_256;
+	Simd_Float32_Proc div_float32_256;
+	Simd_Float32_Unary_Proc sqrt_float32_256;
+	Simd_Float32_Unary_Proc rsqrt_float32_256;
+	Simd_Int32_Proc add_int32_256;
+	Simd_Int32_Proc sub_int32_256;
+	Simd_Int32_Proc mul_int32_256;
+	
+	Simd_Float32_Proc add_float32_512;
+	Simd_Float32_Proc sub_float32_512;
+	Simd_Float32_Proc mul_float32_512;
+	Simd_Float32_Proc div_float32_512;
+	Simd_Float32_Unary_Proc sqrt_float32_512;
+	Simd_Float32_Unary_Proc rsqrt_float32_512;
+	Simd_Int32_Proc add_int32_512;
+	Simd_Int32_Proc sub_int32_512;
+	Simd_Int32_Proc mul_int32_512;
+	
+	// result[i] = a[i] op b[i] for count floats. result may be a or b.
+	Simd_Float32_Array_Proc add_float32_array;
+	Simd_Float32_Array_Proc sub_float32_array;
+	Simd_Float32_Array_Proc mul_float32_array;
+	Simd_Float32_Array_Proc div_float32_array;
+} Simd_Procs;
+
+// #Global
+ogb_instance Simd_Procs simd_procs;
+
+// Caps the level at max_level, so tests can run every path the cpu has.
+ogb_instance void simd_procs_init(Cpu_Capabilities cpu, Simd_Level max_level);
+
+#define simd_add_float32_array simd_procs.add_float32_array
+#define simd_sub_float32_array simd_procs.sub_float32_array
+#define simd_mul_float32_array simd_procs.mul_float32_array
+#define simd_div_float32_array simd_procs.div_float32_array
+
 
 
 #if ENABLE_SIMD
@@ -344,18 +407,18 @@ inline void simd_rsqrt_float32_256_aligned(float *a, float *result) {
     _mm256_store_ps(result, vr);
 }
 #else
-	#define simd_add_float32_256 	basic_add_float32_256
-	#define simd_sub_float32_256 	basic_sub_float32_256
-	#define simd_mul_float32_256 	basic_mul_float32_256
-	#define simd_div_float32_256 	basic_div_float32_256
-	#define simd_sqrt_float32_256   		basic_sqrt_float32_256
-	#define simd_rsqrt_float32_256  		basic_rsqrt_float32_256
-	#define simd_add_float32_256_aligned 	basic_add_float32_256
-	#define simd_sub_float32_256_aligned 	basic_sub_float32_256
-	#define simd_mul_float32_256_aligned 	basic_mul_float32_256
-	#define simd_div_float32_256_aligned 	basic_div_float32_256
-	#define simd_sqrt_float32_256_aligned   basic_sqrt_float32_256
-	#define simd_rsqrt_float32_256_aligned  basic_rsqrt_float32_256
+	#define simd_add_float32_256 	simd_procs.add_float32_256
+	#define simd_sub_float32_256 	simd_procs.sub_float32_256
+	#define simd_mul_float32_256 	simd_procs.mul_float32_256
+	#define simd_div_float32_256 	simd_procs.div_float32_256
+	#define simd_sqrt_float32_256   		simd_procs.sqrt_float32_256
+	#define simd_rsqrt_float32_256  		simd_procs.rsqrt_float32_256
+	#define simd_add_float32_256_aligned 	simd_procs.add_float32_256
+	#define simd_sub_float32_256_aligned 	simd_procs.sub_float32_256
+	#define simd_mul_float32_256_aligned 	simd_procs.mul_float32_256
+	#define simd_div_float32_256_aligned 	simd_procs.div_float32_256
+	#define simd_sqrt_float32_256_aligned   simd_procs.sqrt_float32_256
+	#define simd_rsqrt_float32_256_aligned  simd_procs.rsqrt_float32_256
 #endif
 
 #if SIMD_ENABLE_AVX2
@@ -400,12 +463,12 @@ inline void simd_mul_int32_256_aligned(s32 *a, s32 *b, s32* result) {
     _mm256_store_si256((__m256i*)result, vr);
 }
 #else
-	#define simd_add_int32_256 		basic_add_int32_256
-	#define simd_sub_int32_256 		basic_sub_int32_256
-	#define simd_mul_int32_256 		basic_mul_int32_256
-	#define simd_add_int32_256_aligned 		basic_add_int32_256
-	#define simd_sub_int32_256_aligned 		basic_sub_int32_256
-	#define simd_mul_int32_256_aligned 		basic_mul_int32_256
+	#define simd_add_int32_256 		simd_procs.add_int32_256
+	#define simd_sub_int32_256 		simd_procs.sub_int32_256
+	#define simd_mul_int32_256 		simd_procs.mul_int32_256
+	#define simd_add_int32_256_aligned 		simd_procs.add_int32_256
+	#define simd_sub_int32_256_aligned 		simd_procs.sub_int32_256
+	#define simd_mul_int32_256_aligned 		simd_procs.mul_int32_256
 #endif
 
 #if SIMD_ENABLE_AVX512
@@ -525,24 +588,24 @@ inline void simd_rsqrt_float32_512_aligned(float *a, float *result) {
     _mm512_store_ps(result, vr);
 }
 #else 
-	#define simd_add_float32_512 	basic_add_float32_512
-	#define simd_sub_float32_512 	basic_sub_float32_512
-	#define simd_mul_float32_512 	basic_mul_float32_512
-	#define simd_div_float32_512 	basic_div_float32_512
-	#define simd_add_int32_512 		basic_add_int32_512
-	#define simd_sub_int32_512 		basic_sub_int32_512
-	#define simd_mul_int32_512 		basic_mul_int32_512
-	#define simd_sqrt_float32_512   basic_sqrt_float32_512
-	#define simd_rsqrt_float32_512  basic_rsqrt_float32_512
-	#define simd_add_float32_512_aligned 	basic_add_float32_512
-	#define simd_sub_float32_512_aligned 	basic_sub_float32_512
-	#define simd_mul_float32_512_aligned 	basic_mul_float32_512
-	#define simd_div_float32_512_aligned 	basic_div_float32_512
-	#define simd_add_int32_512_aligned 		basic_add_int32_512
-	#define simd_sub_int32_512_aligned 		basic_sub_int32_512
-	#define simd_mul_int32_512_aligned 		basic_mul_int32_512
-	#define simd_sqrt_float32_512_aligned   basic_sqrt_float32_512
-	#define simd_rsqrt_float32_512_aligned  basic_rsqrt_float32_512
+	#define simd_add_float32_512 	simd_procs.add_float32_512
+	#define simd_sub_float32_512 	simd_procs.sub_float32_512
+	#define simd_mul_float32_512 	simd_procs.mul_float32_512
+	#define simd_div_float32_512 	simd_procs.div_float32_512
+	#define simd_add_int32_512 		simd_procs.add_int32_512
+	#define simd_sub_int32_512 		simd_procs.sub_int32_512
+	#define simd_mul_int32_512 		simd_procs.mul_int32_512
+	#define simd_sqrt_float32_512   simd_procs.sqrt_float32_512
+	#define simd_rsqrt_float32_512  simd_procs.rsqrt_float32_512
+	#define simd_add_float32_512_aligned 	simd_procs.add_float32_512
+	#define simd_sub_float32_512_aligned 	simd_procs.sub_float32_512
+	#define simd_mul_float32_512_aligned 	simd_procs.mul_float32_512
+	#define simd_div_float32_512_aligned 	simd_procs.div_float32_512
+	#define simd_add_int32_512_aligned 		simd_procs.add_int32_512
+	#define simd_sub_int32_512_aligned 		simd_procs.sub_int32_512
+	#define simd_mul_int32_512_aligned 		simd_procs.mul_int32_512
+	#define simd_sqrt_float32_512_aligned   simd_procs.sqrt_float32_512
+	#define simd_rsqrt_float32_512_aligned  simd_procs.rsqrt_float32_512
 #endif // SIMD_ENABLE_AVX512
 
 #else
@@ -628,7 +691,6 @@ inline void simd_rsqrt_float32_512_aligned(float *a, float *result) {
 #endif
 
 double __cdecl sqrt(_In_ double _X);
-double __cdecl rsqrt(_In_ double _X);
 
 inline void basic_add_float32_64 (float32 *a, float32 *b, float32* result) {
 	result[0] = a[0] + b[0];
@@ -777,19 +839,19 @@ inline void basic_sqrt_float32_512(float *a, float *result) {
     basic_sqrt_float32_256(a+8, result+8);
 }
 inline void basic_rsqrt_float32_64(float *a, float *result) {
-    result[0] = rsqrt(a[0]);
-    result[1] = rsqrt(a[1]);
+    result[0] = 1.0f / sqrt(a[0]);
+    result[1] = 1.0f / sqrt(a[1]);
 }
 inline void basic_rsqrt_float32_96(float *a, float *result) {
-    result[0] = rsqrt(a[0]);
-    result[1] = rsqrt(a[1]);
-    result[2] = rsqrt(a[2]);
+    result[0] = 1.0f / sqrt(a[0]);
+    result[1] = 1.0f / sqrt(a[1]);
+    result[2] = 1.0f / sqrt(a[2]);
 }
 inline void basic_rsqrt_float32_128(float *a, float *result) {
-    result[0] = rsqrt(a[0]);
-    result[1] = rsqrt(a[1]);
-    result[2] = rsqrt(a[2]);
-    result[3] = rsqrt(a[3]);
+    result[0] = 1.0f / sqrt(a[0]);
+    result[1] = 1.0f / sqrt(a[1]);
+    result[2] = 1.0f / sqrt(a[2]);
+    result[3] = 1.0f / sqrt(a[3]);
 }
 inline void basic_rsqrt_float32_256(float *a, float *result) {
     basic_rsqrt_float32_128(a, result);
@@ -800,3 +862,238 @@ inline void basic_rsqrt_float32_512(float *a, float *result) {
     basic_rsqrt_float32_256(a+8, result+8);
 }
 
+
+// Basic versions of what's in simd_procs. The 512 ones use the basic 256 ones directly,
+// the simd_*_256 macros might go through simd_procs again.
+#define _SIMD_BASIC_BINARY_PROCS(name, type) \
+void _simd_##name##_256_basic(type *a, type *b, type *result) { \
+	basic_##name##_256(a, b, result); \
+} \
+void _simd_##name##_512_basic(type *a, type *b, type *result) { \
+	basic_##name##_256(a, b, result); \
+	basic_##name##_256(a+8, b+8, result+8); \
+}
+_SIMD_BASIC_BINARY_PROCS(add_float32, float32)
+_SIMD_BASIC_BINARY_PROCS(sub_float32, float32)
+_SIMD_BASIC_BINARY_PROCS(mul_float32, float32)
+_SIMD_BASIC_BINARY_PROCS(div_float32, float32)
+_SIMD_BASIC_BINARY_PROCS(add_int32, s32)
+_SIMD_BASIC_BINARY_PROCS(sub_int32, s32)
+_SIMD_BASIC_BINARY_PROCS(mul_int32, s32)
+
+void _simd_sqrt_float32_256_basic(float32 *a, float32 *result)  { basic_sqrt_float32_256(a, result); }
+void _simd_sqrt_float32_512_basic(float32 *a, float32 *result)  { basic_sqrt_float32_512(a, result); }
+void _simd_rsqrt_float32_256_basic(float32 *a, float32 *result) { basic_rsqrt_float32_256(a, result); }
+void _simd_rsqrt_float32_512_basic(float32 *a, float32 *result) { basic_rsqrt_float32_512(a, result); }
+
+#define _SIMD_BASIC_ARRAY_PROC(name, op) \
+void _simd_##name##_float32_array_basic(float32 *a, float32 *b, float32 *result, u64 count) { \
+	for (u64 i = 0; i < count; i++) result[i] = a[i] op b[i]; \
+}
+_SIMD_BASIC_ARRAY_PROC(add, +)
+_SIMD_BASIC_ARRAY_PROC(sub, -)
+_SIMD_BASIC_ARRAY_PROC(mul, *)
+_SIMD_BASIC_ARRAY_PROC(div, /)
+
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+
+#define _SIMD_SSE_ARRAY_PROC(name, op) \
+void _simd_##name##_float32_array_sse(float32 *a, float32 *b, float32 *result, u64 count) { \
+	u64 i = 0; \
+	for (; i+4 <= count; i += 4) { \
+		_mm_storeu_ps(result+i, _mm_##name##_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i))); \
+	} \
+	for (; i < count; i++) result[i] = a[i] op b[i]; \
+}
+_SIMD_SSE_ARRAY_PROC(add, +)
+_SIMD_SSE_ARRAY_PROC(sub, -)
+_SIMD_SSE_ARRAY_PROC(mul, *)
+_SIMD_SSE_ARRAY_PROC(div, /)
+
+#if COMPILER_CAN_TARGET_AVX
+// 512 is two 256's here, still better than four 128's
+#define _SIMD_AVX_FLOAT32_PROCS(name, op) \
+target_avx void _simd_##name##_float32_256_avx(float32 *a, float32 *b, float32 *result) { \
+	_mm256_storeu_ps(result, _mm256_##name##_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b))); \
+} \
+target_avx void _simd_##name##_float32_512_avx(float32 *a, float32 *b, float32 *result) { \
+	_mm256_storeu_ps(result,   _mm256_##name##_ps(_mm256_loadu_ps(a),   _mm256_loadu_ps(b))); \
+	_mm256_storeu_ps(result+8, _mm256_##name##_ps(_mm256_loadu_ps(a+8), _mm256_loadu_ps(b+8))); \
+} \
+target_avx void _simd_##name##_float32_array_avx(float32 *a, float32 *b, float32 *result, u64 count) { \
+	u64 i = 0; \
+	for (; i+16 <= count; i += 16) { \
+		__m256 r0 = _mm256_##name##_ps(_mm256_loadu_ps(a+i),   _mm256_loadu_ps(b+i)); \
+		__m256 r1 = _mm256_##name##_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8)); \
+		_mm256_storeu_ps(result+i, r0); \
+		_mm256_storeu_ps(result+i+8, r1); \
+	} \
+	for (; i+4 <= count; i += 4) { \
+		_mm_storeu_ps(result+i, _mm_##name##_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i))); \
+	} \
+	for (; i < count; i++) result[i] = a[i] op b[i]; \
+}
+_SIMD_AVX_FLOAT32_PROCS(add, +)
+_SIMD_AVX_FLOAT32_PROCS(sub, -)
+_SIMD_AVX_FLOAT32_PROCS(mul, *)
+_SIMD_AVX_FLOAT32_PROCS(div, /)
+
+target_avx void _simd_sqrt_float32_256_avx(float32 *a, float32 *result) {
+	_mm256_storeu_ps(result, _mm256_sqrt_ps(_mm256_loadu_ps(a)));
+}
+target_avx void _simd_sqrt_float32_512_avx(float32 *a, float32 *result) {
+	_mm256_storeu_ps(result,   _mm256_sqrt_ps(_mm256_loadu_ps(a)));
+	_mm256_storeu_ps(result+8, _mm256_sqrt_ps(_mm256_loadu_ps(a+8)));
+}
+target_avx void _simd_rsqrt_float32_256_avx(float32 *a, float32 *result) {
+	_mm256_storeu_ps(result, _mm256_rsqrt_ps(_mm256_loadu_ps(a)));
+}
+target_avx void _simd_rsqrt_float32_512_avx(float32 *a, float32 *result) {
+	_mm256_storeu_ps(result,   _mm256_rsqrt_ps(_mm256_loadu_ps(a)));
+	_mm256_storeu_ps(result+8, _mm256_rsqrt_ps(_mm256_loadu_ps(a+8)));
+}
+#endif // COMPILER_CAN_TARGET_AVX
+
+#if COMPILER_CAN_TARGET_AVX2
+#define _SIMD_AVX2_INT32_PROCS(name, intrinsic) \
+target_avx2 void _simd_##name##_int32_256_avx2(s32 *a, s32 *b, s32 *result) { \
+	__m256i va = _mm256_loadu_si256((__m256i*)a); \
+	__m256i vb = _mm256_loadu_si256((__m256i*)b); \
+	_mm256_storeu_si256((__m256i*)result, intrinsic(va, vb)); \
+} \
+target_avx2 void _simd_##name##_int32_512_avx2(s32 *a, s32 *b, s32 *result) { \
+	_simd_##name##_int32_256_avx2(a, b, result); \
+	_simd_##name##_int32_256_avx2(a+8, b+8, result+8); \
+}
+_SIMD_AVX2_INT32_PROCS(add, _mm256_add_epi32)
+_SIMD_AVX2_INT32_PROCS(sub, _mm256_sub_epi32)
+_SIMD_AVX2_INT32_PROCS(mul, _mm256_mullo_epi32)
+#endif // COMPILER_CAN_TARGET_AVX2
+
+#if COMPILER_CAN_TARGET_AVX512
+#define _SIMD_AVX512_FLOAT32_PROCS(name, op) \
+target_avx512 void _simd_##name##_float32_512_avx512(float32 *a, float32 *b, float32 *result) { \
+	_mm512_storeu_ps(result, _mm512_##name##_ps(_mm512_loadu_ps(a), _mm512_loadu_ps(b))); \
+} \
+target_avx512 void _simd_##name##_float32_array_avx512(float32 *a, float32 *b, float32 *result, u64 count) { \
+	u64 i = 0; \
+	for (; i+32 <= count; i += 32) { \
+		__m512 r0 = _mm512_##name##_ps(_mm512_loadu_ps(a+i),    _mm512_loadu_ps(b+i)); \
+		__m512 r1 = _mm512_##name##_ps(_mm512_loadu_ps(a+i+16), _mm512_loadu_ps(b+i+16)); \
+		_mm512_storeu_ps(result+i, r0); \
+		_mm512_storeu_ps(result+i+16, r1); \
+	} \
+	/* The tail with masked loads & stores instead of a scalar loop */ \
+	for (; i < count; i += 16) { \
+		__mmask16 mask = (count-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (count-i)) - 1); \
+		__m512 va = _mm512_maskz_loadu_ps(mask, a+i); \
+		__m512 vb = _mm512_mask_loadu_ps(_mm512_set1_ps(1.0f), mask, b+i); \
+		_mm512_mask_storeu_ps(result+i, mask, _mm512_##name##_ps(va, vb)); \
+	} \
+}
+_SIMD_AVX512_FLOAT32_PROCS(add, +)
+_SIMD_AVX512_FLOAT32_PROCS(sub, -)
+_SIMD_AVX512_FLOAT32_PROCS(mul, *)
+_SIMD_AVX512_FLOAT32_PROCS(div, /)
+
+#define _SIMD_AVX512_INT32_PROC(name, intrinsic) \
+target_avx512 void _simd_##name##_int32_512_avx512(s32 *a, s32 *b, s32 *result) { \
+	__m512i va = _mm512_loadu_si512((__m512i*)a); \
+	__m512i vb = _mm512_loadu_si512((__m512i*)b); \
+	_mm512_storeu_si512((__m512i*)result, intrinsic(va, vb)); \
+}
+_SIMD_AVX512_INT32_PROC(add, _mm512_add_epi32)
+_SIMD_AVX512_INT32_PROC(sub, _mm512_sub_epi32)
+_SIMD_AVX512_INT32_PROC(mul, _mm512_mullo_epi32)
+
+target_avx512 void _simd_sqrt_float32_512_avx512(float32 *a, float32 *result) {
+	_mm512_storeu_ps(result, _mm512_sqrt_ps(_mm512_loadu_ps(a)));
+}
+target_avx512 void _simd_rsqrt_float32_512_avx512(float32 *a, float32 *result) {
+	_mm512_storeu_ps(result, _mm512_rsqrt14_ps(_mm512_loadu_ps(a)));
+}
+#endif // COMPILER_CAN_TARGET_AVX512
+
+#endif // ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+
+#define _SIMD_PROCS_BASIC { \
+	SIMD_LEVEL_BASIC, \
+	_simd_add_float32_256_basic, _simd_sub_float32_256_basic, _simd_mul_float32_256_basic, _simd_div_float32_256_basic, \
+	_simd_sqrt_float32_256_basic, _simd_rsqrt_float32_256_basic, \
+	_simd_add_int32_256_basic, _simd_sub_int32_256_basic, _simd_mul_int32_256_basic, \
+	_simd_add_float32_512_basic, _simd_sub_float32_512_basic, _simd_mul_float32_512_basic, _simd_div_float32_512_basic, \
+	_simd_sqrt_float32_512_basic, _simd_rsqrt_float32_512_basic, \
+	_simd_add_int32_512_basic, _simd_sub_int32_512_basic, _simd_mul_int32_512_basic, \
+	_simd_add_float32_array_basic, _simd_sub_float32_array_basic, _simd_mul_float32_array_basic, _simd_div_float32_array_basic, \
+}
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Simd_Procs simd_procs = _SIMD_PROCS_BASIC;
+
+void 
+simd_procs_init(Cpu_Capabilities cpu, Simd_Level max_level) {
+	Simd_Procs p = _SIMD_PROCS_BASIC;
+	
+#if ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	if (max_level >= SIMD_LEVEL_SSE && cpu.sse2) {
+		p.level = SIMD_LEVEL_SSE;
+		p.add_float32_array = _simd_add_float32_array_sse;
+		p.sub_float32_array = _simd_sub_float32_array_sse;
+		p.mul_float32_array = _simd_mul_float32_array_sse;
+		p.div_float32_array = _simd_div_float32_array_sse;
+	}
+#if COMPILER_CAN_TARGET_AVX
+	if (max_level >= SIMD_LEVEL_AVX && cpu.avx) {
+		p.level = SIMD_LEVEL_AVX;
+		p.add_float32_256   = _simd_add_float32_256_avx;
+		p.sub_float32_256   = _simd_sub_float32_256_avx;
+		p.mul_float32_256   = _simd_mul_float32_256_avx;
+		p.div_float32_256   = _simd_div_float32_256_avx;
+		p.sqrt_float32_256  = _simd_sqrt_float32_256_avx;
+		p.rsqrt_float32_256 = _simd_rsqrt_float32_256_avx;
+		p.add_float32_512   = _simd_add_float32_512_avx;
+		p.sub_float32_512   = _simd_sub_float32_512_avx;
+		p.mul_float32_512   = _simd_mul_float32_512_avx;
+		p.div_float32_512   = _simd_div_float32_512_avx;
+		p.sqrt_float32_512  = _simd_sqrt_float32_512_avx;
+		p.rsqrt_float32_512 = _simd_rsqrt_float32_512_avx;
+		p.add_float32_array = _simd_add_float32_array_avx;
+		p.sub_float32_array = _simd_sub_float32_array_avx;
+		p.mul_float32_array = _simd_mul_float32_array_avx;
+		p.div_float32_array = _simd_div_float32_array_avx;
+	}
+#endif
+#if COMPILER_CAN_TARGET_AVX2
+	if (max_level >= SIMD_LEVEL_AVX2 && cpu.avx2) {
+		p.level = SIMD_LEVEL_AVX2;
+		p.add_int32_256 = _simd_add_int32_256_avx2;
+		p.sub_int32_256 = _simd_sub_int32_256_avx2;
+		p.mul_int32_256 = _simd_mul_int32_256_avx2;
+		p.add_int32_512 = _simd_add_int32_512_avx2;
+		p.sub_int32_512 = _simd_sub_int32_512_avx2;
+		p.mul_int32_512 = _simd_mul_int32_512_avx2;
+	}
+#endif
+#if COMPILER_CAN_TARGET_AVX512
+	if (max_level >= SIMD_LEVEL_AVX512 && cpu.avx512) {
+		p.level = SIMD_LEVEL_AVX512;
+		p.add_float32_512   = _simd_add_float32_512_avx512;
+		p.sub_float32_512   = _simd_sub_float32_512_avx512;
+		p.mul_float32_512   = _simd_mul_float32_512_avx512;
+		p.div_float32_512   = _simd_div_float32_512_avx512;
+		p.sqrt_float32_512  = _simd_sqrt_float32_512_avx512;
+		p.rsqrt_float32_512 = _simd_rsqrt_float32_512_avx512;
+		p.add_int32_512     = _simd_add_int32_512_avx512;
+		p.sub_int32_512     = _simd_sub_int32_512_avx512;
+		p.mul_int32_512     = _simd_mul_int32_512_avx512;
+		p.add_float32_array = _simd_add_float32_array_avx512;
+		p.sub_float32_array = _simd_sub_float32_array_avx512;
+		p.mul_float32_array = _simd_mul_float32_array_avx512;
+		p.div_float32_array = _simd_div_float32_array_avx512;
+	}
+#endif
+#endif // ENABLE_SIMD && COMPILER_CAN_DO_SSE2
+	
+	simd_procs = p;
+}
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
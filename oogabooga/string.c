@@ -79,7 +79,36 @@ strings_match(string a, string b) {
 	// Count match, pointer match: they are the same
 	if (a.data == b.data) return true;
 
+#if COMPILER_CAN_DO_SSE2
+	// Most strings we compare are short (names, keys, extensions), where calling memcmp costs
+	// more than the compare itself.
+	u64 n = a.count;
+	if (n >= 16) {
+		u64 i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m128i va = _mm_loadu_si128((const __m128i*)(a.data+i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b.data+i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) return false;
+		}
+		if (i == n) return true;
+		// The last block overlaps the one before it
+		__m128i va = _mm_loadu_si128((const __m128i*)(a.data+n-16));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b.data+n-16));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) == 0xFFFF;
+	}
+	if (n >= 8) {
+		u64 a0, a1, b0, b1;
+		memcpy(&a0, a.data, 8); memcpy(&a1, a.data+n-8, 8);
+		memcpy(&b0, b.data, 8); memcpy(&b1, b.data+n-8, 8);
+		return a0 == b0 && a1 == b1;
+	}
+	for (u64 i = 0; i < n; i++) {
+		if (a.data[i] != b.data[i]) return false;
+	}
+	return true;
+#else
 	return memcmp(a.data, b.data, a.count) == 0;
+#endif
 }
 
 string 
@@ -95,28 +124,229 @@ string_view(string s, u64 start_index, u64 count) {
 	return result;
 }
 
+///
+// String search
+// strings_match & string_find_* look at 16 (SSE2) or 32 (AVX2) bytes at a time, whichever the
+// cpu can do. They follow simd_procs.level (see simd_procs_init()): AVX2 and up use the 32 byte
+// versions, SSE & AVX the 16 byte ones. Before oogabooga_init that's the scalar versions.
+// Substring search compares the first and the last byte of sub against a whole block of
+// positions at once, and only compares the whole of sub where both matched. In real text
+// that's very few positions, so it runs about as fast as searching for a single byte.
+
+#define STRING_AVX2_MIN_COUNT 64
+
+// Scalar versions, also used for what's left over after the simd blocks.
+// Substring search looks at positions [start, end) and sub.count must be at least 2.
+s64
+_string_find_byte_from_left_scalar(const u8 *p, u64 start, u64 end, u8 c) {
+	for (u64 i = start; i < end; i++) {
+		if (p[i] == c) return (s64)i;
+	}
+	return -1;
+}
+s64
+_string_find_byte_from_right_scalar(const u8 *p, u64 start, u64 end, u8 c) {
+	for (u64 i = end; i > start; i--) {
+		if (p[i-1] == c) return (s64)(i-1);
+	}
+	return -1;
+}
+s64
+_string_find_from_left_scalar(const u8 *p, u64 start, u64 end, string sub) {
+	u8 first = sub.data[0];
+	u8 last = sub.data[sub.count-1];
+	for (u64 i = start; i < end; i++) {
+		if (p[i] == first && p[i+sub.count-1] == last && memcmp(p+i+1, sub.data+1, sub.count-2) == 0) return (s64)i;
+	}
+	return -1;
+}
+s64
+_string_find_from_right_scalar(const u8 *p, u64 start, u64 end, string sub) {
+	u8 first = sub.data[0];
+	u8 last = sub.data[sub.count-1];
+	for (u64 i = end; i > start; i--) {
+		u64 j = i-1;
+		if (p[j] == first && p[j+sub.count-1] == last && memcmp(p+j+1, sub.data+1, sub.count-2) == 0) return (s64)j;
+	}
+	return -1;
+}
+
+#if COMPILER_CAN_DO_SSE2
+s64
+_string_find_byte_from_left_sse2(const u8 *p, u64 count, u8 c) {
+	__m128i needle = _mm_set1_epi8((char)c);
+	u64 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p+i)), needle));
+		if (mask) return (s64)(i + bit_scan_forward_64(mask));
+	}
+	return _string_find_byte_from_left_scalar(p, i, count, c);
+}
+s64
+_string_find_byte_from_right_sse2(const u8 *p, u64 count, u8 c) {
+	__m128i needle = _mm_set1_epi8((char)c);
+	u64 i = count;
+	for (; i >= 16; i -= 16) {
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p+i-16)), needle));
+		if (mask) return (s64)(i-16 + bit_scan_reverse_64(mask));
+	}
+	return _string_find_byte_from_right_scalar(p, 0, i, c);
+}
+s64
+_string_find_from_left_sse2(const u8 *p, u64 count, string sub) {
+	__m128i first = _mm_set1_epi8((char)sub.data[0]);
+	__m128i last  = _mm_set1_epi8((char)sub.data[sub.count-1]);
+	u64 positions = count-sub.count+1;
+	u64 i = 0;
+	for (; i + 16 <= positions; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(p+i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(p+i+sub.count-1));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask) {
+			u32 bit = bit_scan_forward_64(mask);
+			if (memcmp(p+i+bit+1, sub.data+1, sub.count-2) == 0) return (s64)(i+bit);
+			mask &= mask-1;
+		}
+	}
+	return _string_find_from_left_scalar(p, i, positions, sub);
+}
+s64
+_string_find_from_right_sse2(const u8 *p, u64 count, string sub) {
+	__m128i first = _mm_set1_epi8((char)sub.data[0]);
+	__m128i last  = _mm_set1_epi8((char)sub.data[sub.count-1]);
+	u64 i = count-sub.count+1;
+	for (; i >= 16; i -= 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(p+i-16));
+		__m128i b = _mm_loadu_si128((const __m128i*)(p+i-16+sub.count-1));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask) {
+			u32 bit = bit_scan_reverse_64(mask);
+			if (memcmp(p+i-16+bit+1, sub.data+1, sub.count-2) == 0) return (s64)(i-16+bit);
+			mask &= ~(1u << bit);
+		}
+	}
+	return _string_find_from_right_scalar(p, 0, i, sub);
+}
+#endif // COMPILER_CAN_DO_SSE2
+
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+target_avx2 s64
+_string_find_byte_from_left_avx2(const u8 *p, u64 count, u8 c) {
+	__m256i needle = _mm256_set1_epi8((char)c);
+	u64 i = 0;
+	for (; i + 32 <= count; i += 32) {
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p+i)), needle));
+		if (mask) return (s64)(i + bit_scan_forward_64(mask));
+	}
+	return _string_find_byte_from_left_scalar(p, i, count, c);
+}
+target_avx2 s64
+_string_find_byte_from_right_avx2(const u8 *p, u64 count, u8 c) {
+	__m256i needle = _mm256_set1_epi8((char)c);
+	u64 i = count;
+	for (; i >= 32; i -= 32) {
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p+i-32)), needle));
+		if (mask) return (s64)(i-32 + bit_scan_reverse_64(mask));
+	}
+	return _string_find_byte_from_right_scalar(p, 0, i, c);
+}
+target_avx2 s64
+_string_find_from_left_avx2(const u8 *p, u64 count, string sub) {
+	__m256i first = _mm256_set1_epi8((char)sub.data[0]);
+	__m256i last  = _mm256_set1_epi8((char)sub.data[sub.count-1]);
+	u64 positions = count-sub.count+1;
+	u64 i = 0;
+	for (; i + 32 <= positions; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(p+i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(p+i+sub.count-1));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask) {
+			u32 bit = bit_scan_forward_64(mask);
+			if (memcmp(p+i+bit+1, sub.data+1, sub.count-2) == 0) return (s64)(i+bit);
+			mask &= mask-1;
+		}
+	}
+	return _string_find_from_left_scalar(p, i, positions, sub);
+}
+target_avx2 s64
+_string_find_from_right_avx2(const u8 *p, u64 count, string sub) {
+	__m256i first = _mm256_set1_epi8((char)sub.data[0]);
+	__m256i last  = _mm256_set1_epi8((char)sub.data[sub.count-1]);
+	u64 i = count-sub.count+1;
+	for (; i >= 32; i -= 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(p+i-32));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(p+i-32+sub.count-1));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask) {
+			u32 bit = bit_scan_reverse_64(mask);
+			if (memcmp(p+i-32+bit+1, sub.data+1, sub.count-2) == 0) return (s64)(i-32+bit);
+			mask &= ~(1u << bit);
+		}
+	}
+	return _string_find_from_right_scalar(p, 0, i, sub);
+}
+#endif // COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+
+// Returns first index from left where c is in s. Returns -1 if it isn't.
+s64
+string_find_byte_from_left(string s, u8 c) {
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	// Short strings are mostly leftovers after the blocks, better done in 16 byte blocks
+	if (simd_procs.level >= SIMD_LEVEL_AVX2 && s.count >= STRING_AVX2_MIN_COUNT) return _string_find_byte_from_left_avx2(s.data, s.count, c);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _string_find_byte_from_left_sse2(s.data, s.count, c);
+#endif
+	return _string_find_byte_from_left_scalar(s.data, 0, s.count, c);
+}
+
+// Returns first index from right where c is in s. Returns -1 if it isn't.
+s64
+string_find_byte_from_right(string s, u8 c) {
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	// Short strings are mostly leftovers after the blocks, better done in 16 byte blocks
+	if (simd_procs.level >= SIMD_LEVEL_AVX2 && s.count >= STRING_AVX2_MIN_COUNT) return _string_find_byte_from_right_avx2(s.data, s.count, c);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _string_find_byte_from_right_sse2(s.data, s.count, c);
+#endif
+	return _string_find_byte_from_right_scalar(s.data, 0, s.count, c);
+}
+
 // Returns first index from left where "sub" matches in "s". Returns -1 if no match is found.
+// An empty sub matches at 0.
 s64 
 string_find_from_left(string s, string sub) {
-	for (s64 i = 0; i <= s.count-sub.count; i++) {
-		if (strings_match(string_view(s, i, sub.count), sub)) {
-			return i;
-		}
-	}
+	if (sub.count > s.count) return -1;
+	if (sub.count == 0) return 0;
+	if (sub.count == 1) return string_find_byte_from_left(s, sub.data[0]);
 	
-	return -1;
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	// Short strings are mostly leftovers after the blocks, better done in 16 byte blocks
+	if (simd_procs.level >= SIMD_LEVEL_AVX2 && s.count >= STRING_AVX2_MIN_COUNT) return _string_find_from_left_avx2(s.data, s.count, sub);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _string_find_from_left_sse2(s.data, s.count, sub);
+#endif
+	return _string_find_from_left_scalar(s.data, 0, s.count-sub.count+1, sub);
 }
 
 // Returns first index from right where "sub" matches in "s" Returns -1 if no match is found.
+// An empty sub matches at s.count.
 s64 
 string_find_from_right(string s, string sub) {
-	for (s64 i = s.count-sub.count; i >= 0 ; i--) {
-		if (strings_match(string_view(s, i, sub.count), sub)) {
-			return i;
-		}
-	}
+	if (sub.count > s.count) return -1;
+	if (sub.count == 0) return (s64)s.count;
+	if (sub.count == 1) return string_find_byte_from_right(s, sub.data[0]);
 	
-	return -1;
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	// Short strings are mostly leftovers after the blocks, better done in 16 byte blocks
+	if (simd_procs.level >= SIMD_LEVEL_AVX2 && s.count >= STRING_AVX2_MIN_COUNT) return _string_find_from_right_avx2(s.data, s.count, sub);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _string_find_from_right_sse2(s.data, s.count, sub);
+#endif
+	return _string_find_from_right_scalar(s.data, 0, s.count-sub.count+1, sub);
 }
 
 bool 
@@ -128,6 +358,16 @@ string_starts_with(string s, string sub) {
 	return strings_match(s, sub);
 }
 
+bool 
+string_ends_with(string s, string sub) {
+	if (s.count < sub.count) return false;
+	
+	s.data += s.count-sub.count;
+	s.count = sub.count;
+	
+	return strings_match(s, sub);
+}
+
 string
 string_copy(string s, Allocator allocator) {
 	string c = alloc_string(allocator, s.count);
@@ -185,27 +425,202 @@ string_builder_get_string(String_Builder b) {
 	return b.result;
 }
 
+///
+// Chunked_String_Builder
+// Like String_Builder, but the text is kept in a list of chunks instead of one buffer that is
+// reallocated and copied as it grows. Appending never moves what's already there, printing
+// formats straight into the last chunk, and chunked_string_builder_write_to_file() writes the
+// chunks as they are. For big outputs like traces, exports & save files.
+// chunked_string_builder_to_contiguous() copies it all into one string, for when you really
+// need that.
+
+#define CHUNKED_STRING_BUILDER_DEFAULT_CHUNK_SIZE (64*1024)
+
+typedef struct String_Chunk String_Chunk;
+typedef struct String_Chunk {
+	String_Chunk *next;
+	u8 *data;
+	u64 count;
+	u64 capacity; // 0 if data isn't ours, see chunked_string_builder_append_reference()
+} String_Chunk;
+
+typedef struct Chunked_String_Builder {
+	String_Chunk *first;
+	String_Chunk *last;
+	u64 count; // All chunks together
+	u64 chunk_count;
+	u64 chunk_size;
+	Allocator allocator;
+} Chunked_String_Builder;
+
+void
+chunked_string_builder_init_chunk_size(Chunked_String_Builder *b, u64 chunk_size, Allocator allocator) {
+	memset(b, 0, sizeof(*b));
+	b->chunk_size = max(chunk_size, 128);
+	b->allocator = allocator;
+}
+void
+chunked_string_builder_init(Chunked_String_Builder *b, Allocator allocator) {
+	chunked_string_builder_init_chunk_size(b, CHUNKED_STRING_BUILDER_DEFAULT_CHUNK_SIZE, allocator);
+}
+// Frees all the chunks. The builder can be used again after.
+void
+chunked_string_builder_reset(Chunked_String_Builder *b) {
+	String_Chunk *c = b->first;
+	while (c) {
+		String_Chunk *next = c->next;
+		dealloc(b->allocator, c);
+		c = next;
+	}
+	b->first = 0;
+	b->last = 0;
+	b->count = 0;
+	b->chunk_count = 0;
+}
+
+// Free bytes at the end of a chunk. Referenced chunks have none.
+inline u64
+_string_chunk_room(String_Chunk *c) {
+	return c->capacity > c->count ? c->capacity-c->count : 0;
+}
+
+void
+_chunked_string_builder_link(Chunked_String_Builder *b, String_Chunk *c) {
+	c->next = 0;
+	if (b->last) b->last->next = c;
+	else         b->first = c;
+	b->last = c;
+	b->chunk_count += 1;
+}
+
+// Returns room for at least size bytes at the end of the last chunk, adding a chunk if there
+// isn't enough. Write there and then call chunked_string_builder_commit() with how much you
+// wrote.
+u8 *
+chunked_string_builder_reserve_tail(Chunked_String_Builder *b, u64 size) {
+	assert(b->allocator.proc, "Chunked_String_Builder is missing allocator");
+	
+	String_Chunk *last = b->last;
+	if (!last || _string_chunk_room(last) < size) {
+		u64 capacity = max(size, b->chunk_size);
+		// Header and data in one allocation
+		last = (String_Chunk*)alloc(b->allocator, sizeof(String_Chunk)+capacity);
+		last->data = (u8*)(last+1);
+		last->count = 0;
+		last->capacity = capacity;
+		_chunked_string_builder_link(b, last);
+	}
+	return last->data+last->count;
+}
+void
+chunked_string_builder_commit(Chunked_String_Builder *b, u64 size) {
+	assert(b->last && b->last->count+size <= b->last->capacity, "Committed more than was reserved");
+	b->last->count += size;
+	b->count += size;
+}
+
+void
+chunked_string_builder_append(Chunked_String_Builder *b, string s) {
+	if (s.count == 0) return;
+	
+	// Fill up the last chunk, the rest goes in a new one
+	String_Chunk *last = b->last;
+	if (last && _string_chunk_room(last) > 0) {
+		u64 n = min(s.count, _string_chunk_room(last));
+		memcpy(last->data+last->count, s.data, n);
+		chunked_string_builder_commit(b, n);
+		s.data  += n;
+		s.count -= n;
+	}
+	if (s.count > 0) {
+		u8 *p = chunked_string_builder_reserve_tail(b, s.count);
+		memcpy(p, s.data, s.count);
+		chunked_string_builder_commit(b, s.count);
+	}
+}
+// Adds s as a chunk of its own, without copying it. s must stay alive and unchanged for as
+// long as the builder is used. Worth it for big strings, small ones are cheaper to append.
+void
+chunked_string_builder_append_reference(Chunked_String_Builder *b, string s) {
+	assert(b->allocator.proc, "Chunked_String_Builder is missing allocator");
+	if (s.count == 0) return;
+	
+	String_Chunk *c = (String_Chunk*)alloc(b->allocator, sizeof(String_Chunk));
+	c->data = s.data;
+	c->count = s.count;
+	c->capacity = 0;
+	_chunked_string_builder_link(b, c);
+	b->count += s.count;
+}
+
+// Copies all the chunks into one string
+string
+chunked_string_builder_to_contiguous(Chunked_String_Builder *b, Allocator allocator) {
+	if (b->count == 0) return null_string;
+	
+	string result = alloc_string(allocator, b->count);
+	u64 offset = 0;
+	for (String_Chunk *c = b->first; c; c = c->next) {
+		memcpy(result.data+offset, c->data, c->count);
+		offset += c->count;
+	}
+	return result;
+}
+
 
 string 
 string_replace_all(string s, string old, string new, Allocator allocator) {
 
 	if (!s.data || !s.count) return string_copy(null_string, allocator);
+	if (old.count == 0) return string_copy(s, allocator);
 
-	String_Builder builder;
-	string_builder_init_reserve(&builder, s.count, allocator);
-	
-	while (s.count > 0) {
-		if (s.count >= old.count && strings_match(string_view(s, 0, old.count), old)) {
-			if (new.count != 0) string_builder_append(&builder, new);
-			s.data += old.count;
-			s.count -= old.count;
-		} else {
-			string_builder_append(&builder, string_view(s, 0, 1));
-			s.data += 1;
-			s.count -= 1;
+	// Find the matches first, so the result is allocated once at its exact size.
+	// Offsets go on the stack and spill to the heap if there are a lot of them. Not into
+	// temporary storage, since there can be any number and s, old & new are often in there.
+	#define REPLACE_LOCAL_MATCH_COUNT 64
+	u64 local_matches[REPLACE_LOCAL_MATCH_COUNT];
+	u64 *matches = local_matches;
+	u64 match_capacity = REPLACE_LOCAL_MATCH_COUNT;
+	u64 match_count = 0;
+	u64 offset = 0;
+	while (true) {
+		string rest;
+		rest.data  = s.data  + offset;
+		rest.count = s.count - offset;
+		s64 index = string_find_from_left(rest, old);
+		if (index < 0) break;
+		if (match_count == match_capacity) {
+			u64 *new_matches = (u64*)alloc(get_heap_allocator(), match_capacity*2*sizeof(u64));
+			memcpy(new_matches, matches, match_count*sizeof(u64));
+			if (matches != local_matches) dealloc(get_heap_allocator(), matches);
+			matches = new_matches;
+			match_capacity *= 2;
 		}
+		matches[match_count++] = offset + index;
+		offset += index + old.count;
 	}
+	#undef REPLACE_LOCAL_MATCH_COUNT
+	if (match_count == 0) return string_copy(s, allocator);
 	
-	return string_builder_get_string(builder);
-}
+	u64 result_count = s.count - match_count*old.count + match_count*new.count;
+	if (result_count == 0) {
+		if (matches != local_matches) dealloc(get_heap_allocator(), matches);
+		return null_string;
+	}
+	string result = alloc_string(allocator, result_count);
+	
+	u8 *out = result.data;
+	offset = 0;
+	for (u64 i = 0; i < match_count; i++) {
+		memcpy(out, s.data+offset, matches[i]-offset);
+		out += matches[i]-offset;
+		memcpy(out, new.data, new.count);
+		out += new.count;
+		offset = matches[i] + old.count;
+	}
+	memcpy(out, s.data+offset, s.count-offset);
 	
+	if (matches != local_matches) dealloc(get_heap_allocator(), matches);
+	
+	return result;
+}
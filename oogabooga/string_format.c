@@ -4,45 +4,802 @@ inline int crt_sprintf(char *str, const char *format, ...);
 int vsnprintf(char* buffer, size_t n, const char* fmt, va_list args);
 bool is_pointer_valid(void *p);
 
-u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list args) {
+///
+// Number formatting
+// Integers & floats are formatted here, without the CRT. Floats with a precision (%f %e %g)
+// are correctly rounded from their exact binary value, ties to even, like a conforming printf.
+//
+// We extend the standard formatting with %r, which prints the shortest digits that read back
+// as the same double, or float32 with %hr. That's what you want when saving floats as text.
+// It's Grisu2, which is always correct and almost always the shortest.
+
+#define FORMAT_MAX_PRECISION 500
+// Fits %f of the biggest double with FORMAT_MAX_PRECISION
+#define FORMAT_NUMBER_BUFFER_SIZE 1024
+// The exact decimal expansion of any double has at most 767 significant digits
+#define FORMAT_MAX_DIGITS 800
+#define FORMAT_BIG_LIMBS 90
+
+typedef struct Format_Spec {
+	bool left_justify; // -
+	bool force_sign;   // +
+	bool space_sign;   // ' '
+	bool alternate;    // #
+	bool zero_pad;     // 0
+	bool long_double;  // L
+	bool wide;         // l, for %ls & %lc. Not in length since long is 4 bytes on windows.
+	s32 width;
+	s32 precision;     // -1 if not specified
+	s32 length;        // Bytes of the integer argument, 0 for int
+} Format_Spec;
+
+// Decimal digits of a float, value is 0.digits * 10^point
+typedef struct Format_Digits {
+	char digits[FORMAT_MAX_DIGITS];
+	s32 count;   // No leading or trailing zeros. 0 if the value is 0.
+	s32 point;
+	bool sticky; // There are more nonzero digits after these
+} Format_Digits;
+
+const char _format_digit_pairs[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// Writes the digits of value right aligned, ending at end. Returns how many.
+s32
+_format_u64_decimal(u64 value, char *end) {
+	char *p = end;
+	while (value >= 100) {
+		u64 pair = (value % 100)*2;
+		value /= 100;
+		p -= 2;
+		p[0] = _format_digit_pairs[pair];
+		p[1] = _format_digit_pairs[pair+1];
+	}
+	if (value >= 10) {
+		p -= 2;
+		p[0] = _format_digit_pairs[value*2];
+		p[1] = _format_digit_pairs[value*2+1];
+	} else {
+		p -= 1;
+		p[0] = (char)('0' + value);
+	}
+	return (s32)(end-p);
+}
+
+///
+// Exact digits with a big integer, for floats too big or too small for the u64 path
+
+typedef struct Format_Big {
+	u32 limbs[FORMAT_BIG_LIMBS];
+	s32 count;
+} Format_Big;
+
+void
+_format_big_trim(Format_Big *b) {
+	while (b->count > 0 && b->limbs[b->count-1] == 0) b->count -= 1;
+}
+void
+_format_big_mul_small(Format_Big *b, u32 m) {
+	u64 carry = 0;
+	for (s32 i = 0; i < b->count; i++) {
+		u64 x = (u64)b->limbs[i]*m + carry;
+		b->limbs[i] = (u32)x;
+		carry = x >> 32;
+	}
+	if (carry) b->limbs[b->count++] = (u32)carry;
+}
+void
+_format_big_shift_left(Format_Big *b, s32 shift) {
+	s32 words = shift/32;
+	s32 bits = shift%32;
+	if (bits) {
+		b->limbs[b->count] = 0;
+		for (s32 i = b->count; i > 0; i--) {
+			b->limbs[i] = (b->limbs[i] << bits) | (b->limbs[i-1] >> (32-bits));
+		}
+		b->limbs[0] <<= bits;
+		b->count += 1;
+	}
+	if (words) {
+		memmove(b->limbs+words, b->limbs, b->count*sizeof(u32));
+		memset(b->limbs, 0, words*sizeof(u32));
+		b->count += words;
+	}
+	_format_big_trim(b);
+}
+// Returns the remainder
+u32
+_format_big_div_small(Format_Big *b, u32 d) {
+	u64 remainder = 0;
+	for (s32 i = b->count-1; i >= 0; i--) {
+		u64 x = (remainder << 32) | b->limbs[i];
+		b->limbs[i] = (u32)(x/d);
+		remainder = x%d;
+	}
+	_format_big_trim(b);
+	return (u32)remainder;
+}
+
+// All the digits of mantissa * 2^exponent
+void
+_format_exact_digits_big(u64 mantissa, s32 exponent, Format_Digits *d) {
+	Format_Big b;
+	b.limbs[0] = (u32)mantissa;
+	b.limbs[1] = (u32)(mantissa >> 32);
+	b.count = 2;
+	_format_big_trim(&b);
+
+	if (exponent >= 0) {
+		_format_big_shift_left(&b, exponent);
+	} else {
+		// m * 2^-k = m * 5^k / 10^k
+		const u32 pow5[14] = {1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625, 48828125, 244140625, 1220703125};
+		for (s32 k = -exponent; k > 0; k -= 13) _format_big_mul_small(&b, pow5[min(k, 13)]);
+	}
+
+	// 9 digits at a time from the bottom
+	char reversed[FORMAT_MAX_DIGITS+9];
+	s32 n = 0;
+	while (b.count > 0) {
+		u32 chunk = _format_big_div_small(&b, 1000000000);
+		for (s32 i = 0; i < 9; i++) {
+			reversed[n++] = (char)('0' + chunk%10);
+			chunk /= 10;
+		}
+	}
+	while (n > 0 && reversed[n-1] == '0') n -= 1;
+	s32 trailing_zeros = 0;
+	while (trailing_zeros < n && reversed[trailing_zeros] == '0') trailing_zeros += 1;
+
+	d->count = n-trailing_zeros;
+	for (s32 i = 0; i < d->count; i++) d->digits[i] = reversed[n-1-i];
+	d->point = exponent < 0 ? n+exponent : n;
+	d->sticky = false;
+}
+
+// Digits of mantissa * 2^exponent, up to max_significant digits or max_fraction digits after
+// the point, whichever comes first. Must be at least one more than what's going to be kept,
+// so rounding can see the next digit.
+void
+_format_exact_digits(u64 mantissa, s32 exponent, s32 max_significant, s32 max_fraction, Format_Digits *d) {
+	if (mantissa == 0) {
+		d->count = 0;
+		d->point = 1;
+		d->sticky = false;
+		return;
+	}
+
+	if (exponent < 0) {
+		s32 zeros = min((s32)bit_scan_forward_64(mantissa), -exponent);
+		mantissa >>= zeros;
+		exponent += zeros;
+	}
+
+	// Fast path for everything from about 0.004 to 2^64, which is most numbers people print
+	bool fits_integer = exponent >= 0 && (s32)bit_scan_reverse_64(mantissa) + exponent < 64;
+	bool fits_fraction = exponent < 0 && exponent >= -60;
+	if (!fits_integer && !fits_fraction) {
+		_format_exact_digits_big(mantissa, exponent, d);
+		return;
+	}
+
+	u64 integer = fits_integer ? mantissa << exponent : mantissa >> -exponent;
+	s32 shift = fits_integer ? 0 : -exponent;
+	u64 fraction_mask = fits_integer ? 0 : ((u64)1 << shift)-1;
+	u64 fraction = mantissa & fraction_mask;
+
+	d->count = 0;
+	d->point = 0;
+	if (integer) {
+		char temp[20];
+		d->count = _format_u64_decimal(integer, temp+20);
+		memcpy(d->digits, temp+20-d->count, d->count);
+		d->point = d->count;
+	}
+
+	// fraction < 2^60, so fraction*10 can't overflow
+	s32 fraction_digits = 0;
+	while (fraction && fraction_digits < max_fraction && d->count < max_significant) {
+		fraction *= 10;
+		char digit = (char)(fraction >> shift);
+		fraction &= fraction_mask;
+		fraction_digits += 1;
+		if (d->count == 0 && digit == 0) {
+			d->point -= 1;
+		} else {
+			d->digits[d->count++] = '0' + digit;
+		}
+	}
+	d->sticky = fraction != 0;
+
+	while (d->count > 0 && d->digits[d->count-1] == '0') d->count -= 1;
+}
+
+// Rounds to the first keep digits, ties to even
+void
+_format_round_digits(Format_Digits *d, s32 keep) {
+	if (keep >= d->count) return; // Next digit is a 0
+	if (keep < 0) {
+		d->count = 0;
+		d->sticky = false;
+		return;
+	}
+
+	s32 next = d->digits[keep]-'0';
+	bool rest = d->sticky || keep+1 < d->count; // Digits are stored without trailing zeros
+	bool odd = keep > 0 && ((d->digits[keep-1]-'0') & 1);
+	bool round_up = next > 5 || (next == 5 && (rest || odd));
+
+	d->count = keep;
+	d->sticky = false;
+	if (round_up) {
+		s32 i = keep-1;
+		while (i >= 0 && d->digits[i] == '9') i -= 1;
+		if (i < 0) {
+			d->digits[0] = '1';
+			d->count = 1;
+			d->point += 1;
+		} else {
+			d->digits[i] += 1;
+			d->count = i+1;
+		}
+	} else {
+		while (d->count > 0 && d->digits[d->count-1] == '0') d->count -= 1;
+	}
+}
+
+///
+// Shortest digits with Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers")
+
+typedef struct Format_Diy_Fp {
+	u64 f;
+	s32 e;
+} Format_Diy_Fp;
+
+// Normalized 10^k for k = -348, -340, ..., 340
+const Format_Diy_Fp _format_cached_powers[87] = {
+	{0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+	{0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+	{0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+	{0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+	{0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+	{0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+	{0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+	{0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+	{0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+	{0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+	{0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+	{0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+	{0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+	{0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+	{0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+	{0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+	{0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+	{0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+	{0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+	{0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+	{0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+	{0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+	{0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+	{0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+	{0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+	{0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+	{0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+	{0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+	{0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+Format_Diy_Fp
+_format_diy_fp_mul(Format_Diy_Fp a, Format_Diy_Fp b) {
+	const u64 m32 = 0xFFFFFFFF;
+	u64 ah = a.f >> 32, al = a.f & m32;
+	u64 bh = b.f >> 32, bl = b.f & m32;
+	u64 hh = ah*bh, lh = al*bh, hl = ah*bl, ll = al*bl;
+	u64 mid = (ll >> 32) + (hl & m32) + (lh & m32);
+	mid += (u64)1 << 31; // Round
+	Format_Diy_Fp r = {hh + (hl >> 32) + (lh >> 32) + (mid >> 32), a.e + b.e + 64};
+	return r;
+}
+
+Format_Diy_Fp
+_format_diy_fp_normalize(Format_Diy_Fp x) {
+	s32 shift = 63 - (s32)bit_scan_reverse_64(x.f);
+	x.f <<= shift;
+	x.e -= shift;
+	return x;
+}
+
+void
+_format_grisu_round(char *digits, s32 count, u64 delta, u64 rest, u64 ten_kappa, u64 wp_w) {
+	while (rest < wp_w && delta-rest >= ten_kappa && (rest+ten_kappa < wp_w || wp_w-rest > rest+ten_kappa-wp_w)) {
+		digits[count-1] -= 1;
+		rest += ten_kappa;
+	}
+}
+
+void
+_format_grisu_digit_gen(Format_Diy_Fp w, Format_Diy_Fp mp, u64 delta, char *digits, s32 *count, s32 *k) {
+	const u64 pow10[20] = {
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+		10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+		1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+	};
+	Format_Diy_Fp one = {(u64)1 << -mp.e, mp.e};
+	u64 wp_w = mp.f - w.f;
+	u32 p1 = (u32)(mp.f >> -one.e);
+	u64 p2 = mp.f & (one.f-1);
+
+	s32 kappa = 1;
+	while (kappa < 10 && p1 >= pow10[kappa]) kappa += 1;
+
+	*count = 0;
+	while (kappa > 0) {
+		u32 divisor = (u32)pow10[kappa-1];
+		u32 digit = p1/divisor;
+		p1 %= divisor;
+		if (digit || *count) digits[(*count)++] = (char)('0' + digit);
+		kappa -= 1;
+		u64 rest = ((u64)p1 << -one.e) + p2;
+		if (rest <= delta) {
+			*k += kappa;
+			_format_grisu_round(digits, *count, delta, rest, pow10[kappa] << -one.e, wp_w);
+			return;
+		}
+	}
+
+	while (true) {
+		p2 *= 10;
+		delta *= 10;
+		char digit = (char)(p2 >> -one.e);
+		if (digit || *count) digits[(*count)++] = '0' + digit;
+		p2 &= one.f-1;
+		kappa -= 1;
+		if (p2 < delta) {
+			*k += kappa;
+			_format_grisu_round(digits, *count, delta, p2, one.f, -kappa < 20 ? wp_w*pow10[-kappa] : 0);
+			return;
+		}
+	}
+}
+
+// mantissa * 2^exponent, where hidden_bit is the implicit leading bit of a normal number of
+// the type (2^52 for f64, 2^23 for f32), so the rounding boundaries are those of that type.
+void
+_format_shortest_digits(u64 mantissa, s32 exponent, u64 hidden_bit, bool lower_boundary_is_closer, Format_Digits *d) {
+	if (mantissa == 0) {
+		d->count = 0;
+		d->point = 1;
+		d->sticky = false;
+		return;
+	}
+
+	Format_Diy_Fp v = {mantissa, exponent};
+
+	// Halfway to the neighbouring floats. The one below is closer at powers of two.
+	Format_Diy_Fp plus = _format_diy_fp_normalize((Format_Diy_Fp){(v.f << 1) + 1, v.e - 1});
+	Format_Diy_Fp minus = lower_boundary_is_closer
+		? (Format_Diy_Fp){(v.f << 2) - 1, v.e - 2}
+		: (Format_Diy_Fp){(v.f << 1) - 1, v.e - 1};
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+
+	// Cached power that brings plus.e into [-60, -32]
+	f64 dk = (-61 - plus.e)*0.30102999566398114 + 347;
+	s32 k = (s32)dk;
+	if (dk - k > 0.0) k += 1;
+	u32 index = (u32)((k >> 3) + 1);
+	s32 decimal_exponent = -(-348 + (s32)index*8);
+	Format_Diy_Fp c = _format_cached_powers[index];
+
+	Format_Diy_Fp w = _format_diy_fp_mul(_format_diy_fp_normalize(v), c);
+	Format_Diy_Fp wp = _format_diy_fp_mul(plus, c);
+	Format_Diy_Fp wm = _format_diy_fp_mul(minus, c);
+	wm.f += 1;
+	wp.f -= 1;
+
+	s32 count;
+	_format_grisu_digit_gen(w, wp, wp.f - wm.f, d->digits, &count, &decimal_exponent);
+
+	d->count = count;
+	while (d->count > 0 && d->digits[d->count-1] == '0') d->count -= 1;
+	d->point = count + decimal_exponent;
+	d->sticky = false;
+}
+
+///
+// Float formatting. These write the number without its sign to out and return the length.
+
+s32
+_format_fixed(Format_Digits *d, s32 precision, bool alternate, char *out) {
+	s32 n = 0;
+	if (d->count == 0 || d->point <= 0) {
+		out[n++] = '0';
+	} else {
+		for (s32 i = 0; i < d->point; i++) out[n++] = i < d->count ? d->digits[i] : '0';
+	}
+	if (precision > 0 || alternate) out[n++] = '.';
+	for (s32 i = 0; i < precision; i++) {
+		s32 index = d->point + i;
+		out[n++] = (index >= 0 && index < d->count) ? d->digits[index] : '0';
+	}
+	return n;
+}
+
+s32
+_format_exponential(Format_Digits *d, s32 precision, bool alternate, bool upper, char *out) {
+	s32 n = 0;
+	out[n++] = d->count > 0 ? d->digits[0] : '0';
+	if (precision > 0 || alternate) out[n++] = '.';
+	for (s32 i = 1; i <= precision; i++) out[n++] = i < d->count ? d->digits[i] : '0';
+
+	s32 exponent = d->count > 0 ? d->point-1 : 0;
+	out[n++] = upper ? 'E' : 'e';
+	out[n++] = exponent < 0 ? '-' : '+';
+	if (exponent < 0) exponent = -exponent;
+	if (exponent >= 100) out[n++] = (char)('0' + exponent/100);
+	out[n++] = (char)('0' + (exponent/10)%10);
+	out[n++] = (char)('0' + exponent%10);
+	return n;
+}
+
+// Removes trailing zeros after the point, and the point if nothing is left after it
+s32
+_format_strip_fraction_zeros(char *out, s32 n) {
+	s32 point = -1;
+	s32 mantissa_end = n;
+	for (s32 i = 0; i < n; i++) {
+		if (out[i] == '.') point = i;
+		if (out[i] == 'e' || out[i] == 'E') { mantissa_end = i; break; }
+	}
+	if (point < 0) return n;
+
+	s32 end = mantissa_end;
+	while (end > point+1 && out[end-1] == '0') end -= 1;
+	if (end == point+1) end = point;
+	memmove(out+end, out+mantissa_end, n-mantissa_end);
+	return n - (mantissa_end-end);
+}
+
+// conversion is one of fFeEgGr. Sets *negative.
+s32
+_format_float(f64 value, char conversion, Format_Spec *spec, bool *negative, char *out) {
+	u64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	*negative = (bits >> 63) != 0;
+	s32 biased_exponent = (s32)((bits >> 52) & 0x7FF);
+	u64 fraction = bits & (((u64)1 << 52)-1);
+	bool upper = conversion >= 'A' && conversion <= 'Z';
+
+	if (biased_exponent == 0x7FF) {
+		const char *s = fraction ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf");
+		memcpy(out, s, 3);
+		return 3;
+	}
+
+	u64 mantissa = biased_exponent ? fraction | ((u64)1 << 52) : fraction;
+	s32 exponent = biased_exponent ? biased_exponent - 1075 : -1074;
+	s32 precision = min(spec->precision, FORMAT_MAX_PRECISION);
+
+	Format_Digits d;
+	switch (conversion) {
+		case 'f': case 'F': {
+			if (precision < 0) precision = 6;
+			_format_exact_digits(mantissa, exponent, FORMAT_MAX_DIGITS-1, precision+1, &d);
+			_format_round_digits(&d, d.point + precision);
+			return _format_fixed(&d, precision, spec->alternate, out);
+		}
+		case 'e': case 'E': {
+			if (precision < 0) precision = 6;
+			_format_exact_digits(mantissa, exponent, precision+2, FORMAT_MAX_DIGITS, &d);
+			_format_round_digits(&d, precision+1);
+			return _format_exponential(&d, precision, spec->alternate, upper, out);
+		}
+		case 'g': case 'G': {
+			if (precision < 0) precision = 6;
+			if (precision == 0) precision = 1;
+			_format_exact_digits(mantissa, exponent, precision+1, FORMAT_MAX_DIGITS, &d);
+			_format_round_digits(&d, precision);
+			s32 x = d.count > 0 ? d.point-1 : 0;
+			s32 n;
+			if (precision > x && x >= -4) n = _format_fixed(&d, precision-1-x, spec->alternate, out);
+			else                          n = _format_exponential(&d, precision-1, spec->alternate, upper, out);
+			return spec->alternate ? n : _format_strip_fraction_zeros(out, n);
+		}
+		case 'r': {
+			if (spec->length == 2) {
+				// %hr, the float32 that was promoted to this double
+				f32 f = (f32)value;
+				u32 f_bits;
+				memcpy(&f_bits, &f, sizeof(f_bits));
+				s32 f_biased_exponent = (s32)((f_bits >> 23) & 0xFF);
+				u64 f_fraction = f_bits & ((1u << 23)-1);
+				u64 f_mantissa = f_biased_exponent ? f_fraction | (1u << 23) : f_fraction;
+				s32 f_exponent = f_biased_exponent ? f_biased_exponent - 150 : -149;
+				_format_shortest_digits(f_mantissa, f_exponent, (u64)1 << 23, f_fraction == 0 && f_biased_exponent > 1, &d);
+			} else {
+				_format_shortest_digits(mantissa, exponent, (u64)1 << 52, fraction == 0 && biased_exponent > 1, &d);
+			}
+			s32 x = d.count > 0 ? d.point-1 : 0;
+			if (x >= -5 && x < 17) return _format_fixed(&d, max(d.count - d.point, 0), false, out);
+			return _format_exponential(&d, d.count > 0 ? d.count-1 : 0, false, false, out);
+		}
+		default: break;
+	}
+	return 0;
+}
+
+///
+// Output
+
+inline void
+_format_write(char *buffer, u64 count, char **bufp, const char *data, u64 size) {
+	u64 written = (u64)(*bufp - buffer);
+	if (size == 0 || written >= count-1) return;
+	if (size > count-1-written) size = count-1-written;
+	if (buffer) memcpy(*bufp, data, size);
+	*bufp += size;
+}
+inline void
+_format_write_repeat(char *buffer, u64 count, char **bufp, char c, u64 size) {
+	u64 written = (u64)(*bufp - buffer);
+	if (written >= count-1) return;
+	if (size > count-1-written) size = count-1-written;
+	if (buffer) memset(*bufp, c, size);
+	*bufp += size;
+}
+// prefix is the sign and/or 0x, which goes before zero padding
+void
+_format_write_padded(char *buffer, u64 count, char **bufp, Format_Spec *spec, bool allow_zero_pad, const char *prefix, s32 prefix_length, const char *body, s32 body_length) {
+	s32 length = prefix_length + body_length;
+	u64 padding = spec->width > length ? (u64)(spec->width - length) : 0;
+	bool zero_pad = spec->zero_pad && allow_zero_pad && !spec->left_justify;
+
+	if (!spec->left_justify && !zero_pad) _format_write_repeat(buffer, count, bufp, ' ', padding);
+	_format_write(buffer, count, bufp, prefix, prefix_length);
+	if (zero_pad) _format_write_repeat(buffer, count, bufp, '0', padding);
+	_format_write(buffer, count, bufp, body, body_length);
+	if (spec->left_justify) _format_write_repeat(buffer, count, bufp, ' ', padding);
+}
+
+u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list args_in) {
 	if (!buffer) count = UINT64_MAX;
+	
+	// Callers format the same va_list twice (once to measure, once to write), so we work on a copy
+	va_list args;
+	va_copy(args, args_in);
+	
     const char* p = fmt;
     char* bufp = buffer;
     while (*p != '\0' && (bufp - buffer) < count - 1) {
-        if (*p == '%') {
-            p += 1;
-            if (*p == 's') {
+        if (*p != '%') {
+        	// Copy everything up to the next % in one go
+        	const char *start = p;
+        	while (*p != '\0' && *p != '%') p += 1;
+        	_format_write(buffer, count, &bufp, start, (u64)(p-start));
+        	continue;
+        }
+        
+        p += 1;
+        
+        Format_Spec spec = ZERO(Format_Spec);
+        spec.precision = -1;
+        
+        while (true) {
+        	if      (*p == '-') spec.left_justify = true;
+        	else if (*p == '+') spec.force_sign = true;
+        	else if (*p == ' ') spec.space_sign = true;
+        	else if (*p == '#') spec.alternate = true;
+        	else if (*p == '0') spec.zero_pad = true;
+        	else break;
+        	p += 1;
+        }
+        
+        if (*p == '*') {
+        	p += 1;
+        	spec.width = va_arg(args, int);
+        	if (spec.width < 0) {
+        		spec.left_justify = true;
+        		spec.width = -spec.width;
+        	}
+        } else {
+        	while (*p >= '0' && *p <= '9') spec.width = spec.width*10 + (*p++ - '0');
+        }
+        
+        if (*p == '.') {
+        	p += 1;
+        	spec.precision = 0;
+        	if (*p == '*') {
+        		p += 1;
+        		spec.precision = va_arg(args, int);
+        		if (spec.precision < 0) spec.precision = -1;
+        	} else {
+        		while (*p >= '0' && *p <= '9') spec.precision = spec.precision*10 + (*p++ - '0');
+        	}
+        }
+        
+        const char *length_start = p;
+        switch (*p) {
+        	case 'h': p += 1; spec.length = 2; if (*p == 'h') { p += 1; spec.length = 1; } break;
+        	case 'l': {
+        		p += 1;
+        		spec.length = sizeof(long);
+        		spec.wide = true;
+        		if (*p == 'l') { p += 1; spec.length = 8; spec.wide = false; }
+        		break;
+        	}
+        	case 'j': p += 1; spec.length = 8; break;
+        	case 'z': p += 1; spec.length = sizeof(size_t); break;
+        	case 't': p += 1; spec.length = sizeof(void*); break;
+        	case 'L': p += 1; spec.long_double = true; break;
+        	case 'I': {
+        		// msvc style
+        		p += 1;
+        		if      (p[0] == '6' && p[1] == '4') { p += 2; spec.length = 8; }
+        		else if (p[0] == '3' && p[1] == '2') { p += 2; spec.length = 4; }
+        		else spec.length = sizeof(size_t);
+        		break;
+        	}
+        	default: break;
+        }
+        if (spec.length == 4) spec.length = 0; // Same as int
+        
+        char number[FORMAT_NUMBER_BUFFER_SIZE];
+        char *number_end = number + FORMAT_NUMBER_BUFFER_SIZE;
+        
+        char conversion = *p;
+        // %ls & %lc are wide, which the crt can have
+        if (conversion == 's' && spec.wide) conversion = 'S';
+        if (conversion == 'c' && spec.wide) conversion = 'C';
+        
+        switch (conversion) {
+        	case 's': {
             	// We replace %s formatting with our fixed length string
                 p += 1;
                 string s = va_arg(args, string);
                 assert(s.count < (1024ULL*1024ULL*1024ULL*256ULL), "Ypu passed something else than a fixed-length 'string' to %%s. Maybe you passed a char* and should do %%cs instead?");
-                for (u64 i = 0; i < s.count && (bufp - buffer) < count - 1; i++) {
-                	if (buffer) *bufp = s.data[i];
-                    bufp += 1;
-                }
-            } else if (*p == 'c' && *(p+1) == 's') {
-            	// We extend the standard formatting and add %cs so we can format c strings if we need to
-                p += 2;
-                char* s = va_arg(args, char*);
-                u64 len = 0;
-                while (*s != '\0' && (bufp - buffer) < count - 1) {
-                	assert(len < (1024ULL*1024ULL*1024ULL*1ULL), "The argument passed to %%cs is either way too big, missing null-termination or simply not a char*.");
-                	if (buffer) {
-                		*bufp = *s;
-                	}
-                	s += 1;
-                    bufp += 1;
-                    len += 1;
-                    assert(len < (1024ULL*1024ULL*1024ULL*1ULL), "The argument passed to %%cs is either way too big, missing null-termination or simply not a char*.");
-                }
-            } else {
-                // Fallback to standard vsnprintf
+                u64 length = s.count;
+                if (spec.precision >= 0 && (u64)spec.precision < length) length = (u64)spec.precision;
+                if (spec.width == 0) _format_write(buffer, count, &bufp, (char*)s.data, length);
+                else _format_write_padded(buffer, count, &bufp, &spec, false, 0, 0, (char*)s.data, (s32)length);
+                break;
+        	}
+        	case 'c': {
+        		if (p[1] == 's') {
+	            	// We extend the standard formatting and add %cs so we can format c strings if we need to
+	                p += 2;
+	                char* s = va_arg(args, char*);
+	                u64 length = 0;
+	                u64 max_length = spec.precision >= 0 ? (u64)spec.precision : UINT64_MAX;
+	                while (length < max_length && s[length] != '\0') {
+	                	length += 1;
+	                	assert(length < (1024ULL*1024ULL*1024ULL*1ULL), "The argument passed to %%cs is either way too big, missing null-termination or simply not a char*.");
+	                }
+	                if (spec.width == 0) _format_write(buffer, count, &bufp, s, length);
+	                else _format_write_padded(buffer, count, &bufp, &spec, false, 0, 0, s, (s32)length);
+        		} else {
+        			p += 1;
+        			char c = (char)va_arg(args, int);
+        			_format_write_padded(buffer, count, &bufp, &spec, false, 0, 0, &c, 1);
+        		}
+                break;
+        	}
+        	case 'd': case 'i': {
+        		p += 1;
+        		s64 value;
+        		if (spec.length == 8) value = va_arg(args, s64);
+        		else {
+        			int i = va_arg(args, int);
+        			value = spec.length == 1 ? (s8)i : spec.length == 2 ? (s16)i : i;
+        		}
+        		
+        		char sign[1];
+        		s32 sign_length = 0;
+        		if (value < 0)             sign[sign_length++] = '-';
+        		else if (spec.force_sign)  sign[sign_length++] = '+';
+        		else if (spec.space_sign)  sign[sign_length++] = ' ';
+        		u64 magnitude = value < 0 ? (u64)0 - (u64)value : (u64)value;
+        		
+        		s32 length = 0;
+        		if (magnitude != 0 || spec.precision != 0) length = _format_u64_decimal(magnitude, number_end);
+        		while (length < spec.precision && length < FORMAT_MAX_PRECISION) number_end[-(++length)] = '0';
+        		_format_write_padded(buffer, count, &bufp, &spec, spec.precision < 0, sign, sign_length, number_end-length, length);
+        		break;
+        	}
+        	case 'u': case 'x': case 'X': case 'o': case 'p': {
+        		p += 1;
+        		u64 value;
+        		if (conversion == 'p') {
+        			value = (u64)(uintptr_t)va_arg(args, void*);
+        			// Like the msvc crt, all the digits in upper case
+        			spec.precision = sizeof(void*)*2;
+        			conversion = 'X';
+        		} else if (spec.length == 8) {
+        			value = va_arg(args, u64);
+        		} else {
+        			unsigned int i = va_arg(args, unsigned int);
+        			value = spec.length == 1 ? (u8)i : spec.length == 2 ? (u16)i : i;
+        		}
+        		
+        		s32 length = 0;
+        		if (value != 0 || spec.precision != 0) {
+        			if (conversion == 'u') {
+        				length = _format_u64_decimal(value, number_end);
+        			} else {
+        				const char *hex = conversion == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+        				u32 bits = conversion == 'o' ? 3 : 4;
+        				u64 mask = conversion == 'o' ? 7 : 15;
+        				do {
+        					number_end[-(++length)] = hex[value & mask];
+        					value >>= bits;
+        				} while (value);
+        			}
+        		}
+        		
+        		char prefix[2];
+        		s32 prefix_length = 0;
+        		if (spec.alternate && conversion == 'o' && (length == 0 || number_end[-length] != '0') && spec.precision <= length) {
+        			prefix[prefix_length++] = '0';
+        		} else if (spec.alternate && (conversion == 'x' || conversion == 'X') && length > 0 && !(length == 1 && number_end[-1] == '0')) {
+        			prefix[prefix_length++] = '0';
+        			prefix[prefix_length++] = conversion;
+        		}
+        		while (length < spec.precision && length < FORMAT_MAX_PRECISION) number_end[-(++length)] = '0';
+        		_format_write_padded(buffer, count, &bufp, &spec, spec.precision < 0, prefix, prefix_length, number_end-length, length);
+        		break;
+        	}
+        	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'r': {
+        		p += 1;
+        		f64 value = spec.long_double ? (f64)va_arg(args, long double) : va_arg(args, f64);
+        		
+        		bool negative;
+        		s32 length = _format_float(value, conversion, &spec, &negative, number);
+        		
+        		char sign[1];
+        		s32 sign_length = 0;
+        		if (negative)             sign[sign_length++] = '-';
+        		else if (spec.force_sign) sign[sign_length++] = '+';
+        		else if (spec.space_sign) sign[sign_length++] = ' ';
+        		bool is_finite = number[0] >= '0' && number[0] <= '9';
+        		_format_write_padded(buffer, count, &bufp, &spec, is_finite, sign, sign_length, number, length);
+        		break;
+        	}
+        	case '%': {
+        		p += 1;
+        		_format_write(buffer, count, &bufp, "%", 1);
+        		break;
+        	}
+        	default: {
+                // Fallback to the crt for the rest (%a, %n, wide characters)
                 char temp_buffer[512];
                 char format_specifier[64];
                 int specifier_len = 0;
                 format_specifier[specifier_len++] = '%';
+                
+                // Width and precision may have come from * arguments which we already consumed,
+                // so we pass them to the crt as numbers.
+                if (spec.left_justify) format_specifier[specifier_len++] = '-';
+                if (spec.force_sign)   format_specifier[specifier_len++] = '+';
+                if (spec.space_sign)   format_specifier[specifier_len++] = ' ';
+                if (spec.alternate)    format_specifier[specifier_len++] = '#';
+                if (spec.zero_pad)     format_specifier[specifier_len++] = '0';
+                if (spec.width > 0) {
+                	s32 length = _format_u64_decimal((u64)spec.width, number_end);
+                	memcpy(format_specifier+specifier_len, number_end-length, length);
+                	specifier_len += length;
+                }
+                if (spec.precision >= 0) {
+                	format_specifier[specifier_len++] = '.';
+                	s32 length = _format_u64_decimal((u64)spec.precision, number_end);
+                	memcpy(format_specifier+specifier_len, number_end-length, length);
+                	specifier_len += length;
+                }
+                const char *spec_start = length_start;
+                while (spec_start < p && specifier_len < 48) format_specifier[specifier_len++] = *spec_start++;
 
-                while (*p != '\0' && strchr("diuoxXfFeEgGaAcCpn%", *p) == NULL) {
+                while (*p != '\0' && strchr("diuoxXfFeEgGaAcCpnsS%", *p) == NULL && specifier_len < 62) {
                     format_specifier[specifier_len++] = *p++;
                 }
                 if (*p != '\0') {
@@ -50,37 +807,31 @@ u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list ar
                 }
                 format_specifier[specifier_len] = '\0';
 
-                int temp_len = vsnprintf(temp_buffer, sizeof(temp_buffer), format_specifier, args);
+				va_list crt_args;
+				va_copy(crt_args, args);
+                int temp_len = vsnprintf(temp_buffer, sizeof(temp_buffer), format_specifier, crt_args);
+                va_end(crt_args);
                 switch (format_specifier[specifier_len - 1]) {
-                    case 'd': case 'i': va_arg(args, int); break;
-                    case 'u': case 'x': case 'X': case 'o': va_arg(args, unsigned int); break;
-                    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': va_arg(args, double); break;
-                    case 'c': va_arg(args, int); break;
-                    case 's': va_arg(args, char*); break;
-                    case 'p': va_arg(args, void*); break;
+                    case 'a': case 'A': va_arg(args, double); break;
+                    case 'c': case 'C': va_arg(args, int); break;
+                    case 's': case 'S': va_arg(args, void*); break;
                     case 'n': va_arg(args, int*); break;
                     default: break;
                 }
 
                 if (temp_len < 0) {
+                	va_end(args);
                     return -1; // Error in formatting
                 }
 
-                for (int i = 0; i < temp_len && (bufp - buffer) < count - 1; i++) {
-                    if (buffer) *bufp = temp_buffer[i];
-                    bufp += 1;
-                }
-            }
-        } else {
-            if (buffer) {
-                *bufp = *p;
-            }
-            bufp += 1;
-            p += 1;
+                _format_write(buffer, count, &bufp, temp_buffer, min((u64)temp_len, sizeof(temp_buffer)-1));
+                break;
+        	}
         }
     }
     if (buffer)  *bufp = '\0';
     
+    va_end(args);
     return bufp - buffer;
 }
 u64 format_string_to_buffer_va(char* buffer, u64 count, const char* fmt, ...) {
@@ -219,8 +970,88 @@ void printf(const char* fmt, ...) {
 
 
 
+// s is only valid during the call, copy it if you need to keep it.
+// It may point into a buffer of the calling thread which the next log call on that thread
+// (at the same logger nesting depth) overwrites.
 typedef void(*Logger_Proc)(Log_Level level, string s);
-#define LOG_BASE(level, ...) if (get_context().logger) ((Logger_Proc)get_context().logger)(level, tprint(__VA_ARGS__))
+
+// Messages shorter than this are formatted without touching temporary storage.
+// Longer messages are formatted into temporary storage instead.
+#define LOG_MAX_MESSAGE_SIZE 4096
+// A logger that logs itself gets its own buffer, deeper than this goes to temporary storage
+#define LOG_MAX_BUFFERED_DEPTH 2
+
+// #Global
+// One bit per Log_Level. Levels that are off are dropped before the message is formatted, so
+// the arguments of a log_verbose() aren't even evaluated when verbose logging is off.
+ogb_instance volatile u32 log_level_mask;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+volatile u32 log_level_mask = 0xFFFFFFFF;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+#define log_is_level_enabled(level) ((log_level_mask >> (level)) & 1)
+
+inline void
+log_set_level_enabled(Log_Level level, bool enabled) {
+	if (enabled) log_level_mask |=  (1u << level);
+	else         log_level_mask &= ~(1u << level);
+}
+
+// Log messages are formatted into a buffer of the calling thread rather than temporary
+// storage, so logging a lot in one frame doesn't eat up the temporary storage.
+// Each logger nesting depth has its own buffer so a Logger_Proc which logs doesn't
+// overwrite the message it was passed.
+thread_local char _log_message_buffers[LOG_MAX_BUFFERED_DEPTH][LOG_MAX_MESSAGE_SIZE];
+thread_local char _log_format_buffer[LOG_MAX_MESSAGE_SIZE];
+thread_local u32 _log_depth = 0;
+
+string _log_format_va(const char *fmt, va_list args) {
+	if (_log_depth < LOG_MAX_BUFFERED_DEPTH) {
+		char *buffer = _log_message_buffers[_log_depth];
+		string s = sprint_null_terminated_string_va_list_to_buffer(fmt, args, buffer, LOG_MAX_MESSAGE_SIZE);
+		// Filling the whole buffer means the message may have been cut off
+		if (s.count < LOG_MAX_MESSAGE_SIZE-1) return s;
+	}
+	
+	string sfmt;
+	sfmt.data = cast(u8*)fmt;
+	sfmt.count = strlen(fmt);
+	return sprint_va_list(get_temporary_allocator(), sfmt, args);
+}
+string _log_formatf(const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	string s = _log_format_va(fmt, args);
+	va_end(args);
+	return s;
+}
+string _log_formats(const string fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	string s;
+	if (fmt.count < LOG_MAX_MESSAGE_SIZE) {
+		memcpy(_log_format_buffer, fmt.data, fmt.count);
+		_log_format_buffer[fmt.count] = 0;
+		s = _log_format_va(_log_format_buffer, args);
+	} else {
+		s = sprint_va_list(get_temporary_allocator(), fmt, args);
+	}
+	va_end(args);
+	return s;
+}
+#define _log_format(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  _log_formats, \
+                           default: _log_formatf \
+                          )(__VA_ARGS__)
+
+void _log_dispatch(Log_Level level, string s) {
+	_log_depth += 1;
+	((Logger_Proc)get_context().logger)(level, s);
+	_log_depth -= 1;
+}
+
+#define LOG_BASE(level, ...) if (log_is_level_enabled(level) && get_context().logger) _log_dispatch(level, _log_format(__VA_ARGS__))
 
 
 #define log_verbose(...) LOG_BASE(LOG_VERBOSE, __VA_ARGS__)
@@ -275,4 +1106,44 @@ void string_builder_printf(String_Builder *b, const char *fmt, ...) {
 #define string_builder_print(...) _Generic((SECOND_ARG(__VA_ARGS__)), \
                            string:  string_builder_prints, \
                            default: string_builder_printf \
+                          )(__VA_ARGS__)
+
+void chunked_string_builder_print_va_list(Chunked_String_Builder *b, const char *fmt, va_list args) {
+	assert(b->allocator.proc, "Chunked_String_Builder is missing allocator");
+	
+	// Format straight into what's left of the last chunk. Only if it didn't fit do we need to
+	// know how long it is, to format it again into a new chunk that's big enough.
+	String_Chunk *last = b->last;
+	if (last && _string_chunk_room(last) >= 2) {
+		u64 room = _string_chunk_room(last);
+		u64 written = format_string_to_buffer((char*)last->data+last->count, room, fmt, args);
+		if (written < room-1) {
+			chunked_string_builder_commit(b, written);
+			return;
+		}
+	}
+	
+	u64 formatted_count = format_string_to_buffer(0, 0, fmt, args);
+	
+	// +1 for the null terminator, which isn't committed
+	char *p = (char*)chunked_string_builder_reserve_tail(b, formatted_count+1);
+	format_string_to_buffer(p, formatted_count+1, fmt, args);
+	chunked_string_builder_commit(b, formatted_count);
+}
+void chunked_string_builder_prints(Chunked_String_Builder *b, string fmt, ...) {
+	va_list args = 0;
+	va_start(args, fmt);
+	chunked_string_builder_print_va_list(b, temp_convert_to_null_terminated_string(fmt), args);
+	va_end(args);
+}
+void chunked_string_builder_printf(Chunked_String_Builder *b, const char *fmt, ...) {
+	va_list args = 0;
+	va_start(args, fmt);
+	chunked_string_builder_print_va_list(b, fmt, args);
+	va_end(args);
+}
+
+#define chunked_string_builder_print(...) _Generic((SECOND_ARG(__VA_ARGS__)), \
+                           string:  chunked_string_builder_prints, \
+                           default: chunked_string_builder_printf \
                           )(__VA_ARGS__)
\ No newline at end of file
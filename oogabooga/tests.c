@@ -210,6 +210,18 @@ void test_thread_proc1(Thread* t) {
 	print("Hello from thread %llu\n", t->id);
 }
 
+typedef struct Thread_Placement_Test {
+	u64 processor;
+	string name;
+} Thread_Placement_Test;
+void test_thread_placement_proc(Thread *t) {
+	Thread_Placement_Test *result = (Thread_Placement_Test*)t->data;
+	// Spin a bit so the scheduler has a reason to move us if the affinity didn't stick
+	u64 end = rdtsc() + 1000000;
+	while (rdtsc() < end) { }
+	result->processor = os_get_current_processor();
+	result->name = os_get_thread_name(context.thread_id, get_heap_allocator());
+}
 void test_threads() {
 	
 	Thread t;
@@ -223,6 +235,44 @@ void test_threads() {
 	Mutex_Handle m = os_make_mutex();
 	os_lock_mutex(m);
 	os_unlock_mutex(m);
+	
+	Os_Cpu_Topology topology;
+	bool got_topology = os_get_cpu_topology(&topology);
+	assert(got_topology, "Failed: os_get_cpu_topology");
+	assert(topology.core_count > 0 && topology.core_count <= topology.logical_processor_count, "Failed: %llu cores, %llu logical processors", topology.core_count, topology.logical_processor_count);
+	u64 all_processors = 0;
+	for (u64 i = 0; i < topology.core_count; i++) {
+		u64 mask = topology.cores[i].logical_processor_mask;
+		assert(mask != 0 && (mask & all_processors) == 0, "Failed: cores should have their own logical processors");
+		all_processors |= mask;
+	}
+	for (u64 i = 0; i < topology.cache_count; i++) {
+		Os_Cpu_Cache cache = topology.caches[i];
+		assert(cache.level >= 1 && cache.size > 0, "Failed: cache level/size");
+		assert(cache.logical_processor_mask != 0 && (cache.logical_processor_mask & ~all_processors) == 0, "Failed: cache shared by unknown processors");
+	}
+	print("%llu cores, %llu logical processors\n", topology.core_count, topology.logical_processor_count);
+	
+	// Name, priority and affinity set before start
+	Thread_Placement_Test result = {0};
+	Thread placed;
+	os_thread_init(&placed, test_thread_placement_proc);
+	placed.data = &result;
+	placed.name = STR("Test worker");
+	placed.priority = OS_THREAD_PRIORITY_HIGH;
+	placed.affinity_mask = topology.cores[topology.core_count-1].logical_processor_mask;
+	os_thread_start(&placed);
+	os_thread_join(&placed);
+	assert((1ull << result.processor) & placed.affinity_mask, "Failed: thread ran on processor %llu, outside its affinity mask", result.processor);
+	// Naming threads needs windows 10 1607+
+	assert(result.name.count == 0 || strings_match(result.name, STR("Test worker")), "Failed: thread name was '%s'", result.name);
+	if (result.name.count) dealloc_string(get_heap_allocator(), result.name);
+	
+	assert(!os_thread_set_priority(&placed, OS_THREAD_PRIORITY_AUDIO), "Failed: audio priority can only be set on the calling thread");
+	os_thread_destroy(&placed);
+	
+	bool calling_thread_ok = os_thread_set_priority(0, OS_THREAD_PRIORITY_DEFAULT) && os_thread_set_affinity(0, 0);
+	assert(calling_thread_ok, "Failed: setting priority & affinity of the calling thread");
 }
 
 void test_allocator_threaded(Thread *t) {
@@ -452,6 +502,803 @@ void test_strings() {
     assert(strings_match(hello_balls, STR("Greetings, Balls!")), "Failed: string_replace");
 }
 
+s64 string_search_test_reference(string s, string sub, bool from_right) {
+    if (sub.count > s.count) return -1;
+    s64 result = -1;
+    for (u64 i = 0; i + sub.count <= s.count; i++) {
+        if (memcmp(s.data+i, sub.data, sub.count) == 0) {
+            result = (s64)i;
+            if (!from_right) break;
+        }
+    }
+    return result;
+}
+// The string procedures have scalar, sse2 & avx2 paths, picked from simd_procs.level.
+// Tests run each of them by capping simd_procs at that level.
+const Simd_Level string_test_simd_levels[] = {SIMD_LEVEL_BASIC, SIMD_LEVEL_SSE, SIMD_LEVEL_AVX2};
+s32 string_test_best_level() {
+    if (simd_procs.level >= SIMD_LEVEL_AVX2) return 2;
+    if (simd_procs.level >= SIMD_LEVEL_SSE) return 1;
+    return 0;
+}
+Cpu_Capabilities string_test_cpu;
+bool string_test_cpu_queried = false;
+void string_test_set_level(s32 level) {
+    // Some of the tests switch levels in their inner loop, and cpuid can be slow in a VM
+    if (!string_test_cpu_queried) {
+        string_test_cpu = query_cpu_capabilities();
+        string_test_cpu_queried = true;
+    }
+    simd_procs_init(string_test_cpu, string_test_simd_levels[level]);
+}
+void string_test_restore_level() {
+    simd_procs_init(query_cpu_capabilities(), SIMD_LEVEL_AVX512);
+}
+void test_string_search() {
+    Allocator heap = get_heap_allocator();
+    s32 best_level = string_test_best_level();
+
+    // Every implementation must agree with the obvious one. Few different bytes so there are
+    // lots of partial matches, and lengths around the block sizes.
+    u8 haystack[300];
+    u8 needle[40];
+    for (s32 level = 0; level <= best_level; level++) {
+        string_test_set_level(level);
+        for (u64 iteration = 0; iteration < 3000; iteration++) {
+            u64 count = get_random() % (sizeof(haystack)+1);
+            for (u64 i = 0; i < count; i++) haystack[i] = "abc"[get_random_int_in_range(0, 2)];
+            u64 sub_count = get_random_int_in_range(1, sizeof(needle));
+            if (count > 0 && (iteration % 2) == 0) {
+                // Somewhere from the haystack, so it's found
+                sub_count = min(sub_count, count);
+                u64 at = get_random() % (count-sub_count+1);
+                memcpy(needle, haystack+at, sub_count);
+            } else {
+                for (u64 i = 0; i < sub_count; i++) needle[i] = "abc"[get_random_int_in_range(0, 2)];
+            }
+            string s = {count, haystack};
+            string sub = {sub_count, needle};
+
+            assert(string_find_from_left(s, sub) == string_search_test_reference(s, sub, false), "Failed: string_find_from_left at simd level %d", level);
+            assert(string_find_from_right(s, sub) == string_search_test_reference(s, sub, true), "Failed: string_find_from_right at simd level %d", level);
+            string byte = {1, needle};
+            assert(string_find_byte_from_left(s, needle[0]) == string_search_test_reference(s, byte, false), "Failed: string_find_byte_from_left at simd level %d", level);
+            assert(string_find_byte_from_right(s, needle[0]) == string_search_test_reference(s, byte, true), "Failed: string_find_byte_from_right at simd level %d", level);
+
+            if (count >= sub_count) {
+                string prefix = {sub_count, haystack};
+                string suffix = {sub_count, haystack+count-sub_count};
+                assert(strings_match(prefix, sub) == (memcmp(haystack, needle, sub_count) == 0), "Failed: strings_match");
+                assert(string_ends_with(s, sub) == (memcmp(suffix.data, needle, sub_count) == 0), "Failed: string_ends_with");
+            }
+        }
+    }
+    string_test_restore_level();
+
+    assert(string_find_from_left(STR("abc"), STR("")) == 0, "Failed: empty sub");
+    assert(string_find_from_right(STR("abc"), STR("")) == 3, "Failed: empty sub");
+    assert(string_find_from_left(STR("ab"), STR("abc")) == -1, "Failed: sub longer than s");
+    string replaced = string_replace_all(STR("aXbXXc"), STR("X"), STR("--"), heap);
+    assert(strings_match(replaced, STR("a--b----c")), "Failed: string_replace_all");
+    dealloc_string(heap, replaced);
+    replaced = string_replace_all(STR("XXXX"), STR("XX"), STR(""), heap);
+    assert(replaced.count == 0, "Failed: string_replace_all to nothing");
+    replaced = string_replace_all(STR("no match"), STR("xyz"), STR("!"), heap);
+    assert(strings_match(replaced, STR("no match")), "Failed: string_replace_all without matches");
+    dealloc_string(heap, replaced);
+    // More matches than fit on the stack
+    string many = alloc_string(heap, 1000);
+    for (u64 i = 0; i < many.count; i++) many.data[i] = i % 3 == 0 ? 'X' : 'a';
+    replaced = string_replace_all(many, STR("X"), STR("YZ"), heap);
+    assert(replaced.count == many.count+334, "Failed: string_replace_all with many matches");
+    for (u64 i = 0, j = 0; i < many.count; i++) {
+        if (i % 3 == 0) { assert(replaced.data[j] == 'Y' && replaced.data[j+1] == 'Z', "Failed: string_replace_all with many matches"); j += 2; }
+        else            { assert(replaced.data[j] == 'a', "Failed: string_replace_all with many matches"); j += 1; }
+    }
+    dealloc_string(heap, replaced);
+    dealloc_string(heap, many);
+    // More matches than would fit in temporary storage
+    string csv = alloc_string(heap, 400000);
+    for (u64 i = 0; i < csv.count; i++) csv.data[i] = i % 2 ? ',' : 'a';
+    replaced = string_replace_all(csv, STR(","), STR(""), get_temporary_allocator());
+    assert(replaced.count == csv.count/2 && replaced.data[0] == 'a' && replaced.data[replaced.count-1] == 'a', "Failed: string_replace_all with 200000 matches");
+    dealloc_string(heap, csv);
+
+    // Throughput at a few lengths, scalar vs the best the cpu can do
+    const u64 lengths[] = {16, 256, KB(4), KB(64), MB(1)};
+    const char *level_names[] = {"scalar", "sse2", "avx2"};
+    u8 *text = (u8*)alloc(heap, MB(1));
+    u8 *text_copy = (u8*)alloc(heap, MB(1));
+    for (u64 i = 0; i < MB(1); i++) text[i] = "etaoin shrdlu"[get_random_int_in_range(0, 12)];
+    memcpy(text_copy, text, MB(1));
+
+    print("\n");
+    for (u64 l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+        u64 length = lengths[l];
+        u64 iterations = max(MB(16)/length, 1);
+        string s = {length, text};
+        string copy = {length, text_copy};
+
+        for (s32 level = 0; level <= best_level; level++) {
+            string_test_set_level(level);
+            s64 sink = 0;
+
+            f64 start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += string_find_from_left(s, STR("needle!"));
+            f64 find_seconds = os_get_current_time_in_seconds()-start;
+
+            // Volatile so the search can't be hoisted out of the loop
+            volatile u8 byte_to_find = '#';
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += string_find_byte_from_left(s, byte_to_find);
+            f64 byte_seconds = os_get_current_time_in_seconds()-start;
+
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += strings_match(s, copy);
+            f64 match_seconds = os_get_current_time_in_seconds()-start;
+
+            u64 replace_iterations = max(iterations/8, 1);
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < replace_iterations; i++) {
+                string r = string_replace_all(s, STR("the"), STR("THE"), heap);
+                sink += r.count;
+                if (r.count) dealloc_string(heap, r);
+            }
+            f64 replace_seconds = os_get_current_time_in_seconds()-start;
+
+            assert(sink != 12345, ""); // Keep the loops from being optimized out
+            f64 gb = (f64)(length*iterations)/(1024.0*1024.0*1024.0);
+            print("%7llu bytes %-6cs: find %6.2f GB/s, find byte %6.2f GB/s, match %6.2f GB/s, replace_all %6.2f GB/s\n",
+                length, level_names[level], gb/find_seconds, gb/byte_seconds, gb/match_seconds, gb/8.0/replace_seconds);
+        }
+    }
+    string_test_restore_level();
+
+    dealloc(heap, text);
+    dealloc(heap, text_copy);
+}
+
+// Decodes by bit pattern and then checks it's the shortest form, not a surrogate & in range.
+// Returns the length of the valid sequence at p, or 0 if it isn't one.
+u64 utf8_test_reference_length(const u8 *p, u64 count, u32 *c) {
+    u8 b = p[0];
+    u64 n = b < 0x80 ? 1 : (b & 0xE0) == 0xC0 ? 2 : (b & 0xF0) == 0xE0 ? 3 : (b & 0xF8) == 0xF0 ? 4 : 0;
+    if (n == 0 || n > count) return 0;
+    u32 v = n == 1 ? b : (b & (0xFF >> (n+1)));
+    for (u64 i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+        v = (v << 6) | (p[i] & 0x3F);
+    }
+    u64 shortest = v < 0x80 ? 1 : v < 0x800 ? 2 : v < 0x10000 ? 3 : 4;
+    if (shortest != n || (v >= 0xD800 && v <= 0xDFFF) || v > 0x10FFFF) return 0;
+    *c = v;
+    return n;
+}
+u64 utf8_test_encode(u32 c, u8 *out) {
+    if (c < 0x80)    { out[0] = (u8)c; return 1; }
+    if (c < 0x800)   { out[0] = (u8)(0xC0 | (c >> 6));  out[1] = (u8)(0x80 | (c & 0x3F)); return 2; }
+    if (c < 0x10000) { out[0] = (u8)(0xE0 | (c >> 12)); out[1] = (u8)(0x80 | ((c >> 6) & 0x3F)); out[2] = (u8)(0x80 | (c & 0x3F)); return 3; }
+    out[0] = (u8)(0xF0 | (c >> 18)); out[1] = (u8)(0x80 | ((c >> 12) & 0x3F)); out[2] = (u8)(0x80 | ((c >> 6) & 0x3F)); out[3] = (u8)(0x80 | (c & 0x3F));
+    return 4;
+}
+u32 utf8_test_random_codepoint() {
+    // Mostly ascii, like real text, with a bit of everything else
+    u64 r = get_random() % 10;
+    if (r < 6) return (u32)get_random_int_in_range(0, 0x7F);
+    if (r < 8) return (u32)get_random_int_in_range(0x80, 0x7FF);
+    if (r < 9) {
+        u32 c = (u32)get_random_int_in_range(0x800, 0xFFFF);
+        return (c >= 0xD800 && c <= 0xDFFF) ? 0xFFFD : c;
+    }
+    return (u32)get_random_int_in_range(0x10000, 0x10FFFF);
+}
+void test_utf8() {
+    Allocator heap = get_heap_allocator();
+    s32 best_level = string_test_best_level();
+
+    assert(utf8_validate(STR("Hello, w\xC3\xB6rld \xE2\x82\xAC \xF0\x9F\x98\x80")), "Failed: valid utf8");
+    const char *invalid[] = {
+        "\xC0\x80",         // Overlong
+        "\xE0\x9F\xBF",     // Overlong
+        "\xF0\x8F\xBF\xBF", // Overlong
+        "\xED\xA0\x80",     // Surrogate
+        "\xF4\x90\x80\x80", // Above U+10FFFF
+        "\xF8\x88\x80\x80\x80",
+        "\x80",
+        "a\xE2\x82",        // Cut off
+        "\xE2\x82" "a",
+    };
+    for (u64 i = 0; i < sizeof(invalid)/sizeof(invalid[0]); i++) {
+        for (s32 level = 0; level <= best_level; level++) {
+            string_test_set_level(level);
+            assert(!utf8_validate(STR(invalid[i])), "Failed: invalid utf8 %llu was valid at simd level %d", i, level);
+        }
+    }
+    string_test_restore_level();
+
+    u32 decoded[64];
+    u64 n = utf8_decode_to_utf32(STR("a\xE2\x82\xAC\xE2\x82" "b\xFF"), decoded);
+    assert(n == 5 && decoded[0] == 'a' && decoded[1] == 0x20AC && decoded[2] == UNI_REPLACEMENT_CHAR && decoded[3] == 'b' && decoded[4] == UNI_REPLACEMENT_CHAR, "Failed: utf8_decode_to_utf32 with invalid parts");
+
+    u16 wide[64];
+    u8 narrow[192];
+    n = utf8_to_utf16(STR("x\xF0\x9F\x98\x80"), wide);
+    assert(n == 3 && wide[0] == 'x' && wide[1] == 0xD83D && wide[2] == 0xDE00, "Failed: utf8_to_utf16 surrogate pair");
+    u16 lone[] = {'a', 0xDC00, 'b'};
+    n = utf16_to_utf8(lone, 3, narrow);
+    assert(n == 5 && memcmp(narrow, "a\xEF\xBF\xBD" "b", 5) == 0, "Failed: utf16_to_utf8 lone surrogate");
+
+    // Random text, valid and then broken in a few places. Lengths around the block sizes.
+    u8 *text = (u8*)alloc(heap, 1024);
+    u32 *expected = (u32*)alloc(heap, 1024*sizeof(u32));
+    u32 *got = (u32*)alloc(heap, 1024*sizeof(u32));
+    u32 *got_scalar = (u32*)alloc(heap, 1024*sizeof(u32));
+    u16 *utf16 = (u16*)alloc(heap, 1024*sizeof(u16));
+    u8 *back = (u8*)alloc(heap, 1024*3);
+    for (u64 iteration = 0; iteration < 4000; iteration++) {
+        u64 target = get_random() % 200;
+        u64 count = 0;
+        u64 codepoint_count = 0;
+        while (count + 4 <= target) {
+            u32 c = utf8_test_random_codepoint();
+            expected[codepoint_count++] = c;
+            count += utf8_test_encode(c, text+count);
+        }
+        bool broken = (iteration % 2) == 1 && count > 0;
+        if (broken) {
+            u64 breaks = get_random_int_in_range(1, 3);
+            for (u64 i = 0; i < breaks; i++) text[get_random() % count] = (u8)get_random();
+            if (get_random() % 4 == 0) count -= 1;
+        }
+        string s = {count, text};
+
+        bool valid = true;
+        for (u64 i = 0; i < count; ) {
+            u32 c;
+            u64 length = utf8_test_reference_length(text+i, count-i, &c);
+            if (length == 0) { valid = false; break; }
+            i += length;
+        }
+        if (!broken) assert(valid, "Failed: test text should be valid");
+
+        string_test_set_level(0);
+        u64 scalar_count = utf8_decode_to_utf32(s, got_scalar);
+
+        for (s32 level = 0; level <= best_level; level++) {
+            string_test_set_level(level);
+            assert(utf8_validate(s) == valid, "Failed: utf8_validate at simd level %d", level);
+
+            // Invalid text decodes the same way at every level
+            u64 got_count = utf8_decode_to_utf32(s, got);
+            assert(got_count == scalar_count && memcmp(got, got_scalar, got_count*sizeof(u32)) == 0, "Failed: utf8_decode_to_utf32 at simd level %d", level);
+            if (!broken) {
+                assert(got_count == codepoint_count && memcmp(got, expected, got_count*sizeof(u32)) == 0, "Failed: utf8_decode_to_utf32 at simd level %d", level);
+            }
+
+            // Through utf16 and back gives the decoded text, encoded properly
+            u64 utf16_count = utf8_to_utf16(s, utf16);
+            u64 back_count = utf16_to_utf8(utf16, utf16_count, back);
+            u8 reencoded[1024*4];
+            u64 reencoded_count = 0;
+            for (u64 i = 0; i < got_count; i++) reencoded_count += utf8_test_encode(got[i], reencoded+reencoded_count);
+            assert(back_count == reencoded_count && memcmp(back, reencoded, back_count) == 0, "Failed: utf8 -> utf16 -> utf8 at simd level %d", level);
+        }
+
+        // next_utf8 agrees on valid text
+        if (!broken) {
+            string rest = s;
+            for (u64 i = 0; i < codepoint_count; i++) {
+                u32 c = next_utf8(&rest);
+                assert(c == expected[i], "Failed: next_utf8 disagrees");
+            }
+            assert(rest.count == 0, "Failed: next_utf8 didn't consume everything");
+        }
+    }
+    string_test_restore_level();
+
+    // Throughput: next_utf8 one by one vs in bulk, on ascii and on text with some of everything
+    u64 bench_count = MB(1);
+    u8 *bench_text = (u8*)alloc(heap, bench_count+4);
+    u32 *bench_out = (u32*)alloc(heap, (bench_count+4)*sizeof(u32));
+    u16 *bench_utf16 = (u16*)alloc(heap, (bench_count+4)*sizeof(u16));
+    const char *level_names[] = {"scalar", "sse2", "avx2"};
+    print("\n");
+    for (u64 kind = 0; kind < 2; kind++) {
+        u64 count = 0;
+        while (count < bench_count) {
+            u32 c = kind == 0 ? (u32)"etaoin shrdlu"[get_random_int_in_range(0, 12)] : utf8_test_random_codepoint();
+            if (c == 0) c = ' ';
+            count += utf8_test_encode(c, bench_text+count);
+        }
+        string s = {count, bench_text};
+        u64 iterations = 16;
+        f64 gb = (f64)(count*iterations)/(1024.0*1024.0*1024.0);
+        u64 sink = 0;
+
+        f64 start = os_get_current_time_in_seconds();
+        for (u64 i = 0; i < iterations; i++) {
+            string rest = s;
+            while (rest.count > 0) sink += next_utf8(&rest);
+        }
+        f64 next_seconds = os_get_current_time_in_seconds()-start;
+        print("%-5cs text: next_utf8 %6.2f GB/s\n", kind == 0 ? "ascii" : "mixed", gb/next_seconds);
+
+        for (s32 level = 0; level <= best_level; level++) {
+            string_test_set_level(level);
+
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += utf8_validate(s);
+            f64 validate_seconds = os_get_current_time_in_seconds()-start;
+
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += utf8_decode_to_utf32(s, bench_out);
+            f64 decode_seconds = os_get_current_time_in_seconds()-start;
+
+            start = os_get_current_time_in_seconds();
+            for (u64 i = 0; i < iterations; i++) sink += utf8_to_utf16(s, bench_utf16);
+            f64 utf16_seconds = os_get_current_time_in_seconds()-start;
+
+            print("%-5cs text %-6cs: validate %6.2f GB/s, decode %6.2f GB/s, to utf16 %6.2f GB/s\n",
+                kind == 0 ? "ascii" : "mixed", level_names[level], gb/validate_seconds, gb/decode_seconds, gb/utf16_seconds);
+        }
+        assert(sink != 12345, ""); // Keep the loops from being optimized out
+    }
+    string_test_restore_level();
+
+    dealloc(heap, text);
+    dealloc(heap, expected);
+    dealloc(heap, got);
+    dealloc(heap, got_scalar);
+    dealloc(heap, utf16);
+    dealloc(heap, back);
+    dealloc(heap, bench_text);
+    dealloc(heap, bench_out);
+    dealloc(heap, bench_utf16);
+}
+
+void test_chunked_string_builder() {
+    Allocator heap = get_heap_allocator();
+
+    // Same text into a String_Builder and a Chunked_String_Builder with small chunks, so
+    // appends & prints land across chunk boundaries all the time
+    String_Builder expected;
+    string_builder_init(&expected, heap);
+    Chunked_String_Builder b;
+    chunked_string_builder_init_chunk_size(&b, 256, heap);
+
+    u8 big[1000];
+    for (u64 i = 0; i < sizeof(big); i++) big[i] = 'a' + (u8)(i % 26);
+    string referenced = STR("This one is not copied. ");
+
+    for (u64 i = 0; i < 2000; i++) {
+        switch (get_random() % 5) {
+            case 0: {
+                string piece = {get_random_int_in_range(0, sizeof(big)), big};
+                string_builder_append(&expected, piece);
+                chunked_string_builder_append(&b, piece);
+                break;
+            }
+            case 1: {
+                string_builder_print(&expected, STR("%llu: %.3f %s|"), i, (f64)i/7.0, referenced);
+                chunked_string_builder_print(&b, STR("%llu: %.3f %s|"), i, (f64)i/7.0, referenced);
+                break;
+            }
+            case 2: {
+                // Longer than a chunk
+                string_builder_print(&expected, "%cs%cs", (char*)"start ", temp_convert_to_null_terminated_string((string){600, big}));
+                chunked_string_builder_print(&b, "%cs%cs", (char*)"start ", temp_convert_to_null_terminated_string((string){600, big}));
+                break;
+            }
+            case 3: {
+                string_builder_append(&expected, referenced);
+                chunked_string_builder_append_reference(&b, referenced);
+                break;
+            }
+            case 4: {
+                string_builder_append(&expected, STR("x"));
+                chunked_string_builder_append(&b, STR("x"));
+                break;
+            }
+        }
+        reset_temporary_storage();
+    }
+    assert(b.count == expected.count, "Failed: Chunked_String_Builder count %llu, expected %llu", b.count, expected.count);
+    assert(b.chunk_count > 1, "Failed: Chunked_String_Builder should have many chunks");
+
+    string contiguous = chunked_string_builder_to_contiguous(&b, heap);
+    assert(strings_match(contiguous, expected.result), "Failed: chunked_string_builder_to_contiguous");
+    dealloc_string(heap, contiguous);
+
+    assert(chunked_string_builder_write_entire_file(&b, "chunked_test.txt"), "Failed: chunked_string_builder_write_entire_file");
+    string read_back;
+    assert(os_read_entire_file("chunked_test.txt", &read_back, heap), "Failed: reading chunked_test.txt");
+    assert(strings_match(read_back, expected.result), "Failed: chunked builder file content");
+    dealloc_string(heap, read_back);
+    os_file_delete("chunked_test.txt");
+
+    chunked_string_builder_reset(&b);
+    assert(b.count == 0 && b.first == 0 && chunked_string_builder_to_contiguous(&b, heap).count == 0, "Failed: chunked_string_builder_reset");
+    chunked_string_builder_append(&b, STR("again"));
+    assert(b.count == 5 && b.chunk_count == 1, "Failed: Chunked_String_Builder after reset");
+    chunked_string_builder_reset(&b);
+    dealloc(heap, expected.buffer);
+
+    // A trace-like export, printed line by line. String_Builder without reserving grows by
+    // copying everything, the chunked one never copies.
+    u64 line_count = 1000000;
+    f64 start = os_get_current_time_in_seconds();
+    String_Builder flat;
+    string_builder_init(&flat, heap);
+    for (u64 i = 0; i < line_count; i++) {
+        string_builder_print(&flat, "{\"name\":\"%cs\",\"tid\":%llu,\"ts\":%.3f},", "scope", i % 8, (f64)i*0.25);
+    }
+    f64 flat_seconds = os_get_current_time_in_seconds()-start;
+
+    start = os_get_current_time_in_seconds();
+    chunked_string_builder_init(&b, heap);
+    for (u64 i = 0; i < line_count; i++) {
+        chunked_string_builder_print(&b, "{\"name\":\"%cs\",\"tid\":%llu,\"ts\":%.3f},", "scope", i % 8, (f64)i*0.25);
+    }
+    f64 chunked_seconds = os_get_current_time_in_seconds()-start;
+    assert(b.count == flat.count, "Failed: chunked trace export size");
+
+    start = os_get_current_time_in_seconds();
+    os_write_entire_file("chunked_test_flat.txt", flat.result);
+    f64 flat_write_seconds = os_get_current_time_in_seconds()-start;
+    start = os_get_current_time_in_seconds();
+    chunked_string_builder_write_entire_file(&b, "chunked_test_chunked.txt");
+    f64 chunked_write_seconds = os_get_current_time_in_seconds()-start;
+    os_file_delete("chunked_test_flat.txt");
+    os_file_delete("chunked_test_chunked.txt");
+
+    print("\n%llu lines, %llu MB: String_Builder %.1fms + write %.1fms, Chunked_String_Builder %.1fms + write %.1fms (%llu chunks)\n",
+        line_count, flat.count/MB(1), flat_seconds*1000.0, flat_write_seconds*1000.0, chunked_seconds*1000.0, chunked_write_seconds*1000.0, b.chunk_count);
+
+    dealloc(heap, flat.buffer);
+    chunked_string_builder_reset(&b);
+}
+
+void format_test_expect(const char *expected, const char *fmt, ...) {
+    char buffer[1024];
+    va_list args;
+    va_start(args, fmt);
+    format_string_to_buffer(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    assert(strcmp(buffer, expected) == 0, "Failed: format '%cs' gave '%cs', expected '%cs'", fmt, buffer, expected);
+}
+u64 format_test_crt(char *buffer, u64 count, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buffer, count, fmt, args);
+    va_end(args);
+    return (u64)n;
+}
+f64 format_test_f64_from_bits(u64 bits) {
+    f64 f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+void test_format() {
+    // Integers
+    format_test_expect("0", "%d", 0);
+    format_test_expect("-42", "%d", -42);
+    format_test_expect("-2147483648", "%d", (s32)0x80000000);
+    format_test_expect("-9223372036854775808", "%lld", (s64)0x8000000000000000ULL);
+    format_test_expect("18446744073709551615", "%llu", 0xFFFFFFFFFFFFFFFFULL);
+    format_test_expect("   42|", "%5d|", 42);
+    format_test_expect("42   |", "%-5d|", 42);
+    format_test_expect("-0042", "%05d", -42);
+    format_test_expect("+5  5", "%+d % d", 5, 5);
+    format_test_expect("007", "%.3d", 7);
+    format_test_expect("", "%.0d", 0);
+    format_test_expect("ff FF 0xff 0x000000ff", "%x %X %#x %#010x", 255, 255, 255, 255);
+    format_test_expect("10 010", "%o %#o", 8, 8);
+    format_test_expect("44 4464", "%hhd %hu", 300, 70000);
+    format_test_expect("123 -7", "%zu %I64d", (size_t)123, (s64)-7);
+    format_test_expect("   7|7   |", "%*d|%-*d|", 4, 7, 4, 7);
+    format_test_expect("A 100%", "%c %d%%", 'A', 100);
+    format_test_expect("0000000000001234", "%p", (void*)0x1234);
+
+    // Strings
+    format_test_expect("    ab|ab    |", "%6s|%-6s|", STR("ab"), STR("ab"));
+    format_test_expect("ab", "%.2s", STR("abc"));
+    format_test_expect("  abc|ab", "%5cs|%.2cs", "abc", "abc");
+
+    // Fixed. Rounding is exact, from the binary value, with ties going to even.
+    format_test_expect("0.000000 -0.000000", "%f %f", 0.0, -0.0);
+    format_test_expect("1.500000", "%f", 1.5);
+    format_test_expect("3.14", "%.2f", 3.14159);
+    format_test_expect("0.12 0.38", "%.2f %.2f", 0.125, 0.375);
+    format_test_expect("2.67", "%.2f", 2.675); // 2.67499999...
+    format_test_expect("0 2 2", "%.0f %.0f %.0f", 0.5, 1.5, 2.5);
+    format_test_expect("0.1", "%.1f", 0.05); // 0.05000000000000000277...
+    format_test_expect("0.000", "%.3f", 1e-10);
+    format_test_expect("0.10000000000000000555", "%.20f", 0.1);
+    format_test_expect("100000000000000000000.000000", "%f", 1e20);
+    format_test_expect("1180591620717411303424", "%.0f", 1180591620717411303424.0); // 2^70
+    format_test_expect("0.000000000000000000000000000000000000000000000000000000000000000000000000000001", "%.78f", 1e-78);
+    format_test_expect("   3.142|3.142   |-003.142", "%8.3f|%-8.3f|%08.3f", 3.14159, 3.14159, -3.14159);
+    format_test_expect("+2.0", "%+.1f", 2.0);
+
+    // Exponential
+    format_test_expect("1.234568e+04", "%e", 12345.678);
+    format_test_expect("1.000000e-300", "%e", 1e-300);
+    format_test_expect("9.99e+00", "%.2e", 9.995); // 9.99499999...
+    format_test_expect("5e-324", "%.0e", 5e-324);
+    format_test_expect("1.500000E+00", "%E", 1.5);
+
+    // General
+    format_test_expect("0.0001 1e-05", "%g %g", 0.0001, 0.00001);
+    format_test_expect("100000 1e+06", "%g %g", 100000.0, 1000000.0);
+    format_test_expect("1.23457e+08", "%g", 123456789.0);
+    format_test_expect("0.5 0", "%g %g", 0.5, 0.0);
+    format_test_expect("1.00000", "%#g", 1.0);
+    format_test_expect("100", "%.3g", 99.95);
+
+    // Crt fallback, * width and precision are consumed before the crt sees the arguments
+    format_test_expect("   ab|ab  |a|7", "%*ls|%-*ls|%.*ls|%d", 5, L"ab", 4, L"ab", 1, L"ab", 7);
+    // l means wide for s & c, but just long for integers (which is 4 bytes on windows)
+    format_test_expect("x|  y|-5|7", "%lc|%3lc|%ld|%d", (wchar_t)'x', (wchar_t)'y', (long)-5, 7);
+
+    // Not numbers
+    f64 inf = format_test_f64_from_bits(0x7FF0000000000000ULL);
+    f64 nan = format_test_f64_from_bits(0x7FF8000000000000ULL);
+    format_test_expect("inf INF  -inf nan", "%f %F %5.1f %g", inf, inf, -inf, nan);
+
+    // Shortest round trip
+    format_test_expect("0.1 -1.5 0", "%r %r %r", 0.1, -1.5, 0.0);
+    format_test_expect("0.3333333333333333 0.6666666666666666", "%r %r", 1.0/3.0, 2.0/3.0);
+    format_test_expect("123456 10000000000000000 1e+17", "%r %r %r", 123456.0, 1e16, 1e17);
+    format_test_expect("0.00001 1e-06", "%r %r", 0.00001, 0.000001);
+    format_test_expect("5e-324 1.7976931348623157e+308", "%r %r", 5e-324, 1.7976931348623157e308);
+    format_test_expect("0.10000000149011612", "%r", (f64)0.1f);
+    format_test_expect("0.1 16777216 3.1415927", "%hr %hr %hr", 0.1f, 16777216.0f, 3.14159265f);
+    format_test_expect("1e-45 3.4028235e+38", "%hr %hr", 1e-45f, 3.4028235e38f);
+
+    // Truncation
+    char small[8];
+    u64 n = format_string_to_buffer_va(small, sizeof(small), "%d-%s", 123456, STR("abcdef"));
+    assert(n == 7, "Failed: format_string_to_buffer_va should return the written length");
+    assert(strcmp(small, "123456-") == 0, "Failed: truncated format");
+
+    // Throughput compared to the C runtime, same formats and arguments
+    const u64 iterations = 200000;
+    char buffer[256];
+    u64 native_bytes = 0;
+    u64 crt_bytes = 0;
+
+    f64 start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < iterations; i++) {
+        native_bytes += format_string_to_buffer_va(buffer, sizeof(buffer), "%d %u %x %.2f %.3f %e %g", (int)i, (u32)i*7, (u32)i, (f64)i*0.37, 1.0/(f64)(i+1), (f64)i*1234.5, (f64)i*0.001);
+    }
+    f64 native_seconds = os_get_current_time_in_seconds()-start;
+
+    start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < iterations; i++) {
+        crt_bytes += format_test_crt(buffer, sizeof(buffer), "%d %u %x %.2f %.3f %e %g", (int)i, (u32)i*7, (u32)i, (f64)i*0.37, 1.0/(f64)(i+1), (f64)i*1234.5, (f64)i*0.001);
+    }
+    f64 crt_seconds = os_get_current_time_in_seconds()-start;
+
+    // msvcrt prints 3 exponent digits so the byte counts only match roughly
+    assert(native_bytes > crt_bytes/2 && native_bytes < crt_bytes*2, "Failed: format byte counts are way off from the C runtime");
+
+    start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < iterations; i++) {
+        string s = tprint("Entity %d at (%.2f, %.2f) named %s", (int)i, (f64)i*0.5, -(f64)i*0.25, STR("player"));
+        assert(s.count > 0, "Failed: tprint");
+        if ((i % 1000) == 0) reset_temporary_storage();
+    }
+    f64 tprint_seconds = os_get_current_time_in_seconds()-start;
+    reset_temporary_storage();
+
+    print("\nformat: %.1f M/s native, %.1f M/s C runtime, tprint %.1f M/s\n",
+        (f64)iterations/native_seconds/1000000.0, (f64)iterations/crt_seconds/1000000.0, (f64)iterations/tprint_seconds/1000000.0);
+}
+
+double strtod(const char *s, char **end);
+
+void parse_test_f64(const char *text, u64 expected_bits, String_Parse_Error expected_error) {
+	f64 f = 1234.0;
+	String_Parse_Error error = string_parse_f64(STR(text), &f);
+	u64 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	assert(error == expected_error, "Failed: string_parse_f64 '%cs' gave error '%cs', expected '%cs'", text, string_parse_error_name(error), string_parse_error_name(expected_error));
+	if (error == STRING_PARSE_OK || error == STRING_PARSE_OUT_OF_RANGE) {
+		assert(bits == expected_bits, "Failed: string_parse_f64 '%cs' gave 0x%llx, expected 0x%llx", text, bits, expected_bits);
+	}
+}
+void test_parse() {
+	Allocator heap = get_heap_allocator();
+
+	u64 u;
+	s64 i;
+	u64 length;
+	assert(string_parse_u64(STR("0"), &u) == STRING_PARSE_OK && u == 0, "Failed: parse u64 0");
+	assert(string_parse_u64(STR("1234567890123"), &u) == STRING_PARSE_OK && u == 1234567890123ull, "Failed: parse u64");
+	assert(string_parse_u64(STR("+7"), &u) == STRING_PARSE_OK && u == 7, "Failed: parse u64 +");
+	assert(string_parse_u64(STR("18446744073709551615"), &u) == STRING_PARSE_OK && u == UINT64_MAX, "Failed: parse u64 max");
+	assert(string_parse_u64(STR("18446744073709551616"), &u) == STRING_PARSE_OUT_OF_RANGE, "Failed: parse u64 overflow");
+	assert(string_parse_u64(STR("0xFFffFFffFFffFFff"), &u) == STRING_PARSE_OK && u == UINT64_MAX, "Failed: parse u64 hex");
+	assert(string_parse_u64(STR("0x1FFFFFFFFFFFFFFFF"), &u) == STRING_PARSE_OUT_OF_RANGE, "Failed: parse u64 hex overflow");
+	assert(string_parse_u64(STR("-1"), &u) == STRING_PARSE_EMPTY, "Failed: parse u64 negative");
+	assert(string_parse_u64(STR(""), &u) == STRING_PARSE_EMPTY, "Failed: parse u64 empty");
+	assert(string_parse_u64(STR("12a"), &u) == STRING_PARSE_INVALID, "Failed: parse u64 trailing junk");
+	assert(string_parse_u64(STR("0x"), &u) == STRING_PARSE_INVALID, "Failed: parse u64 0x");
+	assert(string_parse_s64(STR("-9223372036854775808"), &i) == STRING_PARSE_OK && i == INT64_MIN, "Failed: parse s64 min");
+	assert(string_parse_s64(STR("9223372036854775807"), &i) == STRING_PARSE_OK && i == INT64_MAX, "Failed: parse s64 max");
+	assert(string_parse_s64(STR("9223372036854775808"), &i) == STRING_PARSE_OUT_OF_RANGE && i == INT64_MAX, "Failed: parse s64 overflow");
+	assert(string_parse_s64(STR("-0x10"), &i) == STRING_PARSE_OK && i == -16, "Failed: parse s64 hex");
+	assert(string_parse_s64(STR("-"), &i) == STRING_PARSE_EMPTY, "Failed: parse s64 just a sign");
+	assert(string_parse_s64_prefix(STR("-42,7"), &i, &length) == STRING_PARSE_OK && i == -42 && length == 3, "Failed: parse s64 prefix");
+	for (u64 k = 0; k < 10000; k++) {
+		s64 value = (s64)get_random();
+		if (k % 3 == 0) value >>= get_random_int_in_range(0, 63);
+		assert(string_parse_s64(tprint("%lld", value), &i) == STRING_PARSE_OK && i == value, "Failed: parse s64 round trip");
+		assert(string_parse_u64(tprint("%llu", (u64)value), &u) == STRING_PARSE_OK && u == (u64)value, "Failed: parse u64 round trip");
+		if ((k % 1000) == 0) reset_temporary_storage();
+	}
+
+	parse_test_f64("0", 0, STRING_PARSE_OK);
+	parse_test_f64("-0.0", 0x8000000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("1.5", 0x3FF8000000000000ull, STRING_PARSE_OK);
+	parse_test_f64(".5", 0x3FE0000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("5.", 0x4014000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("0.1", 0x3FB999999999999Aull, STRING_PARSE_OK);
+	parse_test_f64("1e23", 0x44B52D02C7E14AF6ull, STRING_PARSE_OK);
+	parse_test_f64("1.7976931348623157e308", 0x7FEFFFFFFFFFFFFFull, STRING_PARSE_OK);
+	parse_test_f64("2.2250738585072014E-308", 0x0010000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("2.2250738585072011e-308", 0x000FFFFFFFFFFFFFull, STRING_PARSE_OK);
+	parse_test_f64("4.9e-324", 1, STRING_PARSE_OK);
+	parse_test_f64("2e-324", 0, STRING_PARSE_OK);
+	parse_test_f64("1e-400", 0, STRING_PARSE_OK);
+	parse_test_f64("1e309", 0x7FF0000000000000ull, STRING_PARSE_OUT_OF_RANGE);
+	parse_test_f64("-1e99999999999", 0xFFF0000000000000ull, STRING_PARSE_OUT_OF_RANGE);
+	parse_test_f64("-Infinity", 0xFFF0000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("inf", 0x7FF0000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("NaN", 0x7FF8000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("9007199254740993", 0x4340000000000000ull, STRING_PARSE_OK); // Halfway, to even
+	parse_test_f64("9007199254740995", 0x4340000000000002ull, STRING_PARSE_OK);
+	// More than 19 digits, deciding which side of the halfway point takes all of them
+	parse_test_f64("9007199254740993.0000000000000000000000001", 0x4340000000000001ull, STRING_PARSE_OK);
+	parse_test_f64("9007199254740992.9999999999999999999999999", 0x4340000000000000ull, STRING_PARSE_OK);
+	parse_test_f64("0.1000000000000000055511151231257827021181583404541015625", 0x3FB999999999999Aull, STRING_PARSE_OK);
+	parse_test_f64("2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996189898282347722858865463328355177969898199387398005390939063150356595155702263922908583924491051844359318028499365361525003193704576782492193656236698636584807570015857692699037063119282795585513329278343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378573934507363390079677619305775067401763246736009689513405355374585166611342237666786041621596804619144672918403005300575308490487653917113865916462395249126236538818796362393732804238910186723484976682350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854513962138377228261454376934125320985913276672363281255e-324", 1, STRING_PARSE_OK);
+	parse_test_f64("2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996189898282347722858865463328355177969898199387398005390939063150356595155702263922908583924491051844359318028499365361525003193704576782492193656236698636584807570015857692699037063119282795585513329278343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378573934507363390079677619305775067401763246736009689513405355374585166611342237666786041621596804619144672918403005300575308490487653917113865916462395249126236538818796362393732804238910186723484976682350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854513962138377228261454376934125320985913276672363281245e-324", 0, STRING_PARSE_OK);
+	parse_test_f64("1e", 0, STRING_PARSE_INVALID);
+	parse_test_f64("1.2.3", 0, STRING_PARSE_INVALID);
+	parse_test_f64("", 0, STRING_PARSE_EMPTY);
+	parse_test_f64(".", 0, STRING_PARSE_EMPTY);
+	parse_test_f64("e5", 0, STRING_PARSE_EMPTY);
+	f64 f;
+	assert(string_parse_f64_prefix(STR("3.25e2x"), &f, &length) == STRING_PARSE_OK && f == 325.0 && length == 6, "Failed: parse f64 prefix");
+	assert(string_parse_f64_prefix(STR("7e+"), &f, &length) == STRING_PARSE_OK && f == 7.0 && length == 1, "Failed: parse f64 prefix without exponent digits");
+
+	// What %r prints reads back the same, and random decimal text agrees with the C runtime
+	char text[128];
+	for (u64 k = 0; k < 200000; k++) {
+		u64 bits = get_random();
+		if (k % 4 == 0) bits = (bits & 0x800FFFFFFFFFFFFFull) | ((u64)get_random_int_in_range(1000, 1100) << 52);
+		if (((bits >> 52) & 0x7FF) == 0x7FF) continue;
+		f64 original;
+		memcpy(&original, &bits, sizeof(original));
+
+		u64 n = format_string_to_buffer_va(text, sizeof(text), "%r", original);
+		assert(string_parse_f64((string){n, (u8*)text}, &f) == STRING_PARSE_OK && memcmp(&f, &original, sizeof(f)) == 0, "Failed: %%r round trip of '%cs'", text);
+
+		// Up to 25 digits, so the long input path is hit too
+		u64 digits = get_random_int_in_range(1, 25);
+		n = 0;
+		if (get_random() & 1) text[n++] = '-';
+		u64 point_at = get_random_int_in_range(0, digits);
+		for (u64 d = 0; d < digits; d++) {
+			if (d == point_at) text[n++] = '.';
+			text[n++] = (char)('0' + get_random_int_in_range(0, 9));
+		}
+		n += format_string_to_buffer_va(text+n, sizeof(text)-n, "e%d", (int)get_random_int_in_range(-340, 310));
+		text[n] = 0;
+		f64 expected = strtod(text, 0);
+		String_Parse_Error error = string_parse_f64((string){n, (u8*)text}, &f);
+		assert(error == STRING_PARSE_OK || error == STRING_PARSE_OUT_OF_RANGE, "Failed: string_parse_f64 '%cs'", text);
+		assert(memcmp(&f, &expected, sizeof(f)) == 0, "Failed: string_parse_f64 '%cs' gave %r, C runtime %r", text, f, expected);
+	}
+
+	// Tokenizer
+	string tokens[16];
+	u64 token_count = string_split(STR("a,,b\nc,"), STR(",\n"), false, tokens, 16);
+	assert(token_count == 4 && strings_match(tokens[0], STR("a")) && tokens[1].count == 0 && strings_match(tokens[2], STR("b")) && strings_match(tokens[3], STR("c")), "Failed: string_split");
+	token_count = string_split(STR("  hello \t world\n"), STR(" \t\n"), true, tokens, 16);
+	assert(token_count == 2 && strings_match(tokens[0], STR("hello")) && strings_match(tokens[1], STR("world")), "Failed: string_split skip_empty");
+	assert(string_split(STR(""), STR(","), false, tokens, 16) == 0, "Failed: string_split empty");
+
+	// Every simd level splits random text like the obvious loop does
+	s32 best_level = string_test_best_level();
+	u8 random_text[500];
+	for (u64 iteration = 0; iteration < 2000; iteration++) {
+		u64 count = get_random() % (sizeof(random_text)+1);
+		for (u64 k = 0; k < count; k++) random_text[k] = "ab,;\n"[get_random_int_in_range(0, 4)];
+		string text_string = {count, random_text};
+		bool skip_empty = iteration % 2;
+		for (s32 level = 0; level <= best_level; level++) {
+			string_test_set_level(level);
+			String_Tokenizer t;
+			string_tokenizer_init(&t, text_string, STR(",;\n"), skip_empty);
+			u64 start = 0;
+			string token;
+			for (u64 k = 0; k <= count; k++) {
+				if (k < count && random_text[k] != ',' && random_text[k] != ';' && random_text[k] != '\n') continue;
+				if (k == count && start == count) break;
+				if (k > start || !skip_empty) {
+					assert(string_tokenizer_next(&t, &token), "Failed: tokenizer ended early at simd level %d", level);
+					assert(token.data == random_text+start && token.count == k-start, "Failed: tokenizer token at simd level %d", level);
+					assert(t.delimiter == (k < count ? random_text[k] : 0), "Failed: tokenizer delimiter");
+				}
+				start = k+1;
+			}
+			assert(!string_tokenizer_next(&t, &token), "Failed: tokenizer has too many tokens at simd level %d", level);
+		}
+	}
+	string_test_restore_level();
+
+	// Loading a csv of floats: tokenize & parse vs strtod
+	u64 value_count = 1000000;
+	String_Builder csv;
+	string_builder_init_reserve(&csv, value_count*20, heap);
+	for (u64 k = 0; k < value_count; k++) {
+		string_builder_print(&csv, "%r%cs", get_random_float64_in_range(-1000.0, 1000.0), (k % 8) == 7 ? "\n" : ",");
+	}
+	char *csv_cstring = (char*)alloc(heap, csv.count+1);
+	memcpy(csv_cstring, csv.buffer, csv.count);
+	csv_cstring[csv.count] = 0;
+
+	f64 start = os_get_current_time_in_seconds();
+	f64 sum = 0;
+	String_Tokenizer t;
+	string_tokenizer_init(&t, csv.result, STR(",\n"), false);
+	string token;
+	u64 parsed = 0;
+	while (string_tokenizer_next(&t, &token)) {
+		assert(string_parse_f64(token, &f) == STRING_PARSE_OK, "Failed: parsing csv value");
+		sum += f;
+		parsed += 1;
+	}
+	f64 parse_seconds = os_get_current_time_in_seconds()-start;
+	assert(parsed == value_count, "Failed: csv value count");
+
+	start = os_get_current_time_in_seconds();
+	f64 crt_sum = 0;
+	char *p = csv_cstring;
+	for (u64 k = 0; k < value_count; k++) {
+		crt_sum += strtod(p, &p);
+		p += 1;
+	}
+	f64 crt_seconds = os_get_current_time_in_seconds()-start;
+	assert(sum == crt_sum, "Failed: csv sums differ");
+
+	print("\ncsv of %llu floats (%llu MB): tokenize & string_parse_f64 %.1fms (%.0f MB/s), strtod %.1fms\n",
+		value_count, csv.count/MB(1), parse_seconds*1000.0, (f64)csv.count/MB(1)/parse_seconds, crt_seconds*1000.0);
+
+	dealloc(heap, csv_cstring);
+	dealloc(heap, csv.buffer);
+}
+
+typedef struct Directory_Test_Counts {
+    u64 files;
+    u64 directories;
+    u64 total_size;
+    bool saw_nested_file;
+    u64 stop_after;
+} Directory_Test_Counts;
+bool directory_test_count_proc(Os_File_Info *info, void *userdata) {
+    Directory_Test_Counts *counts = (Directory_Test_Counts*)userdata;
+    if (info->is_directory) counts->directories += 1;
+    else                    counts->files += 1;
+    counts->total_size += info->size;
+    if (strings_match(info->path, STR("test_dir1/test_dir2/test_dir3/nested.txt"))) {
+        assert(strings_match(info->name, STR("nested.txt")), "Failed: os_iterate_directory name");
+        counts->saw_nested_file = true;
+    }
+    return !counts->stop_after || counts->files+counts->directories < counts->stop_after;
+}
 void test_file_io() {
 
 #if TARGET_OS == WINDOWS && !OOGABOOGA_LINK_EXTERNAL_INSTANCE
@@ -541,6 +1388,27 @@ void test_file_io() {
     u64 *new_integers = (u64*)integers_data.data;
     assert(integers_read.count == integers_data.count, "Failed: big file read/write mismatch. Read was %d and written was %d", integers_read.count, integers_data.count);
     assert(strings_match(integers_data, integers_read), "Failed: big file read/write mismatch");
+    
+    // Test os_file_map
+    Os_File_Map integers_map;
+    ok = os_file_map("integers", &integers_map, OS_FILE_MAP_ACCESS_SEQUENTIAL | OS_FILE_MAP_PREFETCH);
+    assert(ok, "Failed: os_file_map");
+    assert(strings_match(integers_map.data, integers_data), "Failed: os_file_map contents mismatch");
+    os_file_unmap(&integers_map);
+    assert(integers_map.data.data == 0 && integers_map.data.count == 0, "Failed: os_file_unmap");
+    
+    ok = os_write_entire_file("empty_map_test.txt", STR(""));
+    assert(ok, "Failed: os_write_entire_file (empty)");
+    Os_File_Map empty_map;
+    ok = os_file_map(STR("empty_map_test.txt"), &empty_map, OS_FILE_MAP_ACCESS_RANDOM);
+    assert(ok && empty_map.data.count == 0, "Failed: os_file_map on an empty file");
+    os_file_unmap(&empty_map);
+    ok = os_file_delete("empty_map_test.txt");
+    assert(ok, "Failed: could not delete empty_map_test.txt");
+    
+    Os_File_Map missing_map;
+    ok = os_file_map("does_not_exist.txt", &missing_map, OS_FILE_MAP_ACCESS_NORMAL);
+    assert(!ok, "Failed: os_file_map on a missing file should fail");
 
 	assert(os_is_file("test.txt"), "Failed: test.txt not recognized as file");
 	assert(os_is_file("test_bytes.txt"), "Failed: test_bytes.txt not recognized as file");
@@ -572,9 +1440,90 @@ void test_file_io() {
 	assert(os_is_directory("test_dir1/test_dir2"), "Failed: os_is_directory");
 	assert(os_is_directory("test_dir1/test_dir2//test_dir3"), "Failed: os_is_directory");
 	assert(os_is_directory("test_dir1/test_dir2//test_dir4"), "Failed: os_is_directory");
+	
+	bool delete_ok = false;
+	
+	// Test os_iterate_directory
+	bool write_ok = os_write_entire_file("test_dir1/top.txt", STR("top"));
+	assert(write_ok, "Failed: os_write_entire_file");
+	write_ok = os_write_entire_file("test_dir1/test_dir2/test_dir3/nested.txt", STR("nested"));
+	assert(write_ok, "Failed: os_write_entire_file");
+	
+	Directory_Test_Counts counts = {0};
+	bool iterate_ok = os_iterate_directory("test_dir1", true, directory_test_count_proc, &counts);
+	assert(iterate_ok, "Failed: os_iterate_directory");
+	assert(counts.files == 2 && counts.directories == 3, "Failed: os_iterate_directory recursive found %llu files, %llu directories", counts.files, counts.directories);
+	assert(counts.total_size == 9, "Failed: os_iterate_directory file sizes");
+	assert(counts.saw_nested_file, "Failed: os_iterate_directory path");
+	
+	counts = (Directory_Test_Counts){0};
+	iterate_ok = os_iterate_directory(STR("test_dir1/"), false, directory_test_count_proc, &counts);
+	assert(iterate_ok && counts.files == 1 && counts.directories == 1, "Failed: os_iterate_directory non-recursive");
+	
+	counts = (Directory_Test_Counts){0};
+	counts.stop_after = 1;
+	iterate_ok = os_iterate_directory("test_dir1", true, directory_test_count_proc, &counts);
+	assert(iterate_ok && counts.files+counts.directories == 1, "Failed: os_iterate_directory should stop when proc returns false");
+	
+	assert(!os_iterate_directory("does_not_exist", true, directory_test_count_proc, &counts), "Failed: os_iterate_directory on a missing directory should fail");
+	
+	Os_File_Info file_info;
+	bool info_ok = os_get_file_info("test_dir1/test_dir2/test_dir3/nested.txt", &file_info);
+	assert(info_ok && !file_info.is_directory && file_info.size == 6, "Failed: os_get_file_info");
+	assert(file_info.modification_time != 0, "Failed: os_get_file_info modification_time");
+	info_ok = os_get_file_info("test_dir1/test_dir2", &file_info);
+	assert(info_ok && file_info.is_directory, "Failed: os_get_file_info on a directory");
+	assert(!os_get_file_info("test_dir1/nope.txt", &file_info), "Failed: os_get_file_info on a missing file should fail");
+	
+	// Test os_watch_directory
+	Os_Directory_Watch watch;
+	bool watch_ok = os_watch_directory("test_dir1", true, &watch);
+	assert(watch_ok, "Failed: os_watch_directory");
+	
+	write_ok = os_write_entire_file("test_dir1/watched.txt", STR("hello"));
+	assert(write_ok, "Failed: os_write_entire_file");
+	write_ok = os_write_entire_file("test_dir1/top.txt", STR("top top"));
+	assert(write_ok, "Failed: os_write_entire_file");
+	delete_ok = os_file_delete("test_dir1/watched.txt");
+	assert(delete_ok, "Failed: os_file_delete");
+	
+	// Changes arrive in the background
+	bool saw_added = false, saw_removed = false, saw_modified = false;
+	f64 watch_start = os_get_current_time_in_seconds();
+	while (!(saw_added && saw_removed && saw_modified) && os_get_current_time_in_seconds()-watch_start < 2.0) {
+		Os_File_Change *changes;
+		u64 change_count = os_poll_directory_changes(&watch, &changes, heap);
+		for (u64 i = 0; i < change_count; i++) {
+			if (changes[i].kind == OS_FILE_CHANGE_ADDED    && strings_match(changes[i].path, STR("watched.txt"))) saw_added = true;
+			if (changes[i].kind == OS_FILE_CHANGE_REMOVED  && strings_match(changes[i].path, STR("watched.txt"))) saw_removed = true;
+			if (changes[i].kind == OS_FILE_CHANGE_MODIFIED && strings_match(changes[i].path, STR("top.txt")))     saw_modified = true;
+		}
+		if (changes) dealloc(heap, changes);
+		os_sleep(1);
+	}
+	assert(saw_added && saw_removed && saw_modified, "Failed: os_poll_directory_changes missed changes (added %d, removed %d, modified %d)", saw_added, saw_removed, saw_modified);
+	os_unwatch_directory(&watch);
+	
+	// Repeats are dropped, but not when they'd change the outcome
+	u8 change_names[] = "a.txtb.txt";
+	Os_File_Change raw_changes[] = {
+		{OS_FILE_CHANGE_MODIFIED, {5, (u8*)0}},
+		{OS_FILE_CHANGE_MODIFIED, {5, (u8*)0}},
+		{OS_FILE_CHANGE_MODIFIED, {5, (u8*)5}},
+		{OS_FILE_CHANGE_REMOVED,  {5, (u8*)0}},
+		{OS_FILE_CHANGE_ADDED,    {5, (u8*)0}},
+		{OS_FILE_CHANGE_MODIFIED, {5, (u8*)5}},
+	};
+	Os_File_Change *packed;
+	u64 packed_count = os_pack_directory_changes(raw_changes, 6, change_names, &packed, heap);
+	assert(packed_count == 4, "Failed: os_pack_directory_changes kept %llu changes, expected 4", packed_count);
+	assert(packed[0].kind == OS_FILE_CHANGE_MODIFIED && strings_match(packed[0].path, STR("a.txt")), "Failed: os_pack_directory_changes");
+	assert(packed[1].kind == OS_FILE_CHANGE_MODIFIED && strings_match(packed[1].path, STR("b.txt")), "Failed: os_pack_directory_changes");
+	assert(packed[2].kind == OS_FILE_CHANGE_REMOVED  && strings_match(packed[2].path, STR("a.txt")), "Failed: os_pack_directory_changes");
+	assert(packed[3].kind == OS_FILE_CHANGE_ADDED    && strings_match(packed[3].path, STR("a.txt")), "Failed: os_pack_directory_changes");
+	dealloc(heap, packed);
 
     // Clean up test files
-    bool delete_ok = false;
     delete_ok = os_file_delete("test.txt");
     assert(delete_ok, "Failed: could not delete test.txt");
     delete_ok = os_file_delete("test_bytes.txt");
@@ -590,6 +1539,483 @@ void test_file_io() {
     delete_ok = os_delete_directory("test_dir1", true);
     assert(delete_ok, "Failed: could not delete test_dir1 (recursive)"); 
 }
+
+#define ASYNC_IO_TEST_FILE_COUNT 1000
+void async_io_test_callback(Async_Io_Request *request) {
+    u64 *callback_count = (u64*)request->userdata;
+    *callback_count += 1;
+}
+void test_async_io() {
+    Allocator heap = get_heap_allocator();
+    const u64 N = ASYNC_IO_TEST_FILE_COUNT;
+
+    bool dir_ok = os_make_directory("async_io_test", false);
+    assert(dir_ok, "Failed: os_make_directory");
+
+    string *paths = alloc(heap, N*sizeof(string));
+    string *contents = alloc(heap, N*sizeof(string));
+    Async_Io_Request *requests = alloc(heap, N*sizeof(Async_Io_Request));
+
+    // Write the files async
+    memset(requests, 0, N*sizeof(Async_Io_Request));
+    for (u64 i = 0; i < N; i++) {
+        paths[i] = sprint(heap, STR("async_io_test/%llu.txt"), i);
+        String_Builder b;
+        string_builder_init_reserve(&b, 512, heap);
+        for (u64 j = 0; j < 16 + i%32; j++) string_builder_print(&b, STR("file %llu line %llu\n"), i, j);
+        contents[i] = b.result;
+
+        requests[i].kind = ASYNC_IO_WRITE_ENTIRE_FILE;
+        requests[i].path = paths[i];
+        requests[i].data = contents[i];
+    }
+    async_io_submit(requests, N);
+    async_io_wait(requests, N);
+    for (u64 i = 0; i < N; i++) {
+        assert(requests[i].state == ASYNC_IO_DONE, "Failed: async write of %s", paths[i]);
+        assert(requests[i].bytes_transferred == contents[i].count, "Failed: async write bytes_transferred");
+    }
+
+    // Load all files synchronously, then async
+    f64 start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < N; i++) {
+        string data;
+        bool ok = os_read_entire_file(paths[i], &data, heap);
+        assert(ok && strings_match(data, contents[i]), "Failed: os_read_entire_file %s", paths[i]);
+        dealloc_string(heap, data);
+    }
+    f64 sync_seconds = os_get_current_time_in_seconds()-start;
+
+    u64 callback_count = 0;
+    start = os_get_current_time_in_seconds();
+    memset(requests, 0, N*sizeof(Async_Io_Request));
+    for (u64 i = 0; i < N; i++) {
+        requests[i].kind = ASYNC_IO_READ_ENTIRE_FILE;
+        requests[i].path = paths[i];
+        requests[i].allocator = heap;
+        requests[i].callback = async_io_test_callback;
+        requests[i].userdata = &callback_count;
+    }
+    async_io_submit(requests, N);
+    async_io_wait(requests, N);
+    f64 async_seconds = os_get_current_time_in_seconds()-start;
+
+    for (u64 i = 0; i < N; i++) {
+        assert(async_io_is_complete(&requests[i]), "Failed: async_io_is_complete");
+        assert(requests[i].state == ASYNC_IO_DONE, "Failed: async read of %s", paths[i]);
+        assert(strings_match(requests[i].data, contents[i]), "Failed: async read of %s mismatch", paths[i]);
+        assert(requests[i].bytes_transferred == contents[i].count, "Failed: async read bytes_transferred");
+        dealloc_string(heap, requests[i].data);
+    }
+
+    // Callbacks are only run when polling. Requests with callbacks are queued for the poll
+    // just after they are marked complete, so this may need a few tries.
+    assert(callback_count == 0, "Failed: async_io callback ran before polling");
+    u64 polled = 0;
+    while (polled < N) {
+        polled += async_io_poll();
+        os_yield_thread();
+    }
+    assert(polled == N && callback_count == N, "Failed: async_io_poll ran %llu callbacks, expected %llu", callback_count, N);
+    assert(async_io_poll() == 0, "Failed: async_io_poll ran callbacks twice");
+
+    print("loading %llu files, sync: %.2fms, async: %.2fms... ", N, sync_seconds*1000.0, async_seconds*1000.0);
+
+    // Missing files fail
+    Async_Io_Request missing = {0};
+    missing.kind = ASYNC_IO_READ_ENTIRE_FILE;
+    missing.path = STR("async_io_test/does_not_exist.txt");
+    missing.allocator = heap;
+    async_io_submit(&missing, 1);
+    async_io_wait(&missing, 1);
+    assert(missing.state == ASYNC_IO_FAILED, "Failed: async read of a missing file should fail");
+    assert(missing.data.data == 0 && missing.data.count == 0, "Failed: failed async read should not return data");
+
+    // Reads and writes at offsets in the same file
+    File f = os_file_open("async_io_test/offsets.bin", O_CREATE | O_WRITE);
+    assert(f != OS_INVALID_FILE, "Failed: os_file_open");
+    Async_Io_Request writes[2] = {0};
+    writes[0].kind = ASYNC_IO_WRITE;
+    writes[0].file = f;
+    writes[0].offset = 0;
+    writes[0].data = STR("Hello, ");
+    writes[1].kind = ASYNC_IO_WRITE;
+    writes[1].file = f;
+    writes[1].offset = 7;
+    writes[1].data = STR("World!");
+    async_io_submit(writes, 2);
+    async_io_wait(writes, 2);
+    assert(writes[0].state == ASYNC_IO_DONE && writes[1].state == ASYNC_IO_DONE, "Failed: async write at offset");
+
+    u8 buffer[16] = {0};
+    Async_Io_Request reads[2] = {0};
+    reads[0].kind = ASYNC_IO_READ;
+    reads[0].file = f;
+    reads[0].offset = 7;
+    reads[0].data = (string){5, buffer};
+    reads[1].kind = ASYNC_IO_READ;
+    reads[1].file = f;
+    reads[1].offset = 10;
+    reads[1].data = (string){16, buffer+5};
+    async_io_submit(reads, 2);
+    async_io_wait(reads, 2);
+    assert(reads[0].state == ASYNC_IO_DONE && reads[0].bytes_transferred == 5, "Failed: async read at offset");
+    assert(reads[1].state == ASYNC_IO_DONE && reads[1].bytes_transferred == 3, "Failed: async read at offset past the end");
+    assert(strings_match((string){8, buffer}, STR("Worldld!")), "Failed: async read at offset mismatch");
+    os_file_close(f);
+
+    for (u64 i = 0; i < N; i++) {
+        dealloc_string(heap, paths[i]);
+        dealloc_string(heap, contents[i]);
+    }
+    dealloc(heap, paths);
+    dealloc(heap, contents);
+    dealloc(heap, requests);
+
+    bool delete_ok = os_delete_directory("async_io_test", true);
+    assert(delete_ok, "Failed: could not delete async_io_test");
+}
+#define SOCKET_TEST_DATAGRAM_COUNT 20000
+#define SOCKET_TEST_DATAGRAM_SIZE 1024
+#define SOCKET_TEST_BATCH_SIZE 64
+#define SOCKET_TEST_ROUND_TRIPS 2000
+#define SOCKET_TEST_STREAM_SIZE (32*1024*1024)
+void socket_test_wait(Socket s, Socket_Events events) {
+    Socket_Poll poll = {s, events};
+    u64 ready = os_socket_poll(&poll, 1, 1000);
+    assert(ready == 1 && (poll.events & events), "Failed: socket was not ready within a second");
+}
+void socket_test_send_all(Socket s, u8 *data, u64 size) {
+    while (size > 0) {
+        s64 sent = os_socket_send(s, data, size);
+        assert(sent >= 0, "Failed: os_socket_send");
+        if (sent == 0) socket_test_wait(s, SOCKET_EVENT_WRITE);
+        data += sent;
+        size -= sent;
+    }
+}
+void socket_test_receive_all(Socket s, u8 *buffer, u64 size) {
+    while (size > 0) {
+        s64 received = os_socket_receive(s, buffer, size);
+        assert(received >= 0, "Failed: os_socket_receive");
+        if (received == 0) socket_test_wait(s, SOCKET_EVENT_READ);
+        buffer += received;
+        size -= received;
+    }
+}
+void test_sockets() {
+    Allocator heap = get_heap_allocator();
+
+    ///
+    // UDP
+    Socket a = os_socket_open_udp(socket_address_loopback(0));
+    Socket b = os_socket_open_udp(socket_address_loopback(0));
+    assert(a != OS_INVALID_SOCKET && b != OS_INVALID_SOCKET, "Failed: os_socket_open_udp");
+    Socket_Address a_address, b_address;
+    bool got_addresses = os_socket_get_address(a, &a_address) && os_socket_get_address(b, &b_address);
+    assert(got_addresses, "Failed: os_socket_get_address");
+    assert(b_address.ip == 0x7F000001 && b_address.port != 0 && b_address.port != a_address.port, "Failed: binding to port 0 should give a free port");
+
+    u64 buffer_size = SOCKET_TEST_BATCH_SIZE*SOCKET_MAX_DATAGRAM_SIZE;
+    u8 *buffer = alloc(heap, buffer_size);
+    Socket_Datagram received[SOCKET_TEST_BATCH_SIZE];
+    Socket_Datagram to_send[SOCKET_TEST_BATCH_SIZE];
+    u8 *payloads = alloc(heap, SOCKET_TEST_BATCH_SIZE*SOCKET_TEST_DATAGRAM_SIZE);
+
+    // Nothing to receive doesn't block
+    assert(os_socket_receive_datagrams(b, received, SOCKET_TEST_BATCH_SIZE, buffer, buffer_size) == 0, "Failed: receiving from an empty socket");
+    Socket_Poll poll = {b, SOCKET_EVENT_READ};
+    assert(os_socket_poll(&poll, 1, 0) == 0 && poll.events == 0, "Failed: os_socket_poll on an empty socket");
+
+    // Keep one batch in flight at a time so loopback never has a reason to drop any
+    u64 sent_count = 0;
+    u64 received_count = 0;
+    f64 start = os_get_current_time_in_seconds();
+    while (received_count < SOCKET_TEST_DATAGRAM_COUNT) {
+        if (sent_count == received_count) {
+            u64 count = min(SOCKET_TEST_BATCH_SIZE, SOCKET_TEST_DATAGRAM_COUNT-sent_count);
+            for (u64 i = 0; i < count; i++) {
+                u8 *payload = payloads + i*SOCKET_TEST_DATAGRAM_SIZE;
+                *(u64*)payload = sent_count+i;
+                to_send[i].address = b_address;
+                to_send[i].data = (string){SOCKET_TEST_DATAGRAM_SIZE, payload};
+            }
+            sent_count += os_socket_send_datagrams(a, to_send, count);
+        }
+
+        socket_test_wait(b, SOCKET_EVENT_READ);
+        u64 count = os_socket_receive_datagrams(b, received, SOCKET_TEST_BATCH_SIZE, buffer, buffer_size);
+        for (u64 i = 0; i < count; i++) {
+            Socket_Datagram d = received[i];
+            assert(socket_addresses_match(d.address, a_address), "Failed: datagram from the wrong address");
+            assert(d.data.count == SOCKET_TEST_DATAGRAM_SIZE, "Failed: datagram size %llu", d.data.count);
+            assert(d.data.data >= buffer && d.data.data+d.data.count <= buffer+buffer_size, "Failed: datagram should be received into the buffer");
+            assert(*(u64*)d.data.data == received_count, "Failed: datagram %llu out of order", received_count);
+            received_count += 1;
+        }
+    }
+    f64 udp_seconds = os_get_current_time_in_seconds()-start;
+
+    // A buffer with room for less than SOCKET_MAX_DATAGRAM_SIZE more stops the batch
+    u64 count = os_socket_send_datagrams(a, to_send, 2);
+    assert(count == 2, "Failed: os_socket_send_datagrams");
+    socket_test_wait(b, SOCKET_EVENT_READ);
+    count = os_socket_receive_datagrams(b, received, 2, buffer, SOCKET_MAX_DATAGRAM_SIZE+SOCKET_TEST_DATAGRAM_SIZE-1);
+    assert(count == 1, "Failed: receiving should stop when the buffer is full");
+    socket_test_wait(b, SOCKET_EVENT_READ);
+    count = os_socket_receive_datagrams(b, received, 2, buffer, buffer_size);
+    assert(count == 1, "Failed: the datagram that didn't fit should still be there");
+
+    os_socket_close(a);
+    os_socket_close(b);
+
+    ///
+    // TCP
+    Socket listener = os_socket_listen(socket_address_loopback(0));
+    assert(listener != OS_INVALID_SOCKET, "Failed: os_socket_listen");
+    Socket_Address listen_address;
+    assert(os_socket_get_address(listener, &listen_address), "Failed: os_socket_get_address");
+    assert(os_socket_accept(listener, 0) == OS_INVALID_SOCKET, "Failed: accepting with nothing waiting should not block");
+
+    Socket client = os_socket_connect(listen_address);
+    assert(client != OS_INVALID_SOCKET, "Failed: os_socket_connect");
+    socket_test_wait(listener, SOCKET_EVENT_READ);
+    Socket_Address remote;
+    Socket server = os_socket_accept(listener, &remote);
+    assert(server != OS_INVALID_SOCKET, "Failed: os_socket_accept");
+    socket_test_wait(client, SOCKET_EVENT_WRITE);
+    Socket_Address client_address;
+    os_socket_get_address(client, &client_address);
+    assert(socket_addresses_match(remote, client_address), "Failed: accepted remote address should be the client");
+
+    // Latency, with small messages back and forth
+    u8 message[64] = {0};
+    f64 best_round_trip = 1000.0;
+    start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < SOCKET_TEST_ROUND_TRIPS; i++) {
+        f64 round_trip_start = os_get_current_time_in_seconds();
+        message[0] = (u8)i;
+        socket_test_send_all(client, message, sizeof(message));
+        socket_test_receive_all(server, buffer, sizeof(message));
+        assert(buffer[0] == (u8)i, "Failed: tcp message mismatch");
+        socket_test_send_all(server, buffer, sizeof(message));
+        socket_test_receive_all(client, message, sizeof(message));
+        assert(message[0] == (u8)i, "Failed: tcp reply mismatch");
+        best_round_trip = min(best_round_trip, os_get_current_time_in_seconds()-round_trip_start);
+    }
+    f64 average_round_trip = (os_get_current_time_in_seconds()-start)/SOCKET_TEST_ROUND_TRIPS;
+
+    // Throughput, sending and receiving from the same thread. Bytes count 0-250 so anything
+    // lost, repeated or reordered shows up.
+    u64 pattern_size = 251*1024;
+    u8 *pattern = alloc(heap, pattern_size+251);
+    for (u64 i = 0; i < pattern_size+251; i++) pattern[i] = (u8)(i%251);
+    u64 total_sent = 0;
+    u64 total_received = 0;
+    start = os_get_current_time_in_seconds();
+    while (total_received < SOCKET_TEST_STREAM_SIZE) {
+        bool progress = false;
+        if (total_sent < SOCKET_TEST_STREAM_SIZE) {
+            u64 size = min(pattern_size, SOCKET_TEST_STREAM_SIZE-total_sent);
+            s64 sent = os_socket_send(client, pattern + total_sent%251, size);
+            assert(sent >= 0, "Failed: os_socket_send");
+            total_sent += sent;
+            progress |= sent > 0;
+        }
+        s64 got = os_socket_receive(server, buffer, buffer_size);
+        assert(got >= 0, "Failed: os_socket_receive");
+        for (s64 i = 0; i < got; i++) {
+            assert(buffer[i] == (u8)((total_received+i)%251), "Failed: tcp stream corrupted at byte %llu", total_received+i);
+        }
+        total_received += got;
+        progress |= got > 0;
+
+        if (!progress) {
+            Socket_Poll polls[2] = {{client, SOCKET_EVENT_WRITE}, {server, SOCKET_EVENT_READ}};
+            assert(os_socket_poll(polls, 2, 1000) > 0, "Failed: tcp stream stalled");
+        }
+    }
+    f64 tcp_seconds = os_get_current_time_in_seconds()-start;
+
+    // Closing is seen by the other side
+    os_socket_close(client);
+    socket_test_wait(server, SOCKET_EVENT_READ);
+    assert(os_socket_receive(server, buffer, buffer_size) == -1, "Failed: receiving from a closed connection should return -1");
+
+    os_socket_close(server);
+    os_socket_close(listener);
+
+    print("udp: %.0f datagrams/s (%.1fMB/s), tcp: round trip avg %.1fus best %.1fus, %.1fMB/s... ",
+        SOCKET_TEST_DATAGRAM_COUNT/udp_seconds, SOCKET_TEST_DATAGRAM_COUNT*SOCKET_TEST_DATAGRAM_SIZE/udp_seconds/(1024.0*1024.0),
+        average_round_trip*1000000.0, best_round_trip*1000000.0, SOCKET_TEST_STREAM_SIZE/tcp_seconds/(1024.0*1024.0));
+
+    dealloc(heap, pattern);
+    dealloc(heap, payloads);
+    dealloc(heap, buffer);
+}
+
+#define LOGGER_TEST_THREAD_COUNT 4
+#define LOGGER_TEST_LINE_COUNT 20000
+void test_async_logger_thread_proc(Thread *t) {
+    u64 index = (u64)t->data;
+    for (u64 i = 0; i < LOGGER_TEST_LINE_COUNT; i++) {
+        log_info("thread %llu line %llu", index, i);
+    }
+}
+u64 logger_test_parse_number(string s, u64 *i) {
+    u64 n = 0;
+    while (*i < s.count && s.data[*i] >= '0' && s.data[*i] <= '9') {
+        n = n*10 + (s.data[*i]-'0');
+        *i += 1;
+    }
+    return n;
+}
+u64 logger_test_side_effect_count = 0;
+int logger_test_side_effect() {
+    logger_test_side_effect_count += 1;
+    return 0;
+}
+u64 logger_test_capture_count = 0;
+string logger_test_outer_message = {0};
+void logger_test_capture_logger(Log_Level level, string s) {
+    logger_test_capture_count = s.count;
+    // Logging from inside a logger shouldn't overwrite the message we were passed
+    if (logger_test_outer_message.count == 0) {
+        logger_test_outer_message = s;
+        log_info("inner %d", 1234);
+        assert(strings_match(s, STR("outer 5678")), "Failed: nested log call overwrote the outer message (%s)", s);
+    }
+}
+void test_async_logger() {
+    Allocator heap = get_heap_allocator();
+
+    Context c = get_context();
+    c.logger = logger_test_capture_logger;
+    push_context(c);
+    log_info("outer %d", 5678);
+    assert(logger_test_capture_count == 10, "Failed: nested log call");
+    logger_test_outer_message.count = 1; // Skip the nested log from now on
+    
+    // Messages longer than the log buffer aren't cut off
+    string long_arg = alloc_string(heap, LOG_MAX_MESSAGE_SIZE*2);
+    memset(long_arg.data, 'x', long_arg.count);
+    log_info("%s!", long_arg);
+    assert(logger_test_capture_count == long_arg.count+1, "Failed: long log message was cut off (%llu)", logger_test_capture_count);
+    log_info("short %d", 1);
+    assert(logger_test_capture_count == 7, "Failed: short log message after long one");
+    dealloc_string(heap, long_arg);
+    pop_context();
+
+    // Levels that are off shouldn't even evaluate their arguments
+    log_set_level_enabled(LOG_VERBOSE, false);
+    log_verbose("%d", logger_test_side_effect());
+    assert(logger_test_side_effect_count == 0, "Failed: log arguments were evaluated for a disabled level");
+    log_set_level_enabled(LOG_VERBOSE, true);
+    assert(log_is_level_enabled(LOG_VERBOSE), "Failed: log_set_level_enabled");
+
+    os_file_delete("async_logger_test.log");
+    async_logger_start(STR("async_logger_test.log"), false);
+
+    Async_Logger_Stats stats_before;
+    async_logger_get_stats(&stats_before);
+
+    // A line that takes several records
+    char long_line[1000];
+    for (u64 i = 0; i < sizeof(long_line); i++) long_line[i] = 'a' + (i % 26);
+    log_warning("%s", (string){sizeof(long_line), (u8*)long_line});
+
+    Thread threads[LOGGER_TEST_THREAD_COUNT];
+    f64 start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < LOGGER_TEST_THREAD_COUNT; i++) {
+        os_thread_init(&threads[i], test_async_logger_thread_proc);
+        threads[i].data = (void*)i;
+        os_thread_start(&threads[i]);
+    }
+    for (u64 i = 0; i < LOGGER_TEST_THREAD_COUNT; i++) {
+        os_thread_join(&threads[i]);
+        os_thread_destroy(&threads[i]);
+    }
+    f64 log_seconds = os_get_current_time_in_seconds()-start;
+    async_logger_flush();
+    f64 flush_seconds = os_get_current_time_in_seconds()-start;
+
+    Async_Logger_Stats stats;
+    async_logger_get_stats(&stats);
+    u64 written = stats.lines_written - stats_before.lines_written;
+    u64 dropped = stats.lines_dropped - stats_before.lines_dropped;
+    assert(written + dropped == LOGGER_TEST_THREAD_COUNT*LOGGER_TEST_LINE_COUNT + 1, "Failed: async logger lost lines without counting them (%llu written, %llu dropped)", written, dropped);
+
+    async_logger_stop();
+
+    // Every thread's lines must be there in order, except the dropped ones
+    string log_file;
+    bool ok = os_read_entire_file("async_logger_test.log", &log_file, heap);
+    assert(ok, "Failed: reading async logger file");
+
+    u64 next_line[LOGGER_TEST_THREAD_COUNT] = {0};
+    u64 lines_found = 0;
+    bool found_long_line = false;
+    bool found_drop_warning = false;
+    u64 i = 0;
+    while (i < log_file.count) {
+        u64 end = i;
+        while (end < log_file.count && log_file.data[end] != '\n') end += 1;
+        string line = string_view(log_file, i, end-i);
+        i = end+1;
+
+        string thread_prefix = STR("[INFO]:    thread ");
+        if (string_starts_with(line, thread_prefix)) {
+            u64 j = thread_prefix.count;
+            u64 thread_index = logger_test_parse_number(line, &j);
+            j += STR(" line ").count;
+            u64 line_index = logger_test_parse_number(line, &j);
+            assert(thread_index < LOGGER_TEST_THREAD_COUNT && j == line.count, "Failed: garbled async log line '%s'", line);
+            assert(line_index >= next_line[thread_index], "Failed: async log lines out of order");
+            next_line[thread_index] = line_index+1;
+            lines_found += 1;
+        } else if (string_starts_with(line, STR("[WARNING]: abc"))) {
+            assert(line.count == 11 + sizeof(long_line) && memcmp(line.data+11, long_line, sizeof(long_line)) == 0, "Failed: long async log line was garbled");
+            found_long_line = true;
+        } else if (string_starts_with(line, STR("[WARNING]: Async logger dropped"))) {
+            found_drop_warning = true;
+        }
+    }
+    assert(found_long_line, "Failed: long async log line missing");
+    assert(lines_found + 1 == written, "Failed: async log file has %llu lines, expected %llu", lines_found, written-1);
+    assert(found_drop_warning == (dropped > 0), "Failed: async logger should warn about dropped lines");
+    dealloc_string(heap, log_file);
+    os_file_delete("async_logger_test.log");
+
+    // Rotation
+    u64 max_file_size = async_logger.max_file_size;
+    u64 max_file_count = async_logger.max_file_count;
+    async_logger.max_file_size = KB(4);
+    async_logger.max_file_count = 3;
+    async_logger_start(STR("async_logger_test.log"), false);
+    for (u64 i = 0; i < 1000; i++) {
+        log_info("rotation line %llu", i);
+        if ((i % 100) == 0) async_logger_flush();
+    }
+    async_logger_stop();
+    async_logger.max_file_size = max_file_size;
+    async_logger.max_file_count = max_file_count;
+
+    const char *rotated[] = {"async_logger_test.log", "async_logger_test.1.log", "async_logger_test.2.log"};
+    for (u64 i = 0; i < 3; i++) {
+        s64 size = os_file_get_size_from_path(STR(rotated[i]));
+        assert(size > 0 && size <= (s64)KB(4), "Failed: rotated log file %cs is %lld bytes", rotated[i], size);
+    }
+    assert(!os_is_file("async_logger_test.3.log"), "Failed: async logger kept too many log files");
+    ok = os_read_entire_file("async_logger_test.log", &log_file, heap);
+    string last_line = STR("rotation line 999\n");
+    assert(ok && log_file.count >= last_line.count && strings_match(string_view(log_file, log_file.count-last_line.count, last_line.count), last_line), "Failed: last line should be in the newest log file");
+    dealloc_string(heap, log_file);
+    for (u64 i = 0; i < 3; i++) os_file_delete(rotated[i]);
+
+    print("%.0f ns per line on %d threads, %.1f M lines/s written, %llu dropped... ",
+        log_seconds*1000000000.0/(LOGGER_TEST_THREAD_COUNT*LOGGER_TEST_LINE_COUNT), LOGGER_TEST_THREAD_COUNT,
+        written/flush_seconds/1000000.0, dropped);
+}
 bool floats_roughly_match(float a, float b) {
 	return fabs(a - b) < 0.01;
 }
@@ -840,6 +2266,122 @@ void test_simd() {
     print("NO SIMD float32 mul took %llu cycles\n", cycles);
 } 
 
+bool simd_test_bits_match(float32 *a, float32 *b, u64 count) {
+	return memcmp(a, b, count*sizeof(float32)) == 0;
+}
+void test_simd_dispatch() {
+	Cpu_Capabilities cpu = query_cpu_capabilities();
+	
+	float32 a[16], b[16], expected[16], result[16];
+	s32 ai[16], bi[16], expectedi[16], resulti[16];
+	
+	u64 count = 100003; // Not a multiple of anything, so every array proc has a tail
+	float32 *big_a = alloc(get_heap_allocator(), count*sizeof(float32));
+	float32 *big_b = alloc(get_heap_allocator(), count*sizeof(float32));
+	float32 *big_expected = alloc(get_heap_allocator(), count*sizeof(float32));
+	float32 *big_result = alloc(get_heap_allocator(), count*sizeof(float32));
+	for (u64 i = 0; i < count; i++) {
+		big_a[i] = get_random_float32_in_range(-1000.0f, 1000.0f);
+		big_b[i] = get_random_float32_in_range(0.5f, 100.0f);
+	}
+	
+	// Every level the cpu can run gives the same results as plain C.
+	// Everything except rsqrt is exactly rounded so the bits must match.
+	for (Simd_Level level = SIMD_LEVEL_BASIC; level <= SIMD_LEVEL_AVX512; level++) {
+		simd_procs_init(cpu, level);
+		if (simd_procs.level != level) continue;
+		
+		for (u64 iteration = 0; iteration < 1000; iteration++) {
+			for (u64 i = 0; i < 16; i++) {
+				a[i] = get_random_float32_in_range(-1000.0f, 1000.0f);
+				b[i] = get_random_float32_in_range(0.5f, 100.0f);
+				ai[i] = (s32)get_random_int_in_range(-30000, 30000);
+				bi[i] = (s32)get_random_int_in_range(-30000, 30000);
+			}
+			
+			#define _SIMD_TEST_FLOAT32(name, op, width) \
+				for (u64 i = 0; i < width/32; i++) expected[i] = a[i] op b[i]; \
+				simd_procs.name##_float32_##width(a, b, result); \
+				assert(simd_test_bits_match(result, expected, width/32), "Failed: simd " #name " float32 " #width " at level %d", level);
+			#define _SIMD_TEST_INT32(name, op, width) \
+				for (u64 i = 0; i < width/32; i++) expectedi[i] = ai[i] op bi[i]; \
+				simd_procs.name##_int32_##width(ai, bi, resulti); \
+				assert(memcmp(resulti, expectedi, sizeof(s32)*width/32) == 0, "Failed: simd " #name " int32 " #width " at level %d", level);
+			
+			_SIMD_TEST_FLOAT32(add, +, 256) _SIMD_TEST_FLOAT32(add, +, 512)
+			_SIMD_TEST_FLOAT32(sub, -, 256) _SIMD_TEST_FLOAT32(sub, -, 512)
+			_SIMD_TEST_FLOAT32(mul, *, 256) _SIMD_TEST_FLOAT32(mul, *, 512)
+			_SIMD_TEST_FLOAT32(div, /, 256) _SIMD_TEST_FLOAT32(div, /, 512)
+			_SIMD_TEST_INT32(add, +, 256) _SIMD_TEST_INT32(add, +, 512)
+			_SIMD_TEST_INT32(sub, -, 256) _SIMD_TEST_INT32(sub, -, 512)
+			_SIMD_TEST_INT32(mul, *, 256) _SIMD_TEST_INT32(mul, *, 512)
+			#undef _SIMD_TEST_FLOAT32
+			#undef _SIMD_TEST_INT32
+			
+			for (u64 i = 0; i < 16; i++) expected[i] = (float32)sqrt(b[i]);
+			simd_procs.sqrt_float32_256(b, result);
+			assert(simd_test_bits_match(result, expected, 8), "Failed: simd sqrt float32 256 at level %d", level);
+			simd_procs.sqrt_float32_512(b, result);
+			assert(simd_test_bits_match(result, expected, 16), "Failed: simd sqrt float32 512 at level %d", level);
+			
+			// rsqrt is an approximation on the simd paths (12 bits for avx, 14 for avx-512)
+			simd_procs.rsqrt_float32_256(b, result);
+			for (u64 i = 0; i < 8; i++) {
+				assert(fabs(result[i]*expected[i] - 1.0) < 0.001, "Failed: simd rsqrt float32 256 at level %d", level);
+			}
+			simd_procs.rsqrt_float32_512(b, result);
+			for (u64 i = 0; i < 16; i++) {
+				assert(fabs(result[i]*expected[i] - 1.0) < 0.001, "Failed: simd rsqrt float32 512 at level %d", level);
+			}
+		}
+		
+		// Arrays of every length up to 100 (tails), and the big one
+		for (u64 n = 0; n <= 100; n++) {
+			#define _SIMD_TEST_ARRAY(name, op, n) \
+				for (u64 i = 0; i < n; i++) big_expected[i] = big_a[i] op big_b[i]; \
+				big_result[n] = 12345.0f; \
+				simd_procs.name##_float32_array(big_a, big_b, big_result, n); \
+				assert(simd_test_bits_match(big_result, big_expected, n), "Failed: simd " #name " float32 array of %llu at level %d", n, level); \
+				assert(big_result[n] == 12345.0f, "Failed: simd " #name " float32 array of %llu wrote past the end at level %d", n, level);
+			_SIMD_TEST_ARRAY(add, +, n)
+			_SIMD_TEST_ARRAY(sub, -, n)
+			_SIMD_TEST_ARRAY(mul, *, n)
+			_SIMD_TEST_ARRAY(div, /, n)
+			#undef _SIMD_TEST_ARRAY
+		}
+		for (u64 i = 0; i < count; i++) big_expected[i] = big_a[i] * big_b[i];
+		simd_procs.mul_float32_array(big_a, big_b, big_result, count);
+		assert(simd_test_bits_match(big_result, big_expected, count), "Failed: simd mul float32 array at level %d", level);
+		
+		// In place
+		memcpy(big_result, big_a, count*sizeof(float32));
+		simd_procs.add_float32_array(big_result, big_b, big_result, count);
+		for (u64 i = 0; i < count; i++) big_expected[i] = big_a[i] + big_b[i];
+		assert(simd_test_bits_match(big_result, big_expected, count), "Failed: simd add float32 array in place at level %d", level);
+		
+		// What the dispatch buys: the same array through the 256 procs one call at a time,
+		// and through the array proc.
+		u64 start = rdtsc();
+		for (u64 i = 0; i+8 <= count; i += 8) {
+			simd_procs.mul_float32_256(big_a+i, big_b+i, big_result+i);
+		}
+		u64 per_call_cycles = rdtsc()-start;
+		start = rdtsc();
+		simd_procs.mul_float32_array(big_a, big_b, big_result, count);
+		u64 array_cycles = rdtsc()-start;
+		print("\nsimd level %d: mul %llu floats, 256 per call %llu cycles, array %llu cycles", level, count, per_call_cycles, array_cycles);
+	}
+	print("\n");
+	
+	// Back to the best the cpu can do, like oogabooga_init leaves it
+	simd_procs_init(cpu, SIMD_LEVEL_AVX512);
+	
+	dealloc(get_heap_allocator(), big_a);
+	dealloc(get_heap_allocator(), big_b);
+	dealloc(get_heap_allocator(), big_expected);
+	dealloc(get_heap_allocator(), big_result);
+}
+
 // Indirect testing of some simd stuff
 void test_linmath() {
 
@@ -1031,6 +2573,214 @@ void test_linmath() {
 	assert(floats_roughly_match(v4_dot_product, 30), "Failed: v4_dot");
 }
 
+void test_linmath_batch() {
+	Allocator heap = get_heap_allocator();
+	Cpu_Capabilities cpu = query_cpu_capabilities();
+	
+	u64 count = 100000;
+	Vector2 *points   = alloc(heap, count*sizeof(Vector2));
+	Vector2 *result   = alloc(heap, count*sizeof(Vector2));
+	Vector4 *boxes    = alloc(heap, count*sizeof(Vector4));
+	float32 *lengths  = alloc(heap, count*sizeof(float32));
+	u64 *indices      = alloc(heap, count*sizeof(u64));
+	float32 *x        = alloc(heap, count*sizeof(float32));
+	float32 *y        = alloc(heap, count*sizeof(float32));
+	for (u64 i = 0; i < count; i++) {
+		points[i] = v2(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-500, 500));
+		if (i % 97 == 0) points[i] = v2(0, 0);
+		Vector2 size = v2(get_random_float32_in_range(0, 20), get_random_float32_in_range(0, 20));
+		boxes[i] = v4(points[i].x, points[i].y, points[i].x+size.x, points[i].y+size.y);
+		x[i] = points[i].x;
+		y[i] = points[i].y;
+	}
+	
+	Matrix4 m = m4_scalar(1.0);
+	m = m4_translate(m, v3(13.5, -7.25, 0));
+	m = m4_rotate_z(m, 0.7);
+	m = m4_scale(m, v3(1.5, 0.75, 1));
+	
+	Vector2 p = v2(12, -30);
+	float32 radius = 100;
+	Vector4 box = v4(-50, -60, 40, 70);
+	
+	for (Simd_Level level = SIMD_LEVEL_BASIC; level <= SIMD_LEVEL_AVX; level++) {
+		simd_procs_init(cpu, level);
+		if (simd_procs.level != level) continue;
+		
+		// Every count up to 40 to hit every tail, then all of them
+		for (u64 n = 0; n <= count; n = (n < 40) ? n+1 : count) {
+			m4_transform_points_v2(m, points, result, n);
+			for (u64 i = 0; i < n; i++) {
+				Vector4 expected = m4_transform(m, v4(points[i].x, points[i].y, 0, 1));
+				assert(fabsf(result[i].x-expected.x) <= 0.0001f*(1+fabsf(expected.x)) && fabsf(result[i].y-expected.y) <= 0.0001f*(1+fabsf(expected.y)), "Failed: m4_transform_points_v2 at simd level %d", level);
+			}
+			
+			v2_length_batch(points, lengths, n);
+			for (u64 i = 0; i < n; i++) {
+				assert(lengths[i] == v2_length(points[i]), "Failed: v2_length_batch at simd level %d", level);
+			}
+			
+			v2_normalize_batch(points, result, n);
+			for (u64 i = 0; i < n; i++) {
+				Vector2 expected = v2_normalize(points[i]);
+				assert(result[i].x == expected.x && result[i].y == expected.y, "Failed: v2_normalize_batch at simd level %d", level);
+			}
+			
+			v2_distance_squared_batch(p, points, lengths, n);
+			for (u64 i = 0; i < n; i++) {
+				Vector2 d = v2_sub(points[i], p);
+				assert(lengths[i] == d.x*d.x + d.y*d.y, "Failed: v2_distance_squared_batch at simd level %d", level);
+			}
+			
+			u64 found = v2_find_within_radius(p, radius, points, n, indices);
+			u64 expected_found = 0;
+			for (u64 i = 0; i < n; i++) {
+				Vector2 d = v2_sub(points[i], p);
+				if (d.x*d.x + d.y*d.y <= radius*radius) {
+					assert(expected_found < found && indices[expected_found] == i, "Failed: v2_find_within_radius at simd level %d", level);
+					expected_found += 1;
+				}
+			}
+			assert(found == expected_found, "Failed: v2_find_within_radius count at simd level %d", level);
+			assert(v2_find_within_radius_soa(p, radius, x, y, n, indices) == found, "Failed: v2_find_within_radius_soa at simd level %d", level);
+			
+			found = aabb_find_overlapping(box, boxes, n, indices);
+			expected_found = 0;
+			for (u64 i = 0; i < n; i++) {
+				Vector4 b = boxes[i];
+				if (b.left <= box.right && b.right >= box.left && b.bottom <= box.top && b.top >= box.bottom) {
+					assert(expected_found < found && indices[expected_found] == i, "Failed: aabb_find_overlapping at simd level %d", level);
+					expected_found += 1;
+				}
+			}
+			assert(found == expected_found, "Failed: aabb_find_overlapping count at simd level %d", level);
+			
+			if (n == count) break;
+		}
+		
+		// Edges: touching boxes overlap, exactly on the radius is inside
+		Vector4 touching[5] = { v4(40, 70, 41, 71), v4(-51, -61, -50, -60), v4(40.001, 0, 50, 1), v4(0, 0, 1, 1), v4(-100, -100, 100, 100) };
+		assert(aabb_find_overlapping(box, touching, 5, indices) == 4 && indices[2] == 3, "Failed: aabb_find_overlapping edges");
+		Vector2 on_radius[2] = { v2(p.x+radius, p.y), v2(p.x, p.y-radius-0.01f) };
+		assert(v2_find_within_radius(p, radius, on_radius, 2, indices) == 1 && indices[0] == 0, "Failed: v2_find_within_radius edges");
+		
+		// In place
+		memcpy(result, points, count*sizeof(Vector2));
+		m4_transform_points_v2(m, result, result, count);
+		Vector4 expected = m4_transform(m, v4(points[count-1].x, points[count-1].y, 0, 1));
+		assert(fabsf(result[count-1].x-expected.x) < 0.01f, "Failed: m4_transform_points_v2 in place");
+		
+		float64 start = os_get_current_time_in_seconds();
+		for (u64 i = 0; i < count; i++) {
+			Vector4 t = m4_transform(m, v4(points[i].x, points[i].y, 0, 1));
+			result[i] = t.xy;
+		}
+		float64 one_at_a_time = os_get_current_time_in_seconds()-start;
+		start = os_get_current_time_in_seconds();
+		m4_transform_points_v2(m, points, result, count);
+		float64 batch = os_get_current_time_in_seconds()-start;
+		start = os_get_current_time_in_seconds();
+		m4_transform_points_v2_soa(m, x, y, x, y, count);
+		float64 batch_soa = os_get_current_time_in_seconds()-start;
+		start = os_get_current_time_in_seconds();
+		aabb_find_overlapping(box, boxes, count, indices);
+		float64 cull = os_get_current_time_in_seconds()-start;
+		print("\nsimd level %d, %llu points: m4_transform %.3fms, m4_transform_points_v2 %.3fms (soa %.3fms), aabb_find_overlapping %.3fms",
+			level, count, one_at_a_time*1000.0, batch*1000.0, batch_soa*1000.0, cull*1000.0);
+		for (u64 i = 0; i < count; i++) {
+			x[i] = points[i].x;
+			y[i] = points[i].y;
+		}
+	}
+	print("\n");
+	simd_procs_init(cpu, SIMD_LEVEL_AVX512);
+	
+	dealloc(heap, points);
+	dealloc(heap, result);
+	dealloc(heap, boxes);
+	dealloc(heap, lengths);
+	dealloc(heap, indices);
+	dealloc(heap, x);
+	dealloc(heap, y);
+}
+
+bool affine2_test_matches_m4(Affine2 a, Matrix4 m) {
+	Affine2 from_m = affine2_from_m4(m);
+	for (u64 i = 0; i < 6; i++) {
+		if (fabsf(a.data[i]-from_m.data[i]) > 0.0001f*(1+fabsf(from_m.data[i]))) return false;
+	}
+	return true;
+}
+void test_affine2() {
+	Matrix4 m = m4_scalar(1.0);
+	m = m4_translate(m, v3(100, -50, 0));
+	m = m4_rotate_z(m, 1.1);
+	m = m4_scale(m, v3(2, 0.5, 1));
+	m = m4_translate(m, v3(-3, 7, 0));
+	
+	Affine2 a = affine2_scalar(1.0);
+	a = affine2_translate(a, v2(100, -50));
+	a = affine2_rotate(a, 1.1);
+	a = affine2_scale(a, v2(2, 0.5));
+	a = affine2_translate(a, v2(-3, 7));
+	
+	assert(m4_is_affine2(m), "Failed: m4_is_affine2");
+	assert(!m4_is_affine2(m4_rotate(m, v3(1, 0, 0), 0.5)), "Failed: m4_is_affine2 with rotation around x");
+	assert(!m4_is_affine2(m4_make_rotation(v3(0, 1, 0), 0.5)), "Failed: m4_is_affine2 with rotation around y");
+	assert(affine2_test_matches_m4(a, m), "Failed: Affine2 built like a Matrix4 doesn't match it");
+	assert(affine2_test_matches_m4(affine2_from_m4(m4_from_affine2(a)), m), "Failed: m4_from_affine2");
+	
+	Affine2 b = affine2_mul(affine2_make_rotation(-0.4), affine2_make_scale(v2(3, 3)));
+	Matrix4 mb = m4_mul(m4_make_rotation_z(-0.4), m4_make_scale(v3(3, 3, 1)));
+	assert(affine2_test_matches_m4(affine2_mul(a, b), m4_mul(m, mb)), "Failed: affine2_mul");
+	assert(affine2_test_matches_m4(affine2_inverse(a), m4_inverse(m)), "Failed: affine2_inverse");
+	
+	Affine2 identity = affine2_mul(a, affine2_inverse(a));
+	Affine2 expected_identity = affine2_scalar(1.0);
+	for (u64 i = 0; i < 6; i++) assert(fabsf(identity.data[i]-expected_identity.data[i]) < 0.0001f, "Failed: a*inverse(a) isn't identity");
+	
+	Affine2 singular = affine2_make_scale(v2(0, 1));
+	Affine2 singular_inverse = affine2_inverse(singular);
+	for (u64 i = 0; i < 6; i++) assert(singular_inverse.data[i] == 0, "Failed: inverse of singular Affine2 should be all zeros");
+	
+	for (u64 i = 0; i < 100; i++) {
+		Vector2 p = v2(get_random_float32_in_range(-100, 100), get_random_float32_in_range(-100, 100));
+		Vector2 expected = m4_transform(m, v4(p.x, p.y, 0, 1)).xy;
+		Vector2 got = affine2_transform(a, p);
+		assert(fabsf(got.x-expected.x) < 0.001f && fabsf(got.y-expected.y) < 0.001f, "Failed: affine2_transform");
+		Vector2 back = affine2_transform(affine2_inverse(a), got);
+		assert(fabsf(back.x-p.x) < 0.001f && fabsf(back.y-p.y) < 0.001f, "Failed: affine2_transform with inverse");
+		Vector2 d = affine2_transform_direction(a, p);
+		Vector2 expected_d = v2_sub(expected, affine2_transform(a, v2(0, 0)));
+		assert(fabsf(d.x-expected_d.x) < 0.001f && fabsf(d.y-expected_d.y) < 0.001f, "Failed: affine2_transform_direction");
+	}
+	
+	// What a quad costs to get into clip space, like draw_quad_xform does it
+	Matrix4 projection = m4_make_orthographic_projection(-640, 640, -360, 360, -1, 10);
+	Matrix4 view = m4_translate(m4_scalar(1.0), v3(30, -20, 0));
+	Vector2 corners[4] = { v2(0, 0), v2(0, 20), v2(40, 20), v2(40, 0) };
+	u64 quad_count = 100000;
+	volatile float32 sink = 0;
+	
+	float64 start = os_get_current_time_in_seconds();
+	for (u64 i = 0; i < quad_count; i++) {
+		Matrix4 xform = m4_translate(m4_scalar(1.0), v3((float32)i, 0, 0));
+		Matrix4 world_to_clip = m4_mul(m4_mul(m4_mul(m4_scalar(1.0), projection), m4_inverse(view)), xform);
+		for (u64 c = 0; c < 4; c++) sink += m4_transform(world_to_clip, v4(corners[c].x, corners[c].y, 0, 1)).x;
+	}
+	float64 m4_seconds = os_get_current_time_in_seconds()-start;
+	
+	start = os_get_current_time_in_seconds();
+	for (u64 i = 0; i < quad_count; i++) {
+		Affine2 xform = affine2_make_translation(v2((float32)i, 0));
+		Affine2 world_to_clip = affine2_mul(affine2_mul(affine2_from_m4(projection), affine2_inverse(affine2_from_m4(view))), xform);
+		for (u64 c = 0; c < 4; c++) sink += affine2_transform(world_to_clip, corners[c]).x;
+	}
+	float64 affine2_seconds = os_get_current_time_in_seconds()-start;
+	
+	print("\nquad transform, %llu quads: Matrix4 %.2fms, Affine2 %.2fms (%.1fx)\n", quad_count, m4_seconds*1000.0, affine2_seconds*1000.0, m4_seconds/affine2_seconds);
+}
+
 void test_intmath() {
     // Test vector creation and access
     Vector2i v2i_test = v2i(1, 2);
@@ -1227,6 +2977,833 @@ void test_mutex() {
     mutex_destroy(&data.mutex);
 }
 
+#define ATOMICS_TEST_NUM_THREADS 16
+#define ATOMICS_TEST_ITERATIONS 20000
+typedef struct Atomics_Test_Shared_Data {
+    volatile u64 counter;
+    volatile u32 bits;
+    volatile u32 lock;
+    u64 unprotected_counter;
+    alignat(16) volatile Atomic_128 pair;
+} Atomics_Test_Shared_Data;
+void atomics_test_worker(Thread *t) {
+    Atomics_Test_Shared_Data *data = (Atomics_Test_Shared_Data*)t->data;
+    u32 bit = 1u << (context.thread_id % 32);
+    
+    for (u64 i = 0; i < ATOMICS_TEST_ITERATIONS; i++) {
+        atomic_fetch_add_64(&data->counter, 2, MEMORY_ORDER_RELAXED);
+        atomic_fetch_sub_64(&data->counter, 1, MEMORY_ORDER_RELAXED);
+        
+        // Exchange-based lock protecting a plain counter
+        while (atomic_exchange_32(&data->lock, 1, MEMORY_ORDER_ACQUIRE)) {}
+        data->unprotected_counter += 1;
+        atomic_store_32(&data->lock, 0, MEMORY_ORDER_RELEASE);
+        
+        // Both halves must always move together
+        Atomic_128 old, new;
+        do {
+            old.low  = data->pair.low;
+            old.high = data->pair.high;
+            new.low  = old.low + 1;
+            new.high = old.high + 3;
+        } while (!compare_and_swap_128(&data->pair, new, old));
+    }
+    atomic_fetch_or_32(&data->bits, bit, MEMORY_ORDER_RELAXED);
+}
+void test_atomics() {
+    volatile u64 a64 = 10;
+    volatile u32 a32 = 10;
+    volatile u16 a16 = 10;
+    volatile u8  a8  = 10;
+    
+    assert(atomic_load_64(&a64, MEMORY_ORDER_ACQUIRE) == 10, "Failed: atomic_load_64");
+    atomic_store_64(&a64, 20, MEMORY_ORDER_RELEASE);
+    assert(atomic_load_64(&a64, MEMORY_ORDER_RELAXED) == 20, "Failed: atomic_store_64");
+    atomic_store_64(&a64, 30, MEMORY_ORDER_SEQ_CST);
+    assert(atomic_load_64(&a64, MEMORY_ORDER_SEQ_CST) == 30, "Failed: atomic_store_64 seq_cst");
+    assert(atomic_exchange_64(&a64, 5, MEMORY_ORDER_ACQ_REL) == 30 && a64 == 5, "Failed: atomic_exchange_64");
+    assert(atomic_fetch_add_64(&a64, 3, MEMORY_ORDER_RELAXED) == 5 && a64 == 8, "Failed: atomic_fetch_add_64");
+    assert(atomic_fetch_sub_64(&a64, 10, MEMORY_ORDER_RELAXED) == 8 && a64 == (u64)-2, "Failed: atomic_fetch_sub_64");
+    a64 = 0xF0F0;
+    assert(atomic_fetch_and_64(&a64, 0xFF00, MEMORY_ORDER_RELAXED) == 0xF0F0 && a64 == 0xF000, "Failed: atomic_fetch_and_64");
+    assert(atomic_fetch_or_64(&a64, 0x000F, MEMORY_ORDER_RELAXED) == 0xF000 && a64 == 0xF00F, "Failed: atomic_fetch_or_64");
+    assert(atomic_fetch_xor_64(&a64, 0xFFFF, MEMORY_ORDER_RELAXED) == 0xF00F && a64 == 0x0FF0, "Failed: atomic_fetch_xor_64");
+    
+    assert(atomic_fetch_add_32(&a32, 0xFFFFFFFF, MEMORY_ORDER_RELAXED) == 10 && a32 == 9, "Failed: atomic_fetch_add_32 wrap");
+    assert(atomic_exchange_32(&a32, 1, MEMORY_ORDER_SEQ_CST) == 9 && a32 == 1, "Failed: atomic_exchange_32");
+    assert(atomic_fetch_or_16(&a16, 0x100, MEMORY_ORDER_RELAXED) == 10 && a16 == 0x10A, "Failed: atomic_fetch_or_16");
+    assert(atomic_fetch_sub_8(&a8, 11, MEMORY_ORDER_RELAXED) == 10 && a8 == 0xFF, "Failed: atomic_fetch_sub_8");
+    atomic_fence(MEMORY_ORDER_SEQ_CST);
+    atomic_fence(MEMORY_ORDER_ACQ_REL);
+    
+    alignat(16) volatile Atomic_128 pair = {1, 2};
+    Atomic_128 wrong = {1, 3};
+    Atomic_128 right = {1, 2};
+    Atomic_128 new   = {5, 6};
+    assert(!compare_and_swap_128(&pair, new, wrong), "Failed: compare_and_swap_128 should fail on mismatched high half");
+    assert(pair.low == 1 && pair.high == 2, "Failed: compare_and_swap_128 modified on failure");
+    assert(compare_and_swap_128(&pair, new, right), "Failed: compare_and_swap_128");
+    assert(pair.low == 5 && pair.high == 6, "Failed: compare_and_swap_128");
+    
+    Allocator heap = get_heap_allocator();
+    
+    Atomics_Test_Shared_Data *data = alloc(heap, sizeof(Atomics_Test_Shared_Data));
+    memset(data, 0, sizeof(*data));
+    Thread *threads = alloc(heap, sizeof(Thread)*ATOMICS_TEST_NUM_THREADS);
+    for (u64 i = 0; i < ATOMICS_TEST_NUM_THREADS; i++) {
+        os_thread_init(&threads[i], atomics_test_worker);
+        threads[i].data = data;
+    }
+    for (u64 i = 0; i < ATOMICS_TEST_NUM_THREADS; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < ATOMICS_TEST_NUM_THREADS; i++) os_thread_join(&threads[i]);
+    
+    u64 expected = ATOMICS_TEST_NUM_THREADS*ATOMICS_TEST_ITERATIONS;
+    assert(data->counter == expected, "Failed: atomic_fetch_add_64/atomic_fetch_sub_64 lost updates (%llu != %llu)", data->counter, expected);
+    assert(data->unprotected_counter == expected, "Failed: atomic_exchange_32 lock let threads through");
+    assert(data->pair.low == expected && data->pair.high == expected*3, "Failed: compare_and_swap_128 tore or lost updates");
+    assert(data->bits != 0, "Failed: atomic_fetch_or_32");
+    
+    dealloc(heap, threads);
+    dealloc(heap, data);
+    
+    // Cost per op, uncontended
+    const u64 bench_count = 1000000;
+    volatile u64 target = 0;
+    
+    u64 start_cycles = rdtsc();
+    for (u64 i = 0; i < bench_count; i++) atomic_fetch_add_64(&target, 1, MEMORY_ORDER_RELAXED);
+    u64 fetch_add_cycles = rdtsc() - start_cycles;
+    
+    start_cycles = rdtsc();
+    for (u64 i = 0; i < bench_count; i++) {
+        u64 old;
+        do { old = target; } while (!compare_and_swap_64(&target, old+1, old));
+    }
+    u64 cas_loop_cycles = rdtsc() - start_cycles;
+    
+    start_cycles = rdtsc();
+    for (u64 i = 0; i < bench_count; i++) atomic_store_64(&target, atomic_load_64(&target, MEMORY_ORDER_ACQUIRE)+1, MEMORY_ORDER_RELEASE);
+    u64 acq_rel_cycles = rdtsc() - start_cycles;
+    
+    assert(target == bench_count*3, "Failed: atomics benchmark miscounted");
+    
+    print("fetch_add: %.2f cycles, cas loop: %.2f cycles, acquire load + release store: %.2f cycles\n", (f64)fetch_add_cycles/(f64)bench_count, (f64)cas_loop_cycles/(f64)bench_count, (f64)acq_rel_cycles/(f64)bench_count);
+}
+
+#define RW_LOCK_TEST_NUM_THREADS 16
+#define RW_LOCK_TEST_ITERATIONS 20000
+#define RW_LOCK_TEST_READS_PER_WRITE 100
+typedef struct Seqlock_Test_Pod {
+    u64 x, y, z, w;
+} Seqlock_Test_Pod;
+typedef struct Rw_Lock_Test_Shared_Data {
+    Rw_Lock rw_lock;
+    Mutex mutex;
+    bool use_mutex;
+    u64 a;
+    u64 b;
+    volatile u32 active_writers;
+    volatile u32 active_readers;
+    u64 writes;
+    Seqlock seqlock;
+    Seqlock_Test_Pod pod;
+} Rw_Lock_Test_Shared_Data;
+void rw_lock_test_worker(Thread *t) {
+    Rw_Lock_Test_Shared_Data *data = (Rw_Lock_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < RW_LOCK_TEST_ITERATIONS; i++) {
+        bool write = (i % RW_LOCK_TEST_READS_PER_WRITE) == 0;
+        
+        if (data->use_mutex) {
+            mutex_acquire_or_wait(&data->mutex);
+            if (write) { data->a += 1; data->b += 1; data->writes += 1; }
+            else assert(data->a == data->b, "Failed: Mutex let a write through during read");
+            mutex_release(&data->mutex);
+            continue;
+        }
+        
+        if (write) {
+            rw_lock_write_acquire(&data->rw_lock);
+            assert(atomic_fetch_add_32(&data->active_writers, 1, MEMORY_ORDER_RELAXED) == 0, "Failed: Rw_Lock let two writers in");
+            assert(atomic_load_32(&data->active_readers, MEMORY_ORDER_RELAXED) == 0, "Failed: Rw_Lock let a writer in with readers");
+            data->a += 1;
+            data->b += 1;
+            data->writes += 1;
+            atomic_fetch_sub_32(&data->active_writers, 1, MEMORY_ORDER_RELAXED);
+            rw_lock_write_release(&data->rw_lock);
+        } else {
+            rw_lock_read_acquire(&data->rw_lock);
+            atomic_fetch_add_32(&data->active_readers, 1, MEMORY_ORDER_RELAXED);
+            assert(atomic_load_32(&data->active_writers, MEMORY_ORDER_RELAXED) == 0, "Failed: Rw_Lock let a reader in with a writer");
+            assert(data->a == data->b, "Failed: Rw_Lock let a write through during read");
+            atomic_fetch_sub_32(&data->active_readers, 1, MEMORY_ORDER_RELAXED);
+            rw_lock_read_release(&data->rw_lock);
+        }
+    }
+}
+void seqlock_test_worker(Thread *t) {
+    Rw_Lock_Test_Shared_Data *data = (Rw_Lock_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < RW_LOCK_TEST_ITERATIONS; i++) {
+        if ((i % RW_LOCK_TEST_READS_PER_WRITE) == 0) {
+            seqlock_write_begin(&data->seqlock);
+            u64 v = data->pod.x + 1;
+            data->pod.x = v;
+            data->pod.y = v*2;
+            data->pod.z = v*3;
+            data->pod.w = v*4;
+            seqlock_write_end(&data->seqlock);
+        } else {
+            Seqlock_Test_Pod pod;
+            seqlock_read(&data->seqlock, &pod, &data->pod, sizeof(pod));
+            assert(pod.y == pod.x*2 && pod.z == pod.x*3 && pod.w == pod.x*4, "Failed: seqlock_read returned a torn value");
+        }
+    }
+}
+f64 run_rw_lock_test(Rw_Lock_Test_Shared_Data *data, Thread_Proc proc) {
+    Allocator heap = get_heap_allocator();
+    Thread *threads = alloc(heap, sizeof(Thread)*RW_LOCK_TEST_NUM_THREADS);
+    for (u64 i = 0; i < RW_LOCK_TEST_NUM_THREADS; i++) {
+        os_thread_init(&threads[i], proc);
+        threads[i].data = data;
+    }
+    f64 start = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < RW_LOCK_TEST_NUM_THREADS; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < RW_LOCK_TEST_NUM_THREADS; i++) os_thread_join(&threads[i]);
+    f64 end = os_get_current_time_in_seconds();
+    dealloc(heap, threads);
+    return end-start;
+}
+void test_rw_lock() {
+    Rw_Lock_Test_Shared_Data *data = alloc(get_heap_allocator(), sizeof(Rw_Lock_Test_Shared_Data));
+    memset(data, 0, sizeof(*data));
+    rw_lock_init(&data->rw_lock);
+    mutex_init(&data->mutex);
+    seqlock_init(&data->seqlock);
+    
+    // Single-threaded sanity
+    rw_lock_read_acquire(&data->rw_lock);
+    rw_lock_read_acquire(&data->rw_lock);
+    assert(data->rw_lock.state == 2, "Failed: Rw_Lock should allow multiple readers");
+    rw_lock_read_release(&data->rw_lock);
+    rw_lock_read_release(&data->rw_lock);
+    rw_lock_write_acquire(&data->rw_lock);
+    assert(data->rw_lock.state == RW_LOCK_WRITER, "Failed: Rw_Lock write acquire");
+    rw_lock_write_release(&data->rw_lock);
+    assert(data->rw_lock.state == 0 && data->rw_lock.waiting_writers == 0, "Failed: Rw_Lock write release");
+    
+    u32 start = seqlock_read_begin(&data->seqlock);
+    assert(!seqlock_read_retry(&data->seqlock, start), "Failed: seqlock_read_retry without a write");
+    Seqlock_Test_Pod pod = {1, 2, 3, 4};
+    seqlock_write(&data->seqlock, &data->pod, &pod, sizeof(pod));
+    assert(seqlock_read_retry(&data->seqlock, start), "Failed: seqlock_read_retry after a write");
+    assert(data->seqlock.sequence == 2, "Failed: seqlock_write");
+    
+    u64 expected_writes = RW_LOCK_TEST_NUM_THREADS*(RW_LOCK_TEST_ITERATIONS/RW_LOCK_TEST_READS_PER_WRITE);
+    
+    f64 rw_lock_seconds = run_rw_lock_test(data, rw_lock_test_worker);
+    assert(data->writes == expected_writes && data->a == data->b, "Failed: Rw_Lock lost writes");
+    assert(data->rw_lock.state == 0 && data->rw_lock.waiting_writers == 0, "Failed: Rw_Lock not released");
+    
+    data->use_mutex = true;
+    data->writes = 0;
+    f64 mutex_seconds = run_rw_lock_test(data, rw_lock_test_worker);
+    assert(data->writes == expected_writes, "Failed: Mutex lost writes");
+    
+    f64 seqlock_seconds = run_rw_lock_test(data, seqlock_test_worker);
+    
+    print("%d threads, %d reads per write: Rw_Lock %.2f ms, Mutex %.2f ms, Seqlock %.2f ms\n", RW_LOCK_TEST_NUM_THREADS, RW_LOCK_TEST_READS_PER_WRITE, rw_lock_seconds*1000.0, mutex_seconds*1000.0, seqlock_seconds*1000.0);
+    
+    mutex_destroy(&data->mutex);
+    dealloc(get_heap_allocator(), data);
+}
+
+void test_profiler_thread_proc(Thread *t) {
+    _tm_scope_impl("Test thread scope") {}
+}
+u64 test_profiler_count_thread_buffers() {
+    u64 count = 0;
+    for (Profiler_Thread_Buffer *b = _profiler_thread_buffers; b; b = b->next) count += 1;
+    return count;
+}
+void test_profiler() {
+    // Record into a private buffer so nothing here ends up in the real trace
+    Profiler_Thread_Buffer *real_buffer = _profiler_thread_buffer;
+    Profiler_Thread_Buffer *b = alloc(get_heap_allocator(), sizeof(Profiler_Thread_Buffer));
+    _profiler_thread_buffer_init(b);
+    _profiler_thread_buffer = b;
+    
+    const u64 count = PROFILER_THREAD_BUFFER_CAPACITY;
+    const u64 num_samples = 10;
+    
+    u64 best_baseline_cycles = UINT64_MAX;
+    u64 best_scope_cycles = UINT64_MAX;
+    volatile u64 sink = 0;
+    for (u64 sample = 0; sample < num_samples; sample++) {
+        // Same loop with the two timestamps but without recording, so we can subtract rdtsc cost
+        u64 start = rdtsc();
+        for (u64 i = 0; i < count; i++) {
+            u64 t0 = rdtsc();
+            u64 t1 = rdtsc();
+            sink += t1-t0;
+        }
+        best_baseline_cycles = min(best_baseline_cycles, rdtsc()-start);
+        
+        atomic_store_64(&b->read_index, b->write_index, MEMORY_ORDER_RELEASE);
+        start = rdtsc();
+        for (u64 i = 0; i < count; i++) _tm_scope_impl("Test scope") {
+            sink += 1;
+        }
+        best_scope_cycles = min(best_scope_cycles, rdtsc()-start);
+    }
+    
+    assert(b->write_index == count*num_samples, "Failed: profiler lost records");
+    assert(b->dropped_count == 0, "Failed: profiler dropped records with room in buffer");
+    for (u64 i = 0; i < count; i++) {
+        Profile_Scope_Record *r = &b->records[i];
+        assert(r->end > r->start, "Failed: profiler record has bad timestamps");
+        assert(strcmp(r->name, "Test scope") == 0, "Failed: profiler record has wrong name");
+        if (i > 0) assert(r->start >= b->records[i-1].end, "Failed: profiler records out of order");
+    }
+    
+    // Full buffer drops instead of blocking
+    _tm_scope_impl("Test scope") {}
+    assert(b->dropped_count == 1, "Failed: profiler should drop records when buffer is full");
+    
+    f64 cycles_per_scope = (f64)best_scope_cycles/(f64)count;
+    f64 overhead_per_scope = ((f64)best_scope_cycles - (f64)best_baseline_cycles)/(f64)count;
+    print("tm_scope: %.2f cycles per scope, %.2f cycles of profiler overhead on top of the two rdtsc's\n", cycles_per_scope, overhead_per_scope);
+#if RUN_BENCHMARK_ASSERTS
+    assert(overhead_per_scope < 30, "Failed: profiler overhead per scope is %.2f cycles, should be < 30", overhead_per_scope);
+#endif
+    
+    _profiler_thread_buffer = real_buffer;
+    dealloc(get_heap_allocator(), b->records);
+    dealloc(get_heap_allocator(), b);
+    
+    // Scope stats. Separate buffers so name grouping can't rely on pointer equality.
+    char name_a[] = "Scope A";
+    char name_a_copy[] = "Scope A";
+    char name_b[] = "Scope B";
+    const u64 record_count = 300;
+    Profile_Record *records = alloc(get_heap_allocator(), sizeof(Profile_Record)*record_count);
+    for (u64 i = 0; i < 200; i++) {
+        // Durations 1..200, shuffled
+        u64 d = ((i*77) % 200) + 1;
+        records[i] = (Profile_Record){ (i & 1) ? name_a : name_a_copy, 1000+i, 1000+i+d, 0 };
+    }
+    for (u64 i = 200; i < record_count; i++) {
+        records[i] = (Profile_Record){ name_b, 5000, 5010, 1 };
+    }
+    u64 stats_count;
+    Profile_Scope_Stats *stats = profile_compute_scope_stats(records, record_count, &stats_count, get_heap_allocator());
+    assert(stats_count == 2, "Failed: expected 2 scope stats, got %llu", stats_count);
+    assert(strcmp(stats[0].name, "Scope A") == 0 && strcmp(stats[1].name, "Scope B") == 0, "Failed: scope stats names");
+    assert(stats[0].count == 200, "Failed: scope stats count");
+    assert(stats[0].min_cycles == 1 && stats[0].max_cycles == 200, "Failed: scope stats min/max");
+    assert(stats[0].p99_cycles == 198, "Failed: scope stats p99 %llu", stats[0].p99_cycles);
+    assert(stats[0].total_cycles == 200*201/2, "Failed: scope stats total");
+    assert(stats[0].mean_cycles == 100.5, "Failed: scope stats mean");
+    assert(stats[1].count == 100 && stats[1].min_cycles == 10 && stats[1].p99_cycles == 10 && stats[1].max_cycles == 10, "Failed: scope stats for constant durations");
+    dealloc(get_heap_allocator(), stats);
+    dealloc(get_heap_allocator(), records);
+    
+    // TSC calibration (started in oogabooga_init, finished on first use) should agree with the os clock
+    u64 tsc_frequency = os_get_tsc_frequency();
+    assert(tsc_frequency > 0 && os.tsc_frequency == tsc_frequency, "Failed: TSC frequency was not calibrated");
+    f64 t0 = os_get_current_time_in_seconds();
+    u64 c0 = rdtsc();
+    while (os_get_current_time_in_seconds()-t0 < 0.02) {}
+    u64 c1 = rdtsc();
+    f64 t1 = os_get_current_time_in_seconds();
+    f64 measured_seconds = (f64)(c1-c0)/(f64)tsc_frequency;
+    assert(measured_seconds > (t1-t0)*0.8 && measured_seconds < (t1-t0)*1.2, "Failed: TSC calibration is off, rdtsc says %.4fs, os clock says %.4fs", measured_seconds, t1-t0);
+    
+    // Starting a calibration doesn't wait, the first os_get_tsc_frequency() after it does
+    os_start_tsc_calibration();
+    assert(os.tsc_frequency == 0, "Failed: os_start_tsc_calibration calibrated right away");
+    u64 recalibrated_frequency = os_get_tsc_frequency();
+    assert(os_get_current_time_in_seconds()-os.tsc_calibration_start_seconds >= OS_TSC_CALIBRATION_SECONDS, "Failed: lazy TSC calibration did not wait for OS_TSC_CALIBRATION_SECONDS");
+    assert(recalibrated_frequency > tsc_frequency*0.8 && recalibrated_frequency < tsc_frequency*1.2, "Failed: lazy TSC calibration gave %llu, before it was %llu", recalibrated_frequency, tsc_frequency);
+    
+    // Recent records by time window, like the overlay uses them
+    profiler_enable_recent_records();
+    u64 window_start = rdtsc();
+    for (u64 i = 0; i < 10; i++) _tm_scope_impl("Recent scope") {
+        _tm_scope_impl("Recent inner scope") {}
+    }
+    u64 window_end = rdtsc();
+    Profile_Record recent[64];
+    u64 recent_count = profiler_copy_recent_records(window_start, window_end, recent, 64);
+    u64 outer_count = 0, inner_count = 0;
+    for (u64 i = 0; i < recent_count; i++) {
+        assert(recent[i].end >= window_start && recent[i].start <= window_end, "Failed: recent record outside of window");
+        if (strcmp(recent[i].name, "Recent scope") == 0) outer_count += 1;
+        if (strcmp(recent[i].name, "Recent inner scope") == 0) inner_count += 1;
+    }
+    assert(outer_count == 10 && inner_count == 10, "Failed: expected 10+10 recent records, got %llu+%llu", outer_count, inner_count);
+    assert(profiler_copy_recent_records(window_end+1, window_end+2, recent, 64) == 0, "Failed: recent records outside of window were copied");
+    
+    // When more records overlap the window than fit, the newest ones are copied, oldest first
+    window_start = rdtsc();
+    u64 newest_start = 0;
+    for (u64 i = 0; i < 10; i++) {
+        if (i == 6) newest_start = rdtsc();
+        _tm_scope_impl("Newest scope") {}
+    }
+    window_end = rdtsc();
+    recent_count = profiler_copy_recent_records(window_start, window_end, recent, 4);
+    assert(recent_count == 4, "Failed: expected 4 recent records, got %llu", recent_count);
+    for (u64 i = 0; i < recent_count; i++) {
+        assert(recent[i].start >= newest_start, "Failed: profiler_copy_recent_records copied old records instead of the newest");
+        assert(i == 0 || recent[i].start >= recent[i-1].start, "Failed: recent records are not oldest first");
+    }
+    
+    // Drained records stop at profiler_max_records, the rest only reach the recent records ring
+    _profiler_drain_thread_buffers();
+    u64 saved_max_records = profiler_max_records;
+    u64 saved_dropped_count = _profile_dropped_record_count;
+    profiler_max_records = _profile_record_count+4;
+    window_start = rdtsc();
+    for (u64 i = 0; i < 10; i++) _tm_scope_impl("Capped scope") {}
+    window_end = rdtsc();
+    recent_count = profiler_copy_recent_records(window_start, window_end, recent, 64);
+    assert(_profile_record_count == profiler_max_records, "Failed: profiler kept %llu records past profiler_max_records", _profile_record_count-profiler_max_records);
+    assert(_profile_dropped_record_count-saved_dropped_count == 6, "Failed: expected 6 dropped records, got %llu", _profile_dropped_record_count-saved_dropped_count);
+    assert(recent_count == 10, "Failed: records past profiler_max_records should still be recent records, got %llu", recent_count);
+    profiler_max_records = saved_max_records;
+    _profile_dropped_record_count = saved_dropped_count;
+    
+    // Buffers of threads that exited are reused once they are drained
+    u64 buffer_count_before = test_profiler_count_thread_buffers();
+    for (u64 i = 0; i < 4; i++) {
+        Thread scope_thread;
+        os_thread_init(&scope_thread, test_profiler_thread_proc);
+        os_thread_start(&scope_thread);
+        os_thread_join(&scope_thread);
+        os_thread_destroy(&scope_thread);
+        _profiler_drain_thread_buffers();
+    }
+    u64 buffer_count_after = test_profiler_count_thread_buffers();
+    assert(buffer_count_after <= buffer_count_before+1, "Failed: exited threads' profiler buffers were not reused (%llu -> %llu buffers)", buffer_count_before, buffer_count_after);
+    
+    // Allocation report attributes allocations to the innermost open scope on the same thread, per frame
+    Profile_Record report_records[] = {
+        {"Scope A", 100, 200, 1},
+        {"Scope B", 120, 150, 1},
+    };
+    #define ALLOC_EVENT(tsc, size, thread) {{tsc, 0, 0, (size) | ((u64)PROFILE_EVENT_HEAP_ALLOC << PROFILE_EVENT_KIND_SHIFT)}, thread}
+    Profile_Event_Record report_events[] = {
+        ALLOC_EVENT(300, 5, 1),
+        ALLOC_EVENT(130, 10, 1),
+        ALLOC_EVENT(170, 20, 1),
+        ALLOC_EVENT(130, 7, 2),
+        {{160, 0, 0, (u64)PROFILE_EVENT_FRAME << PROFILE_EVENT_KIND_SHIFT}, 1},
+    };
+    #undef ALLOC_EVENT
+    String_Builder report;
+    string_builder_init(&report, get_heap_allocator());
+    bool wrote_report = profile_write_allocation_report(report_records, 2, report_events, 5, &report);
+    assert(wrote_report, "Failed: allocation report was not written");
+    assert(string_find_from_left(report.result, STR("Heap allocations: 4, 42 bytes, over 2 frames")) != -1, "Failed: allocation report totals\n%s", report.result);
+    assert(string_find_from_left(report.result, STR("Frame 0: 17 bytes in 2 allocations\n                10 bytes          1 allocations  Scope B\n                 7 bytes          1 allocations  (no scope)")) != -1, "Failed: allocation report frame 0\n%s", report.result);
+    assert(string_find_from_left(report.result, STR("Frame 1: 25 bytes in 2 allocations\n                20 bytes          1 allocations  Scope A\n                 5 bytes          1 allocations  (no scope)")) != -1, "Failed: allocation report frame 1\n%s", report.result);
+    dealloc(get_heap_allocator(), report.buffer);
+}
+
+#define METRICS_TEST_NUM_THREADS 4
+#define METRICS_TEST_ADDS_PER_THREAD 100000
+void metrics_test_worker(Thread *t) {
+    Metric_Id id = *(Metric_Id*)t->data;
+    for (u64 i = 0; i < METRICS_TEST_ADDS_PER_THREAD; i++) metric_add(id, 1);
+}
+u64 metrics_test_count_char(string s, u8 c) {
+    u64 n = 0;
+    for (u64 i = 0; i < s.count; i++) if (s.data[i] == c) n += 1;
+    return n;
+}
+void test_metrics() {
+    Allocator heap = get_heap_allocator();
+    
+    Metric_Id counter   = metric_register("test.counter", METRIC_KIND_COUNTER);
+    Metric_Id gauge     = metric_register("test.gauge", METRIC_KIND_GAUGE);
+    Metric_Id histogram = metric_register("test.histogram", METRIC_KIND_HISTOGRAM);
+    assert(metric_register("test.counter", METRIC_KIND_COUNTER) == counter, "Failed: registering the same name twice should give the same id");
+    assert(counter >= METRIC_BUILTIN_COUNT, "Failed: registered metric collides with builtin metrics");
+    
+    Metrics_Snapshot *snapshot = alloc(heap, sizeof(Metrics_Snapshot));
+    memset(snapshot, 0, sizeof(Metrics_Snapshot));
+    metrics_take_snapshot(snapshot);
+    
+    // Per-thread counters sum up
+    Thread *threads = alloc(heap, sizeof(Thread)*METRICS_TEST_NUM_THREADS);
+    for (u64 i = 0; i < METRICS_TEST_NUM_THREADS; i++) {
+        os_thread_init(&threads[i], metrics_test_worker);
+        threads[i].data = &counter;
+        os_thread_start(&threads[i]);
+    }
+    for (u64 i = 0; i < METRICS_TEST_NUM_THREADS; i++) os_thread_join(&threads[i]);
+    for (u64 i = 0; i < METRICS_TEST_NUM_THREADS; i++) os_thread_destroy(&threads[i]);
+    dealloc(heap, threads);
+    metric_add(counter, 5);
+    
+    metric_set(gauge, 123.5);
+    
+    for (u64 i = 1; i <= 1000; i++) metric_record(histogram, i);
+    
+    u64 heap_allocations_before = snapshot->metrics[METRIC_HEAP_ALLOCATIONS].total;
+    void *p = alloc(heap, 64);
+    dealloc(heap, p);
+    
+    metrics_take_snapshot(snapshot);
+    
+    Metric_Value *c = &snapshot->metrics[counter];
+    assert(c->total == METRICS_TEST_NUM_THREADS*METRICS_TEST_ADDS_PER_THREAD+5, "Failed: counter total %lld", c->total);
+    assert(c->frame == c->total, "Failed: counter frame value %lld", c->frame);
+    assert(snapshot->metrics[gauge].value == 123.5, "Failed: gauge value");
+    assert(snapshot->metrics[METRIC_HEAP_ALLOCATIONS].total > (s64)heap_allocations_before, "Failed: heap allocations are not counted");
+    
+    Metric_Value *h = &snapshot->metrics[histogram];
+    assert(h->count == 1000 && h->min == 1 && h->max == 1000, "Failed: histogram count/min/max %llu %llu %llu", h->count, h->min, h->max);
+    assert(h->mean == 500.5, "Failed: histogram mean %f", h->mean);
+    assert(h->p50 >= 485 && h->p50 <= 515, "Failed: histogram p50 %llu", h->p50);
+    assert(h->p90 >= 873 && h->p90 <= 927, "Failed: histogram p90 %llu", h->p90);
+    assert(h->p99 >= 960 && h->p99 <= 1000, "Failed: histogram p99 %llu", h->p99);
+    
+    // Buckets stay within ~3% of the value over the whole range
+    for (u64 shift = 0; shift < 63; shift++) {
+        u64 v = (1ull << shift) + (get_random() & ((1ull << shift)-1));
+        u64 bucket_value = _metrics_histogram_bucket_value(_metrics_histogram_bucket(v));
+        f64 error = ((f64)bucket_value-(f64)v)/(f64)v;
+        assert(error < 0.032 && error > -0.032, "Failed: histogram bucket for %llu is off by %f", v, error);
+    }
+    
+    // Frame values reset, totals don't
+    metrics_take_snapshot(snapshot);
+    assert(snapshot->metrics[counter].frame == 0 && snapshot->metrics[counter].total == c->total, "Failed: counter did not reset per frame");
+    assert(snapshot->metrics[histogram].count == 0, "Failed: histogram did not reset per frame");
+    
+    String_Builder builder;
+    string_builder_init(&builder, heap);
+    metrics_snapshot_append_json(snapshot, &builder);
+    assert(builder.result.data[0] == '{' && builder.result.data[builder.result.count-1] == '}', "Failed: metrics json");
+    assert(string_find_from_left(builder.result, STR("\"test.histogram\":{\"kind\":\"histogram\"")) != -1, "Failed: metrics json is missing histogram");
+    assert(metrics_test_count_char(builder.result, '{') == metrics_test_count_char(builder.result, '}'), "Failed: metrics json braces");
+    dealloc(heap, builder.buffer);
+    
+    string_builder_init(&builder, heap);
+    metrics_snapshot_append_csv_header(snapshot, &builder);
+    string header = builder.result;
+    string_builder_init(&builder, heap);
+    metrics_snapshot_append_csv_row(snapshot, &builder);
+    assert(metrics_test_count_char(header, ',') == metrics_test_count_char(builder.result, ','), "Failed: metrics csv row and header have different column counts");
+    dealloc(heap, header.data);
+    dealloc(heap, builder.buffer);
+    
+    dealloc(heap, snapshot);
+}
+
+#define QUEUE_TEST_NUM_PAIRS 8
+#define QUEUE_TEST_NUM_PRODUCERS 8
+#define QUEUE_TEST_NUM_CONSUMERS 8
+#define QUEUE_TEST_ITEMS_PER_PRODUCER 20000
+typedef struct Queue_Test_Item {
+    u64 producer;
+    u64 sequence;
+    u64 check;
+} Queue_Test_Item;
+typedef struct Queue_Test_Shared_Data {
+    Spsc_Ring *ring;
+    Mpmc_Queue *queue;
+    u64 producer;
+    u64 item_count;
+    volatile u64 *consumed_count;
+    u64 total_count;
+    u64 sum;
+} Queue_Test_Shared_Data;
+volatile bool sampling_test_spinning = false;
+void sampling_test_spin(Thread *t) {
+    volatile u64 x = 0;
+    while (sampling_test_spinning) x += 1;
+}
+void test_frame_pacer() {
+    const u64 frames = 40;
+    const f64 fps = 200.0;
+
+    Frame_Pacer pacer;
+    frame_pacer_init(&pacer, fps);
+    assert(fabs(pacer.target_seconds - 1.0/fps) < 0.000001, "Failed: frame_pacer_init target");
+
+    f64 start = os_get_current_time_in_seconds();
+    f64 delta_sum = 0;
+    for (u64 i = 0; i < frames; i++) {
+        delta_sum += frame_pacer_wait(&pacer);
+    }
+    f64 elapsed = os_get_current_time_in_seconds()-start;
+
+    // The pacer never starts a frame early
+    assert(elapsed >= (frames-1)/fps, "Failed: frame pacer ran %llu frames in %.2fms", frames, elapsed*1000.0);
+    assert(delta_sum >= (frames-1)/fps, "Failed: frame pacer delta_t's sum up to less than a frame interval each");
+
+    // A long frame restarts the schedule instead of rushing through frames
+    os_sleep(30);
+    f64 hitch_delta = frame_pacer_wait(&pacer);
+    assert(hitch_delta >= 0.03, "Failed: frame pacer delta_t after a hitch is %.2fms", hitch_delta*1000.0);
+    f64 after_hitch = os_get_current_time_in_seconds();
+    frame_pacer_wait(&pacer);
+    assert(os_get_current_time_in_seconds()-after_hitch >= 1.0/fps*0.9, "Failed: frame pacer tried to catch up after a hitch");
+
+    Frame_Pacer_Stats stats;
+    frame_pacer_take_stats(&pacer, &stats);
+    assert(stats.frame_count == frames+2, "Failed: frame pacer counted %llu frames", stats.frame_count);
+    assert(stats.missed_frame_count >= 1, "Failed: frame pacer didn't count the hitch as missed");
+    assert(stats.lateness_us.count == frames+2 && stats.jitter_us.count == frames+2, "Failed: frame pacer histograms");
+    assert(stats.lateness_us.max >= 20000, "Failed: frame pacer lateness should include the hitch");
+    assert(stats.seconds_slept+stats.seconds_spun > 0, "Failed: frame pacer never waited");
+    print("lateness p50 %lluus, p90 %lluus, %.0f%% of the wait spinning... ", stats.lateness_us.p50, stats.lateness_us.p90, stats.seconds_spun/(stats.seconds_slept+stats.seconds_spun)*100.0);
+
+    frame_pacer_take_stats(&pacer, &stats);
+    assert(stats.frame_count == 0 && stats.lateness_us.count == 0, "Failed: frame_pacer_take_stats should reset");
+
+    frame_pacer_set_rate(&pacer, 0);
+    assert(pacer.target_seconds > 0, "Failed: frame_pacer_set_rate with refresh rate");
+
+    frame_pacer_deinit(&pacer);
+}
+void test_sampling_profiler() {
+    Allocator heap = get_heap_allocator();
+
+    sampling_test_spinning = true;
+    Thread spinner;
+    os_thread_init(&spinner, sampling_test_spin);
+    os_thread_start(&spinner);
+
+    sampling_profiler_start(1000);
+    os_sleep(50);
+    sampling_profiler_stop();
+
+    sampling_test_spinning = false;
+    os_thread_destroy(&spinner);
+
+    u64 sample_count = sampling_profiler_get_sample_count();
+    assert(sample_count > 0, "Failed: sampling profiler took no samples");
+
+    String_Builder folded;
+    String_Builder trace;
+    string_builder_init(&folded, heap);
+    string_builder_init(&trace, heap);
+    assert(sampling_profiler_write_results(&folded, &trace), "Failed: sampling_profiler_write_results");
+
+    // Every line is "thread <id>;frames... <count>" and the counts add up to all samples
+    u64 counted = 0;
+    string rest = folded.result;
+    while (rest.count > 0) {
+        s64 line_end = string_find_from_left(rest, STR("\n"));
+        assert(line_end > 0, "Failed: folded stacks don't end in a newline");
+        string line = string_view(rest, 0, line_end);
+        assert(string_starts_with(line, STR("thread ")), "Failed: folded stack does not start with a thread: %s", line);
+        s64 last_space = line_end-1;
+        while (last_space >= 0 && line.data[last_space] != ' ') last_space -= 1;
+        assert(last_space > 0, "Failed: folded stack has no count");
+        u64 count = 0;
+        for (s64 i = last_space+1; i < line_end; i++) count = count*10 + (line.data[i]-'0');
+        assert(count > 0, "Failed: folded stack count is 0");
+        counted += count;
+        rest.data  += line_end+1;
+        rest.count -= line_end+1;
+    }
+    assert(counted == sample_count, "Failed: folded stack counts add up to %llu, expected %llu", counted, sample_count);
+
+    assert(string_starts_with(trace.result, STR("{\"traceEvents\":[")), "Failed: bad sampling trace start");
+    assert(string_find_from_left(trace.result, STR("\"stackFrames\":{")) > 0, "Failed: sampling trace has no stack frames");
+    assert(string_find_from_left(trace.result, STR("\"samples\":[")) > 0, "Failed: sampling trace has no samples");
+
+    dealloc(heap, folded.buffer);
+    dealloc(heap, trace.buffer);
+
+    // So it's not dumped at exit
+    sampling_profiler_reset();
+    assert(sampling_profiler_get_sample_count() == 0, "Failed: sampling_profiler_reset");
+}
+void spsc_test_producer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < data->item_count; i++) {
+        while (!spsc_ring_push(data->ring, &i)) os_yield_thread();
+    }
+}
+void spsc_test_consumer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < data->item_count; i++) {
+        u64 item;
+        while (!spsc_ring_pop(data->ring, &item)) os_yield_thread();
+        assert(item == i, "Failed: Spsc_Ring items out of order, expected %llu got %llu", i, item);
+    }
+}
+void mpmc_test_producer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < data->item_count; i++) {
+        Queue_Test_Item item = {data->producer, i, data->producer ^ i ^ 0xB00B5};
+        while (!mpmc_queue_push(data->queue, &item)) os_yield_thread();
+    }
+}
+void mpmc_test_consumer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    s64 last_sequence[QUEUE_TEST_NUM_PRODUCERS];
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS; i++) last_sequence[i] = -1;
+    
+    while (true) {
+        if (atomic_load_64(data->consumed_count, MEMORY_ORDER_RELAXED) >= data->total_count) break;
+        
+        Queue_Test_Item item;
+        if (!mpmc_queue_pop(data->queue, &item)) {
+            os_yield_thread();
+            continue;
+        }
+        assert(item.producer < QUEUE_TEST_NUM_PRODUCERS, "Failed: Mpmc_Queue gave garbage item");
+        assert(item.check == (item.producer ^ item.sequence ^ 0xB00B5), "Failed: Mpmc_Queue item was torn");
+        // Queue is FIFO so each consumer must see any single producer's items in order
+        assert((s64)item.sequence > last_sequence[item.producer], "Failed: Mpmc_Queue items out of order");
+        last_sequence[item.producer] = (s64)item.sequence;
+        data->sum += item.sequence;
+        
+        atomic_fetch_add_64(data->consumed_count, 1, MEMORY_ORDER_RELAXED);
+    }
+}
+void test_queues() {
+    Allocator heap = get_heap_allocator();
+    
+    // Single-threaded sanity
+    Spsc_Ring ring;
+    spsc_ring_init(&ring, sizeof(u32), 5, heap);
+    assert(ring.capacity == 8, "Failed: Spsc_Ring capacity should round to power of two");
+    u32 x;
+    assert(!spsc_ring_pop(&ring, &x), "Failed: Spsc_Ring pop on empty ring should fail");
+    for (u32 i = 0; i < 8; i++) assert(spsc_ring_push(&ring, &i), "Failed: Spsc_Ring push");
+    x = 1337;
+    assert(!spsc_ring_push(&ring, &x), "Failed: Spsc_Ring push on full ring should fail");
+    assert(spsc_ring_get_count(&ring) == 8, "Failed: spsc_ring_get_count");
+    for (u32 i = 0; i < 8; i++) {
+        assert(spsc_ring_pop(&ring, &x) && x == i, "Failed: Spsc_Ring pop");
+    }
+    assert(!spsc_ring_pop(&ring, &x), "Failed: Spsc_Ring pop on empty ring should fail");
+    // Wrap around a few laps
+    for (u32 i = 0; i < 100; i++) {
+        assert(spsc_ring_push(&ring, &i), "Failed: Spsc_Ring push");
+        assert(spsc_ring_pop(&ring, &x) && x == i, "Failed: Spsc_Ring pop");
+    }
+    spsc_ring_destroy(&ring);
+    
+    Mpmc_Queue queue;
+    mpmc_queue_init(&queue, sizeof(Queue_Test_Item), 3, heap);
+    assert(queue.capacity == 4, "Failed: Mpmc_Queue capacity should round to power of two");
+    Queue_Test_Item item = {0};
+    assert(!mpmc_queue_pop(&queue, &item), "Failed: Mpmc_Queue pop on empty queue should fail");
+    for (u64 i = 0; i < 4; i++) {
+        item.sequence = i;
+        assert(mpmc_queue_push(&queue, &item), "Failed: Mpmc_Queue push");
+    }
+    assert(!mpmc_queue_push(&queue, &item), "Failed: Mpmc_Queue push on full queue should fail");
+    for (u64 i = 0; i < 4; i++) {
+        assert(mpmc_queue_pop(&queue, &item) && item.sequence == i, "Failed: Mpmc_Queue pop");
+    }
+    assert(!mpmc_queue_pop(&queue, &item), "Failed: Mpmc_Queue pop on empty queue should fail");
+    mpmc_queue_destroy(&queue);
+    
+    // Many spsc pairs at once
+    Spsc_Ring rings[QUEUE_TEST_NUM_PAIRS];
+    Queue_Test_Shared_Data pair_data[QUEUE_TEST_NUM_PAIRS];
+    Thread *threads = alloc(heap, sizeof(Thread)*QUEUE_TEST_NUM_PAIRS*2);
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PAIRS; i++) {
+        spsc_ring_init(&rings[i], sizeof(u64), 64, heap);
+        memset(&pair_data[i], 0, sizeof(pair_data[i]));
+        pair_data[i].ring = &rings[i];
+        pair_data[i].item_count = QUEUE_TEST_ITEMS_PER_PRODUCER;
+        os_thread_init(&threads[i*2+0], spsc_test_producer);
+        os_thread_init(&threads[i*2+1], spsc_test_consumer);
+        threads[i*2+0].data = &pair_data[i];
+        threads[i*2+1].data = &pair_data[i];
+    }
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PAIRS*2; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PAIRS*2; i++) os_thread_join(&threads[i]);
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PAIRS; i++) {
+        assert(spsc_ring_get_count(&rings[i]) == 0, "Failed: Spsc_Ring should be drained");
+        spsc_ring_destroy(&rings[i]);
+    }
+    dealloc(heap, threads);
+    
+    // Many producers & consumers on one mpmc queue
+    mpmc_queue_init(&queue, sizeof(Queue_Test_Item), 64, heap);
+    volatile u64 consumed_count = 0;
+    u64 total_count = QUEUE_TEST_NUM_PRODUCERS*QUEUE_TEST_ITEMS_PER_PRODUCER;
+    Queue_Test_Shared_Data mpmc_data[QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS];
+    threads = alloc(heap, sizeof(Thread)*(QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS));
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) {
+        memset(&mpmc_data[i], 0, sizeof(mpmc_data[i]));
+        mpmc_data[i].queue = &queue;
+        mpmc_data[i].producer = i;
+        mpmc_data[i].item_count = QUEUE_TEST_ITEMS_PER_PRODUCER;
+        mpmc_data[i].consumed_count = &consumed_count;
+        mpmc_data[i].total_count = total_count;
+        bool is_producer = i < QUEUE_TEST_NUM_PRODUCERS;
+        os_thread_init(&threads[i], is_producer ? mpmc_test_producer : mpmc_test_consumer);
+        threads[i].data = &mpmc_data[i];
+    }
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) os_thread_join(&threads[i]);
+    
+    u64 sum = 0;
+    for (u64 i = QUEUE_TEST_NUM_PRODUCERS; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) sum += mpmc_data[i].sum;
+    u64 expected_sum = QUEUE_TEST_NUM_PRODUCERS * ((u64)QUEUE_TEST_ITEMS_PER_PRODUCER*(QUEUE_TEST_ITEMS_PER_PRODUCER-1)/2);
+    assert(consumed_count == total_count, "Failed: Mpmc_Queue lost or duplicated items");
+    assert(sum == expected_sum, "Failed: Mpmc_Queue lost or duplicated items");
+    assert(!mpmc_queue_pop(&queue, &item), "Failed: Mpmc_Queue should be drained");
+    mpmc_queue_destroy(&queue);
+    dealloc(heap, threads);
+    
+    // Throughput
+    const u64 bench_count = 2000000;
+    
+    spsc_ring_init(&ring, sizeof(u64), 1024, heap);
+    Queue_Test_Shared_Data bench_data = {0};
+    bench_data.ring = &ring;
+    bench_data.item_count = bench_count;
+    Thread producer, consumer;
+    os_thread_init(&producer, spsc_test_producer);
+    os_thread_init(&consumer, spsc_test_consumer);
+    producer.data = &bench_data;
+    consumer.data = &bench_data;
+    float64 start_seconds = os_get_current_time_in_seconds();
+    os_thread_start(&producer);
+    os_thread_start(&consumer);
+    os_thread_join(&producer);
+    os_thread_join(&consumer);
+    float64 end_seconds = os_get_current_time_in_seconds();
+    spsc_ring_destroy(&ring);
+    print("Spsc_Ring 1 -> 1: %.2f million messages/s\n", ((f64)bench_count / (end_seconds-start_seconds)) / 1000000.0);
+    
+    mpmc_queue_init(&queue, sizeof(Queue_Test_Item), 1024, heap);
+    consumed_count = 0;
+    total_count = QUEUE_TEST_NUM_PRODUCERS*(bench_count/QUEUE_TEST_NUM_PRODUCERS);
+    threads = alloc(heap, sizeof(Thread)*(QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS));
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) {
+        memset(&mpmc_data[i], 0, sizeof(mpmc_data[i]));
+        mpmc_data[i].queue = &queue;
+        mpmc_data[i].producer = i;
+        mpmc_data[i].item_count = bench_count/QUEUE_TEST_NUM_PRODUCERS;
+        mpmc_data[i].consumed_count = &consumed_count;
+        mpmc_data[i].total_count = total_count;
+        bool is_producer = i < QUEUE_TEST_NUM_PRODUCERS;
+        os_thread_init(&threads[i], is_producer ? mpmc_test_producer : mpmc_test_consumer);
+        threads[i].data = &mpmc_data[i];
+    }
+    start_seconds = os_get_current_time_in_seconds();
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < QUEUE_TEST_NUM_PRODUCERS+QUEUE_TEST_NUM_CONSUMERS; i++) os_thread_join(&threads[i]);
+    end_seconds = os_get_current_time_in_seconds();
+    assert(consumed_count == total_count, "Failed: Mpmc_Queue lost or duplicated items");
+    mpmc_queue_destroy(&queue);
+    dealloc(heap, threads);
+    print("Mpmc_Queue %d -> %d: %.2f million messages/s\n", QUEUE_TEST_NUM_PRODUCERS, QUEUE_TEST_NUM_CONSUMERS, ((f64)total_count / (end_seconds-start_seconds)) / 1000000.0);
+}
+
 #ifndef OOGABOOGA_HEADLESS
 int compare_draw_quads(const void *a, const void *b) {
     return ((Draw_Quad*)a)->z-((Draw_Quad*)b)->z;
@@ -1297,6 +3874,204 @@ void test_sort() {
     
     print("Merge sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
 }
+void test_draw_xform() {
+    Draw_Frame saved_frame = draw_frame;
+    reset_draw_frame(&draw_frame);
+
+    // A projection where z moves x & y, so the z translation of the xform matters
+    draw_frame.projection = m4_make_orthographic_projection(-100, 100, -100, 100, -1, 10);
+    draw_frame.projection.m[0][2] = 0.05;
+    draw_frame.projection.m[1][2] = -0.03;
+    draw_frame.view = m4_translate(m4_scalar(1.0), v3(5, -5, 0));
+    Matrix4 xform = m4_translate(m4_scalar(1.0), v3(10, 20, 4));
+    Matrix4 world_to_clip = m4_mul(m4_mul(draw_frame.projection, m4_inverse(draw_frame.view)), xform);
+
+    Draw_Quad *q = draw_rect_xform(xform, v2(30, 40), COLOR_WHITE);
+    Vector2 bottom_left = m4_transform(world_to_clip, v4(0, 0, 0, 1)).xy;
+    Vector2 top_right   = m4_transform(world_to_clip, v4(30, 40, 0, 1)).xy;
+    assert(v2_length(v2_sub(q->bottom_left, bottom_left)) < 1e-5 && v2_length(v2_sub(q->top_right, top_right)) < 1e-5, "Failed: draw_rect_xform dropped the z of the xform with a 3D projection");
+
+    draw_frame = saved_frame;
+}
+void test_profiler_overlay() {
+    Draw_Frame saved_frame = draw_frame;
+    Profiler_Overlay saved_overlay = profiler_overlay;
+    reset_draw_frame(&draw_frame);
+    Matrix4 projection = draw_frame.projection;
+
+    profiler_overlay.enabled = true;
+    profiler_overlay.visible = true;
+    profiler_overlay.freeze_on_spike = false;
+    profiler_overlay.font = 0;
+    profiler_overlay.font_load_failed = false;
+    profiler_overlay.font_path = STR("ogb_test_missing_font.ttf");
+
+    // First update only starts the frame
+    profiler_overlay_update_and_draw();
+    assert(profiler_overlay.frame_count == 0, "Failed: profiler overlay counted a frame before it had a start");
+
+    _tm_scope_impl("Overlay scope") {}
+    profiler_overlay_update_and_draw();
+    assert(profiler_overlay.frame_count == 1 && profiler_overlay.frame_times_ms[0] > 0, "Failed: profiler overlay frame time");
+    assert(!profiler_overlay.font && profiler_overlay.font_load_failed, "Failed: profiler overlay did not load its font from profiler_overlay.font_path");
+    assert(draw_frame.num_quads > 0, "Failed: profiler overlay drew nothing");
+    assert(memcmp(&draw_frame.projection, &projection, sizeof(Matrix4)) == 0, "Failed: profiler overlay did not restore the projection");
+
+#if ENABLE_PROFILING
+    bool found = false;
+    for (u64 i = 0; i < profiler_overlay.record_count; i++) {
+        if (strcmp(profiler_overlay.records[i].name, "Overlay scope") == 0) found = true;
+    }
+    assert(found, "Failed: profiler overlay timeline is missing a scope from the last frame");
+    dealloc(get_heap_allocator(), profiler_overlay.records);
+#endif
+
+    profiler_overlay = saved_overlay;
+    draw_frame = saved_frame;
+}
+Draw_Quad *test_draw_batch_quads = 0;
+u64 test_draw_batch_first_quad = 0;
+// Every vertex must sample the texture of its quad from the slots the batch is drawn with
+void test_draw_batch_check_textures(Draw_Batch *batch) {
+    for (u64 i = 0; i < batch->quad_count; i++) {
+        Draw_Quad *q = &test_draw_batch_quads[test_draw_batch_first_quad+i];
+        s8 texture_index = batch->vertices[i*6].texture_index;
+        if (!q->image) {
+            assert(texture_index == -1, "Failed: draw batch quad without image has a texture");
+            continue;
+        }
+        assert(texture_index >= 0 && (u64)texture_index < batch->num_textures, "Failed: draw batch texture index %d out of %llu slots", texture_index, batch->num_textures);
+        assert(batch->textures[texture_index] == q->image->gfx_handle, "Failed: draw batch quad %llu samples the wrong texture", test_draw_batch_first_quad+i);
+    }
+    test_draw_batch_first_quad += batch->quad_count;
+}
+void test_draw_capture() {
+    Allocator heap = get_heap_allocator();
+
+    // Fake images, only the size & handle matter to the CPU side of the renderer
+    const u64 image_count = DRAW_BATCH_MAX_TEXTURES+8;
+    Gfx_Image images[DRAW_BATCH_MAX_TEXTURES+8];
+    for (u64 i = 0; i < image_count; i++) {
+        images[i] = ZERO(Gfx_Image);
+        images[i].width = 16+i;
+        images[i].height = 32;
+        images[i].channels = 4;
+        images[i].gfx_handle = (Gfx_Handle)(0x1000+i);
+    }
+
+    Draw_Frame saved_frame = draw_frame;
+    reset_draw_frame(&draw_frame);
+    draw_frame.enable_z_sorting = true;
+
+    push_window_scissor(v2(10, 20), v2(110, 220));
+    for (u64 i = 0; i < image_count; i++) {
+        push_z_layer((s32)(image_count-i));
+        draw_image(&images[i], v2(-0.5, -0.5), v2(0.1, 0.1), COLOR_WHITE);
+        pop_z_layer();
+    }
+    pop_window_scissor();
+    draw_rect(v2(0, 0), v2(0.1, 0.1), COLOR_RED);
+    u64 quad_count = draw_frame.num_quads;
+    assert(quad_count == image_count+1, "Failed: expected %llu quads, got %llu", image_count+1, quad_count);
+
+    // Offscreen quads are culled when drawn
+    draw_rect(v2(100, 100), v2(0.1, 0.1), COLOR_RED);
+    assert(draw_frame.num_quads == quad_count, "Failed: offscreen quad was not culled");
+
+    string path = STR("ogb_test_draw_capture.bin");
+    assert(draw_capture_start(path, 2), "Failed: draw_capture_start");
+    draw_capture_frame();
+    draw_capture_frame();
+    assert(draw_capture.frames_left == 0, "Failed: draw capture did not stop after 2 frames");
+
+    Draw_Replay replay;
+    assert(draw_replay_load(path, &replay, heap), "Failed: draw_replay_load");
+    assert(replay.frame_count == 2, "Failed: expected 2 replay frames, got %llu", replay.frame_count);
+    assert(replay.image_count == image_count, "Failed: expected %llu replay images, got %llu", image_count, replay.image_count);
+    assert(replay.max_quad_count == quad_count, "Failed: replay max_quad_count");
+    for (u64 f = 0; f < replay.frame_count; f++) {
+        Draw_Replay_Frame *frame = &replay.frames[f];
+        assert(frame->quad_count == quad_count, "Failed: replay frame quad count");
+        assert(frame->enable_z_sorting, "Failed: replay frame lost enable_z_sorting");
+        assert(frame->window_width == window.width && frame->window_height == window.height, "Failed: replay frame window size");
+        assert(memcmp(&frame->projection, &draw_frame.projection, sizeof(Matrix4)) == 0, "Failed: replay frame projection");
+        for (u64 i = 0; i < quad_count; i++) {
+            Draw_Quad *a = &quad_buffer[i];
+            Draw_Quad *b = &frame->quads[i];
+            assert(a->z == b->z && a->has_scissor == b->has_scissor && v2_length(v2_sub(a->top_right, b->top_right)) == 0, "Failed: replayed quad %llu differs", i);
+            if (a->image) {
+                assert(b->image && b->image->width == a->image->width && b->image->height == a->image->height, "Failed: replayed quad %llu has the wrong image", i);
+            } else {
+                assert(!b->image, "Failed: replayed quad %llu should not have an image", i);
+            }
+        }
+    }
+
+    Draw_Replay_Stats stats;
+    draw_replay_run(&replay, 3, &stats);
+    assert(stats.frames == 6, "Failed: expected 6 replayed frames, got %llu", stats.frames);
+    assert(stats.quads == quad_count*6, "Failed: replay quad count");
+    assert(stats.culled_quads == 0, "Failed: replay culled visible quads");
+    // More images than texture slots means one flush per frame
+    assert(stats.flushes == 6, "Failed: expected 6 texture limit flushes, got %llu", stats.flushes);
+    for (u64 s = 0; s < DRAW_REPLAY_STAGE_COUNT; s++) {
+        assert(stats.min_cycles[s] <= stats.max_cycles[s], "Failed: replay stage stats");
+    }
+    String_Builder report;
+    string_builder_init(&report, heap);
+    draw_replay_append_report(&stats, &report);
+    assert(string_find_from_left(report.result, STR("vertices")) >= 0, "Failed: replay report has no vertices stage");
+    dealloc(heap, report.buffer);
+
+    // Vertices
+    Draw_Quad *quads = replay.frames[0].quads;
+    draw_batch_sort_quads(quads, quad_count);
+    for (u64 i = 1; i < quad_count; i++) {
+        assert(quads[i].z >= quads[i-1].z, "Failed: draw_batch_sort_quads did not sort");
+    }
+    Draw_Vertex *vertices = alloc(heap, quad_count*6*sizeof(Draw_Vertex));
+    Draw_Batch batch = ZERO(Draw_Batch);
+    batch.vertices = vertices;
+    batch.window_width = 200;
+    batch.window_height = 300;
+    draw_batch_build_vertices(&batch, quads, 1);
+    assert(batch.quad_count == 1 && batch.num_textures == (quads[0].image ? 1 : 0), "Failed: draw_batch_build_vertices counts");
+    assert(vertices[0].position.x == quads[0].bottom_left.x && vertices[5].position.y == quads[0].bottom_right.y, "Failed: draw batch vertex positions");
+    assert(vertices[3].position.x == vertices[0].position.x && vertices[4].position.y == vertices[2].position.y, "Failed: draw batch second triangle");
+    if (quads[0].has_scissor) {
+        assert(vertices[0].scissor.y1 == 300-quads[0].scissor.y2 && vertices[0].scissor.y2 == 300-quads[0].scissor.y1, "Failed: draw batch scissor was not flipped");
+    }
+    
+    // More textures than slots, quads after the flush must still sample the right textures
+    batch = ZERO(Draw_Batch);
+    batch.vertices = vertices;
+    batch.window_width = 200;
+    batch.window_height = 300;
+    batch.flush = test_draw_batch_check_textures;
+    test_draw_batch_quads = quads;
+    test_draw_batch_first_quad = 0;
+    draw_batch_build_vertices(&batch, quads, quad_count);
+    assert(batch.flush_count == 1, "Failed: expected 1 texture limit flush, got %llu", batch.flush_count);
+    test_draw_batch_check_textures(&batch);
+    assert(test_draw_batch_first_quad == quad_count, "Failed: draw batch lost quads over a flush");
+
+    // Culling drops offscreen quads and keeps order
+    quads[1].bottom_left = quads[1].top_left = quads[1].top_right = quads[1].bottom_right = v2(5, 5);
+    s32 z2 = quads[2].z;
+    u64 visible = draw_batch_cull_quads(quads, quad_count);
+    assert(visible == quad_count-1 && quads[1].z == z2, "Failed: draw_batch_cull_quads");
+
+    dealloc(heap, vertices);
+    draw_replay_destroy(&replay);
+    os_file_delete_s(path);
+
+    // A file that isn't a capture
+    os_write_entire_file_s(path, STR("Hello there, this is not a draw capture at all"));
+    assert(!draw_replay_load(path, &replay, heap), "Failed: loaded garbage as a draw capture");
+    os_file_delete_s(path);
+
+    draw_frame = saved_frame;
+}
 #endif /* OOGABOOGA_HEADLESS */
 
 typedef struct Test_Thing {
@@ -1383,13 +4158,53 @@ void oogabooga_run_tests() {
 	test_strings();
 	print("OK!\n");
 	
+	print("Testing string search... ");
+	test_string_search();
+	print("OK!\n");
+	
+	print("Testing utf8... ");
+	test_utf8();
+	print("OK!\n");
+	
+	print("Testing chunked string builder... ");
+	test_chunked_string_builder();
+	print("OK!\n");
+	
+	print("Testing format... ");
+	test_format();
+	print("OK!\n");
+	
+	print("Testing parse... ");
+	test_parse();
+	print("OK!\n");
+	
 	print("Testing file IO... ");
 	test_file_io();
 	print("OK!\n");
 	
+	print("Testing async IO... ");
+	test_async_io();
+	print("OK!\n");
+	
+	print("Testing sockets... ");
+	test_sockets();
+	print("OK!\n");
+	
+	print("Testing async logger... ");
+	test_async_logger();
+	print("OK!\n");
+	
 	print("Testing linmath... ");
 	test_linmath();
 	print("OK!\n");
+	
+	print("Testing linmath batch... ");
+	test_linmath_batch();
+	print("OK!\n");
+	
+	print("Testing affine2... ");
+	test_affine2();
+	print("OK!\n");
 
 	print("Testing intmath... ");
 	test_intmath();
@@ -1399,6 +4214,10 @@ void oogabooga_run_tests() {
 	test_simd();
 	print("OK!\n");
 	
+	print("Testing simd dispatch... ");
+	test_simd_dispatch();
+	print("OK!\n");
+	
 	print("Testing hash table... ");
 	test_hash_table();
 	print("OK!\n");
@@ -1411,10 +4230,50 @@ void oogabooga_run_tests() {
 	test_mutex();
 	print("OK!\n");
 
+	print("Testing atomics... ");
+	test_atomics();
+	print("OK!\n");
+	
+	print("Testing reader-writer lock... ");
+	test_rw_lock();
+	print("OK!\n");
+	
+	print("Testing profiler... ");
+	test_profiler();
+	print("OK!\n");
+	
+	print("Testing metrics... ");
+	test_metrics();
+	print("OK!\n");
+	
+	print("Testing frame pacer... ");
+	test_frame_pacer();
+	print("OK!\n");
+	
+	print("Testing sampling profiler... ");
+	test_sampling_profiler();
+	print("OK!\n");
+	
+	print("Testing queues... ");
+	test_queues();
+	print("OK!\n");
+
 #ifndef OOGABOOGA_HEADLESS
 	print("Testing radix sort... ");
 	test_sort();
 	print("OK!\n");
+	
+	print("Testing draw xform... ");
+	test_draw_xform();
+	print("OK!\n");
+	
+	print("Testing profiler overlay... ");
+	test_profiler_overlay();
+	print("OK!\n");
+	
+	print("Testing draw capture... ");
+	test_draw_capture();
+	print("OK!\n");
 #endif
 
 	
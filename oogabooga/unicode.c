@@ -108,4 +108,449 @@ u32 next_utf8(string *s) {
 	if (result.error) return 0;
 
     return result.utf32;
-}
\ No newline at end of file
+}
+///
+// Bulk utf8
+// utf8_validate, utf8_decode_to_utf32 & utf8_to_utf16 skip over ascii 16 (SSE2) or 32 (AVX2)
+// bytes at a time and only go codepoint by codepoint where there's something else, so mostly
+// ascii text (which is most text in a game) goes through at memory speed.
+// With AVX2, utf8_validate checks everything in blocks of 32 bytes, with the lookup table
+// algorithm from "Validating UTF-8 In Less Than One Instruction Per Byte" (Keiser & Lemire).
+//
+// These are strict: overlong forms, surrogates and anything above U+10FFFF are invalid. The
+// decoders turn each invalid sequence into one UNI_REPLACEMENT_CHAR and carry on.
+// They follow simd_procs.level like the string search functions do.
+
+#define UTF8_INVALID 0xFFFFFFFF
+
+// Decodes one codepoint, p has count > 0 bytes. On an invalid sequence it returns UTF8_INVALID
+// and *length is how many bytes to skip: the lead byte and the continuation bytes that were
+// fine so far.
+inline u32
+_utf8_decode_one(const u8 *p, u64 count, u64 *length) {
+	u8 b0 = p[0];
+	if (b0 < 0x80) {
+		*length = 1;
+		return b0;
+	}
+
+	// Allowed range for the first continuation byte, from table 3-7 in the unicode standard
+	u64 continuation_bytes;
+	u32 c;
+	u8 lo = 0x80;
+	u8 hi = 0xBF;
+	if (b0 >= 0xC2 && b0 <= 0xDF) {
+		continuation_bytes = 1;
+		c = b0 & 0x1F;
+	} else if (b0 >= 0xE0 && b0 <= 0xEF) {
+		continuation_bytes = 2;
+		c = b0 & 0x0F;
+		if (b0 == 0xE0) lo = 0xA0; // Overlong
+		if (b0 == 0xED) hi = 0x9F; // Surrogates
+	} else if (b0 >= 0xF0 && b0 <= 0xF4) {
+		continuation_bytes = 3;
+		c = b0 & 0x07;
+		if (b0 == 0xF0) lo = 0x90; // Overlong
+		if (b0 == 0xF4) hi = 0x8F; // Above U+10FFFF
+	} else {
+		*length = 1;
+		return UTF8_INVALID;
+	}
+
+	for (u64 i = 1; i <= continuation_bytes; i++) {
+		if (i >= count || p[i] < lo || p[i] > hi) {
+			*length = i;
+			return UTF8_INVALID;
+		}
+		c = (c << 6) | (p[i] & 0x3F);
+		lo = 0x80;
+		hi = 0xBF;
+	}
+
+	*length = continuation_bytes+1;
+	return c;
+}
+
+// Scalar versions, also used for the parts that aren't ascii in the sse2 versions.
+bool
+_utf8_validate_scalar(const u8 *p, u64 count) {
+	u64 i = 0;
+	while (i < count) {
+		if (i + 8 <= count) {
+			u64 word;
+			memcpy(&word, p+i, 8);
+			if ((word & 0x8080808080808080ull) == 0) {
+				i += 8;
+				continue;
+			}
+		}
+		u64 length;
+		if (_utf8_decode_one(p+i, count-i, &length) == UTF8_INVALID) return false;
+		i += length;
+	}
+	return true;
+}
+u64
+_utf8_decode_to_utf32_scalar(const u8 *p, u64 count, u32 *out) {
+	u64 n = 0;
+	u64 i = 0;
+	while (i < count) {
+		u64 length;
+		u32 c = _utf8_decode_one(p+i, count-i, &length);
+		out[n++] = c == UTF8_INVALID ? UNI_REPLACEMENT_CHAR : c;
+		i += length;
+	}
+	return n;
+}
+// Writes c as utf16 and returns how many units it took
+inline u64
+_utf16_encode_one(u32 c, u16 *out) {
+	if (c < UTF16_SURROGATE_OFFSET) {
+		out[0] = (u16)c;
+		return 1;
+	}
+	c -= UTF16_SURROGATE_OFFSET;
+	out[0] = (u16)(UTF16_SURROGATE_HIGH_START + (c >> 10));
+	out[1] = (u16)(UTF16_SURROGATE_LOW_START  + (c & UTF16_SURROGATE_MASK));
+	return 2;
+}
+u64
+_utf8_to_utf16_scalar(const u8 *p, u64 count, u16 *out) {
+	u64 n = 0;
+	u64 i = 0;
+	while (i < count) {
+		u64 length;
+		u32 c = _utf8_decode_one(p+i, count-i, &length);
+		n += _utf16_encode_one(c == UTF8_INVALID ? UNI_REPLACEMENT_CHAR : c, out+n);
+		i += length;
+	}
+	return n;
+}
+
+#if COMPILER_CAN_DO_SSE2
+bool
+_utf8_validate_sse2(const u8 *p, u64 count) {
+	u64 i = 0;
+	while (i + 16 <= count) {
+		u32 mask = (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p+i)));
+		if (mask == 0) {
+			i += 16;
+			continue;
+		}
+		// Go codepoint by codepoint through the rest of the block
+		u64 end = i + 16;
+		i += bit_scan_forward_64(mask);
+		while (i < end) {
+			u64 length;
+			if (_utf8_decode_one(p+i, count-i, &length) == UTF8_INVALID) return false;
+			i += length;
+		}
+	}
+	return _utf8_validate_scalar(p+i, count-i);
+}
+u64
+_utf8_decode_to_utf32_sse2(const u8 *p, u64 count, u32 *out) {
+	__m128i zero = _mm_setzero_si128();
+	u64 n = 0;
+	u64 i = 0;
+	while (i + 16 <= count) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p+i));
+		u32 mask = (u32)_mm_movemask_epi8(v);
+		if (mask == 0) {
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			_mm_storeu_si128((__m128i*)(out+n),    _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(out+n+4),  _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(out+n+8),  _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128((__m128i*)(out+n+12), _mm_unpackhi_epi16(hi, zero));
+			i += 16;
+			n += 16;
+			continue;
+		}
+		u64 end = i + 16;
+		while (i < end) {
+			u64 length;
+			u32 c = _utf8_decode_one(p+i, count-i, &length);
+			out[n++] = c == UTF8_INVALID ? UNI_REPLACEMENT_CHAR : c;
+			i += length;
+		}
+	}
+	return n + _utf8_decode_to_utf32_scalar(p+i, count-i, out+n);
+}
+u64
+_utf8_to_utf16_sse2(const u8 *p, u64 count, u16 *out) {
+	__m128i zero = _mm_setzero_si128();
+	u64 n = 0;
+	u64 i = 0;
+	while (i + 16 <= count) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p+i));
+		u32 mask = (u32)_mm_movemask_epi8(v);
+		if (mask == 0) {
+			_mm_storeu_si128((__m128i*)(out+n),   _mm_unpacklo_epi8(v, zero));
+			_mm_storeu_si128((__m128i*)(out+n+8), _mm_unpackhi_epi8(v, zero));
+			i += 16;
+			n += 16;
+			continue;
+		}
+		u64 end = i + 16;
+		while (i < end) {
+			u64 length;
+			u32 c = _utf8_decode_one(p+i, count-i, &length);
+			n += _utf16_encode_one(c == UTF8_INVALID ? UNI_REPLACEMENT_CHAR : c, out+n);
+			i += length;
+		}
+	}
+	return n + _utf8_to_utf16_scalar(p+i, count-i, out+n);
+}
+#endif // COMPILER_CAN_DO_SSE2
+
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+
+// Error bits for each (previous byte, byte) pair. A pair is invalid when a bit is set in all
+// three lookups: high nibble of the previous byte, low nibble of the previous byte & high
+// nibble of the byte.
+#define _UTF8_TOO_SHORT      (1 << 0) // Lead byte followed by a lead byte or ascii
+#define _UTF8_TOO_LONG       (1 << 1) // Ascii followed by a continuation byte
+#define _UTF8_OVERLONG_3     (1 << 2)
+#define _UTF8_TOO_LARGE      (1 << 3)
+#define _UTF8_SURROGATE      (1 << 4)
+#define _UTF8_OVERLONG_2     (1 << 5)
+#define _UTF8_TOO_LARGE_1000 (1 << 6)
+#define _UTF8_OVERLONG_4     (1 << 6)
+#define _UTF8_TWO_CONTS      (1 << 7) // Continuation byte after a continuation byte
+#define _UTF8_CARRY          (_UTF8_TOO_SHORT | _UTF8_TOO_LONG | _UTF8_TWO_CONTS)
+
+// Table repeated for both 128 bit lanes, since that's how vpshufb works
+#define _UTF8_LOOKUP_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// The bytes of input shifted up by n, with the last n bytes of prev shifted in
+#define _utf8_prev_avx2(input, prev, n) _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev), (input), 0x21), 16-(n))
+
+target_avx2 __m256i
+_utf8_block_errors_avx2(__m256i input, __m256i prev_input) {
+	const __m256i byte_1_high_table = _UTF8_LOOKUP_TABLE(
+		// 0_______ ________ ascii in byte 1
+		_UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG,
+		_UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG, _UTF8_TOO_LONG,
+		// 10______ ________ continuation in byte 1
+		_UTF8_TWO_CONTS, _UTF8_TWO_CONTS, _UTF8_TWO_CONTS, _UTF8_TWO_CONTS,
+		// 1100____ ________
+		_UTF8_TOO_SHORT | _UTF8_OVERLONG_2,
+		// 1101____ ________
+		_UTF8_TOO_SHORT,
+		// 1110____ ________
+		_UTF8_TOO_SHORT | _UTF8_OVERLONG_3 | _UTF8_SURROGATE,
+		// 1111____ ________
+		_UTF8_TOO_SHORT | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000 | _UTF8_OVERLONG_4
+	);
+	const __m256i byte_1_low_table = _UTF8_LOOKUP_TABLE(
+		// ____0000 ________
+		_UTF8_CARRY | _UTF8_OVERLONG_3 | _UTF8_OVERLONG_2 | _UTF8_OVERLONG_4,
+		// ____0001 ________
+		_UTF8_CARRY | _UTF8_OVERLONG_2,
+		// ____001_ ________
+		_UTF8_CARRY,
+		_UTF8_CARRY,
+		// ____0100 ________
+		_UTF8_CARRY | _UTF8_TOO_LARGE,
+		// ____0101 ________ and up
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		// ____1101 ________
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000 | _UTF8_SURROGATE,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000,
+		_UTF8_CARRY | _UTF8_TOO_LARGE | _UTF8_TOO_LARGE_1000
+	);
+	const __m256i byte_2_high_table = _UTF8_LOOKUP_TABLE(
+		// ________ 0_______ ascii in byte 2
+		_UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT,
+		_UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT,
+		// ________ 1000____
+		_UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_OVERLONG_3 | _UTF8_TOO_LARGE_1000 | _UTF8_OVERLONG_4,
+		// ________ 1001____
+		_UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_OVERLONG_3 | _UTF8_TOO_LARGE,
+		// ________ 101_____
+		_UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_SURROGATE | _UTF8_TOO_LARGE,
+		_UTF8_TOO_LONG | _UTF8_OVERLONG_2 | _UTF8_TWO_CONTS | _UTF8_SURROGATE | _UTF8_TOO_LARGE,
+		// ________ 11______ lead byte in byte 2
+		_UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT, _UTF8_TOO_SHORT
+	);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+	__m256i prev1 = _utf8_prev_avx2(input, prev_input, 1);
+	__m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+	__m256i byte_1_low  = _mm256_shuffle_epi8(byte_1_low_table,  _mm256_and_si256(prev1, nibble));
+	__m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+	__m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+	// Continuation bytes 2 & 3 of 3 and 4 byte sequences must be continuations (TWO_CONTS),
+	// and nothing else may be two continuations in a row.
+	__m256i prev2 = _utf8_prev_avx2(input, prev_input, 2);
+	__m256i prev3 = _utf8_prev_avx2(input, prev_input, 3);
+	__m256i is_third_byte  = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0-0x80)));
+	__m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0-0x80)));
+	__m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8((char)0x80));
+
+	return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+// Nonzero where the block ends in the middle of a sequence
+target_avx2 __m256i
+_utf8_block_incomplete_avx2(__m256i input) {
+	const __m256i max_complete = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		(char)(0xF0-1), (char)(0xE0-1), (char)(0xC0-1)
+	);
+	return _mm256_subs_epu8(input, max_complete);
+}
+target_avx2 bool
+_utf8_validate_avx2(const u8 *p, u64 count) {
+	__m256i error = _mm256_setzero_si256();
+	__m256i prev_input = _mm256_setzero_si256();
+	__m256i prev_incomplete = _mm256_setzero_si256();
+
+	u64 i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i input = _mm256_loadu_si256((const __m256i*)(p+i));
+		if (_mm256_movemask_epi8(input) == 0) {
+			// All ascii, so the only possible error is the previous block not being finished
+			error = _mm256_or_si256(error, prev_incomplete);
+		} else {
+			error = _mm256_or_si256(error, _utf8_block_errors_avx2(input, prev_input));
+			prev_incomplete = _utf8_block_incomplete_avx2(input);
+		}
+		prev_input = input;
+	}
+
+	// The rest, padded with zeros. Zeros are ascii so they catch a sequence that was cut off,
+	// also when there's no rest.
+	u8 last[32] = {0};
+	memcpy(last, p+i, count-i);
+	__m256i input = _mm256_loadu_si256((const __m256i*)last);
+	error = _mm256_or_si256(error, _utf8_block_errors_avx2(input, prev_input));
+
+	return _mm256_testz_si256(error, error);
+}
+target_avx2 u64
+_utf8_decode_to_utf32_avx2(const u8 *p, u64 count, u32 *out) {
+	u64 n = 0;
+	u64 i = 0;
+	while (i + 32 <= count) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(p+i));
+		u32 mask = (u32)_mm256_movemask_epi8(v);
+		if (mask == 0) {
+			for (u64 j = 0; j < 32; j += 8) {
+				__m128i bytes = _mm_loadl_epi64((const __m128i*)(p+i+j));
+				_mm256_storeu_si256((__m256i*)(out+n+j), _mm256_cvtepu8_epi32(bytes));
+			}
+			i += 32;
+			n += 32;
+			continue;
+		}
+		u64 end = i + 32;
+		while (i < end) {
+			u64 length;
+			u32 c = _utf8_decode_one(p+i, count-i, &length);
+			out[n++] = c == UTF8_INVALID ? UNI_REPLACEMENT_CHAR : c;
+			i += length;
+		}
+	}
+	return n + _utf8_decode_to_utf32_scalar(p+i, count-i, out+n);
+}
+#endif // COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+
+// True if s is valid utf8
+bool
+utf8_validate(string s) {
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	if (simd_procs.level >= SIMD_LEVEL_AVX2) return _utf8_validate_avx2(s.data, s.count);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _utf8_validate_sse2(s.data, s.count);
+#endif
+	return _utf8_validate_scalar(s.data, s.count);
+}
+
+// Decodes all of s to out and returns how many codepoints that was.
+// out needs room for s.count codepoints, which is the most there can be.
+u64
+utf8_decode_to_utf32(string s, u32 *out) {
+#if COMPILER_CAN_DO_SSE2 && COMPILER_CAN_TARGET_AVX2
+	if (simd_procs.level >= SIMD_LEVEL_AVX2) return _utf8_decode_to_utf32_avx2(s.data, s.count, out);
+#endif
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _utf8_decode_to_utf32_sse2(s.data, s.count, out);
+#endif
+	return _utf8_decode_to_utf32_scalar(s.data, s.count, out);
+}
+
+// Converts all of s to out and returns how many utf16 units that was.
+// out needs room for s.count units, which is the most there can be.
+u64
+utf8_to_utf16(string s, u16 *out) {
+#if COMPILER_CAN_DO_SSE2
+	if (simd_procs.level >= SIMD_LEVEL_SSE) return _utf8_to_utf16_sse2(s.data, s.count, out);
+#endif
+	return _utf8_to_utf16_scalar(s.data, s.count, out);
+}
+
+// Converts count utf16 units to out and returns how many bytes that was. Unpaired surrogates
+// become UNI_REPLACEMENT_CHAR.
+// out needs room for count*3 bytes, which is the most there can be.
+u64
+utf16_to_utf8(const u16 *utf16, u64 count, u8 *out) {
+	u64 n = 0;
+	u64 i = 0;
+	while (i < count) {
+#if COMPILER_CAN_DO_SSE2
+		if (simd_procs.level >= SIMD_LEVEL_SSE) {
+			// 8 units at a time while they're ascii
+			while (i + 8 <= count) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(utf16+i));
+				__m128i not_ascii = _mm_and_si128(v, _mm_set1_epi16((s16)0xFF80));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(not_ascii, _mm_setzero_si128())) != 0xFFFF) break;
+				_mm_storel_epi64((__m128i*)(out+n), _mm_packus_epi16(v, v));
+				i += 8;
+				n += 8;
+			}
+			if (i >= count) break;
+		}
+#endif
+		u32 c = utf16[i];
+		if (c < 0x80) {
+			out[n++] = (u8)c;
+			i += 1;
+			continue;
+		}
+
+		if (c >= UTF16_SURROGATE_HIGH_START && c <= UTF16_SURROGATE_HIGH_END
+		 && i+1 < count && utf16[i+1] >= UTF16_SURROGATE_LOW_START && utf16[i+1] <= UTF16_SURROGATE_LOW_END) {
+			c = ((c - UTF16_SURROGATE_HIGH_START) << 10) + (utf16[i+1] - UTF16_SURROGATE_LOW_START) + UTF16_SURROGATE_OFFSET;
+			i += 2;
+		} else {
+			if (c >= UTF16_SURROGATE_HIGH_START && c <= UTF16_SURROGATE_LOW_END) c = UNI_REPLACEMENT_CHAR;
+			i += 1;
+		}
+
+		if (c < 0x800) {
+			out[n++] = (u8)(0xC0 | (c >> 6));
+			out[n++] = (u8)(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			out[n++] = (u8)(0xE0 | (c >> 12));
+			out[n++] = (u8)(0x80 | ((c >> 6) & 0x3F));
+			out[n++] = (u8)(0x80 | (c & 0x3F));
+		} else {
+			out[n++] = (u8)(0xF0 | (c >> 18));
+			out[n++] = (u8)(0x80 | ((c >> 12) & 0x3F));
+			out[n++] = (u8)(0x80 | ((c >> 6) & 0x3F));
+			out[n++] = (u8)(0x80 | (c & 0x3F));
+		}
+	}
+	return n;
+}